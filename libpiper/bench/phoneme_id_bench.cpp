@@ -0,0 +1,161 @@
+// Microbenchmark for phoneme to id conversion.
+//
+// Usage: phoneme_id_bench CONFIG [NUM_PHONEMES] [ITERATIONS]
+//
+// Maps a long phoneme sequence built from the voice config's phonemes with
+// the previous std::map lookup and with PhonemeIdTable.
+// Results are written to stdout as JSON.
+
+#include "json.hpp"
+#include "phoneme_id_table.hpp"
+#include "uni_algo.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+typedef std::map<Phoneme, std::vector<PhonemeId>> PhonemeIdMap;
+
+const PhonemeId ID_PAD = 0;
+
+// Time a mapping function over all iterations.
+// Returns the best time per phoneme in nanoseconds.
+template <typename MapFunc>
+static double time_mapping(const std::vector<Phoneme> &phonemes,
+                           int iterations, MapFunc map_phonemes,
+                           std::size_t &num_ids) {
+    std::vector<PhonemeId> ids;
+    ids.reserve(phonemes.size() * 4);
+
+    double best_ns = 0;
+    for (int i = 0; i < iterations; i++) {
+        ids.clear();
+
+        auto start_time = std::chrono::steady_clock::now();
+        map_phonemes(phonemes, ids);
+        auto end_time = std::chrono::steady_clock::now();
+
+        double ns =
+            std::chrono::duration<double, std::nano>(end_time - start_time)
+                .count() /
+            phonemes.size();
+        if ((i == 0) || (ns < best_ns)) {
+            best_ns = ns;
+        }
+    }
+
+    num_ids = ids.size();
+    return best_ns;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s CONFIG [NUM_PHONEMES] [ITERATIONS]\n",
+                     argv[0]);
+        return 1;
+    }
+
+    std::size_t num_phonemes =
+        (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+    int iterations = (argc > 3) ? std::atoi(argv[3]) : 20;
+
+    std::ifstream config_stream(argv[1]);
+    if (!config_stream) {
+        std::fprintf(stderr, "Failed to open %s\n", argv[1]);
+        return 1;
+    }
+    auto config = json::parse(config_stream);
+
+    // Build both structures from the same config
+    PhonemeIdMap id_map;
+    PhonemeIdTable id_table;
+    std::vector<Phoneme> known_phonemes;
+    for (auto &item : config["phoneme_id_map"].items()) {
+        std::string from_phoneme = item.key();
+        auto view = una::views::utf8(from_phoneme);
+        if (view.begin() == view.end()) {
+            continue;
+        }
+        Phoneme phoneme = *view.begin();
+
+        std::vector<PhonemeId> to_ids;
+        for (auto &to_id_value : item.value()) {
+            to_ids.push_back(to_id_value.get<PhonemeId>());
+        }
+
+        id_map[phoneme].insert(id_map[phoneme].end(), to_ids.begin(),
+                               to_ids.end());
+        id_table.add(phoneme, to_ids);
+        known_phonemes.push_back(phoneme);
+    }
+
+    if (known_phonemes.empty()) {
+        std::fprintf(stderr, "No phonemes in config\n");
+        return 1;
+    }
+
+    // Long text: cycle through phonemes with a stride, plus some unknowns
+    std::vector<Phoneme> phonemes(num_phonemes);
+    for (std::size_t i = 0; i < num_phonemes; i++) {
+        if ((i % 50) == 49) {
+            phonemes[i] = U'一';
+        } else {
+            phonemes[i] = known_phonemes[(i * 7) % known_phonemes.size()];
+        }
+    }
+
+    std::size_t map_num_ids = 0;
+    double map_ns = time_mapping(
+        phonemes, iterations,
+        [&id_map](const std::vector<Phoneme> &input,
+                  std::vector<PhonemeId> &ids) {
+            for (Phoneme phoneme : input) {
+                auto ids_for_phoneme = id_map.find(phoneme);
+                if (ids_for_phoneme != id_map.end()) {
+                    for (auto id : ids_for_phoneme->second) {
+                        ids.push_back(id);
+                        ids.push_back(ID_PAD);
+                    }
+                }
+            }
+        },
+        map_num_ids);
+
+    std::size_t table_num_ids = 0;
+    double table_ns = time_mapping(
+        phonemes, iterations,
+        [&id_table](const std::vector<Phoneme> &input,
+                    std::vector<PhonemeId> &ids) {
+            for (Phoneme phoneme : input) {
+                PhonemeIdSpan span = id_table.find(phoneme);
+                const PhonemeId *ids_for_phoneme = id_table.ids(span);
+                for (uint32_t i = 0; i < span.count; i++) {
+                    ids.push_back(ids_for_phoneme[i]);
+                    ids.push_back(ID_PAD);
+                }
+            }
+        },
+        table_num_ids);
+
+    if (map_num_ids != table_num_ids) {
+        std::fprintf(stderr, "Mismatch: %zu ids from map, %zu from table\n",
+                     map_num_ids, table_num_ids);
+        return 1;
+    }
+
+    std::printf("{\n  \"phonemes\": %zu,\n  \"iterations\": %d,\n"
+                "  \"results\": [\n"
+                "    {\"name\": \"std_map\", \"ns_per_phoneme\": %.2f},\n"
+                "    {\"name\": \"flat_table\", \"ns_per_phoneme\": %.2f}\n"
+                "  ]\n}\n",
+                num_phonemes, iterations, map_ns, table_ns);
+
+    return 0;
+}
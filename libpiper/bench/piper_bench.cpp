@@ -0,0 +1,549 @@
+// Benchmarks for libpiper.
+//
+// Usage: piper_bench MODEL ESPEAK_DATA [ITERATIONS]
+//
+// Runs on a fixed text corpus and measures:
+//
+// * cold start: piper_create_ex and the first inference
+// * steady-state piper_synthesize_next latency and heap allocations with
+//   onnxruntime's memory arena/pattern disabled (default) and enabled
+// * time to first chunk and real-time factor across text lengths and
+//   intra-op thread counts, with the stage timings from piper_get_stats
+// * throughput of concurrent contexts sharing one voice
+// * peak resident memory
+//
+// Results are written to stdout as JSON.
+
+#include "piper.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// ---- allocation counting ---
+
+// Replacing the global operator new counts C++ heap allocations made by
+// libpiper and onnxruntime (not raw malloc calls inside onnxruntime).
+static std::atomic<std::size_t> num_allocations{0};
+
+void *operator new(std::size_t size) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+// ---- corpus ---
+
+// Keep in sync with node/bench/bench.mjs
+struct CorpusText {
+    const char *name;
+    const char *text;
+};
+
+static const CorpusText CORPUS[] = {
+    {"short", "Hello, how can I help you today?"},
+    {"medium",
+     "The quick brown fox jumps over the lazy dog. "
+     "A journey of a thousand miles begins with a single step. "
+     "She sells sea shells by the sea shore. "
+     "How much wood would a woodchuck chuck if a woodchuck could chuck wood?"},
+    {"long",
+     "It was the best of times, it was the worst of times, it was the age of "
+     "wisdom, it was the age of foolishness, it was the epoch of belief, it "
+     "was the epoch of incredulity, it was the season of Light, it was the "
+     "season of Darkness, it was the spring of hope, it was the winter of "
+     "despair. We had everything before us, we had nothing before us. There "
+     "were a king with a large jaw and a queen with a plain face, on the "
+     "throne of England. There were a king with a large jaw and a queen with "
+     "a fair face, on the throne of France. In both countries it was clearer "
+     "than crystal to the lords of the State preserves of loaves and fishes, "
+     "that things in general were settled for ever."},
+};
+
+// Text used for latency, allocation and concurrency runs
+static const char *BENCH_TEXT = CORPUS[1].text;
+
+// ---- helpers ---
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+
+    std::sort(values.begin(), values.end());
+    std::size_t idx = static_cast<std::size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(idx, values.size() - 1)];
+}
+
+// Peak resident set size of the process in KiB (0 if unknown)
+static long peak_rss_kb() {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    // Bytes on macOS
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// Thread counts to compare, up to the number of cores
+static std::vector<int> thread_counts() {
+    int num_cores = (int)std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> counts;
+    for (int count = 1; count <= num_cores; count *= 2) {
+        counts.push_back(count);
+        if (count >= 8) {
+            break;
+        }
+    }
+
+    return counts;
+}
+
+// Synthesize a text to the end.
+// Returns false on error.
+static bool synthesize_text(piper_synthesizer *synth, const char *text,
+                            double &first_chunk_ms, double &audio_seconds) {
+    auto start_time = std::chrono::steady_clock::now();
+    if (piper_synthesize_start(synth, text, nullptr) != PIPER_OK) {
+        return false;
+    }
+
+    first_chunk_ms = 0;
+    audio_seconds = 0;
+    bool first = true;
+    piper_audio_chunk chunk;
+    while (true) {
+        int status = piper_synthesize_next(synth, &chunk);
+        if (status == PIPER_DONE) {
+            break;
+        }
+        if (status != PIPER_OK) {
+            return false;
+        }
+
+        if (first) {
+            first_chunk_ms = elapsed_ms(start_time);
+            first = false;
+        }
+        audio_seconds += (double)chunk.num_samples / chunk.sample_rate;
+    }
+
+    return true;
+}
+
+// ---- cold start ---
+
+struct ColdStartResult {
+    // First create in the process (onnxruntime and espeak-ng setup)
+    double create_ms = 0;
+    // Second create of the same voice
+    double reload_ms = 0;
+    double first_inference_ms = 0;
+    long peak_rss_kb = 0;
+};
+
+static bool run_cold_start(const char *model_path, const char *espeak_data_path,
+                           ColdStartResult &result) {
+    auto start_time = std::chrono::steady_clock::now();
+    piper_synthesizer *synth =
+        piper_create_ex(model_path, nullptr, espeak_data_path, nullptr);
+    result.create_ms = elapsed_ms(start_time);
+    if (!synth) {
+        return false;
+    }
+
+    start_time = std::chrono::steady_clock::now();
+    int status = piper_warmup(synth);
+    result.first_inference_ms = elapsed_ms(start_time);
+    result.peak_rss_kb = peak_rss_kb();
+    piper_free(synth);
+    if (status != PIPER_OK) {
+        return false;
+    }
+
+    start_time = std::chrono::steady_clock::now();
+    synth = piper_create_ex(model_path, nullptr, espeak_data_path, nullptr);
+    result.reload_ms = elapsed_ms(start_time);
+    if (!synth) {
+        return false;
+    }
+    piper_free(synth);
+
+    return true;
+}
+
+// ---- chunk latency and allocations ---
+
+struct BenchResult {
+    std::string name;
+    std::size_t num_chunks = 0;
+    std::size_t num_allocations = 0;
+    std::vector<double> latencies_ms;
+};
+
+static bool run_bench(const char *model_path, const char *espeak_data_path,
+                      const piper_create_options &create_options,
+                      int iterations, BenchResult &result) {
+    piper_synthesizer *synth =
+        piper_create_ex(model_path, nullptr, espeak_data_path, &create_options);
+    if (!synth) {
+        return false;
+    }
+
+    piper_audio_chunk chunk;
+    for (int i = 0; i < iterations + 1; i++) {
+        // First iteration is warm-up
+        bool measure = (i > 0);
+
+        if (piper_synthesize_start(synth, BENCH_TEXT, nullptr) != PIPER_OK) {
+            piper_free(synth);
+            return false;
+        }
+
+        while (true) {
+            std::size_t allocations_before = num_allocations.load();
+            auto start_time = std::chrono::steady_clock::now();
+
+            int status = piper_synthesize_next(synth, &chunk);
+
+            auto end_time = std::chrono::steady_clock::now();
+            std::size_t allocations_after = num_allocations.load();
+
+            if (status == PIPER_DONE) {
+                break;
+            }
+            if (status != PIPER_OK) {
+                piper_free(synth);
+                return false;
+            }
+
+            if (measure) {
+                result.num_chunks++;
+                result.num_allocations += allocations_after - allocations_before;
+                result.latencies_ms.push_back(
+                    std::chrono::duration<double, std::milli>(end_time -
+                                                              start_time)
+                        .count());
+            }
+        }
+    }
+
+    piper_free(synth);
+    return true;
+}
+
+// ---- throughput ---
+
+struct ThroughputResult {
+    std::string text_name;
+    int num_threads = 0;
+    std::vector<double> first_chunk_ms;
+    double wall_seconds = 0;
+    double audio_seconds = 0;
+    piper_stats stats = {};
+};
+
+static bool run_throughput(const char *model_path,
+                           const char *espeak_data_path,
+                           const CorpusText &text, int num_threads,
+                           int iterations, ThroughputResult &result) {
+    piper_create_options options = piper_default_create_options();
+    options.intra_op_num_threads = num_threads;
+
+    piper_synthesizer *synth =
+        piper_create_ex(model_path, nullptr, espeak_data_path, &options);
+    if (!synth) {
+        return false;
+    }
+
+    result.text_name = text.name;
+    result.num_threads = num_threads;
+
+    double first_chunk_ms = 0;
+    double audio_seconds = 0;
+    bool ok = synthesize_text(synth, text.text, first_chunk_ms, audio_seconds);
+    piper_reset_stats(synth);
+
+    for (int i = 0; ok && (i < iterations); i++) {
+        auto start_time = std::chrono::steady_clock::now();
+        ok = synthesize_text(synth, text.text, first_chunk_ms, audio_seconds);
+        result.wall_seconds += elapsed_ms(start_time) / 1000.0;
+        result.audio_seconds += audio_seconds;
+        result.first_chunk_ms.push_back(first_chunk_ms);
+    }
+
+    piper_get_stats(synth, &result.stats);
+    piper_free(synth);
+
+    return ok;
+}
+
+// ---- concurrency ---
+
+struct ConcurrencyResult {
+    int num_instances = 0;
+    double wall_seconds = 0;
+    double audio_seconds = 0;
+};
+
+// Each instance is a context of one shared voice, running on its own
+// thread with a single intra-op thread
+static bool run_concurrency(piper_voice *voice, int num_instances,
+                            int iterations, ConcurrencyResult &result) {
+    std::vector<piper_synthesis_context *> contexts;
+    for (int i = 0; i < num_instances; i++) {
+        piper_synthesis_context *context = piper_context_create(voice);
+        if (!context) {
+            break;
+        }
+        contexts.push_back(context);
+
+        // Warm up outside of the measurement
+        piper_warmup(context);
+    }
+
+    std::atomic<bool> ok{contexts.size() == (std::size_t)num_instances};
+    std::vector<double> audio_seconds(contexts.size(), 0.0);
+
+    auto start_time = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; ok && (i < contexts.size()); i++) {
+        threads.emplace_back([&, i] {
+            for (int j = 0; ok && (j < iterations); j++) {
+                double first_chunk_ms = 0;
+                double seconds = 0;
+                if (!synthesize_text(contexts[i], BENCH_TEXT, first_chunk_ms,
+                                     seconds)) {
+                    ok = false;
+                }
+                audio_seconds[i] += seconds;
+            }
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    result.num_instances = num_instances;
+    result.wall_seconds = elapsed_ms(start_time) / 1000.0;
+    for (double seconds : audio_seconds) {
+        result.audio_seconds += seconds;
+    }
+
+    for (piper_synthesis_context *context : contexts) {
+        piper_free(context);
+    }
+
+    return ok;
+}
+
+// ---- output ---
+
+static void print_stage_ms(const piper_stage_stats &stats, int iterations) {
+    double scale = 1000.0 / std::max(1, iterations);
+    std::printf("{\"phonemize\": %.3f, \"phoneme_ids\": %.3f, "
+                "\"inference\": %.3f, \"output\": %.3f}",
+                stats.phonemize_seconds * scale,
+                stats.phoneme_ids_seconds * scale,
+                stats.inference_seconds * scale, stats.output_seconds * scale);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::fprintf(stderr, "Usage: %s MODEL ESPEAK_DATA [ITERATIONS]\n",
+                     argv[0]);
+        return 1;
+    }
+
+    const char *model_path = argv[1];
+    const char *espeak_data_path = argv[2];
+    int iterations = (argc > 3) ? std::max(1, std::atoi(argv[3])) : 20;
+
+    // Must run first to include process-wide setup
+    ColdStartResult cold_start;
+    if (!run_cold_start(model_path, espeak_data_path, cold_start)) {
+        std::fprintf(stderr, "Benchmark failed: cold_start\n");
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+
+    {
+        BenchResult result;
+        result.name = "arena_disabled";
+        piper_create_options options = piper_default_create_options();
+        if (!run_bench(model_path, espeak_data_path, options, iterations,
+                       result)) {
+            std::fprintf(stderr, "Benchmark failed: %s\n", result.name.c_str());
+            return 1;
+        }
+        results.push_back(std::move(result));
+    }
+
+    {
+        BenchResult result;
+        result.name = "arena_enabled";
+        piper_create_options options = piper_default_create_options();
+        options.enable_cpu_mem_arena = true;
+        options.enable_mem_pattern = true;
+        if (!run_bench(model_path, espeak_data_path, options, iterations,
+                       result)) {
+            std::fprintf(stderr, "Benchmark failed: %s\n", result.name.c_str());
+            return 1;
+        }
+        results.push_back(std::move(result));
+    }
+
+    std::vector<int> counts = thread_counts();
+
+    std::vector<ThroughputResult> throughput;
+    for (const CorpusText &text : CORPUS) {
+        for (int num_threads : counts) {
+            ThroughputResult result;
+            if (!run_throughput(model_path, espeak_data_path, text,
+                                num_threads, iterations, result)) {
+                std::fprintf(stderr, "Benchmark failed: throughput %s\n",
+                             text.name);
+                return 1;
+            }
+            throughput.push_back(std::move(result));
+        }
+    }
+
+    std::vector<ConcurrencyResult> concurrency;
+    {
+        piper_create_options options = piper_default_create_options();
+        options.intra_op_num_threads = 1;
+        options.inter_op_num_threads = 1;
+        piper_voice *voice =
+            piper_voice_load(model_path, nullptr, espeak_data_path, &options);
+        if (!voice) {
+            std::fprintf(stderr, "Benchmark failed: concurrency\n");
+            return 1;
+        }
+
+        for (int num_instances : counts) {
+            ConcurrencyResult result;
+            if (!run_concurrency(voice, num_instances, iterations, result)) {
+                piper_voice_release(voice);
+                std::fprintf(stderr, "Benchmark failed: concurrency %d\n",
+                             num_instances);
+                return 1;
+            }
+            concurrency.push_back(result);
+        }
+
+        piper_voice_release(voice);
+    }
+
+    std::printf("{\n  \"iterations\": %d,\n", iterations);
+    std::printf("  \"cold_start\": {\"create_ms\": %.3f, \"reload_ms\": %.3f, "
+                "\"first_inference_ms\": %.3f, \"peak_rss_kb\": %ld},\n",
+                cold_start.create_ms, cold_start.reload_ms,
+                cold_start.first_inference_ms, cold_start.peak_rss_kb);
+
+    std::printf("  \"results\": [\n");
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const BenchResult &result = results[i];
+        double allocations_per_chunk =
+            result.num_chunks
+                ? static_cast<double>(result.num_allocations) / result.num_chunks
+                : 0;
+
+        std::printf("    {\"name\": \"%s\", \"chunks\": %zu, "
+                    "\"allocations_per_chunk\": %.1f, "
+                    "\"latency_ms\": {\"p50\": %.3f, \"p99\": %.3f}}%s\n",
+                    result.name.c_str(), result.num_chunks,
+                    allocations_per_chunk, percentile(result.latencies_ms, 0.5),
+                    percentile(result.latencies_ms, 0.99),
+                    (i + 1) < results.size() ? "," : "");
+    }
+    std::printf("  ],\n");
+
+    std::printf("  \"throughput\": [\n");
+    for (std::size_t i = 0; i < throughput.size(); i++) {
+        const ThroughputResult &result = throughput[i];
+        double rtf = (result.audio_seconds > 0)
+                         ? (result.wall_seconds / result.audio_seconds)
+                         : 0;
+
+        std::printf("    {\"text\": \"%s\", \"threads\": %d, "
+                    "\"audio_seconds\": %.3f, \"real_time_factor\": %.4f, "
+                    "\"first_chunk_ms\": {\"p50\": %.3f, \"p99\": %.3f}, "
+                    "\"stage_ms\": ",
+                    result.text_name.c_str(), result.num_threads,
+                    result.audio_seconds / iterations, rtf,
+                    percentile(result.first_chunk_ms, 0.5),
+                    percentile(result.first_chunk_ms, 0.99));
+        print_stage_ms(result.stats.total, iterations);
+        std::printf("}%s\n", (i + 1) < throughput.size() ? "," : "");
+    }
+    std::printf("  ],\n");
+
+    std::printf("  \"concurrency\": [\n");
+    double base_throughput = 0;
+    for (std::size_t i = 0; i < concurrency.size(); i++) {
+        const ConcurrencyResult &result = concurrency[i];
+
+        // Seconds of audio per second
+        double audio_throughput =
+            (result.wall_seconds > 0)
+                ? (result.audio_seconds / result.wall_seconds)
+                : 0;
+        if (i == 0) {
+            base_throughput = audio_throughput;
+        }
+
+        std::printf("    {\"instances\": %d, \"audio_per_second\": %.3f, "
+                    "\"scaling\": %.3f}%s\n",
+                    result.num_instances, audio_throughput,
+                    (base_throughput > 0) ? (audio_throughput / base_throughput)
+                                          : 0,
+                    (i + 1) < concurrency.size() ? "," : "");
+    }
+    std::printf("  ],\n");
+
+    std::printf("  \"peak_rss_kb\": %ld\n}\n", peak_rss_kb());
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+#ifndef PCM_CONVERT_H_
+#define PCM_CONVERT_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) ||            \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define PCM_CONVERT_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+// AVX is compiled per function and selected at runtime
+#define PCM_CONVERT_AVX 1
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PCM_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+// float32 -> int16 PCM, matching the JavaScript conversion
+//
+//   s = Math.max(-1, Math.min(1, sample))
+//   Math.round(s < 0 ? s * 32768 : s * 32767)
+//
+// with NaN written as 0. Samples are scaled in double, where the product
+// and the + 0.5 of round-half-up are exact for every float32 input, so
+// floor(scaled + 0.5) gives the same result as Math.round.
+
+inline int16_t float_to_int16_sample(float sample) {
+    double s = sample;
+    if (s != s) {
+        // NaN
+        return 0;
+    }
+
+    s = std::min(1.0, std::max(-1.0, s));
+    double scaled = (s < 0) ? (s * 32768.0) : (s * 32767.0);
+
+    return static_cast<int16_t>(std::floor(scaled + 0.5));
+}
+
+inline void float_to_int16_scalar(const float *samples, std::size_t num_samples,
+                                  int16_t *pcm) {
+    for (std::size_t i = 0; i < num_samples; i++) {
+        pcm[i] = float_to_int16_sample(samples[i]);
+    }
+}
+
+#ifdef PCM_CONVERT_SSE2
+
+// Scale and round 2 samples, results are in the low 2 int32 lanes
+inline __m128i float_to_int16_sse2_pd(__m128d s) {
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d half = _mm_set1_pd(0.5);
+
+    // NaN -> 0, then clamp
+    s = _mm_and_pd(s, _mm_cmpord_pd(s, s));
+    s = _mm_min_pd(_mm_max_pd(s, _mm_set1_pd(-1.0)), one);
+
+    __m128d negative = _mm_cmplt_pd(s, zero);
+    __m128d scale = _mm_or_pd(_mm_and_pd(negative, _mm_set1_pd(32768.0)),
+                              _mm_andnot_pd(negative, _mm_set1_pd(32767.0)));
+    __m128d x = _mm_add_pd(_mm_mul_pd(s, scale), half);
+
+    // floor(x): truncate, then step down where truncation rounded up
+    __m128d truncated = _mm_cvtepi32_pd(_mm_cvttpd_epi32(x));
+    __m128d adjust = _mm_and_pd(_mm_cmpgt_pd(truncated, x), one);
+
+    return _mm_cvttpd_epi32(_mm_sub_pd(truncated, adjust));
+}
+
+// Convert 4 samples to int32
+inline __m128i float_to_int16_sse2_ps(__m128 f) {
+    __m128i lo = float_to_int16_sse2_pd(_mm_cvtps_pd(f));
+    __m128i hi = float_to_int16_sse2_pd(_mm_cvtps_pd(_mm_movehl_ps(f, f)));
+
+    return _mm_unpacklo_epi64(lo, hi);
+}
+
+inline void float_to_int16_sse2(const float *samples, std::size_t num_samples,
+                                int16_t *pcm) {
+    std::size_t i = 0;
+    for (; (i + 8) <= num_samples; i += 8) {
+        __m128i lo = float_to_int16_sse2_ps(_mm_loadu_ps(samples + i));
+        __m128i hi = float_to_int16_sse2_ps(_mm_loadu_ps(samples + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pcm + i),
+                         _mm_packs_epi32(lo, hi));
+    }
+
+    float_to_int16_scalar(samples + i, num_samples - i, pcm + i);
+}
+
+#endif // PCM_CONVERT_SSE2
+
+#ifdef PCM_CONVERT_AVX
+
+// Convert 4 samples to int32
+__attribute__((target("avx"))) inline __m128i
+float_to_int16_avx_ps(__m128 f) {
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    __m256d s = _mm256_cvtps_pd(f);
+
+    // NaN -> 0, then clamp
+    s = _mm256_and_pd(s, _mm256_cmp_pd(s, s, _CMP_ORD_Q));
+    s = _mm256_min_pd(_mm256_max_pd(s, _mm256_set1_pd(-1.0)), one);
+
+    __m256d negative = _mm256_cmp_pd(s, _mm256_setzero_pd(), _CMP_LT_OQ);
+    __m256d scale = _mm256_blendv_pd(_mm256_set1_pd(32767.0),
+                                     _mm256_set1_pd(32768.0), negative);
+    __m256d x = _mm256_add_pd(_mm256_mul_pd(s, scale), _mm256_set1_pd(0.5));
+
+    return _mm256_cvttpd_epi32(_mm256_floor_pd(x));
+}
+
+__attribute__((target("avx"))) inline void
+float_to_int16_avx(const float *samples, std::size_t num_samples,
+                   int16_t *pcm) {
+    std::size_t i = 0;
+    for (; (i + 16) <= num_samples; i += 16) {
+        __m256 a = _mm256_loadu_ps(samples + i);
+        __m256 b = _mm256_loadu_ps(samples + i + 8);
+
+        __m128i a_lo = float_to_int16_avx_ps(_mm256_castps256_ps128(a));
+        __m128i a_hi = float_to_int16_avx_ps(_mm256_extractf128_ps(a, 1));
+        __m128i b_lo = float_to_int16_avx_ps(_mm256_castps256_ps128(b));
+        __m128i b_hi = float_to_int16_avx_ps(_mm256_extractf128_ps(b, 1));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pcm + i),
+                         _mm_packs_epi32(a_lo, a_hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pcm + i + 8),
+                         _mm_packs_epi32(b_lo, b_hi));
+    }
+
+    float_to_int16_sse2(samples + i, num_samples - i, pcm + i);
+}
+
+inline bool has_avx() {
+    static const bool supported = __builtin_cpu_supports("avx");
+    return supported;
+}
+
+#endif // PCM_CONVERT_AVX
+
+#ifdef PCM_CONVERT_NEON
+
+// Scale and round 2 samples
+inline int32x2_t float_to_int16_neon_pd(float64x2_t s) {
+    const float64x2_t one = vdupq_n_f64(1.0);
+
+    // NaN -> 0, then clamp
+    s = vreinterpretq_f64_u64(
+        vandq_u64(vreinterpretq_u64_f64(s), vceqq_f64(s, s)));
+    s = vminq_f64(vmaxq_f64(s, vdupq_n_f64(-1.0)), one);
+
+    uint64x2_t negative = vcltq_f64(s, vdupq_n_f64(0.0));
+    float64x2_t scale =
+        vbslq_f64(negative, vdupq_n_f64(32768.0), vdupq_n_f64(32767.0));
+    float64x2_t x = vaddq_f64(vmulq_f64(s, scale), vdupq_n_f64(0.5));
+
+    return vmovn_s64(vcvtq_s64_f64(vrndmq_f64(x)));
+}
+
+// Convert 4 samples to int32
+inline int32x4_t float_to_int16_neon_ps(float32x4_t f) {
+    int32x2_t lo = float_to_int16_neon_pd(vcvt_f64_f32(vget_low_f32(f)));
+    int32x2_t hi = float_to_int16_neon_pd(vcvt_high_f64_f32(f));
+
+    return vcombine_s32(lo, hi);
+}
+
+inline void float_to_int16_neon(const float *samples, std::size_t num_samples,
+                                int16_t *pcm) {
+    std::size_t i = 0;
+    for (; (i + 8) <= num_samples; i += 8) {
+        int32x4_t lo = float_to_int16_neon_ps(vld1q_f32(samples + i));
+        int32x4_t hi = float_to_int16_neon_ps(vld1q_f32(samples + i + 4));
+        vst1q_s16(pcm + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+
+    float_to_int16_scalar(samples + i, num_samples - i, pcm + i);
+}
+
+#endif // PCM_CONVERT_NEON
+
+// Convert samples with the best kernel for the CPU
+inline void float_to_int16(const float *samples, std::size_t num_samples,
+                           int16_t *pcm) {
+#if defined(PCM_CONVERT_AVX)
+    if (has_avx()) {
+        float_to_int16_avx(samples, num_samples, pcm);
+        return;
+    }
+#endif
+
+#if defined(PCM_CONVERT_SSE2)
+    float_to_int16_sse2(samples, num_samples, pcm);
+#elif defined(PCM_CONVERT_NEON)
+    float_to_int16_neon(samples, num_samples, pcm);
+#else
+    float_to_int16_scalar(samples, num_samples, pcm);
+#endif
+}
+
+// G.711 companding (8-bit telephony samples) from 16-bit PCM
+
+// Upper bound of each segment
+const int16_t G711_ULAW_SEGMENT_END[8] = {0x3F,  0x7F,  0xFF,   0x1FF,
+                                          0x3FF, 0x7FF, 0xFFF, 0x1FFF};
+const int16_t G711_ALAW_SEGMENT_END[8] = {0x1F,  0x3F,  0x7F,  0xFF,
+                                          0x1FF, 0x3FF, 0x7FF, 0xFFF};
+
+inline int g711_segment(int value, const int16_t *segment_end) {
+    int segment = 0;
+    while ((segment < 8) && (value > segment_end[segment])) {
+        segment++;
+    }
+
+    return segment;
+}
+
+inline uint8_t int16_to_ulaw(int16_t sample) {
+    // 14-bit magnitude plus bias
+    int value = sample >> 2;
+    int mask = 0xFF;
+    if (value < 0) {
+        value = -value;
+        mask = 0x7F;
+    }
+    value = std::min(value, 8159) + (0x84 >> 2);
+
+    int segment = g711_segment(value, G711_ULAW_SEGMENT_END);
+    if (segment >= 8) {
+        return (uint8_t)(0x7F ^ mask);
+    }
+
+    int ulaw = (segment << 4) | ((value >> (segment + 1)) & 0x0F);
+    return (uint8_t)(ulaw ^ mask);
+}
+
+inline uint8_t int16_to_alaw(int16_t sample) {
+    // 13-bit magnitude
+    int value = sample >> 3;
+    int mask = 0xD5;
+    if (value < 0) {
+        value = -value - 1;
+        mask = 0x55;
+    }
+
+    int segment = g711_segment(value, G711_ALAW_SEGMENT_END);
+    if (segment >= 8) {
+        return (uint8_t)(0x7F ^ mask);
+    }
+
+    int alaw = segment << 4;
+    if (segment < 2) {
+        alaw |= (value >> 1) & 0x0F;
+    } else {
+        alaw |= (value >> segment) & 0x0F;
+    }
+
+    return (uint8_t)(alaw ^ mask);
+}
+
+// Convert float samples to G.711 through 16-bit PCM
+template <uint8_t (*Encode)(int16_t)>
+inline void float_to_g711(const float *samples, std::size_t num_samples,
+                          uint8_t *output) {
+    int16_t block[256];
+    for (std::size_t offset = 0; offset < num_samples; offset += 256) {
+        std::size_t num_block_samples =
+            std::min(num_samples - offset, (std::size_t)256);
+        float_to_int16(samples + offset, num_block_samples, block);
+        for (std::size_t i = 0; i < num_block_samples; i++) {
+            output[offset + i] = Encode(block[i]);
+        }
+    }
+}
+
+#endif // PCM_CONVERT_H_
@@ -0,0 +1,74 @@
+#ifndef PHONEME_ID_TABLE_H_
+#define PHONEME_ID_TABLE_H_
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+typedef char32_t Phoneme;
+typedef int64_t PhonemeId;
+
+// Codepoints below this are looked up directly.
+// Covers ASCII, Latin, IPA extensions, modifier letters and combining marks.
+const Phoneme DIRECT_PHONEME_LIMIT = 0x0800;
+
+// Ids of one phoneme as a range of PhonemeIdTable::ids
+struct PhonemeIdSpan {
+    uint32_t offset = 0;
+    uint32_t count = 0;
+};
+
+// Flat phoneme -> [id] table.
+// All ids live in one array; common phonemes index a table of spans
+// directly and the rest go through a small hash map.
+class PhonemeIdTable {
+public:
+    PhonemeIdTable() : direct_(DIRECT_PHONEME_LIMIT) {}
+
+    // Append ids for a phoneme
+    void add(Phoneme phoneme, const std::vector<PhonemeId> &phoneme_ids) {
+        if (phoneme_ids.empty()) {
+            return;
+        }
+
+        PhonemeIdSpan &span = (phoneme < DIRECT_PHONEME_LIMIT)
+                                  ? direct_[phoneme]
+                                  : other_[phoneme];
+
+        // Keep each phoneme's ids contiguous
+        std::vector<PhonemeId> all_ids(ids_.begin() + span.offset,
+                                       ids_.begin() + span.offset + span.count);
+        all_ids.insert(all_ids.end(), phoneme_ids.begin(), phoneme_ids.end());
+
+        span.offset = static_cast<uint32_t>(ids_.size());
+        span.count = static_cast<uint32_t>(all_ids.size());
+        ids_.insert(ids_.end(), all_ids.begin(), all_ids.end());
+    }
+
+    // Ids for a phoneme (count is 0 if it has none)
+    PhonemeIdSpan find(Phoneme phoneme) const {
+        if (phoneme < DIRECT_PHONEME_LIMIT) {
+            return direct_[phoneme];
+        }
+
+        auto it = other_.find(phoneme);
+        if (it == other_.end()) {
+            return PhonemeIdSpan();
+        }
+
+        return it->second;
+    }
+
+    const PhonemeId *ids(PhonemeIdSpan span) const {
+        return ids_.data() + span.offset;
+    }
+
+    bool empty() const { return ids_.empty(); }
+
+private:
+    std::vector<PhonemeId> ids_;
+    std::vector<PhonemeIdSpan> direct_;
+    std::unordered_map<Phoneme, PhonemeIdSpan> other_;
+};
+
+#endif // PHONEME_ID_TABLE_H_
@@ -13,18 +13,114 @@ extern "C" {
 #define PIPER_OK 0
 #define PIPER_DONE 1
 #define PIPER_ERR_GENERIC -1
+#define PIPER_ERR_CANCELLED -2
+#define PIPER_ERR_TIMEOUT -3
+#define PIPER_ERR_SPEAKER_EMBEDDING -4
+
+/**
+ * \brief Size of a WAV header in bytes.
+ */
+#define PIPER_WAV_HEADER_SIZE 44
+
+/**
+ * \brief Sample count for a WAV header written before the length is known.
+ */
+#define PIPER_WAV_UNKNOWN_LENGTH ((size_t)-1)
 
 /**
  * \brief Text-to-speech synthesizer.
  */
 typedef struct piper_synthesizer piper_synthesizer;
 
+/**
+ * \brief Loaded voice model (config, phoneme map and model weights).
+ *
+ * A voice is immutable and reference counted, so any number of synthesis
+ * contexts can share one copy of the model.
+ *
+ * \sa \ref piper_voice_load
+ */
+typedef struct piper_voice piper_voice;
+
+/**
+ * \brief Per-stream synthesis state created from a voice.
+ *
+ * A context is a synthesizer: it is used with piper_synthesize_start and
+ * piper_synthesize_next, and freed with piper_free.
+ *
+ * \sa \ref piper_context_create
+ */
+typedef struct piper_synthesizer piper_synthesis_context;
+
+/**
+ * \brief Worker threads sharing one voice model between concurrent requests.
+ *
+ * \sa \ref piper_pool_create
+ */
+typedef struct piper_pool piper_pool;
+
+/**
+ * \brief Text submitted to a synthesizer pool.
+ *
+ * \sa \ref piper_pool_submit
+ */
+typedef struct piper_pool_request piper_pool_request;
+
+/**
+ * \brief Scheduler batching the sentences of concurrent requests.
+ *
+ * \sa \ref piper_batcher_create
+ */
+typedef struct piper_batcher piper_batcher;
+
+/**
+ * \brief WAV file written as audio is synthesized.
+ *
+ * \sa \ref piper_wav_writer_open
+ */
+typedef struct piper_wav_writer piper_wav_writer;
+
+/**
+ * \brief Audio samples detached from a synthesizer.
+ *
+ * \sa \ref piper_take_samples
+ */
+typedef struct piper_sample_buffer piper_sample_buffer;
+
+/**
+ * \brief Format of the samples in piper_audio_chunk.pcm_data.
+ */
+typedef enum piper_sample_format {
+  /**
+   * \brief 32-bit float samples, the raw model output.
+   */
+  PIPER_SAMPLE_FORMAT_FLOAT32 = 0,
+
+  /**
+   * \brief Signed 16-bit PCM samples (see \ref piper_float_to_int16).
+   */
+  PIPER_SAMPLE_FORMAT_INT16 = 1,
+
+  /**
+   * \brief 8-bit G.711 mu-law samples.
+   */
+  PIPER_SAMPLE_FORMAT_MULAW = 2,
+
+  /**
+   * \brief 8-bit G.711 A-law samples.
+   */
+  PIPER_SAMPLE_FORMAT_ALAW = 3,
+} piper_sample_format;
+
 /**
  * \brief Chunk of synthesized audio samples.
  */
 typedef struct piper_audio_chunk {
   /**
    * \brief Raw samples returned from the voice model.
+   *
+   * Samples are at sample_rate, which differs from the voice's rate when
+   * output_sample_rate is set.
    */
   const float *samples;
 
@@ -40,6 +136,11 @@ typedef struct piper_audio_chunk {
 
   /**
    * \brief True if this is the last audio chunk.
+   *
+   * With phonemize_lookahead, a chunk that is returned before phonemization
+   * has finished can't be known to be the last one, so synthesis may end
+   * with an extra chunk that has no phonemes and no samples apart from the
+   * resampler's tail.
    */
   bool is_last;
 
@@ -99,6 +200,24 @@ typedef struct piper_audio_chunk {
    * This should be the same as num_phoneme_ids.
    */
   size_t num_alignments;
+
+  /**
+   * \brief Samples in the sample_format of the synthesis options.
+   *
+   * For PIPER_SAMPLE_FORMAT_FLOAT32 this is the same memory as samples.
+   * Other formats are converted from samples, which stay available.
+   */
+  const void *pcm_data;
+
+  /**
+   * \brief Size of pcm_data in bytes.
+   */
+  size_t pcm_size;
+
+  /**
+   * \brief Format of pcm_data.
+   */
+  piper_sample_format sample_format;
 } piper_audio_chunk;
 
 /**
@@ -140,75 +259,1313 @@ typedef struct piper_synthesize_options {
    * For multi-speaker models, a value of 0.333 is usually good.
    */
   float noise_w_scale;
+
+  /**
+   * \brief Maximum number of phonemes per audio chunk or 0 for no limit.
+   *
+   * By default, each audio chunk is a full sentence.
+   * When set, long sentences are split at clause boundaries (commas, colons,
+   * and semicolons) so that earlier clauses can be heard while later ones are
+   * still being synthesized.
+   * A single clause is never split, even if it is longer than the limit.
+   * The default is 0.
+   */
+  int max_chunk_phonemes;
+
+  /**
+   * \brief Seconds of silence added after a chunk that ends mid-sentence.
+   *
+   * Only applies to chunks split by max_chunk_phonemes.
+   * The default is 0.
+   */
+  float clause_silence_seconds;
+
+  /**
+   * \brief Maximum number of sentences to synthesize in one inference call.
+   *
+   * Values above 1 pad consecutive sentences of similar length into a single
+   * batch, which improves throughput at the cost of a longer wait for the
+   * first chunk of each batch.
+   * Requires a voice model with alignments (see docs/ALIGNMENTS.md) to split
+   * the batch back into chunks; otherwise sentences are run one at a time.
+   * Chunks are still returned one per call in the original order.
+   * The default is 1.
+   */
+  int max_batch_sentences;
+
+  /**
+   * \brief Number of chunks to phonemize ahead of synthesis or 0 to
+   * phonemize all text up front.
+   *
+   * When set, piper_synthesize_start returns immediately and text is
+   * phonemized on a background thread, at most this many chunks ahead of
+   * piper_synthesize_next. Inference of one sentence then overlaps with
+   * phonemization of the next, and the time to the first chunk no longer
+   * grows with the length of the text.
+   * The default is 0.
+   */
+  int phonemize_lookahead;
+
+  /**
+   * \brief Format of the samples in piper_audio_chunk.pcm_data.
+   *
+   * The default is PIPER_SAMPLE_FORMAT_FLOAT32.
+   */
+  piper_sample_format sample_format;
+
+  /**
+   * \brief Sample rate of the audio in Hertz or 0 for the voice's rate.
+   *
+   * Audio is resampled with a polyphase windowed-sinc filter whose state
+   * carries over between chunks, so chunk boundaries stay seamless.
+   * Alignments are scaled to the new rate as well.
+   * The default is 0.
+   */
+  int output_sample_rate;
+
+  /**
+   * \brief Cache the audio of this text in the voice's synthesis cache.
+   *
+   * Audio is only cached when synthesis is deterministic, i.e. noise_scale
+   * and noise_w_scale are both 0, and only once the last chunk has been
+   * returned. Later requests with the same text and settings skip inference.
+   * Requires synthesis_cache_bytes in the create options.
+   * The default is false.
+   */
+  bool cache_audio;
+
+  /**
+   * \brief Time limit for the whole synthesis in milliseconds or 0 for none.
+   *
+   * Measured from piper_synthesize_start (or piper_pool_submit). Once it
+   * has passed, the remaining sentences are dropped and the next call
+   * returns PIPER_ERR_TIMEOUT. A sentence that is already being synthesized
+   * is finished first.
+   * The default is 0.
+   */
+  int timeout_ms;
+
+  /**
+   * \brief Precomputed speaker embedding or NULL.
+   *
+   * Required by models with a speaker_embedding input (see \ref
+   * piper_voice_has_speaker_embedding), which take the embedding directly
+   * instead of looking up speaker_id. Callers serving many speakers can
+   * keep one embedding per speaker. The values are copied when synthesis
+   * starts. Must be NULL for other models. Starting synthesis with a
+   * missing, unexpected or wrongly sized embedding returns
+   * PIPER_ERR_SPEAKER_EMBEDDING.
+   * The default is NULL.
+   */
+  const float *speaker_embedding;
+
+  /**
+   * \brief Number of floats in speaker_embedding.
+   */
+  size_t speaker_embedding_size;
+
+  /**
+   * \brief Batcher that runs inference for this request or NULL.
+   *
+   * Each sentence is queued on the batcher and synthesized in one
+   * inference call together with sentences of other requests, instead of
+   * on the synthesizer's own execution context. piper_synthesize_next
+   * blocks until the batch with its sentence has run.
+   * max_batch_sentences is ignored. Must share the synthesizer's voice.
+   * Ignored by pools.
+   * The default is NULL.
+   */
+  piper_batcher *batcher;
+
+  /**
+   * \brief Leave phonemes, phoneme ids and alignments out of audio chunks.
+   *
+   * Chunks only carry audio, which saves copying the metadata for callers
+   * that don't use it. Alignments are still computed internally where
+   * needed (e.g. to trim padding).
+   * The default is false.
+   */
+  bool skip_metadata;
 } piper_synthesize_options;
 
 /**
- * \brief Create a Piper text-to-speech synthesizer from a voice model.
- *
- * \param model_path path to ONNX voice model file.
- *
- * \param config_path path to JSON voice config file or NULL if it's the
- * model_path + .json.
- *
- * \param espeak_data_path path to the espeak-ng data
- * directory.
- *
- * \return a Piper text-to-speech synthesizer for the voice model.
+ * \brief Counters of a voice's synthesis cache.
  */
-piper_synthesizer *piper_create(const char *model_path, const char *config_path,
-                                const char *espeak_data_path);
+typedef struct piper_cache_stats {
+  /**
+   * \brief Texts whose phoneme ids were found in the cache.
+   */
+  uint64_t hits;
+
+  /**
+   * \brief Texts that had to be phonemized.
+   */
+  uint64_t misses;
+
+  /**
+   * \brief Requests with cache_audio whose audio was found in the cache.
+   */
+  uint64_t audio_hits;
+
+  /**
+   * \brief Requests with cache_audio that had to be synthesized.
+   */
+  uint64_t audio_misses;
+
+  /**
+   * \brief Entries dropped to stay within the memory budget.
+   */
+  uint64_t evictions;
+
+  /**
+   * \brief Number of cached entries.
+   */
+  size_t num_entries;
+
+  /**
+   * \brief Approximate memory used by cached entries in bytes.
+   */
+  size_t size_bytes;
+
+  /**
+   * \brief Memory budget in bytes (synthesis_cache_bytes).
+   */
+  size_t capacity_bytes;
+} piper_cache_stats;
 
 /**
- * \brief Free resources for Piper synthesizer.
+ * \brief Time spent in each stage of synthesis and the audio produced.
  *
- * \param synth Piper synthesizer.
+ * \sa \ref piper_stats
  */
-void piper_free(piper_synthesizer *synth);
+typedef struct piper_stage_stats {
+  /**
+   * \brief Seconds spent phonemizing text with espeak-ng.
+   */
+  double phonemize_seconds;
+
+  /**
+   * \brief Seconds spent normalizing phonemes (NFD) and mapping them to ids.
+   */
+  double phoneme_ids_seconds;
+
+  /**
+   * \brief Seconds spent running the voice model.
+   */
+  double inference_seconds;
+
+  /**
+   * \brief Seconds spent copying, splitting, resampling and converting
+   * audio after inference.
+   */
+  double output_seconds;
+
+  /**
+   * \brief Audio chunks returned.
+   */
+  uint64_t num_chunks;
+
+  /**
+   * \brief Audio samples returned, at the voice's sample rate.
+   */
+  uint64_t num_samples;
+
+  /**
+   * \brief Seconds of audio returned.
+   */
+  double audio_seconds;
+
+  /**
+   * \brief Time of all stages divided by audio_seconds or 0 without audio.
+   *
+   * Values below 1 are faster than real time. With phonemize_lookahead,
+   * phonemization overlaps inference, so the stages add up to more than
+   * the elapsed time.
+   */
+  double real_time_factor;
+} piper_stage_stats;
 
 /**
- * \brief Get the default synthesis options for a Piper synthesizer.
- *
- * \param synth Piper synthesizer.
+ * \brief Timings of a synthesizer.
  *
- * \return synthesis options from voice config.
+ * \sa \ref piper_get_stats
  */
-piper_synthesize_options
-piper_default_synthesize_options(piper_synthesizer *synth);
+typedef struct piper_stats {
+  /**
+   * \brief Calls to \ref piper_synthesize_start.
+   */
+  uint64_t num_requests;
+
+  /**
+   * \brief Totals since the synthesizer was created or the stats were reset.
+   */
+  piper_stage_stats total;
+
+  /**
+   * \brief Totals of the current (or most recent) request.
+   */
+  piper_stage_stats last_request;
+
+  /**
+   * \brief Chunks phonemized or synthesized ahead of \ref
+   * piper_synthesize_next, as of the last chunk returned.
+   */
+  size_t queue_depth;
+} piper_stats;
 
 /**
- * \brief Start text-to-speech synthesis.
- *
- * \param synth Piper synthesizer.
+ * \brief Settings of a batcher.
  *
- * \param text text to synthesize into audio.
- *
- * \param options synthesis options or NULL for defaults.
- *
- * \sa \ref piper_synthesize_next
- *
- * \return PIPER_OK or error code.
+ * \sa \ref piper_batcher_default_options
  */
-int piper_synthesize_start(piper_synthesizer *synth, const char *text,
-                           const piper_synthesize_options *options);
+typedef struct piper_batcher_options {
+  /**
+   * \brief Maximum number of sentences in one inference call.
+   *
+   * Larger batches raise throughput under load at the cost of longer
+   * inference calls. Voices without an alignments output can't be split
+   * after a batched call, so they always run one sentence at a time.
+   * The default is 8.
+   */
+  int max_batch_size;
+
+  /**
+   * \brief Maximum time in milliseconds a sentence waits for others to
+   * fill its batch.
+   *
+   * A batch runs once it is full or once its oldest sentence has waited
+   * this long. Every sentence may be delayed by up to this much in
+   * exchange for fewer, fuller inference calls; 0 runs whatever is queued
+   * as soon as the previous batch is done.
+   * The default is 5.
+   */
+  int max_wait_ms;
+} piper_batcher_options;
 
 /**
- * \brief Synthesize next chunk of audio.
+ * \brief Counters of a batcher.
  *
- * \param synth Piper synthesizer.
+ * \sa \ref piper_batcher_get_stats
+ */
+typedef struct piper_batcher_stats {
+  /**
+   * \brief Inference calls made.
+   */
+  uint64_t num_batches;
+
+  /**
+   * \brief Sentences synthesized (num_chunks / num_batches is the average
+   * batch size).
+   */
+  uint64_t num_chunks;
+
+  /**
+   * \brief Total seconds sentences waited in the queue before their batch
+   * started.
+   */
+  double queue_seconds;
+
+  /**
+   * \brief Total seconds spent running the voice model.
+   */
+  double inference_seconds;
+} piper_batcher_stats;
+
+/**
+ * \brief Progress of a document (see \ref piper_synthesize_document).
+ */
+typedef struct piper_document_progress {
+  /**
+   * \brief Bytes of text whose audio has been written.
+   *
+   * May run ahead by a clause when max_chunk_phonemes is set.
+   */
+  size_t text_bytes_done;
+
+  /**
+   * \brief Audio chunks (sentences) written.
+   */
+  size_t num_chunks;
+
+  /**
+   * \brief Seconds of audio written.
+   */
+  double audio_seconds;
+
+  /**
+   * \brief Seconds since synthesis of the document started.
+   */
+  double elapsed_seconds;
+
+  /**
+   * \brief elapsed_seconds divided by audio_seconds (0 without audio).
+   */
+  double real_time_factor;
+} piper_document_progress;
+
+/**
+ * \brief Reads the next part of a document.
  *
- * \param chunk audio chunk to fill.
+ * Called from a background thread with room for size bytes. Text may be
+ * cut anywhere, including inside a UTF-8 sequence.
  *
- * piper_synthesize_start must be called before this function.
- * Each call to piper_synthesize_next will fill the audio chunk, invalidating
- * the memory of the previous chunk.
- * The final audio chunk will have is_last = true.
- * A return value of PIPER_DONE indicates that synthesis is complete.
+ * \return number of bytes read, 0 at the end of the document, or a
+ * negative value on error.
+ */
+typedef int (*piper_read_text_callback)(void *user_data, char *buffer,
+                                        size_t size);
+
+/**
+ * \brief Receives an audio chunk of a document.
  *
- * \sa \ref piper_synthesize_start
+ * The chunk is only valid during the call.
  *
- * \return PIPER_DONE when complete, otherwise PIPER_OK or error code.
+ * \return 0 to continue or any other value to stop synthesis.
  */
-int piper_synthesize_next(piper_synthesizer *synth, piper_audio_chunk *chunk);
+typedef int (*piper_write_audio_callback)(void *user_data,
+                                          const piper_audio_chunk *chunk);
+
+/**
+ * \brief Receives the progress of a document after each chunk.
+ */
+typedef void (*piper_document_progress_callback)(
+    void *user_data, const piper_document_progress *progress);
+
+/**
+ * \brief Input, output and look-ahead of a document.
+ *
+ * \sa \ref piper_default_document_options
+ */
+typedef struct piper_document_options {
+  /**
+   * \brief Reads the text of the document (required).
+   */
+  piper_read_text_callback read_text;
+
+  /**
+   * \brief Receives each audio chunk (required).
+   */
+  piper_write_audio_callback write_audio;
+
+  /**
+   * \brief Receives progress after each chunk or NULL.
+   */
+  piper_document_progress_callback on_progress;
+
+  /**
+   * \brief Passed to every callback.
+   */
+  void *user_data;
+
+  /**
+   * \brief Chunks (sentences) phonemized ahead of synthesis.
+   *
+   * Together with the text read ahead (at most a few tens of kilobytes to
+   * reach the next sentence boundary), this bounds memory regardless of
+   * the document's length.
+   * The default is 8.
+   */
+  int lookahead_chunks;
+} piper_document_options;
+
+/**
+ * \brief Hardware used to run the voice model.
+ *
+ * Providers other than CPU require an onnxruntime build that includes them.
+ */
+typedef enum piper_execution_provider {
+  PIPER_PROVIDER_CPU = 0,
+  PIPER_PROVIDER_CUDA = 1,
+  PIPER_PROVIDER_COREML = 2,
+  PIPER_PROVIDER_DIRECTML = 3,
+} piper_execution_provider;
+
+/**
+ * \brief Graph optimizations applied by onnxruntime when loading a model.
+ */
+typedef enum piper_graph_optimization_level {
+  PIPER_GRAPH_OPTIMIZATION_DISABLE = 0,
+  PIPER_GRAPH_OPTIMIZATION_BASIC = 1,
+  PIPER_GRAPH_OPTIMIZATION_EXTENDED = 2,
+  PIPER_GRAPH_OPTIMIZATION_ALL = 99,
+} piper_graph_optimization_level;
+
+/**
+ * \brief Options for creating a synthesizer.
+ *
+ * \sa \ref piper_default_create_options
+ */
+typedef struct piper_create_options {
+  /**
+   * \brief Number of threads used within an operator or 0 for default.
+   *
+   * The onnxruntime default is one thread per physical core, which
+   * oversubscribes the CPU when many synthesizers run at once.
+   */
+  int intra_op_num_threads;
+
+  /**
+   * \brief Number of threads used across operators or 0 for default.
+   *
+   * Values above 1 enable parallel execution of independent graph nodes.
+   */
+  int inter_op_num_threads;
+
+  /**
+   * \brief Let idle threads spin instead of sleeping.
+   *
+   * Spinning lowers latency but burns CPU between requests.
+   * The default is true.
+   */
+  bool allow_spinning;
+
+  /**
+   * \brief Graph optimization level.
+   *
+   * The default is PIPER_GRAPH_OPTIMIZATION_ALL.
+   */
+  piper_graph_optimization_level graph_optimization_level;
+
+  /**
+   * \brief Execution provider used for inference.
+   *
+   * The default is PIPER_PROVIDER_CPU.
+   */
+  piper_execution_provider execution_provider;
+
+  /**
+   * \brief Device id for GPU execution providers.
+   *
+   * Id 0 is the first device.
+   */
+  int device_id;
+
+  /**
+   * \brief Run on the process-wide thread pool instead of private pools.
+   *
+   * All synthesizers created with this option share one set of threads,
+   * sized by \ref piper_init_global_thread_pool. The thread counts and
+   * spinning options above are ignored when this is set. Creating a
+   * synthesizer with this option throws std::runtime_error if another one
+   * was already created without it, since the pool can no longer be added.
+   * The default is false.
+   */
+  bool use_global_thread_pool;
+
+  /**
+   * \brief Use onnxruntime's CPU memory arena.
+   *
+   * The arena keeps freed tensor memory for reuse, which avoids allocator
+   * calls during steady-state synthesis at the cost of higher resident memory.
+   * The default is false.
+   */
+  bool enable_cpu_mem_arena;
+
+  /**
+   * \brief Let onnxruntime plan memory from previous runs with the same
+   * input shapes.
+   *
+   * The default is false.
+   */
+  bool enable_mem_pattern;
+
+  /**
+   * \brief Use model bytes passed to a from_memory function in place.
+   *
+   * Only applies to models in ORT format, whose initializers can then point
+   * into the caller's memory (e.g. a memory-mapped file shared between
+   * processes) instead of being copied. The bytes must stay valid and
+   * unchanged until the voice is freed.
+   * The default is false.
+   */
+  bool use_model_bytes_directly;
+
+  /**
+   * \brief Directory for optimized models or NULL to disable caching.
+   *
+   * The first load of a voice saves the graph optimized by onnxruntime to
+   * this directory, keyed on a hash of the model, the onnxruntime version,
+   * the optimization level and the execution provider. Later loads skip
+   * graph optimization by loading the cached model. With
+   * PIPER_GRAPH_OPTIMIZATION_ALL, cached models may be specific to the CPU
+   * they were created on, so don't share the directory across machines.
+   * The directory must already exist. The default is NULL.
+   */
+  const char *optimized_model_cache_dir;
+
+  /**
+   * \brief Memory budget of the voice's synthesis cache in bytes or 0 to
+   * disable it.
+   *
+   * The cache maps normalized text (NFC with runs of spaces and tabs
+   * collapsed, and the chunking options) to its phoneme ids, so repeated
+   * prompts skip espeak-ng and the id lookups. The normalized text is also
+   * what gets phonemized, so hits and misses return the same chunks.
+   * With cache_audio in the synthesis options, audio is cached as well.
+   * Least recently used entries are evicted to stay within the budget.
+   * The default is 0.
+   */
+  size_t synthesis_cache_bytes;
+
+  /**
+   * \brief Prefix of the onnxruntime profile file or NULL to disable
+   * profiling.
+   *
+   * onnxruntime records every operator run by the voice model and writes a
+   * JSON trace named <prefix>_<timestamp>.json (viewable in chrome://tracing)
+   * when \ref piper_voice_end_profiling is called or the voice is freed.
+   * Profiling slows down inference. The default is NULL.
+   */
+  const char *profile_file_prefix;
+
+  /**
+   * \brief Lengths that phoneme id sequences are padded up to or NULL.
+   *
+   * Every sentence otherwise gives the model a new input shape, which can
+   * make accelerator execution providers (CUDA, CoreML, TensorRT) plan or
+   * select kernels again, and keeps enable_mem_pattern from reusing its
+   * plans. With buckets, ids are padded with the pad id up to the smallest
+   * bucket that fits (longer sequences are left as they are), and the
+   * padding is trimmed from the audio using the alignments. Requires a
+   * voice with an alignments output (ignored otherwise). The lengths are
+   * copied. The default is NULL.
+   */
+  const int *length_buckets;
+
+  /**
+   * \brief Number of lengths in length_buckets.
+   */
+  size_t num_length_buckets;
+
+  /**
+   * \brief Run the model once per bucket length while loading the voice.
+   *
+   * Moves the first-run cost of every bucket shape out of the first
+   * requests. The default is false.
+   */
+  bool warmup_length_buckets;
+} piper_create_options;
+
+/**
+ * \brief Create the process-wide thread pool shared by synthesizers.
+ *
+ * Must be called before any synthesizer is created, since onnxruntime only
+ * allows a single environment per process. If it is never called, the first
+ * synthesizer created with use_global_thread_pool creates a pool with
+ * onnxruntime's default sizes.
+ *
+ * \param intra_op_num_threads threads used within an operator or 0 for
+ * default.
+ *
+ * \param inter_op_num_threads threads used across operators or 0 for default.
+ *
+ * \param allow_spinning let idle threads spin instead of sleeping.
+ *
+ * \return PIPER_OK or error code if a synthesizer was already created.
+ */
+int piper_init_global_thread_pool(int intra_op_num_threads,
+                                  int inter_op_num_threads, bool allow_spinning);
+
+/**
+ * \brief Get the default options for creating a synthesizer.
+ *
+ * \return default create options.
+ */
+piper_create_options piper_default_create_options(void);
+
+/**
+ * \brief Create a Piper text-to-speech synthesizer from a voice model.
+ *
+ * \param model_path path to ONNX voice model file.
+ *
+ * \param config_path path to JSON voice config file or NULL if it's the
+ * model_path + .json.
+ *
+ * \param espeak_data_path path to the espeak-ng data
+ * directory.
+ *
+ * \return a Piper text-to-speech synthesizer for the voice model.
+ */
+piper_synthesizer *piper_create(const char *model_path, const char *config_path,
+                                const char *espeak_data_path);
+
+/**
+ * \brief Create a Piper text-to-speech synthesizer with custom options.
+ *
+ * \param model_path path to ONNX voice model file.
+ *
+ * \param config_path path to JSON voice config file or NULL if it's the
+ * model_path + .json.
+ *
+ * \param espeak_data_path path to the espeak-ng data
+ * directory.
+ *
+ * \param options create options or NULL for defaults.
+ *
+ * \sa \ref piper_default_create_options
+ *
+ * \return a Piper text-to-speech synthesizer for the voice model.
+ */
+piper_synthesizer *piper_create_ex(const char *model_path,
+                                   const char *config_path,
+                                   const char *espeak_data_path,
+                                   const piper_create_options *options);
+
+/**
+ * \brief Create a Piper text-to-speech synthesizer from a voice in memory.
+ *
+ * \param model_data ONNX (or ORT format) model bytes, e.g. a memory-mapped
+ * file. Unless use_model_bytes_directly is set, the bytes are only read
+ * during this call.
+ *
+ * \param model_size size of model_data in bytes.
+ *
+ * \param config_json JSON voice config text.
+ *
+ * \param config_size size of config_json in bytes.
+ *
+ * \param espeak_data_path path to the espeak-ng data
+ * directory.
+ *
+ * \param options create options or NULL for defaults.
+ *
+ * \return a Piper text-to-speech synthesizer for the voice model.
+ */
+piper_synthesizer *
+piper_create_from_memory(const void *model_data, size_t model_size,
+                         const char *config_json, size_t config_size,
+                         const char *espeak_data_path,
+                         const piper_create_options *options);
+
+/**
+ * \brief Free resources for Piper synthesizer.
+ *
+ * \param synth Piper synthesizer.
+ */
+void piper_free(piper_synthesizer *synth);
+
+/**
+ * \brief Load a voice model to share between synthesis contexts.
+ *
+ * \param model_path path to ONNX voice model file.
+ *
+ * \param config_path path to JSON voice config file or NULL if it's the
+ * model_path + .json.
+ *
+ * \param espeak_data_path path to the espeak-ng data
+ * directory.
+ *
+ * \param options create options or NULL for defaults.
+ *
+ * \sa \ref piper_context_create
+ *
+ * \return a voice with one reference owned by the caller or NULL on error.
+ */
+piper_voice *piper_voice_load(const char *model_path, const char *config_path,
+                              const char *espeak_data_path,
+                              const piper_create_options *options);
+
+/**
+ * \brief Load a voice from memory to share between synthesis contexts.
+ *
+ * \param model_data ONNX (or ORT format) model bytes.
+ *
+ * \param model_size size of model_data in bytes.
+ *
+ * \param config_json JSON voice config text.
+ *
+ * \param config_size size of config_json in bytes.
+ *
+ * \param espeak_data_path path to the espeak-ng data
+ * directory.
+ *
+ * \param options create options or NULL for defaults.
+ *
+ * \sa \ref piper_create_from_memory
+ *
+ * \return a voice with one reference owned by the caller or NULL on error.
+ */
+piper_voice *piper_voice_load_from_memory(const void *model_data,
+                                          size_t model_size,
+                                          const char *config_json,
+                                          size_t config_size,
+                                          const char *espeak_data_path,
+                                          const piper_create_options *options);
+
+/**
+ * \brief Add a reference to a voice.
+ *
+ * \param voice Piper voice.
+ */
+void piper_voice_retain(piper_voice *voice);
+
+/**
+ * \brief Release a reference to a voice.
+ *
+ * The voice is freed once the last reference is released. Contexts created
+ * from the voice hold their own reference.
+ *
+ * \param voice Piper voice (may be NULL).
+ */
+void piper_voice_release(piper_voice *voice);
+
+/**
+ * \brief Get the counters of a voice's synthesis cache.
+ *
+ * \param voice Piper voice.
+ *
+ * \param stats cache counters (output).
+ *
+ * \return PIPER_OK or error code.
+ */
+int piper_voice_cache_stats(piper_voice *voice, piper_cache_stats *stats);
+
+/**
+ * \brief Remove all entries from a voice's synthesis cache.
+ *
+ * Counters are kept.
+ *
+ * \param voice Piper voice.
+ */
+void piper_voice_cache_clear(piper_voice *voice);
+
+/**
+ * \brief Check whether a voice takes a precomputed speaker embedding.
+ *
+ * \param voice Piper voice.
+ *
+ * \param size number of floats in an embedding, or 0 if the model accepts
+ * any size (output, may be NULL).
+ *
+ * \return true if synthesis requires speaker_embedding in the options.
+ */
+bool piper_voice_has_speaker_embedding(piper_voice *voice, size_t *size);
+
+/**
+ * \brief Stop onnxruntime profiling and write the profile file.
+ *
+ * Only has an effect if the voice was loaded with profile_file_prefix.
+ *
+ * \param voice Piper voice.
+ *
+ * \param path buffer for the NUL-terminated path of the profile file
+ * (truncated to fit) or NULL.
+ *
+ * \param path_size size of path in bytes.
+ *
+ * \return PIPER_OK or error code if profiling is not enabled.
+ */
+int piper_voice_end_profiling(piper_voice *voice, char *path,
+                              size_t path_size);
+
+/**
+ * \brief Create a synthesis context that shares a voice.
+ *
+ * Contexts are cheap: they only hold inference buffers and the state of
+ * one synthesis stream. Each context must only be used by one thread at a
+ * time, but contexts of the same voice may synthesize concurrently.
+ *
+ * \param voice Piper voice.
+ *
+ * \return a synthesis context (freed with piper_free) or NULL on error.
+ */
+piper_synthesis_context *piper_context_create(piper_voice *voice);
+
+/**
+ * \brief Get the voice of a synthesizer or synthesis context.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \return the voice, borrowed from the synthesizer (see
+ * \ref piper_voice_retain).
+ */
+piper_voice *piper_get_voice(piper_synthesizer *synth);
+
+/**
+ * \brief Get the default synthesis options for a Piper synthesizer.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \return synthesis options from voice config.
+ */
+piper_synthesize_options
+piper_default_synthesize_options(piper_synthesizer *synth);
+
+/**
+ * \brief Start text-to-speech synthesis.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \param text text to synthesize into audio.
+ *
+ * \param options synthesis options or NULL for defaults.
+ *
+ * \sa \ref piper_synthesize_next
+ *
+ * \return PIPER_OK or error code.
+ */
+int piper_synthesize_start(piper_synthesizer *synth, const char *text,
+                           const piper_synthesize_options *options);
+
+/**
+ * \brief Start synthesis of phonemes instead of text.
+ *
+ * For callers that phonemize elsewhere (a custom G2P, a lexicon service or
+ * another machine). espeak-ng and phoneme normalization are skipped: each
+ * codepoint is looked up in the voice's phoneme_id_map as it is, so
+ * phonemes must already be in that form (e.g. NFD). Every line (separated
+ * by '\n') is synthesized into its own chunk, with the pad, BOS and EOS ids
+ * added as for text. Unknown phonemes are skipped. max_chunk_phonemes,
+ * clause_silence_seconds and phonemize_lookahead are ignored, and nothing
+ * is cached.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \param phonemes UTF-32 phoneme codepoints.
+ *
+ * \param num_phonemes number of codepoints in phonemes.
+ *
+ * \param options synthesis options or NULL for defaults.
+ *
+ * \sa \ref piper_synthesize_next
+ *
+ * \return PIPER_OK or error code.
+ */
+int piper_synthesize_phonemes(piper_synthesizer *synth,
+                              const char32_t *phonemes, size_t num_phonemes,
+                              const piper_synthesize_options *options);
+
+/**
+ * \brief Start synthesis of UTF-8 phonemes instead of text.
+ *
+ * Same as \ref piper_synthesize_phonemes with UTF-8 input.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \param phonemes UTF-8 phonemes.
+ *
+ * \param options synthesis options or NULL for defaults.
+ *
+ * \return PIPER_OK or error code.
+ */
+int piper_synthesize_phonemes_utf8(piper_synthesizer *synth,
+                                   const char *phonemes,
+                                   const piper_synthesize_options *options);
+
+/**
+ * \brief Start synthesis of phoneme ids instead of text.
+ *
+ * Ids go to the model as they are, so they must include the pad, BOS and
+ * EOS ids the voice expects (e.g. ids cached from earlier chunks). A new
+ * chunk starts after every EOS id. Chunks have no phonemes. Options are
+ * ignored as for \ref piper_synthesize_phonemes.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \param ids phoneme ids.
+ *
+ * \param num_ids number of ids.
+ *
+ * \param options synthesis options or NULL for defaults.
+ *
+ * \sa \ref piper_synthesize_next
+ *
+ * \return PIPER_OK or error code (e.g. for a negative id).
+ */
+int piper_synthesize_ids(piper_synthesizer *synth, const int64_t *ids,
+                         size_t num_ids,
+                         const piper_synthesize_options *options);
+
+/**
+ * \brief Get default settings for a document.
+ *
+ * \return document options with default values and no callbacks.
+ */
+piper_document_options piper_default_document_options(void);
+
+/**
+ * \brief Synthesize a document of any length with bounded memory.
+ *
+ * Text is read incrementally with read_text and split at sentence
+ * boundaries, then phonemized on a background thread at most
+ * lookahead_chunks sentences ahead of synthesis. Each audio chunk goes to
+ * write_audio as soon as it's ready, so neither the text nor the audio of
+ * the whole document is ever held in memory. Blocks until the document is
+ * done, write_audio asks to stop, or synthesis is cancelled with \ref
+ * piper_synthesize_cancel from another thread.
+ *
+ * The synthesis cache and phonemize_lookahead are not used.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \param document document input, output and look-ahead.
+ *
+ * \param options synthesis options or NULL for defaults.
+ *
+ * \return PIPER_DONE when the whole document has been written,
+ * PIPER_ERR_CANCELLED if write_audio stopped synthesis or it was
+ * cancelled, or an error code.
+ */
+int piper_synthesize_document(piper_synthesizer *synth,
+                              const piper_document_options *document,
+                              const piper_synthesize_options *options);
+
+/**
+ * \brief Synthesize next chunk of audio.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \param chunk audio chunk to fill.
+ *
+ * piper_synthesize_start must be called before this function.
+ * Each call to piper_synthesize_next will fill the audio chunk, invalidating
+ * the memory of the previous chunk.
+ * The final audio chunk will have is_last = true.
+ * A return value of PIPER_DONE indicates that synthesis is complete.
+ *
+ * \sa \ref piper_synthesize_start
+ *
+ * \return PIPER_DONE when complete, otherwise PIPER_OK or error code.
+ */
+int piper_synthesize_next(piper_synthesizer *synth, piper_audio_chunk *chunk);
+
+/**
+ * \brief Cancel the synthesis in progress.
+ *
+ * Safe to call from any thread, including while another thread is in
+ * piper_synthesize_next. A running inference call is terminated, queued
+ * sentences are dropped, and piper_synthesize_next returns
+ * PIPER_ERR_CANCELLED until the next piper_synthesize_start.
+ *
+ * \param synth Piper synthesizer.
+ */
+void piper_synthesize_cancel(piper_synthesizer *synth);
+
+/**
+ * \brief Run a short dummy inference.
+ *
+ * onnxruntime initializes some kernels and allocations lazily on the first
+ * run. Warming up after creating a synthesizer moves that cost out of the
+ * first real request. Invalidates the memory of the last audio chunk.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \return PIPER_OK or error code.
+ */
+int piper_warmup(piper_synthesizer *synth);
+
+/**
+ * \brief Get the stage timings of a synthesizer.
+ *
+ * Safe to call from any thread, including while another thread is
+ * synthesizing.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \param stats timings (output).
+ *
+ * \return PIPER_OK or error code.
+ */
+int piper_get_stats(piper_synthesizer *synth, piper_stats *stats);
+
+/**
+ * \brief Reset the stage timings of a synthesizer to zero.
+ *
+ * \param synth Piper synthesizer.
+ */
+void piper_reset_stats(piper_synthesizer *synth);
+
+/**
+ * \brief Take ownership of the samples from the last audio chunk.
+ *
+ * Normally a chunk's samples are only valid until the next call to
+ * piper_synthesize_next. This transfers the memory behind chunk.samples to
+ * the caller without copying, so it stays valid (at the same address) until
+ * \ref piper_sample_buffer_free is called, even after the synthesizer is
+ * freed.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \param samples set to the sample data (may be NULL).
+ *
+ * \param num_samples set to the number of samples (may be NULL).
+ *
+ * \return sample buffer owned by the caller or NULL if the last chunk has
+ * no samples.
+ */
+piper_sample_buffer *piper_take_samples(piper_synthesizer *synth,
+                                        const float **samples,
+                                        size_t *num_samples);
+
+/**
+ * \brief Free samples taken with \ref piper_take_samples.
+ *
+ * \param buffer sample buffer (may be NULL).
+ */
+void piper_sample_buffer_free(piper_sample_buffer *buffer);
+
+/**
+ * \brief Convert float samples to signed 16-bit PCM.
+ *
+ * Samples are clamped to [-1, 1], scaled by 32768 (negative) or 32767
+ * (positive) and rounded half up. NaN becomes 0. Uses SIMD instructions
+ * when the CPU supports them.
+ *
+ * \param samples float samples.
+ *
+ * \param num_samples number of samples.
+ *
+ * \param pcm output with room for num_samples values.
+ */
+void piper_float_to_int16(const float *samples, size_t num_samples,
+                          int16_t *pcm);
+
+/**
+ * \brief Fill a 16-bit mono PCM WAV header.
+ *
+ * Streams whose length isn't known up front use PIPER_WAV_UNKNOWN_LENGTH,
+ * which sets the RIFF and data sizes to 0xFFFFFFFF. Most players then read
+ * until the end of the stream.
+ *
+ * \param sample_rate sample rate in Hertz.
+ *
+ * \param num_samples number of samples in the data chunk or
+ * PIPER_WAV_UNKNOWN_LENGTH.
+ *
+ * \param header output with room for PIPER_WAV_HEADER_SIZE bytes.
+ */
+void piper_wav_header(int sample_rate, size_t num_samples, uint8_t *header);
+
+/**
+ * \brief Open a WAV file to append audio to chunk by chunk.
+ *
+ * The header is written with unknown sizes, which are patched in by
+ * \ref piper_wav_writer_close if the file is seekable. Memory use does not
+ * grow with the length of the audio.
+ *
+ * \param path path of the file to create (overwritten if it exists).
+ *
+ * \param sample_rate sample rate in Hertz.
+ *
+ * \return a WAV writer or NULL if the file couldn't be created.
+ */
+piper_wav_writer *piper_wav_writer_open(const char *path, int sample_rate);
+
+/**
+ * \brief Append samples to a WAV file as 16-bit PCM.
+ *
+ * \param writer WAV writer.
+ *
+ * \param samples float samples (see \ref piper_float_to_int16).
+ *
+ * \param num_samples number of samples.
+ *
+ * \return PIPER_OK or error code.
+ */
+int piper_wav_writer_write(piper_wav_writer *writer, const float *samples,
+                           size_t num_samples);
+
+/**
+ * \brief Finish and close a WAV file.
+ *
+ * The writer is freed even if an error is returned.
+ *
+ * \param writer WAV writer (may be NULL).
+ *
+ * \return PIPER_OK or error code if the file couldn't be written.
+ */
+int piper_wav_writer_close(piper_wav_writer *writer);
+
+/**
+ * \brief Create a pool of worker threads for concurrent synthesis.
+ *
+ * Every worker has its own execution context (inference buffers and
+ * per-call state) but all of them share the model already loaded by synth,
+ * so memory does not grow with the number of workers. Sentences of each
+ * request are spread across the workers, and idle workers steal queued
+ * sentences from busy ones.
+ *
+ * The synthesizer is not used by the pool after this call and may be freed
+ * or keep synthesizing on its own.
+ * Since workers run inference concurrently, the synthesizer is best created
+ * with a small intra_op_num_threads (e.g. 1).
+ *
+ * \param synth Piper synthesizer whose model is shared.
+ *
+ * \param num_workers number of worker threads or 0 for one per CPU core.
+ *
+ * \return a Piper synthesizer pool or NULL on error.
+ */
+piper_pool *piper_pool_create(piper_synthesizer *synth, int num_workers);
+
+/**
+ * \brief Free resources for a synthesizer pool.
+ *
+ * Outstanding requests fail with an error and must still be freed with
+ * \ref piper_pool_request_free.
+ *
+ * \param pool Piper synthesizer pool.
+ */
+void piper_pool_free(piper_pool *pool);
+
+/**
+ * \brief Get the number of worker threads in a pool.
+ *
+ * \param pool Piper synthesizer pool.
+ *
+ * \return number of workers.
+ */
+int piper_pool_num_workers(piper_pool *pool);
+
+/**
+ * \brief Get the voice of a pool.
+ *
+ * \param pool Piper synthesizer pool.
+ *
+ * \return the voice, borrowed from the pool (see \ref piper_voice_retain).
+ */
+piper_voice *piper_pool_get_voice(piper_pool *pool);
+
+/**
+ * \brief Get default synthesis options for requests in a pool.
+ *
+ * \param pool Piper synthesizer pool.
+ *
+ * \return synthesis options from the voice config.
+ */
+piper_synthesize_options piper_pool_default_synthesize_options(piper_pool *pool);
+
+/**
+ * \brief Submit text to be synthesized by a pool.
+ *
+ * Text is phonemized on the calling thread, then the sentences are queued
+ * for the workers. Requests may be submitted from multiple threads at once.
+ * max_batch_sentences and phonemize_lookahead are ignored.
+ *
+ * \param pool Piper synthesizer pool.
+ *
+ * \param text text to synthesize.
+ *
+ * \param options synthesis options or NULL for defaults.
+ *
+ * \sa \ref piper_pool_next
+ *
+ * \return request owned by the caller or NULL on error.
+ */
+piper_pool_request *piper_pool_submit(piper_pool *pool, const char *text,
+                                      const piper_synthesize_options *options);
+
+/**
+ * \brief Get the next chunk of audio for a pool request.
+ *
+ * Chunks are returned in the order of the text, blocking until the next one
+ * has been synthesized. Each call invalidates the memory of the previous
+ * chunk from the same request.
+ *
+ * \param request Pool request.
+ *
+ * \param chunk audio chunk to fill.
+ *
+ * \return PIPER_DONE when complete, otherwise PIPER_OK or error code.
+ */
+int piper_pool_next(piper_pool_request *request, piper_audio_chunk *chunk);
+
+/**
+ * \brief Take ownership of the samples from the last chunk of a request.
+ *
+ * \param request Pool request.
+ *
+ * \param samples set to the sample data (may be NULL).
+ *
+ * \param num_samples set to the number of samples (may be NULL).
+ *
+ * \sa \ref piper_take_samples
+ *
+ * \return sample buffer owned by the caller or NULL if the last chunk has
+ * no samples.
+ */
+piper_sample_buffer *piper_pool_take_samples(piper_pool_request *request,
+                                             const float **samples,
+                                             size_t *num_samples);
+
+/**
+ * \brief Cancel a pool request.
+ *
+ * Safe to call from any thread, including while another thread is in
+ * piper_pool_next. Sentences that have not been synthesized yet are
+ * skipped, and piper_pool_next returns PIPER_ERR_CANCELLED.
+ *
+ * \param request Pool request.
+ */
+void piper_pool_request_cancel(piper_pool_request *request);
+
+/**
+ * \brief Free a pool request.
+ *
+ * Sentences of the request that have not been synthesized yet are skipped.
+ *
+ * \param request Pool request (may be NULL).
+ */
+void piper_pool_request_free(piper_pool_request *request);
+
+/**
+ * \brief Get default settings for a batcher.
+ *
+ * \return batcher options with default values.
+ */
+piper_batcher_options piper_batcher_default_options(void);
+
+/**
+ * \brief Create a scheduler that batches sentences across requests.
+ *
+ * Synthesis contexts of the same voice use the batcher by setting batcher
+ * in their synthesize options. Their sentences are queued, and a scheduler
+ * thread pads up to max_batch_size of them into one [batch, length] input
+ * (the real lengths go to input_lengths) for a single inference call, then
+ * hands each request its own audio. Sentences can only share a batch if
+ * their length_scale, noise_scale, noise_w_scale and speaker embedding
+ * size match; speaker ids may differ.
+ *
+ * This suits many short concurrent requests, where batching within one
+ * request (max_batch_sentences) has nothing to batch.
+ * The batcher has its own execution context for inference.
+ *
+ * \param voice Piper voice (a reference is held by the batcher).
+ *
+ * \param options batcher settings or NULL for defaults.
+ *
+ * \return a Piper batcher or NULL on error.
+ */
+piper_batcher *piper_batcher_create(piper_voice *voice,
+                                    const piper_batcher_options *options);
+
+/**
+ * \brief Free a batcher.
+ *
+ * Synthesis contexts that used the batcher keep it alive until their next
+ * piper_synthesize_start without it, or until they are freed.
+ *
+ * \param batcher Piper batcher (may be NULL).
+ */
+void piper_batcher_free(piper_batcher *batcher);
+
+/**
+ * \brief Get the counters of a batcher.
+ *
+ * \param batcher Piper batcher.
+ *
+ * \param stats counters to fill.
+ *
+ * \return PIPER_OK or error code.
+ */
+int piper_batcher_get_stats(piper_batcher *batcher, piper_batcher_stats *stats);
+
+/**
+ * \brief Reset the counters of a batcher.
+ *
+ * \param batcher Piper batcher.
+ */
+void piper_batcher_reset_stats(piper_batcher *batcher);
 
 #ifdef __cplusplus
 }
@@ -2,22 +2,31 @@
 #define PIPER_IMPL_H_
 
 #include "json.hpp"
+#include "pcm_convert.hpp"
+#include "phoneme_id_table.hpp"
+#include "resampler.hpp"
 #include "uni_algo.h"
 
-#include <map>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
 #include <stdint.h>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <onnxruntime_cxx_api.h>
 
-typedef char32_t Phoneme;
-typedef int64_t PhonemeId;
 typedef int64_t SpeakerId;
-typedef std::map<Phoneme, std::vector<PhonemeId>> PhonemeIdMap;
 
 const PhonemeId ID_PAD = 0; // interleaved
 const PhonemeId ID_BOS = 1; // beginning of sentence
@@ -34,10 +43,48 @@ const float DEFAULT_NOISE_W_SCALE = 0.8f;
 
 const int DEFAULT_HOP_LENGTH = 256;
 
+// Stop growing a batch once padding would exceed this much of the real ids
+const float MAX_BATCH_PADDING_RATIO = 1.5f;
+
+const int DEFAULT_BATCHER_MAX_BATCH_SIZE = 8;
+const int DEFAULT_BATCHER_MAX_WAIT_MS = 5;
+
+// Documents are read in blocks and phonemized one segment at a time.
+// Segments end at a sentence boundary, or at a space once they reach the
+// maximum size without one.
+const std::size_t DOCUMENT_READ_BLOCK_SIZE = 16384;
+const std::size_t DOCUMENT_MAX_SEGMENT_SIZE = 65536;
+const int DEFAULT_DOCUMENT_LOOKAHEAD_CHUNKS = 8;
+
+// FNV-1a (64-bit) for optimized model cache keys
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
 // onnx
-Ort::Env ort_env{ORT_LOGGING_LEVEL_WARNING, "piper"};
+// onnxruntime allows one environment per process, so it is created lazily.
+// Global thread pools can only be attached when the environment is created.
+struct OrtEnvState {
+    std::mutex mutex;
+    std::unique_ptr<Ort::Env> env;
+    bool has_global_thread_pool = false;
+};
+
+OrtEnvState ort_env_state;
 
 // espeak
+// espeak-ng keeps process-global state, so every call goes through one lock.
+// It is initialized by the first synthesizer and terminated with the last.
+// Only phonemization is serialized; inference runs in parallel.
+struct EspeakState {
+    std::mutex mutex;
+    int ref_count = 0;
+
+    // Voice currently loaded in espeak-ng
+    std::string current_voice;
+};
+
+EspeakState espeak_state;
+
 #define CLAUSE_INTONATION_FULL_STOP 0x00000000
 #define CLAUSE_INTONATION_COMMA 0x00001000
 #define CLAUSE_INTONATION_QUESTION 0x00002000
@@ -54,12 +101,413 @@ Ort::Env ort_env{ORT_LOGGING_LEVEL_WARNING, "piper"};
 #define CLAUSE_COLON (30 | CLAUSE_INTONATION_FULL_STOP | CLAUSE_TYPE_CLAUSE)
 #define CLAUSE_SEMICOLON (30 | CLAUSE_INTONATION_COMMA | CLAUSE_TYPE_CLAUSE)
 
-struct piper_synthesizer {
+// Phonemes and ids for one audio chunk (a sentence or clause group), as
+// ranges of a PhonemeIdArena
+struct PhonemeIdChunkSpan {
+    std::size_t phonemes_offset = 0;
+    std::size_t num_phonemes = 0;
+    std::size_t ids_offset = 0;
+    std::size_t num_ids = 0;
+
+    // Silence to append after the audio (clause splits only)
+    std::size_t silence_samples = 0;
+
+    // Bytes of text up to the end of this chunk (documents only)
+    std::size_t text_end = 0;
+};
+
+// Queue of chunks whose phonemes and ids are stored back to back in two
+// flat buffers. Buffers are cleared instead of freed, so their capacity
+// is reused by later requests.
+struct PhonemeIdArena {
+    std::vector<Phoneme> phonemes;
+    std::vector<PhonemeId> ids;
+    std::vector<PhonemeIdChunkSpan> chunks;
+
+    // Chunks before this one were already taken
+    std::size_t next_chunk = 0;
+
+    bool empty() const { return next_chunk >= chunks.size(); }
+    std::size_t size() const { return chunks.size() - next_chunk; }
+    const PhonemeIdChunkSpan &front() const { return chunks[next_chunk]; }
+    void pop() { next_chunk++; }
+
+    const Phoneme *chunk_phonemes(const PhonemeIdChunkSpan &span) const {
+        return phonemes.data() + span.phonemes_offset;
+    }
+
+    const PhonemeId *chunk_ids(const PhonemeIdChunkSpan &span) const {
+        return ids.data() + span.ids_offset;
+    }
+
+    void clear() {
+        phonemes.clear();
+        ids.clear();
+        chunks.clear();
+        next_chunk = 0;
+    }
+
+    // Copy a chunk from another arena
+    void append(const PhonemeIdArena &other, const PhonemeIdChunkSpan &span) {
+        PhonemeIdChunkSpan new_span = span;
+        new_span.phonemes_offset = phonemes.size();
+        new_span.ids_offset = ids.size();
+
+        const Phoneme *span_phonemes = other.chunk_phonemes(span);
+        phonemes.insert(phonemes.end(), span_phonemes,
+                        span_phonemes + span.num_phonemes);
+
+        const PhonemeId *span_ids = other.chunk_ids(span);
+        ids.insert(ids.end(), span_ids, span_ids + span.num_ids);
+
+        chunks.push_back(new_span);
+    }
+
+    // Drop taken chunks and move the rest to the front
+    void compact() {
+        if (next_chunk == 0) {
+            return;
+        }
+
+        if (empty()) {
+            clear();
+            return;
+        }
+
+        std::size_t phonemes_offset = chunks[next_chunk].phonemes_offset;
+        std::size_t ids_offset = chunks[next_chunk].ids_offset;
+        phonemes.erase(phonemes.begin(), phonemes.begin() + phonemes_offset);
+        ids.erase(ids.begin(), ids.begin() + ids_offset);
+        chunks.erase(chunks.begin(), chunks.begin() + next_chunk);
+        for (auto &span : chunks) {
+            span.phonemes_offset -= phonemes_offset;
+            span.ids_offset -= ids_offset;
+        }
+
+        next_chunk = 0;
+    }
+};
+
+// Stage timings of a synthesizer (see piper_stats).
+// The phonemize pipeline thread adds to them too, so access is locked.
+struct SynthesisStats {
+    std::mutex mutex;
+    piper_stats stats = {};
+
+    void add_time(double piper_stage_stats::*stage, double seconds) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.total.*stage += seconds;
+        stats.last_request.*stage += seconds;
+        update_real_time_factor(stats.total);
+        update_real_time_factor(stats.last_request);
+    }
+
+    void add_chunk(std::size_t num_samples, int sample_rate,
+                   std::size_t queue_depth) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (piper_stage_stats *stage : {&stats.total, &stats.last_request}) {
+            stage->num_chunks++;
+            stage->num_samples += num_samples;
+            stage->audio_seconds += (double)num_samples / sample_rate;
+            update_real_time_factor(*stage);
+        }
+        stats.queue_depth = queue_depth;
+    }
+
+    void start_request() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.num_requests++;
+        stats.last_request = {};
+        stats.queue_depth = 0;
+    }
+
+    piper_stats get() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats = {};
+    }
+
+    static void update_real_time_factor(piper_stage_stats &stage) {
+        double seconds = stage.phonemize_seconds + stage.phoneme_ids_seconds +
+                         stage.inference_seconds + stage.output_seconds;
+        stage.real_time_factor =
+            (stage.audio_seconds > 0) ? (seconds / stage.audio_seconds) : 0.0;
+    }
+};
+
+// Adds the time until it goes out of scope to a stage (if stats is set)
+class StageTimer {
+public:
+    StageTimer(SynthesisStats *stats, double piper_stage_stats::*stage)
+        : stats_(stats), stage_(stage),
+          start_(std::chrono::steady_clock::now()) {}
+
+    ~StageTimer() {
+        if (stats_) {
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start_;
+            stats_->add_time(stage_, elapsed.count());
+        }
+    }
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+    SynthesisStats *stats_;
+    double piper_stage_stats::*stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Clause phonemized by espeak-ng
+struct PhonemizedClause {
+    std::string phonemes;
+    bool ends_sentence = false;
+};
+
+// Phonemizes text incrementally, one chunk of clauses at a time.
+// The text is owned so a background thread can outlive the caller's string.
+struct TextPhonemizer {
+    std::string text;
+    const void *text_ptr = nullptr;
+    std::string espeak_voice;
+    int max_chunk_phonemes = 0;
+    std::size_t clause_silence_samples = 0;
+
+    // Next clause, read early to decide where to split
+    std::optional<PhonemizedClause> next_clause;
+
+    // Phonemes of the current chunk (reused between chunks)
+    std::string chunk_phonemes;
+
+    // Stats of the synthesizer or NULL
+    SynthesisStats *stats = nullptr;
+
+    // Reads the next segment of a document into text, or NULL if text is
+    // all there is
+    piper_read_text_callback read_text = nullptr;
+    void *read_text_user_data = nullptr;
+
+    // Document text read past the end of the current segment
+    std::string pending_text;
+    bool text_eof = false;
+
+    // Bytes of the document before text
+    std::size_t text_offset = 0;
+};
+
+// Background phonemization feeding a bounded queue (phonemize_lookahead > 0)
+struct PhonemizePipeline {
+    TextPhonemizer phonemizer;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    PhonemeIdArena chunks;
+    std::size_t capacity = 1;
+    bool done = false;
+    bool stop = false;
+    bool failed = false;
+};
+
+// Chunk whose audio is already synthesized (from a batch)
+struct SynthesizedChunk {
+    PhonemeIdChunkSpan source;
+    std::vector<float> samples;
+    std::vector<int> alignments;
+};
+
+// Approximate heap overhead of a cache entry beyond its buffers
+const std::size_t SYNTHESIS_CACHE_ENTRY_OVERHEAD = 256;
+
+// Cached phoneme ids of a text, and optionally its audio.
+// Sources of audio chunks are spans of phoneme_ids.
+struct SynthesisCacheEntry {
+    std::string key;
+    PhonemeIdArena phoneme_ids;
+    std::vector<SynthesizedChunk> audio;
+
+    std::size_t size_bytes() const {
+        std::size_t size = SYNTHESIS_CACHE_ENTRY_OVERHEAD + key.size() +
+                           (phoneme_ids.phonemes.size() * sizeof(Phoneme)) +
+                           (phoneme_ids.ids.size() * sizeof(PhonemeId)) +
+                           (phoneme_ids.chunks.size() *
+                            sizeof(PhonemeIdChunkSpan));
+        for (const auto &chunk : audio) {
+            size += sizeof(SynthesizedChunk) +
+                    (chunk.samples.size() * sizeof(float)) +
+                    (chunk.alignments.size() * sizeof(int));
+        }
+
+        return size;
+    }
+};
+
+// LRU cache of synthesis results for repeated text, limited to
+// capacity_bytes (0 disables it). Shared by all contexts of a voice.
+struct SynthesisCache {
+    std::mutex mutex;
+    std::size_t capacity_bytes = 0;
+    std::size_t size_bytes = 0;
+
+    // Most recently used first
+    std::list<SynthesisCacheEntry> entries;
+    std::unordered_map<std::string, std::list<SynthesisCacheEntry>::iterator>
+        index;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t audio_hits = 0;
+    uint64_t audio_misses = 0;
+    uint64_t evictions = 0;
+
+    bool enabled() const { return capacity_bytes > 0; }
+
+    // Copy a cached entry into phoneme_ids (and audio if not null).
+    // Returns false if the key isn't cached.
+    bool find(const std::string &key, bool is_audio, PhonemeIdArena &phoneme_ids,
+              std::vector<SynthesizedChunk> *audio) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(key);
+        if (found == index.end()) {
+            (is_audio ? audio_misses : misses)++;
+            return false;
+        }
+
+        (is_audio ? audio_hits : hits)++;
+        entries.splice(entries.begin(), entries, found->second);
+
+        const SynthesisCacheEntry &entry = *found->second;
+        phoneme_ids = entry.phoneme_ids;
+        if (audio) {
+            *audio = entry.audio;
+        }
+
+        return true;
+    }
+
+    // Add or replace an entry, evicting the least recently used ones
+    void insert(SynthesisCacheEntry &&entry) {
+        std::size_t entry_size = entry.size_bytes();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (entry_size > capacity_bytes) {
+            return;
+        }
+
+        auto found = index.find(entry.key);
+        if (found != index.end()) {
+            size_bytes -= found->second->size_bytes();
+            entries.erase(found->second);
+            index.erase(found);
+        }
+
+        while (!entries.empty() && (size_bytes + entry_size > capacity_bytes)) {
+            size_bytes -= entries.back().size_bytes();
+            index.erase(entries.back().key);
+            entries.pop_back();
+            evictions++;
+        }
+
+        entries.push_front(std::move(entry));
+        index[entries.front().key] = entries.begin();
+        size_bytes += entry_size;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+        size_bytes = 0;
+    }
+};
+
+// Results of the current synthesis to add to the cache when it finishes.
+// A key is empty if that result is already cached or not wanted.
+struct SynthesisCapture {
+    std::string phoneme_key;
+    std::string audio_key;
+    PhonemeIdArena phoneme_ids;
+    std::vector<SynthesizedChunk> audio;
+
+    bool active() const { return !phoneme_key.empty() || !audio_key.empty(); }
+
+    void clear() {
+        phoneme_key.clear();
+        audio_key.clear();
+        phoneme_ids.clear();
+        audio.clear();
+    }
+};
+
+// Model inputs that are fixed for a request.
+// Held by each synthesis context and pool request, and passed to every
+// inference call.
+struct RequestParams {
+    float length_scale = DEFAULT_LENGTH_SCALE;
+    float noise_scale = DEFAULT_NOISE_SCALE;
+    float noise_w_scale = DEFAULT_NOISE_W_SCALE;
+    SpeakerId speaker_id = 0;
+
+    // Precomputed speaker embedding (models with a speaker_embedding input)
+    std::vector<float> speaker_embedding;
+};
+
+// Inference state reused across piper_synthesize_next calls so that
+// steady-state synthesis doesn't allocate outside of onnxruntime.
+struct InferenceWorkspace {
+    Ort::MemoryInfo memory_info{nullptr};
+
+    // Cached from the session
+    std::vector<std::string> output_names_strs;
+    std::vector<const char *> output_names;
+
+    // Model inputs used by the voice, in tensor order
+    std::vector<const char *> input_names;
+
+    std::vector<Ort::Value> input_tensors;
+    std::vector<Ort::Value> output_tensors;
+
+    // Backing storage for input tensors.
+    // Sized for the largest batch seen so far.
+    std::vector<int64_t> batch_phoneme_ids;
+    std::array<int64_t, 2> phoneme_ids_shape{1, 0};
+    std::vector<int64_t> phoneme_id_lengths;
+    std::array<int64_t, 1> phoneme_id_lengths_shape{1};
+    std::array<float, 3> scales{0, 0, 0};
+    std::array<int64_t, 1> scales_shape{3};
+    std::vector<int64_t> speaker_ids;
+    std::array<int64_t, 1> speaker_ids_shape{1};
+    std::vector<float> speaker_embeddings;
+    std::array<int64_t, 2> speaker_embeddings_shape{1, 0};
+
+    // Ids padded up to a length bucket, and whether the last run was
+    std::vector<int64_t> bucket_phoneme_ids;
+    bool bucket_padded = false;
+
+    // Tensors of the request inputs (scales, sid, speaker_embedding) stay in
+    // input_tensors between runs. Values are written in place, so they are
+    // only recreated when their shape changes.
+    std::size_t request_inputs_batch_size = 0;
+
+    // Output shape (audio is [batch, 1, time])
+    std::array<int64_t, 4> output_shape{0, 0, 0, 0};
+};
+
+// Immutable voice shared by synthesis contexts (only the cache changes,
+// behind its own lock).
+// Freed with the last reference (piper_voice_release).
+struct piper_voice {
+    std::atomic<int> ref_count{1};
+
     // From config JSON file
     std::string espeak_voice;
     int sample_rate;
     int num_speakers;
-    PhonemeIdMap phoneme_id_map;
+    PhonemeIdTable phoneme_id_table;
     int hop_length = DEFAULT_HOP_LENGTH;
 
     // Default synthesis settings for the voice
@@ -68,24 +516,226 @@ struct piper_synthesizer {
     float synth_noise_w_scale = DEFAULT_NOISE_W_SCALE;
 
     // onnx
-    std::unique_ptr<Ort::Session> session;
-    Ort::AllocatorWithDefaultOptions session_allocator;
+    // Shared with sample buffers so their output tensors outlive the session
+    std::shared_ptr<Ort::Session> session;
     Ort::SessionOptions session_options;
-    Ort::Env session_env;
+
+    // Optional model inputs
+    bool has_sid_input = false;
+    bool has_speaker_embedding_input = false;
+    // 0 if the embedding size is dynamic
+    std::size_t speaker_embedding_size = 0;
+
+    // Sorted lengths that phoneme ids are padded up to (length_buckets)
+    std::vector<std::size_t> length_buckets;
+
+    // Set while onnxruntime profiling is on (profile_file_prefix)
+    std::atomic<bool> profiling{false};
+
+    SynthesisCache cache;
+};
+
+// Synthesis context (piper_synthesis_context) with per-request state
+struct piper_synthesizer {
+    // One reference is held for the lifetime of the context
+    piper_voice *voice = nullptr;
+    InferenceWorkspace workspace;
+
+    // Used for every inference call, so piper_synthesize_cancel can
+    // terminate the one in progress from another thread
+    Ort::RunOptions run_options;
+    std::atomic<bool> cancelled{false};
+
+    // From timeout_ms
+    bool has_deadline = false;
+    std::chrono::steady_clock::time_point deadline;
 
     // synthesize state
-    std::queue<std::pair<std::vector<Phoneme>, std::vector<PhonemeId>>>
-        phoneme_id_queue;
+    PhonemeIdArena phoneme_id_queue;
+    std::queue<SynthesizedChunk> synthesized_queue;
+    std::unique_ptr<PhonemizePipeline> pipeline;
+    int max_batch_sentences = 1;
+
+    // Chunk samples are either the audio output tensor (zero copy) or a
+    // copy in chunk_samples when they had to be modified. The tensor may be
+    // longer than the chunk (bucket padding), so its sample count is kept.
     std::vector<float> chunk_samples;
+    bool chunk_samples_in_tensor = false;
+    std::size_t chunk_tensor_samples = 0;
     std::vector<int> chunk_phoneme_ids;
-    std::vector<Phoneme> chunk_phonemes;
     std::vector<int> chunk_alignments;
-    float length_scale = DEFAULT_LENGTH_SCALE;
-    float noise_scale = DEFAULT_NOISE_SCALE;
-    float noise_w_scale = DEFAULT_NOISE_W_SCALE;
-    SpeakerId speaker_id = 0;
+    std::vector<uint8_t> chunk_pcm;
+    piper_sample_format sample_format = PIPER_SAMPLE_FORMAT_FLOAT32;
+    bool skip_metadata = false;
+
+    // A chunk was returned without is_last, so the end of the synthesis
+    // still needs an is_last chunk
+    bool last_chunk_pending = false;
+
+    // Text position of the last chunk returned (documents only)
+    std::size_t chunk_text_end = 0;
+
+    // Resampling to output_sample_rate (state spans one synthesis)
+    int output_sample_rate = 0;
+    Resampler resampler;
+    std::vector<float> resampled_samples;
+
+    SynthesisCapture capture;
+    SynthesisStats stats;
+
+    RequestParams params;
+
+    // From the batcher option (one reference held until the next request
+    // without it)
+    piper_batcher *batcher = nullptr;
+};
+
+// Samples detached from a synthesizer by piper_take_samples
+struct piper_sample_buffer {
+    std::shared_ptr<Ort::Session> session;
+    Ort::Value tensor{nullptr};
+    std::vector<float> samples;
+    const float *data = nullptr;
+    std::size_t size = 0;
+};
+
+// 16-bit PCM is written in blocks of this many samples
+const std::size_t WAV_WRITE_BLOCK_SAMPLES = 4096;
+
+struct piper_wav_writer {
+    std::FILE *file = nullptr;
+    int sample_rate = 0;
+    uint64_t num_samples = 0;
+    bool failed = false;
+
+    // Conversion buffer for one block
+    std::vector<int16_t> pcm;
+};
+
+// Result slot for one chunk of a pool request
+struct PoolChunk {
+    SynthesizedChunk synthesized;
+    bool ready = false;
+};
+
+// State of a pool request shared between the caller and the workers.
+// Workers keep it alive while they still hold tasks for the request.
+struct PoolRequestState {
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    // Phoneme ids of every chunk, filled when submitted and then read-only
+    PhonemeIdArena phoneme_ids;
+
+    // Sized when submitted, each slot is written by one worker
+    std::vector<PoolChunk> chunks;
+    bool failed = false;
+    bool cancelled = false;
+
+    // From timeout_ms
+    bool has_deadline = false;
+    std::chrono::steady_clock::time_point deadline;
+
+    RequestParams params;
+};
+
+// One chunk of a request to synthesize
+struct PoolTask {
+    std::shared_ptr<PoolRequestState> request;
+    std::size_t index = 0;
+};
+
+// Worker thread with its own execution context and task deque.
+// The owner takes tasks from the front, thieves from the back.
+struct PoolWorker {
+    piper_synthesizer *context = nullptr;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::deque<PoolTask> tasks;
 };
 
+struct piper_pool {
+    // Used for phonemization and defaults (one reference held)
+    piper_voice *voice = nullptr;
+    std::vector<std::unique_ptr<PoolWorker>> workers;
+
+    // Protects everything below
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::size_t num_queued = 0; // tasks in the deques not claimed by a worker
+    std::size_t next_worker = 0;
+    bool stop = false;
+};
+
+struct piper_pool_request {
+    std::shared_ptr<PoolRequestState> state;
+    int sample_rate = 0;
+    piper_sample_format sample_format = PIPER_SAMPLE_FORMAT_FLOAT32;
+    bool skip_metadata = false;
+    std::size_t next_index = 0;
+    Resampler resampler;
+
+    // Memory for the chunk returned by piper_pool_next
+    std::vector<float> chunk_samples;
+    std::vector<int> chunk_phoneme_ids;
+    std::vector<int> chunk_alignments;
+    std::vector<uint8_t> chunk_pcm;
+    std::vector<float> resampled_samples;
+};
+
+// Sentence of a synthesis context queued on a batcher.
+// Lives in piper_synthesize_next until its batch is done.
+struct BatcherItem {
+    const RequestParams *params = nullptr;
+    const PhonemeIdArena *phoneme_ids = nullptr;
+    std::chrono::steady_clock::time_point queued_at;
+
+    // source is set when queued, the rest by the scheduler
+    SynthesizedChunk synthesized;
+    double inference_seconds = 0.0;
+    int result = PIPER_OK;
+    bool running = false;
+    bool done = false;
+};
+
+struct piper_batcher {
+    // One reference for the creator and one for each context using it
+    std::atomic<int> ref_count{1};
+
+    // One reference held
+    piper_voice *voice = nullptr;
+
+    // Execution context of every batch
+    piper_synthesizer *context = nullptr;
+
+    std::size_t max_batch_size = 1;
+    std::chrono::milliseconds max_wait{0};
+    std::thread thread;
+
+    // Protects everything below
+    std::mutex mutex;
+    // Wakes the scheduler
+    std::condition_variable cond;
+    // Wakes contexts waiting for their sentence
+    std::condition_variable done_cond;
+    std::deque<BatcherItem *> queue;
+    piper_batcher_stats stats = {};
+    bool stop = false;
+};
+
+// Count the UTF-8 codepoints in a string
+std::size_t count_codepoints(const std::string &s) {
+    std::size_t count = 0;
+    for (unsigned char c : s) {
+        if ((c & 0xC0) != 0x80) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
 // Get the first UTF-8 codepoint of a string
 std::optional<Phoneme> get_codepoint(std::string s) {
     auto view = una::views::utf8(s);
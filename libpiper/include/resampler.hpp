@@ -0,0 +1,231 @@
+#ifndef RESAMPLER_H_
+#define RESAMPLER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <stdint.h>
+#include <vector>
+
+// Zero crossings of the sinc on each side of the center
+const int RESAMPLER_ZERO_CROSSINGS = 8;
+
+// Cutoff as a fraction of the lower Nyquist frequency
+const double RESAMPLER_ROLLOFF = 0.95;
+
+// Kaiser window shape (about 80 dB stopband)
+const double RESAMPLER_KAISER_BETA = 8.6;
+
+const double RESAMPLER_PI = 3.14159265358979323846;
+
+// Polyphase windowed-sinc resampler for a rate change of L/M.
+//
+// The input is treated as one continuous stream, so chunks can be passed
+// in as they are synthesized without clicks at the boundaries. The filter
+// is centered on each output sample (no delay), and the tail is produced
+// when the last block is flushed.
+class Resampler {
+public:
+    // Set up for a rate change and reset the stream.
+    // Filters are only rebuilt when the rates change.
+    void configure(int input_rate, int output_rate) {
+        if ((input_rate <= 0) || (output_rate <= 0) ||
+            (input_rate == output_rate)) {
+            upsample_ = 0;
+            downsample_ = 0;
+            bank_.clear();
+            reset();
+            return;
+        }
+
+        int64_t divisor = std::gcd((int64_t)input_rate, (int64_t)output_rate);
+        int64_t upsample = output_rate / divisor;
+        int64_t downsample = input_rate / divisor;
+        if ((upsample != upsample_) || (downsample != downsample_)) {
+            upsample_ = upsample;
+            downsample_ = downsample;
+            build_bank();
+        }
+
+        reset();
+    }
+
+    // True if samples need resampling
+    bool active() const { return upsample_ > 0; }
+
+    // Start a new stream with the same rates
+    void reset() {
+        // Samples before the stream are zero
+        history_.assign(num_taps_ > 0 ? num_taps_ - 1 : 0, 0.0f);
+        history_start_ = -(int64_t)history_.size();
+        num_input_ = 0;
+        next_output_ = 0;
+        flushed_ = false;
+    }
+
+    // Resample the next block of the stream into output.
+    // With flush set, the stream ends after this block.
+    void process(const float *input, std::size_t num_input, bool flush,
+                 std::vector<float> &output) {
+        output.clear();
+        if (flushed_) {
+            return;
+        }
+
+        history_.insert(history_.end(), input, input + num_input);
+        num_input_ += (int64_t)num_input;
+
+        int64_t end_output = INT64_MAX;
+        if (flush) {
+            // Enough outputs to cover the input, using zeros past the end
+            end_output =
+                ((num_input_ * upsample_) + downsample_ - 1) / downsample_;
+            if (end_output > next_output_) {
+                int64_t last_index = input_index(end_output - 1);
+                int64_t history_end =
+                    history_start_ + (int64_t)history_.size();
+                if (last_index >= history_end) {
+                    history_.resize(history_.size() +
+                                        (std::size_t)(last_index + 1 -
+                                                      history_end),
+                                    0.0f);
+                }
+            }
+
+            flushed_ = true;
+        }
+
+        output.reserve((std::size_t)scale((int64_t)num_input) + 1);
+
+        int64_t history_end = history_start_ + (int64_t)history_.size();
+        while (next_output_ < end_output) {
+            int64_t position = (next_output_ * downsample_) + center_;
+            int64_t index = position / upsample_;
+            if (index >= history_end) {
+                // Wait for more input
+                break;
+            }
+
+            const float *phase_taps =
+                bank_.data() + ((position % upsample_) * num_taps_);
+            const float *window =
+                history_.data() + (index - (int64_t)num_taps_ + 1 -
+                                   history_start_);
+
+            float sum = 0.0f;
+            for (std::size_t k = 0; k < num_taps_; k++) {
+                sum += phase_taps[k] * window[k];
+            }
+
+            output.push_back(sum);
+            next_output_++;
+        }
+
+        // Keep only the samples the next output still needs
+        int64_t first_needed =
+            input_index(next_output_) - (int64_t)num_taps_ + 1;
+        if (first_needed > history_start_) {
+            std::size_t num_drop = (std::size_t)std::min(
+                first_needed - history_start_, (int64_t)history_.size());
+            history_.erase(history_.begin(), history_.begin() + num_drop);
+            history_start_ += (int64_t)num_drop;
+        }
+    }
+
+    // Map an input sample count to the output rate (rounded)
+    int64_t scale(int64_t num_samples) const {
+        if (!active()) {
+            return num_samples;
+        }
+
+        return ((num_samples * upsample_) + (downsample_ / 2)) / downsample_;
+    }
+
+private:
+    // Last input sample used by an output sample
+    int64_t input_index(int64_t output) const {
+        return ((output * downsample_) + center_) / upsample_;
+    }
+
+    static double bessel_i0(double x) {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 50; k++) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+            if (term < (sum * 1e-12)) {
+                break;
+            }
+        }
+
+        return sum;
+    }
+
+    // Split a windowed-sinc lowpass into one filter per phase.
+    // Taps of each phase are stored in input order for the dot product.
+    void build_bank() {
+        double ratio = (double)upsample_ / (double)downsample_;
+        double cutoff = 0.5 * std::min(1.0, ratio) * RESAMPLER_ROLLOFF;
+
+        // Input samples between zero crossings of the sinc
+        double spacing = 0.5 / cutoff;
+        num_taps_ = 2 * (std::size_t)std::ceil(RESAMPLER_ZERO_CROSSINGS *
+                                               spacing);
+
+        int64_t length = upsample_ * (int64_t)num_taps_;
+        center_ = length / 2;
+
+        bank_.assign((std::size_t)length, 0.0f);
+        double window_scale = 1.0 / bessel_i0(RESAMPLER_KAISER_BETA);
+        for (int64_t phase = 0; phase < upsample_; phase++) {
+            float *phase_taps = bank_.data() + (phase * num_taps_);
+            double phase_sum = 0.0;
+
+            for (std::size_t k = 0; k < num_taps_; k++) {
+                // Prototype tap for input (index - (num_taps - 1 - k))
+                int64_t j = phase + (upsample_ * (int64_t)(num_taps_ - 1 - k));
+                double t = (double)(j - center_) / (double)upsample_;
+                double x = (double)(j - center_) / (double)center_;
+
+                double sinc_arg = 2.0 * cutoff * t;
+                double sinc = (sinc_arg == 0.0)
+                                  ? 1.0
+                                  : std::sin(RESAMPLER_PI * sinc_arg) /
+                                        (RESAMPLER_PI * sinc_arg);
+                double window =
+                    (std::abs(x) >= 1.0)
+                        ? 0.0
+                        : bessel_i0(RESAMPLER_KAISER_BETA *
+                                    std::sqrt(1.0 - (x * x))) *
+                              window_scale;
+
+                double tap = 2.0 * cutoff * sinc * window;
+                phase_taps[k] = (float)tap;
+                phase_sum += tap;
+            }
+
+            // Unity gain at DC for every phase
+            if (phase_sum != 0.0) {
+                for (std::size_t k = 0; k < num_taps_; k++) {
+                    phase_taps[k] = (float)(phase_taps[k] / phase_sum);
+                }
+            }
+        }
+    }
+
+    int64_t upsample_ = 0;
+    int64_t downsample_ = 0;
+    std::size_t num_taps_ = 0;
+    int64_t center_ = 0;
+    std::vector<float> bank_;
+
+    // Recent input, starting at stream index history_start_
+    std::vector<float> history_;
+    int64_t history_start_ = 0;
+    int64_t num_input_ = 0;
+    int64_t next_output_ = 0;
+    bool flushed_ = false;
+};
+
+#endif // RESAMPLER_H_
@@ -1,45 +1,384 @@
 #include "piper.h"
 #include "piper_impl.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <limits>
+#include <random>
+#include <stdexcept>
 
 #include <espeak-ng/speak_lib.h>
 
 using json = nlohmann::json;
 
+// From export_onnx.py
+static const std::array<const char *, 3> INPUT_NAMES = {"input", "input_lengths",
+                                                        "scales"};
+static const char *SID_INPUT_NAME = "sid";
+
+// Models exported to take a precomputed speaker embedding ([batch, size])
+static const char *SPEAKER_EMBEDDING_INPUT_NAME = "speaker_embedding";
+
+// Cache everything that doesn't change between inference calls
+static void init_workspace(piper_synthesizer *synth) {
+    InferenceWorkspace &ws = synth->workspace;
+
+    ws.memory_info = Ort::MemoryInfo::CreateCpu(
+        OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+
+    ws.output_names_strs = synth->voice->session->GetOutputNames();
+    ws.output_names.clear();
+    for (const auto &name : ws.output_names_strs) {
+        ws.output_names.push_back(name.c_str());
+    }
+
+    ws.input_names.assign(INPUT_NAMES.begin(), INPUT_NAMES.end());
+    if (synth->voice->has_sid_input) {
+        ws.input_names.push_back(SID_INPUT_NAME);
+    }
+    if (synth->voice->has_speaker_embedding_input) {
+        ws.input_names.push_back(SPEAKER_EMBEDDING_INPUT_NAME);
+    }
+
+    ws.input_tensors.clear();
+    for (std::size_t i = 0; i < ws.input_names.size(); i++) {
+        ws.input_tensors.emplace_back(nullptr);
+    }
+
+    // Scales have a fixed shape and are written in place
+    ws.input_tensors[2] = Ort::Value::CreateTensor<float>(
+        ws.memory_info, ws.scales.data(), ws.scales.size(),
+        ws.scales_shape.data(), ws.scales_shape.size());
+
+    ws.output_tensors.clear();
+    for (std::size_t i = 0; i < ws.output_names.size(); i++) {
+        ws.output_tensors.emplace_back(nullptr);
+    }
+}
+
+// Get the last dimension of an output tensor without allocating
+static int64_t last_dimension(const Ort::Value &tensor,
+                              std::array<int64_t, 4> &shape) {
+    auto shape_info = tensor.GetTensorTypeAndShapeInfo();
+    std::size_t num_dims = shape_info.GetDimensionsCount();
+    if ((num_dims < 1) || (num_dims > shape.size())) {
+        return 0;
+    }
+
+    shape_info.GetDimensions(shape.data(), num_dims);
+    return shape[num_dims - 1];
+}
+
+// Initialize espeak-ng for one more synthesizer.
+// The data path of the first synthesizer is used for every voice.
+static bool espeak_acquire(const char *espeak_data_path) {
+    std::lock_guard<std::mutex> lock(espeak_state.mutex);
+    if (espeak_state.ref_count == 0) {
+        if (espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 0, espeak_data_path,
+                              0) < 0) {
+            return false;
+        }
+        espeak_state.current_voice.clear();
+    }
+
+    espeak_state.ref_count++;
+    return true;
+}
+
+// Terminate espeak-ng once the last synthesizer is gone
+static void espeak_release() {
+    std::lock_guard<std::mutex> lock(espeak_state.mutex);
+    if (espeak_state.ref_count <= 0) {
+        return;
+    }
+
+    espeak_state.ref_count--;
+    if (espeak_state.ref_count == 0) {
+        espeak_Terminate();
+        espeak_state.current_voice.clear();
+    }
+}
+
+// Switch espeak-ng voice only when it changes (espeak_state.mutex held)
+static bool espeak_use_voice(const std::string &voice) {
+    if (espeak_state.current_voice == voice) {
+        return true;
+    }
+
+    if (espeak_SetVoiceByName(voice.c_str()) != EE_OK) {
+        espeak_state.current_voice.clear();
+        return false;
+    }
+
+    espeak_state.current_voice = voice;
+    return true;
+}
+
+// Create the onnxruntime environment if needed (ort_env_state.mutex held).
+// A global thread pool is only created if requested.
+static Ort::Env &ensure_ort_env(bool global_thread_pool,
+                                int intra_op_num_threads = 0,
+                                int inter_op_num_threads = 0,
+                                bool allow_spinning = true) {
+    if (!ort_env_state.env) {
+        if (global_thread_pool) {
+            Ort::ThreadingOptions threading_options;
+            if (intra_op_num_threads > 0) {
+                threading_options.SetGlobalIntraOpNumThreads(
+                    intra_op_num_threads);
+            }
+            if (inter_op_num_threads > 0) {
+                threading_options.SetGlobalInterOpNumThreads(
+                    inter_op_num_threads);
+            }
+            threading_options.SetGlobalSpinControl(allow_spinning ? 1 : 0);
+
+            ort_env_state.env = std::make_unique<Ort::Env>(
+                threading_options, ORT_LOGGING_LEVEL_WARNING, "piper");
+            ort_env_state.has_global_thread_pool = true;
+        } else {
+            ort_env_state.env =
+                std::make_unique<Ort::Env>(ORT_LOGGING_LEVEL_WARNING, "piper");
+        }
+    }
+
+    return *ort_env_state.env;
+}
+
+int piper_init_global_thread_pool(int intra_op_num_threads,
+                                  int inter_op_num_threads,
+                                  bool allow_spinning) {
+    std::lock_guard<std::mutex> lock(ort_env_state.mutex);
+    if (ort_env_state.env) {
+        // Too late to attach a thread pool
+        return PIPER_ERR_GENERIC;
+    }
+
+    ensure_ort_env(true, intra_op_num_threads, inter_op_num_threads,
+                   allow_spinning);
+
+    return PIPER_OK;
+}
+
+// Configure threading, optimization, and execution provider.
+// Throws Ort::Exception if a provider is not available.
+static void apply_create_options(Ort::SessionOptions &session_options,
+                                 const piper_create_options &options) {
+    if (options.use_global_thread_pool) {
+        // Threads come from the environment's global pool
+        session_options.DisablePerSessionThreads();
+    } else {
+        if (options.intra_op_num_threads > 0) {
+            session_options.SetIntraOpNumThreads(options.intra_op_num_threads);
+        }
+
+        if (options.inter_op_num_threads > 0) {
+            session_options.SetInterOpNumThreads(options.inter_op_num_threads);
+            if (options.inter_op_num_threads > 1) {
+                session_options.SetExecutionMode(ExecutionMode::ORT_PARALLEL);
+            }
+        }
+
+        if (!options.allow_spinning) {
+            session_options.AddConfigEntry("session.intra_op.allow_spinning",
+                                           "0");
+            session_options.AddConfigEntry("session.inter_op.allow_spinning",
+                                           "0");
+        }
+    }
+
+    switch (options.graph_optimization_level) {
+    case PIPER_GRAPH_OPTIMIZATION_DISABLE:
+        session_options.SetGraphOptimizationLevel(
+            GraphOptimizationLevel::ORT_DISABLE_ALL);
+        break;
+    case PIPER_GRAPH_OPTIMIZATION_BASIC:
+        session_options.SetGraphOptimizationLevel(
+            GraphOptimizationLevel::ORT_ENABLE_BASIC);
+        break;
+    case PIPER_GRAPH_OPTIMIZATION_EXTENDED:
+        session_options.SetGraphOptimizationLevel(
+            GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+        break;
+    default:
+        session_options.SetGraphOptimizationLevel(
+            GraphOptimizationLevel::ORT_ENABLE_ALL);
+        break;
+    }
+
+    std::string device_id_str = std::to_string(options.device_id);
+    switch (options.execution_provider) {
+    case PIPER_PROVIDER_CUDA: {
+        OrtCUDAProviderOptions cuda_options;
+        cuda_options.device_id = options.device_id;
+        session_options.AppendExecutionProvider_CUDA(cuda_options);
+        break;
+    }
+    case PIPER_PROVIDER_COREML:
+        session_options.AppendExecutionProvider("CoreML");
+        break;
+    case PIPER_PROVIDER_DIRECTML:
+        session_options.AppendExecutionProvider(
+            "DML", {{"device_id", device_id_str}});
+        break;
+    default:
+        // CPU is always available
+        break;
+    }
+}
+
+piper_create_options piper_default_create_options(void) {
+    piper_create_options options;
+    options.intra_op_num_threads = 0;
+    options.inter_op_num_threads = 0;
+    options.allow_spinning = true;
+    options.graph_optimization_level = PIPER_GRAPH_OPTIMIZATION_ALL;
+    options.execution_provider = PIPER_PROVIDER_CPU;
+    options.device_id = 0;
+    options.use_global_thread_pool = false;
+    options.enable_cpu_mem_arena = false;
+    options.enable_mem_pattern = false;
+    options.use_model_bytes_directly = false;
+    options.optimized_model_cache_dir = nullptr;
+    options.synthesis_cache_bytes = 0;
+    options.profile_file_prefix = nullptr;
+    options.length_buckets = nullptr;
+    options.num_length_buckets = 0;
+    options.warmup_length_buckets = false;
+
+    return options;
+}
+
 struct piper_synthesizer *piper_create(const char *model_path,
                                        const char *config_path,
                                        const char *espeak_data_path) {
-    if (!model_path) {
-        return nullptr;
+    return piper_create_ex(model_path, config_path, espeak_data_path, nullptr);
+}
+
+// Where the onnx model is loaded from
+struct ModelSource {
+    const char *path = nullptr;
+    const void *data = nullptr;
+    std::size_t size = 0;
+};
+
+// Apply create options that don't depend on the model
+static void init_session_options(Ort::SessionOptions &session_options,
+                                 const piper_create_options &options) {
+    if (options.enable_cpu_mem_arena) {
+        session_options.EnableCpuMemArena();
+    } else {
+        session_options.DisableCpuMemArena();
     }
 
-    std::string config_path_str;
-    if (!config_path) {
-        std::string model_path_str(model_path);
-        config_path_str = model_path_str + ".json";
+    if (options.enable_mem_pattern) {
+        session_options.EnableMemPattern();
     } else {
-        config_path_str = config_path;
+        session_options.DisableMemPattern();
     }
 
-    std::ifstream config_stream(config_path_str);
-    auto config = json::parse(config_stream);
+    if (options.profile_file_prefix) {
+        session_options.EnableProfiling(options.profile_file_prefix);
+    } else {
+        session_options.DisableProfiling();
+    }
 
-    if (espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 0, espeak_data_path, 0) <
-        0) {
-        return nullptr;
+    apply_create_options(session_options, options);
+}
+
+static std::shared_ptr<Ort::Session>
+create_session(Ort::Env &ort_env, const ModelSource &model,
+               Ort::SessionOptions &session_options,
+               const piper_create_options &options) {
+    if (model.data) {
+        if (options.use_model_bytes_directly) {
+            // Caller keeps the model bytes alive
+            session_options.AddConfigEntry(
+                "session.use_ort_model_bytes_directly", "1");
+        }
+
+        return std::make_shared<Ort::Session>(
+            Ort::Session(ort_env, model.data, model.size, session_options));
+    }
+
+    return std::make_shared<Ort::Session>(
+        Ort::Session(ort_env, model.path, session_options));
+}
+
+// 64-bit FNV-1a
+static uint64_t fnv1a_hash(const void *data, std::size_t size,
+                           uint64_t hash = FNV_OFFSET_BASIS) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+// Hash the model bytes to key the optimized model cache
+static bool hash_model(const ModelSource &model, uint64_t &hash) {
+    if (model.data) {
+        hash = fnv1a_hash(model.data, model.size);
+        return true;
+    }
+
+    std::ifstream model_stream(model.path, std::ios::binary);
+    if (!model_stream) {
+        return false;
+    }
+
+    std::vector<char> buffer(1 << 16);
+    hash = FNV_OFFSET_BASIS;
+    while (model_stream) {
+        model_stream.read(buffer.data(), buffer.size());
+        hash = fnv1a_hash(buffer.data(), (std::size_t)model_stream.gcount(), hash);
+    }
+
+    return true;
+}
+
+// Path of an optimized model in the cache directory.
+// Optimizations depend on the onnxruntime version and the create options.
+static std::string optimized_model_path(const std::string &cache_dir,
+                                        uint64_t model_hash,
+                                        const piper_create_options &options) {
+    char hash_str[17];
+    std::snprintf(hash_str, sizeof(hash_str), "%016llx",
+                  (unsigned long long)model_hash);
+
+    std::string path = cache_dir;
+    if (!path.empty() && (path.back() != '/') && (path.back() != '\\')) {
+        path += '/';
     }
 
-    piper_synthesizer *synth = new piper_synthesizer();
+    path += hash_str;
+    path += "-ort" + Ort::GetVersionString();
+    path += "-o" + std::to_string((int)options.graph_optimization_level);
+    path += "-p" + std::to_string((int)options.execution_provider);
+    path += ".onnx";
+
+    return path;
+}
+
+static int warmup_length_buckets(piper_voice *voice);
+
+// Load a voice from its parsed config and model
+static piper_voice *load_voice(json &config, const ModelSource &model,
+                               const char *espeak_data_path,
+                               const piper_create_options *options) {
+    piper_voice *voice = new piper_voice();
 
     // Load config options
-    synth->espeak_voice = "en-us"; // default
+    voice->espeak_voice = "en-us"; // default
     if (config.contains("espeak")) {
         auto &espeak_obj = config["espeak"];
         if (espeak_obj.contains("voice")) {
-            synth->espeak_voice = espeak_obj["voice"].get<std::string>();
+            voice->espeak_voice = espeak_obj["voice"].get<std::string>();
         }
     }
 
@@ -47,7 +386,7 @@ struct piper_synthesizer *piper_create(const char *model_path,
         auto &audio_obj = config["audio"];
         if (audio_obj.contains("sample_rate")) {
             // Sample rate of generated audio in hertz
-            synth->sample_rate = audio_obj["sample_rate"].get<int>();
+            voice->sample_rate = audio_obj["sample_rate"].get<int>();
         }
     }
 
@@ -63,355 +402,2983 @@ struct piper_synthesizer *piper_create(const char *model_path,
                 continue;
             }
 
+            std::vector<PhonemeId> to_ids;
             for (auto &to_id_value : from_phoneme_item.value()) {
-                PhonemeId to_id = to_id_value.get<PhonemeId>();
-                synth->phoneme_id_map[*from_codepoint].push_back(to_id);
+                to_ids.push_back(to_id_value.get<PhonemeId>());
             }
+
+            voice->phoneme_id_table.add(*from_codepoint, to_ids);
         }
     }
 
-    synth->num_speakers = config["num_speakers"].get<SpeakerId>();
+    voice->num_speakers = config["num_speakers"].get<SpeakerId>();
 
     if (config.contains("inference")) {
         // Overrides default inference settings
         auto inference_value = config["inference"];
         if (inference_value.contains("noise_scale")) {
-            synth->synth_noise_scale =
+            voice->synth_noise_scale =
                 inference_value["noise_scale"].get<float>();
         }
 
         if (inference_value.contains("length_scale")) {
-            synth->synth_length_scale =
+            voice->synth_length_scale =
                 inference_value["length_scale"].get<float>();
         }
 
         if (inference_value.contains("noise_w")) {
-            synth->synth_noise_w_scale =
+            voice->synth_noise_w_scale =
                 inference_value["noise_w"].get<float>();
         }
     }
 
     // Load onnx model
-    synth->session_options.DisableCpuMemArena();
-    synth->session_options.DisableMemPattern();
-    synth->session_options.DisableProfiling();
-
-    synth->session = std::make_unique<Ort::Session>(
-        Ort::Session(ort_env, model_path, synth->session_options));
-
-    return synth;
-}
+    piper_create_options default_options;
+    if (!options) {
+        default_options = piper_default_create_options();
+        options = &default_options;
+    }
 
-void piper_free(struct piper_synthesizer *synth) {
-    espeak_Terminate();
+    voice->cache.capacity_bytes = options->synthesis_cache_bytes;
+    voice->profiling = (options->profile_file_prefix != nullptr);
+
+    try {
+        std::unique_lock<std::mutex> env_lock(ort_env_state.mutex);
+        Ort::Env &ort_env = ensure_ort_env(options->use_global_thread_pool);
+        if (options->use_global_thread_pool &&
+            !ort_env_state.has_global_thread_pool) {
+            // Environment was already created without a global pool
+            throw std::runtime_error(
+                "use_global_thread_pool requires the global thread pool to be "
+                "created (piper_init_global_thread_pool) before the first "
+                "voice is loaded");
+        }
+        env_lock.unlock();
+
+        std::string cache_path;
+        uint64_t model_hash = 0;
+        if (options->optimized_model_cache_dir &&
+            hash_model(model, model_hash)) {
+            cache_path = optimized_model_path(options->optimized_model_cache_dir,
+                                              model_hash, *options);
+        }
 
-    if (!synth) {
-        return;
-    }
+        if (!cache_path.empty() && std::ifstream(cache_path).good()) {
+            try {
+                init_session_options(voice->session_options, *options);
 
-    delete synth;
-}
+                // Already optimized
+                voice->session_options.SetGraphOptimizationLevel(
+                    GraphOptimizationLevel::ORT_DISABLE_ALL);
 
-piper_synthesize_options
-piper_default_synthesize_options(piper_synthesizer *synth) {
-    piper_synthesize_options options;
-    options.speaker_id = 0;
-    options.length_scale = DEFAULT_LENGTH_SCALE;
-    options.noise_scale = DEFAULT_NOISE_SCALE;
-    options.noise_w_scale = DEFAULT_NOISE_W_SCALE;
+                voice->session = std::make_shared<Ort::Session>(Ort::Session(
+                    ort_env, cache_path.c_str(), voice->session_options));
+            } catch (const Ort::Exception &) {
+                // Unreadable cache entry, optimize the model again
+                voice->session.reset();
+            }
+        }
 
-    if (synth) {
-        options.length_scale = synth->synth_length_scale;
-        options.noise_scale = synth->synth_noise_scale;
-        options.noise_w_scale = synth->synth_noise_w_scale;
-    }
+        if (!voice->session && !cache_path.empty()) {
+            // Write to a temporary file first so other processes never load
+            // a partial model
+            std::string temp_path =
+                cache_path + ".tmp" + std::to_string(std::random_device{}());
+            try {
+                voice->session_options = Ort::SessionOptions();
+                init_session_options(voice->session_options, *options);
+                voice->session_options.SetOptimizedModelFilePath(
+                    temp_path.c_str());
+
+                voice->session =
+                    create_session(ort_env, model, voice->session_options, *options);
+
+                if (std::rename(temp_path.c_str(), cache_path.c_str()) != 0) {
+                    // Another process won the race
+                    std::remove(temp_path.c_str());
+                }
+            } catch (const Ort::Exception &) {
+                // Cache directory is not writable
+                std::remove(temp_path.c_str());
+                voice->session.reset();
+            }
+        }
 
-    return options;
-}
+        if (!voice->session) {
+            voice->session_options = Ort::SessionOptions();
+            init_session_options(voice->session_options, *options);
+            voice->session =
+                create_session(ort_env, model, voice->session_options, *options);
+        }
 
-int piper_synthesize_start(struct piper_synthesizer *synth, const char *text,
-                           const piper_synthesize_options *options) {
-    if (!synth) {
-        return PIPER_ERR_GENERIC;
-    }
+        // Speaker inputs depend on how the model was exported
+        std::vector<std::string> input_names = voice->session->GetInputNames();
+        for (std::size_t i = 0; i < input_names.size(); i++) {
+            if (input_names[i] == SID_INPUT_NAME) {
+                voice->has_sid_input = true;
+            } else if (input_names[i] == SPEAKER_EMBEDDING_INPUT_NAME) {
+                voice->has_speaker_embedding_input = true;
+                std::vector<int64_t> shape = voice->session->GetInputTypeInfo(i)
+                                                 .GetTensorTypeAndShapeInfo()
+                                                 .GetShape();
+                if (!shape.empty() && (shape.back() > 0)) {
+                    voice->speaker_embedding_size = (std::size_t)shape.back();
+                }
+            }
+        }
 
-    if (espeak_SetVoiceByName(synth->espeak_voice.c_str()) != EE_OK) {
-        return PIPER_ERR_GENERIC;
+        // Padding is trimmed using the alignments
+        if (options->length_buckets && (voice->session->GetOutputCount() > 1)) {
+            for (std::size_t i = 0; i < options->num_length_buckets; i++) {
+                if (options->length_buckets[i] > 0) {
+                    voice->length_buckets.push_back(
+                        (std::size_t)options->length_buckets[i]);
+                }
+            }
+            std::sort(voice->length_buckets.begin(), voice->length_buckets.end());
+            voice->length_buckets.erase(std::unique(voice->length_buckets.begin(),
+                                                    voice->length_buckets.end()),
+                                        voice->length_buckets.end());
+        }
+    } catch (...) {
+        delete voice;
+        throw;
     }
 
-    // Clear state
-    while (!synth->phoneme_id_queue.empty()) {
-        synth->phoneme_id_queue.pop();
+    if (!espeak_acquire(espeak_data_path)) {
+        delete voice;
+        return nullptr;
     }
-    synth->chunk_samples.clear();
 
-    std::unique_ptr<piper_synthesize_options> default_options;
-    if (!options) {
-        default_options = std::make_unique<piper_synthesize_options>(
-            piper_default_synthesize_options(synth));
-        options = default_options.get();
+    if (options->warmup_length_buckets && !voice->length_buckets.empty()) {
+        try {
+            if (warmup_length_buckets(voice) != PIPER_OK) {
+                piper_voice_release(voice);
+                return nullptr;
+            }
+        } catch (...) {
+            piper_voice_release(voice);
+            throw;
+        }
     }
 
-    synth->length_scale = options->length_scale;
-    synth->noise_scale = options->noise_scale;
-    synth->noise_w_scale = options->noise_w_scale;
-    synth->speaker_id = options->speaker_id;
-
-    // phonemize
-    std::vector<std::string> sentence_phonemes{""};
-    std::size_t current_idx = 0;
-    const void *text_ptr = text;
-    while (text_ptr != nullptr) {
-        int terminator = 0;
-        std::string terminator_str = "";
+    return voice;
+}
 
-        const char *phonemes = espeak_TextToPhonemesWithTerminator(
-            &text_ptr, espeakCHARS_AUTO, espeakPHONEMES_IPA, &terminator);
+piper_voice *piper_voice_load(const char *model_path, const char *config_path,
+                              const char *espeak_data_path,
+                              const piper_create_options *options) {
+    if (!model_path) {
+        return nullptr;
+    }
 
-        if (phonemes) {
-            sentence_phonemes[current_idx] += phonemes;
-        }
+    std::string config_path_str;
+    if (!config_path) {
+        std::string model_path_str(model_path);
+        config_path_str = model_path_str + ".json";
+    } else {
+        config_path_str = config_path;
+    }
 
-        // Categorize terminator
-        terminator &= 0x000FFFFF;
+    std::ifstream config_stream(config_path_str);
+    auto config = json::parse(config_stream);
 
-        if (terminator == CLAUSE_PERIOD) {
-            terminator_str = ".";
-        } else if (terminator == CLAUSE_QUESTION) {
-            terminator_str = "?";
-        } else if (terminator == CLAUSE_EXCLAMATION) {
-            terminator_str = "!";
-        } else if (terminator == CLAUSE_COMMA) {
-            terminator_str = ", ";
-        } else if (terminator == CLAUSE_COLON) {
-            terminator_str = ": ";
-        } else if (terminator == CLAUSE_SEMICOLON) {
-            terminator_str = "; ";
-        }
+    ModelSource model;
+    model.path = model_path;
 
-        sentence_phonemes[current_idx] += terminator_str;
+    return load_voice(config, model, espeak_data_path, options);
+}
 
-        if ((terminator & CLAUSE_TYPE_SENTENCE) == CLAUSE_TYPE_SENTENCE) {
-            sentence_phonemes.push_back("");
-            current_idx = sentence_phonemes.size() - 1;
-        }
+piper_voice *piper_voice_load_from_memory(const void *model_data,
+                                          size_t model_size,
+                                          const char *config_json,
+                                          size_t config_size,
+                                          const char *espeak_data_path,
+                                          const piper_create_options *options) {
+    if (!model_data || (model_size == 0) || !config_json) {
+        return nullptr;
     }
 
-    // phonemes to ids
-    std::vector<Phoneme> sentence_codepoints;
-    std::vector<PhonemeId> sentence_ids;
-    for (auto &phonemes_str : sentence_phonemes) {
-        if (phonemes_str.empty()) {
-            continue;
-        }
+    auto config = json::parse(config_json, config_json + config_size);
 
-        sentence_codepoints.push_back(PHONEME_BOS);
-        sentence_ids.push_back(ID_BOS);
+    ModelSource model;
+    model.data = model_data;
+    model.size = model_size;
 
-        sentence_codepoints.push_back(PHONEME_BOS);
-        sentence_ids.push_back(ID_PAD);
-
-        sentence_codepoints.push_back(PHONEME_SEPARATOR);
+    return load_voice(config, model, espeak_data_path, options);
+}
 
-        auto phonemes_norm = una::norm::to_nfd_utf8(phonemes_str);
-        auto phonemes_range = una::ranges::utf8_view{phonemes_norm};
-        auto phonemes_iter = phonemes_range.begin();
-        auto phonemes_end = phonemes_range.end();
+// Create a synthesizer with its own reference to a new voice
+static piper_synthesizer *create_with_voice(piper_voice *voice) {
+    if (!voice) {
+        return nullptr;
+    }
 
-        // Filter out (lang) switch (flags).
-        // These surround words from languages other than the current voice.
-        bool in_lang_flag = false;
-        while (phonemes_iter != phonemes_end) {
-            auto phoneme = *phonemes_iter;
+    // Context holds the only reference
+    piper_synthesizer *synth = nullptr;
+    try {
+        synth = piper_context_create(voice);
+    } catch (...) {
+        piper_voice_release(voice);
+        throw;
+    }
+    piper_voice_release(voice);
 
-            if (in_lang_flag) {
-                if (phoneme == U')') {
-                    // End of (lang) switch
-                    in_lang_flag = false;
-                }
-            } else if (phoneme == U'(') {
-                // Start of (lang) switch
-                in_lang_flag = true;
-            } else {
-                // Look up ids
-                auto ids_for_phoneme = synth->phoneme_id_map.find(phoneme);
-                if (ids_for_phoneme != synth->phoneme_id_map.end()) {
-                    for (auto id : ids_for_phoneme->second) {
-                        sentence_codepoints.push_back(phoneme);
-                        sentence_ids.push_back(id);
-
-                        sentence_codepoints.push_back(phoneme);
-                        sentence_ids.push_back(ID_PAD);
-
-                        sentence_codepoints.push_back(PHONEME_SEPARATOR);
-                    }
-                }
-            }
+    return synth;
+}
 
-            phonemes_iter++;
-        }
+piper_synthesizer *
+piper_create_ex(const char *model_path, const char *config_path,
+                const char *espeak_data_path,
+                const piper_create_options *options) {
+    return create_with_voice(
+        piper_voice_load(model_path, config_path, espeak_data_path, options));
+}
 
-        sentence_codepoints.push_back(PHONEME_EOS);
-        sentence_ids.push_back(ID_EOS);
-        sentence_codepoints.push_back(PHONEME_SEPARATOR);
+piper_synthesizer *
+piper_create_from_memory(const void *model_data, size_t model_size,
+                         const char *config_json, size_t config_size,
+                         const char *espeak_data_path,
+                         const piper_create_options *options) {
+    return create_with_voice(piper_voice_load_from_memory(
+        model_data, model_size, config_json, config_size, espeak_data_path,
+        options));
+}
 
-        synth->phoneme_id_queue.emplace(
-            std::move(std::make_pair(sentence_codepoints, sentence_ids)));
-        sentence_ids.clear();
+void piper_voice_retain(piper_voice *voice) {
+    if (!voice) {
+        return;
     }
 
-    return PIPER_OK;
+    voice->ref_count.fetch_add(1, std::memory_order_relaxed);
 }
 
-int piper_synthesize_next(struct piper_synthesizer *synth,
-                          struct piper_audio_chunk *chunk) {
-    if (!synth) {
-        return PIPER_ERR_GENERIC;
+void piper_voice_release(piper_voice *voice) {
+    if (!voice) {
+        return;
     }
 
-    if (!chunk) {
+    if (voice->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete voice;
+        espeak_release();
+    }
+}
+
+int piper_voice_cache_stats(piper_voice *voice, piper_cache_stats *stats) {
+    if (!voice || !stats) {
         return PIPER_ERR_GENERIC;
     }
 
-    // Clear data from previous call
-    synth->chunk_samples.clear();
-    synth->chunk_phonemes.clear();
-    synth->chunk_phoneme_ids.clear();
-    synth->chunk_alignments.clear();
+    SynthesisCache &cache = voice->cache;
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    stats->hits = cache.hits;
+    stats->misses = cache.misses;
+    stats->audio_hits = cache.audio_hits;
+    stats->audio_misses = cache.audio_misses;
+    stats->evictions = cache.evictions;
+    stats->num_entries = cache.entries.size();
+    stats->size_bytes = cache.size_bytes;
+    stats->capacity_bytes = cache.capacity_bytes;
 
-    chunk->sample_rate = synth->sample_rate;
-    chunk->samples = nullptr;
-    chunk->num_samples = 0;
-    chunk->is_last = false;
-    chunk->phoneme_ids = nullptr;
-    chunk->num_phoneme_ids = 0;
-    chunk->alignments = nullptr;
-    chunk->num_alignments = 0;
+    return PIPER_OK;
+}
 
-    if (synth->phoneme_id_queue.empty()) {
-        // Empty final chunk
-        chunk->is_last = true;
-        return PIPER_DONE;
+void piper_voice_cache_clear(piper_voice *voice) {
+    if (!voice) {
+        return;
     }
 
-    // Process next list of phoneme ids
-    auto [next_phonemes, next_ids] = std::move(synth->phoneme_id_queue.front());
-    synth->phoneme_id_queue.pop();
-
-    auto memoryInfo = Ort::MemoryInfo::CreateCpu(
-        OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+    voice->cache.clear();
+}
 
-    // Allocate
-    std::vector<int64_t> phoneme_id_lengths{(int64_t)next_ids.size()};
-    std::vector<float> scales{synth->noise_scale, synth->length_scale,
-                              synth->noise_w_scale};
+bool piper_voice_has_speaker_embedding(piper_voice *voice, size_t *size) {
+    if (!voice) {
+        return false;
+    }
 
-    std::vector<Ort::Value> input_tensors;
-    std::vector<int64_t> phoneme_ids_shape{1, (int64_t)next_ids.size()};
-    input_tensors.push_back(Ort::Value::CreateTensor<int64_t>(
-        memoryInfo, next_ids.data(), next_ids.size(), phoneme_ids_shape.data(),
-        phoneme_ids_shape.size()));
+    if (size) {
+        *size = voice->speaker_embedding_size;
+    }
 
-    std::vector<int64_t> phoneme_id_lengths_shape{
-        (int64_t)phoneme_id_lengths.size()};
-    input_tensors.push_back(Ort::Value::CreateTensor<int64_t>(
-        memoryInfo, phoneme_id_lengths.data(), phoneme_id_lengths.size(),
-        phoneme_id_lengths_shape.data(), phoneme_id_lengths_shape.size()));
+    return voice->has_speaker_embedding_input;
+}
 
-    std::vector<int64_t> scales_shape{(int64_t)scales.size()};
-    input_tensors.push_back(Ort::Value::CreateTensor<float>(
-        memoryInfo, scales.data(), scales.size(), scales_shape.data(),
-        scales_shape.size()));
+int piper_voice_end_profiling(piper_voice *voice, char *path,
+                              size_t path_size) {
+    if (!voice || !voice->profiling.exchange(false)) {
+        return PIPER_ERR_GENERIC;
+    }
 
-    // Add speaker id.
-    // NOTE: These must be kept outside the "if" below to avoid being
-    // deallocated.
-    std::vector<int64_t> speaker_id{(int64_t)synth->speaker_id};
-    std::vector<int64_t> speaker_id_shape{(int64_t)speaker_id.size()};
+    Ort::AllocatorWithDefaultOptions allocator;
+    Ort::AllocatedStringPtr profile_path =
+        voice->session->EndProfilingAllocated(allocator);
 
-    if (synth->num_speakers > 1) {
-        input_tensors.push_back(Ort::Value::CreateTensor<int64_t>(
-            memoryInfo, speaker_id.data(), speaker_id.size(),
-            speaker_id_shape.data(), speaker_id_shape.size()));
+    if (path && (path_size > 0)) {
+        std::snprintf(path, path_size, "%s", profile_path.get());
     }
 
-    // From export_onnx.py
-    std::array<const char *, 4> input_names = {"input", "input_lengths",
-                                               "scales", "sid"};
+    return PIPER_OK;
+}
 
-    // Get all output names
-    std::vector<std::string> output_names_strs =
-        synth->session->GetOutputNames();
-    std::vector<const char *> output_names;
-    for (const auto &name : output_names_strs) {
-        output_names.push_back(name.c_str());
+piper_synthesis_context *piper_context_create(piper_voice *voice) {
+    if (!voice) {
+        return nullptr;
     }
 
-    // Infer
-    auto output_tensors = synth->session->Run(
-        Ort::RunOptions{nullptr}, input_names.data(), input_tensors.data(),
-        input_tensors.size(), output_names.data(), output_names.size());
+    auto synth = std::make_unique<piper_synthesizer>();
+    synth->voice = voice;
+    init_workspace(synth.get());
 
-    if ((output_tensors.size() < 1) || (!output_tensors.front().IsTensor())) {
-        return PIPER_ERR_GENERIC;
+    piper_voice_retain(voice);
+    return synth.release();
+}
+
+piper_voice *piper_get_voice(piper_synthesizer *synth) {
+    if (!synth) {
+        return nullptr;
     }
 
-    auto audio_shape =
-        output_tensors.front().GetTensorTypeAndShapeInfo().GetShape();
-    chunk->num_samples = audio_shape[audio_shape.size() - 1];
+    return synth->voice;
+}
 
-    const float *audio_tensor_data =
-        output_tensors.front().GetTensorData<float>();
-    synth->chunk_samples.resize(chunk->num_samples);
-    std::copy(audio_tensor_data, audio_tensor_data + chunk->num_samples,
-              synth->chunk_samples.begin());
-    chunk->samples = synth->chunk_samples.data();
+static void stop_pipeline(piper_synthesizer *synth);
+static void drop_queued(piper_synthesizer *synth);
+static void release_batcher(piper_batcher *batcher);
 
-    chunk->is_last = synth->phoneme_id_queue.empty();
+void piper_free(struct piper_synthesizer *synth) {
+    if (!synth) {
+        return;
+    }
 
-    // Copy phonemes
-    synth->chunk_phonemes = std::move(next_phonemes);
-    chunk->phonemes = synth->chunk_phonemes.data();
-    chunk->num_phonemes = synth->chunk_phonemes.size();
+    stop_pipeline(synth);
+    release_batcher(synth->batcher);
 
-    // Copy phoneme ids
-    for (auto phoneme_id : next_ids) {
+    piper_voice *voice = synth->voice;
+    delete synth;
+    piper_voice_release(voice);
+}
+
+piper_synthesize_options
+piper_default_synthesize_options(piper_synthesizer *synth) {
+    piper_synthesize_options options;
+    options.speaker_id = 0;
+    options.length_scale = DEFAULT_LENGTH_SCALE;
+    options.noise_scale = DEFAULT_NOISE_SCALE;
+    options.noise_w_scale = DEFAULT_NOISE_W_SCALE;
+    options.max_chunk_phonemes = 0;
+    options.clause_silence_seconds = 0.0f;
+    options.max_batch_sentences = 1;
+    options.phonemize_lookahead = 0;
+    options.sample_format = PIPER_SAMPLE_FORMAT_FLOAT32;
+    options.output_sample_rate = 0;
+    options.cache_audio = false;
+    options.timeout_ms = 0;
+    options.speaker_embedding = nullptr;
+    options.speaker_embedding_size = 0;
+    options.batcher = nullptr;
+    options.skip_metadata = false;
+
+    if (synth) {
+        options.length_scale = synth->voice->synth_length_scale;
+        options.noise_scale = synth->voice->synth_noise_scale;
+        options.noise_w_scale = synth->voice->synth_noise_w_scale;
+    }
+
+    return options;
+}
+
+// End of the last sentence in document text: after a newline, or after
+// whitespace that follows '.', '!' or '?'. Returns 0 if there is none.
+static std::size_t find_sentence_end(const std::string &text) {
+    for (std::size_t i = text.size(); i > 0; i--) {
+        char c = text[i - 1];
+        if (c == '\n') {
+            return i;
+        }
+
+        if (((c == ' ') || (c == '\t') || (c == '\r')) && (i > 1)) {
+            char prev = text[i - 2];
+            if ((prev == '.') || (prev == '!') || (prev == '?')) {
+                return i;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// End of a segment without a sentence boundary: after the last space, or
+// else at the maximum size (moved back to the start of a UTF-8 sequence)
+static std::size_t find_forced_segment_end(const std::string &text) {
+    std::size_t space = text.find_last_of(" \t\r");
+    if (space != std::string::npos) {
+        return space + 1;
+    }
+
+    std::size_t end = std::min(text.size(), DOCUMENT_MAX_SEGMENT_SIZE);
+    while ((end > 1) && ((static_cast<unsigned char>(text[end]) & 0xC0) == 0x80)) {
+        end--;
+    }
+
+    return end;
+}
+
+// Read the next segment of a document into phonemizer.text, so espeak-ng
+// never sees a sentence cut in two by a read.
+// Returns PIPER_OK with a segment, PIPER_DONE at the end of the document
+// (or without a document), or an error code if reading failed.
+static int read_text_segment(TextPhonemizer &phonemizer) {
+    if (!phonemizer.read_text) {
+        return PIPER_DONE;
+    }
+
+    phonemizer.text_offset += phonemizer.text.size();
+    phonemizer.text.clear();
+    phonemizer.text_ptr = nullptr;
+
+    std::string &pending = phonemizer.pending_text;
+    while (true) {
+        std::size_t end = pending.size();
+        if (!phonemizer.text_eof) {
+            end = find_sentence_end(pending);
+            if ((end == 0) && (pending.size() >= DOCUMENT_MAX_SEGMENT_SIZE)) {
+                end = find_forced_segment_end(pending);
+            }
+        }
+
+        if (end > 0) {
+            phonemizer.text.assign(pending, 0, end);
+            pending.erase(0, end);
+            phonemizer.text_ptr = phonemizer.text.c_str();
+            return PIPER_OK;
+        }
+
+        if (phonemizer.text_eof) {
+            return PIPER_DONE;
+        }
+
+        std::size_t size = pending.size();
+        pending.resize(size + DOCUMENT_READ_BLOCK_SIZE);
+        int num_read = phonemizer.read_text(phonemizer.read_text_user_data,
+                                            &pending[size],
+                                            DOCUMENT_READ_BLOCK_SIZE);
+        if (num_read < 0) {
+            pending.resize(size);
+            return PIPER_ERR_GENERIC;
+        }
+
+        pending.resize(size + std::min<std::size_t>(num_read,
+                                                    DOCUMENT_READ_BLOCK_SIZE));
+        phonemizer.text_eof = (num_read == 0);
+    }
+}
+
+// Bytes of text (or of the document) phonemized so far
+static std::size_t text_position(const TextPhonemizer &phonemizer) {
+    if (phonemizer.text_ptr == nullptr) {
+        return phonemizer.text_offset + phonemizer.text.size();
+    }
+
+    return phonemizer.text_offset +
+           (static_cast<const char *>(phonemizer.text_ptr) -
+            phonemizer.text.c_str());
+}
+
+// Read the next clause with espeak-ng.
+// Returns PIPER_OK with a clause, PIPER_DONE at the end of the text, or an
+// error code.
+static int read_clause(TextPhonemizer &phonemizer, PhonemizedClause &clause) {
+    if (phonemizer.text_ptr == nullptr) {
+        // Continue with the next segment of a document
+        int result = read_text_segment(phonemizer);
+        if (result != PIPER_OK) {
+            return result;
+        }
+    }
+
+    int terminator = 0;
+    std::string terminator_str = "";
+
+    {
+        // Other synthesizers may phonemize between our clauses
+        std::lock_guard<std::mutex> lock(espeak_state.mutex);
+        if (!espeak_use_voice(phonemizer.espeak_voice)) {
+            return PIPER_ERR_GENERIC;
+        }
+
+        StageTimer timer(phonemizer.stats,
+                         &piper_stage_stats::phonemize_seconds);
+        const char *phonemes = espeak_TextToPhonemesWithTerminator(
+            &phonemizer.text_ptr, espeakCHARS_AUTO, espeakPHONEMES_IPA,
+            &terminator);
+
+        clause.phonemes.clear();
+        if (phonemes) {
+            clause.phonemes = phonemes;
+        }
+    }
+
+    // Categorize terminator
+    terminator &= 0x000FFFFF;
+
+    if (terminator == CLAUSE_PERIOD) {
+        terminator_str = ".";
+    } else if (terminator == CLAUSE_QUESTION) {
+        terminator_str = "?";
+    } else if (terminator == CLAUSE_EXCLAMATION) {
+        terminator_str = "!";
+    } else if (terminator == CLAUSE_COMMA) {
+        terminator_str = ", ";
+    } else if (terminator == CLAUSE_COLON) {
+        terminator_str = ": ";
+    } else if (terminator == CLAUSE_SEMICOLON) {
+        terminator_str = "; ";
+    }
+
+    clause.phonemes += terminator_str;
+    clause.ends_sentence =
+        (terminator & CLAUSE_TYPE_SENTENCE) == CLAUSE_TYPE_SENTENCE;
+
+    return PIPER_OK;
+}
+
+// Group clauses into the phonemes of the next chunk.
+// A chunk always ends with a sentence. If max_chunk_phonemes is set, it
+// may also end at a clause boundary when the next clause would push it
+// over the limit.
+// Returns PIPER_OK with a chunk, PIPER_DONE at the end of the text, or an
+// error code.
+static int next_chunk_phonemes(TextPhonemizer &phonemizer,
+                               bool &split_clause) {
+    std::string &chunk_phonemes = phonemizer.chunk_phonemes;
+    chunk_phonemes.clear();
+    split_clause = false;
+
+    std::size_t current_length = 0;
+    while (true) {
+        if (!phonemizer.next_clause) {
+            PhonemizedClause clause;
+            int result = read_clause(phonemizer, clause);
+            if (result == PIPER_DONE) {
+                break;
+            }
+            if (result != PIPER_OK) {
+                return result;
+            }
+
+            phonemizer.next_clause = std::move(clause);
+        }
+
+        PhonemizedClause clause = std::move(*phonemizer.next_clause);
+        phonemizer.next_clause.reset();
+
+        chunk_phonemes += clause.phonemes;
+        current_length += count_codepoints(clause.phonemes);
+
+        if (!clause.ends_sentence && (phonemizer.max_chunk_phonemes > 0)) {
+            // Peek at the next clause
+            PhonemizedClause next_clause;
+            int result = read_clause(phonemizer, next_clause);
+            if (result == PIPER_OK) {
+                split_clause =
+                    (current_length + count_codepoints(next_clause.phonemes)) >
+                    static_cast<std::size_t>(phonemizer.max_chunk_phonemes);
+                phonemizer.next_clause = std::move(next_clause);
+            } else if (result != PIPER_DONE) {
+                return result;
+            }
+        }
+
+        if (clause.ends_sentence || split_clause) {
+            if (chunk_phonemes.empty()) {
+                // Skip empty sentences
+                split_clause = false;
+                current_length = 0;
+                continue;
+            }
+
+            return PIPER_OK;
+        }
+    }
+
+    return chunk_phonemes.empty() ? PIPER_DONE : PIPER_OK;
+}
+
+// Start a chunk in an arena with the BOS ids
+static PhonemeIdChunkSpan begin_phoneme_id_chunk(PhonemeIdArena &arena,
+                                                 std::size_t silence_samples) {
+    PhonemeIdChunkSpan span;
+    span.phonemes_offset = arena.phonemes.size();
+    span.ids_offset = arena.ids.size();
+    span.silence_samples = silence_samples;
+
+    arena.phonemes.push_back(PHONEME_BOS);
+    arena.ids.push_back(ID_BOS);
+
+    arena.phonemes.push_back(PHONEME_BOS);
+    arena.ids.push_back(ID_PAD);
+
+    arena.phonemes.push_back(PHONEME_SEPARATOR);
+
+    return span;
+}
+
+// Append the ids of one phoneme, each followed by a pad
+static void append_phoneme(const piper_voice *voice, Phoneme phoneme,
+                           PhonemeIdArena &arena) {
+    // Look up ids (count is 0 for unknown phonemes)
+    PhonemeIdSpan id_span = voice->phoneme_id_table.find(phoneme);
+    const PhonemeId *ids_for_phoneme = voice->phoneme_id_table.ids(id_span);
+    for (uint32_t i = 0; i < id_span.count; i++) {
+        arena.phonemes.push_back(phoneme);
+        arena.ids.push_back(ids_for_phoneme[i]);
+
+        arena.phonemes.push_back(phoneme);
+        arena.ids.push_back(ID_PAD);
+
+        arena.phonemes.push_back(PHONEME_SEPARATOR);
+    }
+}
+
+// End a chunk with the EOS id and add it to the arena
+static void end_phoneme_id_chunk(PhonemeIdArena &arena,
+                                 PhonemeIdChunkSpan &span) {
+    arena.phonemes.push_back(PHONEME_EOS);
+    arena.ids.push_back(ID_EOS);
+    arena.phonemes.push_back(PHONEME_SEPARATOR);
+
+    span.num_phonemes = arena.phonemes.size() - span.phonemes_offset;
+    span.num_ids = arena.ids.size() - span.ids_offset;
+    arena.chunks.push_back(span);
+}
+
+// Map the phonemes of a chunk to ids and append the chunk to an arena
+static void append_phoneme_ids(const piper_voice *voice,
+                               const std::string &phonemes_str,
+                               std::size_t silence_samples,
+                               PhonemeIdArena &arena) {
+    PhonemeIdChunkSpan span = begin_phoneme_id_chunk(arena, silence_samples);
+
+    // Normalized lazily, without an intermediate string
+    auto phonemes_range =
+        una::views::utf8(phonemes_str) | una::views::norm::nfd;
+    auto phonemes_iter = phonemes_range.begin();
+    auto phonemes_end = phonemes_range.end();
+
+    // Filter out (lang) switch (flags).
+    // These surround words from languages other than the current voice.
+    bool in_lang_flag = false;
+    while (phonemes_iter != phonemes_end) {
+        auto phoneme = *phonemes_iter;
+
+        if (in_lang_flag) {
+            if (phoneme == U')') {
+                // End of (lang) switch
+                in_lang_flag = false;
+            }
+        } else if (phoneme == U'(') {
+            // Start of (lang) switch
+            in_lang_flag = true;
+        } else {
+            append_phoneme(voice, phoneme, arena);
+        }
+
+        phonemes_iter++;
+    }
+
+    end_phoneme_id_chunk(arena, span);
+}
+
+// Phonemize the next chunk of text and append its ids to an arena.
+// Returns PIPER_OK with a chunk, PIPER_DONE at the end of the text, or an
+// error code.
+static int next_phoneme_id_chunk(const piper_voice *voice,
+                                 TextPhonemizer &phonemizer,
+                                 PhonemeIdArena &arena) {
+    bool split_clause = false;
+    int result = next_chunk_phonemes(phonemizer, split_clause);
+    if (result != PIPER_OK) {
+        return result;
+    }
+
+    StageTimer timer(phonemizer.stats, &piper_stage_stats::phoneme_ids_seconds);
+    append_phoneme_ids(voice, phonemizer.chunk_phonemes,
+                       split_clause ? phonemizer.clause_silence_samples : 0,
+                       arena);
+    arena.chunks.back().text_end = text_position(phonemizer);
+
+    return PIPER_OK;
+}
+
+// Background thread body for phonemize_lookahead > 0
+static void run_pipeline(const piper_voice *voice,
+                         PhonemizePipeline *pipeline) {
+    // Holds one chunk at a time outside of the lock
+    PhonemeIdArena next_chunk;
+    while (true) {
+        next_chunk.clear();
+        int result;
+        try {
+            result = next_phoneme_id_chunk(voice, pipeline->phonemizer,
+                                           next_chunk);
+        } catch (...) {
+            result = PIPER_ERR_GENERIC;
+        }
+
+        std::unique_lock<std::mutex> lock(pipeline->mutex);
+        if (result != PIPER_OK) {
+            pipeline->failed = (result != PIPER_DONE);
+            pipeline->done = true;
+            pipeline->cond.notify_all();
+            return;
+        }
+
+        // Wait for room in the queue
+        pipeline->cond.wait(lock, [pipeline] {
+            return pipeline->stop ||
+                   (pipeline->chunks.size() < pipeline->capacity);
+        });
+
+        if (pipeline->stop) {
+            pipeline->done = true;
+            pipeline->cond.notify_all();
+            return;
+        }
+
+        pipeline->chunks.append(next_chunk, next_chunk.front());
+        pipeline->cond.notify_all();
+    }
+}
+
+// Stop background phonemization (if running)
+static void stop_pipeline(piper_synthesizer *synth) {
+    if (!synth->pipeline) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(synth->pipeline->mutex);
+        synth->pipeline->stop = true;
+    }
+    synth->pipeline->cond.notify_all();
+
+    if (synth->pipeline->thread.joinable()) {
+        synth->pipeline->thread.join();
+    }
+
+    synth->pipeline.reset();
+}
+
+// Move phonemized chunks from the background pipeline into phoneme_id_queue.
+// Waits for at least one chunk if the queue is empty.
+// Returns PIPER_OK or an error code if phonemization failed.
+static int pull_from_pipeline(piper_synthesizer *synth) {
+    if (!synth->pipeline) {
+        return PIPER_OK;
+    }
+
+    PhonemizePipeline &pipeline = *synth->pipeline;
+    std::unique_lock<std::mutex> lock(pipeline.mutex);
+
+    // Chunks are appended as they arrive, so reclaim the consumed ones
+    synth->phoneme_id_queue.compact();
+
+    if (synth->phoneme_id_queue.empty()) {
+        pipeline.cond.wait(lock, [&pipeline] {
+            return pipeline.done || !pipeline.chunks.empty();
+        });
+    }
+
+    // Take enough for a batch
+    while (!pipeline.chunks.empty() &&
+           (synth->phoneme_id_queue.size() <
+            (std::size_t)synth->max_batch_sentences)) {
+        synth->phoneme_id_queue.append(pipeline.chunks,
+                                       pipeline.chunks.front());
+        pipeline.chunks.pop();
+    }
+    pipeline.chunks.compact();
+    pipeline.cond.notify_all();
+
+    if (pipeline.failed && synth->phoneme_id_queue.empty()) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    return PIPER_OK;
+}
+
+// True unless the background pipeline has finished with nothing left.
+// Doesn't wait for phonemization, so a chunk is only known to be the last
+// one if the pipeline was already done when it was synthesized.
+static bool pipeline_has_more(piper_synthesizer *synth) {
+    if (!synth->pipeline) {
+        return false;
+    }
+
+    PhonemizePipeline &pipeline = *synth->pipeline;
+    std::lock_guard<std::mutex> lock(pipeline.mutex);
+
+    return !pipeline.done || !pipeline.chunks.empty() || pipeline.failed;
+}
+
+template <typename T> static void append_key_bytes(std::string &key, T value) {
+    key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Text as it is phonemized when the cache is enabled: NFC-normalized with
+// runs of spaces and tabs collapsed. Line breaks are kept, since espeak-ng
+// may split at them. Phonemizing this text instead of the original means a
+// cache hit returns the same chunks as a miss.
+static std::string normalize_cache_text(const std::string &text) {
+    std::string collapsed;
+    collapsed.reserve(text.size());
+    bool in_space = true;
+    for (char c : text) {
+        if ((c == ' ') || (c == '\t')) {
+            in_space = true;
+            continue;
+        }
+
+        // Spaces next to a line break are dropped
+        if (in_space && !collapsed.empty() && (collapsed.back() != '\n') &&
+            (c != '\n')) {
+            collapsed += ' ';
+        }
+        in_space = false;
+        collapsed += c;
+    }
+
+    return una::norm::to_nfc_utf8(collapsed);
+}
+
+// Cache key of a text (already normalized with normalize_cache_text) for the
+// phoneme ids: the text followed by the options that change how it is split
+// into chunks.
+static std::string phoneme_cache_key(const TextPhonemizer &phonemizer) {
+    std::string key = phonemizer.text;
+    key += '\0';
+    append_key_bytes(key, phonemizer.max_chunk_phonemes);
+    append_key_bytes(key, phonemizer.clause_silence_samples);
+
+    return key;
+}
+
+// Cache key for the audio of a text with the settings that change it
+static std::string audio_cache_key(const std::string &phoneme_key,
+                                   const piper_synthesize_options &options) {
+    std::string key = phoneme_key;
+    key += '\0';
+    append_key_bytes(key, options.speaker_id);
+    append_key_bytes(key, options.length_scale);
+    if (options.speaker_embedding) {
+        key.append(reinterpret_cast<const char *>(options.speaker_embedding),
+                   options.speaker_embedding_size * sizeof(float));
+    }
+
+    return key;
+}
+
+// Add the results of a finished synthesis to the voice's cache
+static void finish_capture(piper_synthesizer *synth) {
+    SynthesisCapture &capture = synth->capture;
+    SynthesisCache &cache = synth->voice->cache;
+
+    if (!capture.phoneme_key.empty()) {
+        SynthesisCacheEntry entry;
+        entry.key = std::move(capture.phoneme_key);
+        entry.phoneme_ids = capture.phoneme_ids;
+        cache.insert(std::move(entry));
+    }
+
+    if (!capture.audio_key.empty()) {
+        SynthesisCacheEntry entry;
+        entry.key = std::move(capture.audio_key);
+        entry.phoneme_ids = std::move(capture.phoneme_ids);
+        entry.audio = std::move(capture.audio);
+        cache.insert(std::move(entry));
+    }
+
+    capture.clear();
+}
+
+// Keep the phoneme ids and audio of a chunk for the cache.
+// Must be called before resampling, so audio is cached at the voice's rate.
+static void capture_chunk(piper_synthesizer *synth,
+                          const PhonemeIdChunkSpan &source,
+                          const piper_audio_chunk *chunk) {
+    SynthesisCapture &capture = synth->capture;
+    if (!capture.active()) {
+        return;
+    }
+
+    capture.phoneme_ids.append(synth->phoneme_id_queue, source);
+    if (!capture.audio_key.empty()) {
+        SynthesizedChunk audio;
+        audio.source = capture.phoneme_ids.chunks.back();
+        audio.samples.assign(chunk->samples,
+                             chunk->samples + chunk->num_samples);
+        audio.alignments = synth->chunk_alignments;
+        capture.audio.push_back(std::move(audio));
+    }
+
+    if (chunk->is_last) {
+        finish_capture(synth);
+    }
+}
+
+// Copy the model inputs of a request from its options.
+// Returns PIPER_OK or PIPER_ERR_SPEAKER_EMBEDDING if the speaker embedding
+// doesn't fit the model.
+static int set_request_params(const piper_voice *voice,
+                              const piper_synthesize_options &options,
+                              RequestParams &params) {
+    params.length_scale = options.length_scale;
+    params.noise_scale = options.noise_scale;
+    params.noise_w_scale = options.noise_w_scale;
+    params.speaker_id = options.speaker_id;
+    params.speaker_embedding.clear();
+
+    if (!voice->has_speaker_embedding_input) {
+        // Speakers can only be selected by id
+        return options.speaker_embedding ? PIPER_ERR_SPEAKER_EMBEDDING : PIPER_OK;
+    }
+
+    if (!options.speaker_embedding || (options.speaker_embedding_size == 0)) {
+        return PIPER_ERR_SPEAKER_EMBEDDING;
+    }
+
+    if ((voice->speaker_embedding_size > 0) &&
+        (options.speaker_embedding_size != voice->speaker_embedding_size)) {
+        return PIPER_ERR_SPEAKER_EMBEDDING;
+    }
+
+    params.speaker_embedding.assign(options.speaker_embedding,
+                                    options.speaker_embedding +
+                                        options.speaker_embedding_size);
+
+    return PIPER_OK;
+}
+
+// Clear the state of the previous request and apply the options of a new
+// one. Shared by every way of starting synthesis.
+static int start_request(piper_synthesizer *synth,
+                         const piper_synthesize_options &options) {
+    // Clear state
+    stop_pipeline(synth);
+    synth->phoneme_id_queue.clear();
+    while (!synth->synthesized_queue.empty()) {
+        synth->synthesized_queue.pop();
+    }
+    synth->chunk_samples.clear();
+    synth->capture.clear();
+    synth->last_chunk_pending = false;
+    synth->cancelled.store(false, std::memory_order_release);
+    synth->run_options.UnsetTerminate();
+    synth->stats.start_request();
+
+    int result = set_request_params(synth->voice, options, synth->params);
+    if (result != PIPER_OK) {
+        return result;
+    }
+    if (options.batcher && (options.batcher->voice != synth->voice)) {
+        return PIPER_ERR_GENERIC;
+    }
+    if (options.batcher != synth->batcher) {
+        if (options.batcher) {
+            options.batcher->ref_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        release_batcher(synth->batcher);
+        synth->batcher = options.batcher;
+    }
+    synth->max_batch_sentences = std::max(1, options.max_batch_sentences);
+    synth->has_deadline = (options.timeout_ms > 0);
+    if (synth->has_deadline) {
+        synth->deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(options.timeout_ms);
+    }
+    synth->sample_format = options.sample_format;
+    synth->skip_metadata = options.skip_metadata;
+    synth->output_sample_rate = (options.output_sample_rate > 0)
+                                    ? options.output_sample_rate
+                                    : synth->voice->sample_rate;
+    synth->resampler.configure(synth->voice->sample_rate,
+                               synth->output_sample_rate);
+
+    return PIPER_OK;
+}
+
+// Set up phonemization of a request (without its text)
+static void init_phonemizer(piper_synthesizer *synth,
+                            const piper_synthesize_options &options,
+                            TextPhonemizer &phonemizer) {
+    phonemizer.espeak_voice = synth->voice->espeak_voice;
+    phonemizer.max_chunk_phonemes = options.max_chunk_phonemes;
+    phonemizer.stats = &synth->stats;
+    if (options.clause_silence_seconds > 0) {
+        phonemizer.clause_silence_samples = static_cast<std::size_t>(
+            options.clause_silence_seconds * synth->voice->sample_rate);
+    }
+}
+
+int piper_synthesize_start(struct piper_synthesizer *synth, const char *text,
+                           const piper_synthesize_options *options) {
+    if (!synth) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    std::unique_ptr<piper_synthesize_options> default_options;
+    if (!options) {
+        default_options = std::make_unique<piper_synthesize_options>(
+            piper_default_synthesize_options(synth));
+        options = default_options.get();
+    }
+
+    int result = start_request(synth, *options);
+    if (result != PIPER_OK) {
+        return result;
+    }
+
+    TextPhonemizer phonemizer;
+    init_phonemizer(synth, *options, phonemizer);
+    phonemizer.text = text ? text : "";
+
+    SynthesisCache &cache = synth->voice->cache;
+    if (cache.enabled()) {
+        phonemizer.text = normalize_cache_text(phonemizer.text);
+        std::string phoneme_key = phoneme_cache_key(phonemizer);
+
+        // Audio is only reproducible without noise
+        if (options->cache_audio && (options->noise_scale == 0) &&
+            (options->noise_w_scale == 0)) {
+            std::string audio_key = audio_cache_key(phoneme_key, *options);
+            std::vector<SynthesizedChunk> audio;
+            if (cache.find(audio_key, true, synth->phoneme_id_queue, &audio)) {
+                // Every chunk is already synthesized
+                synth->phoneme_id_queue.next_chunk =
+                    synth->phoneme_id_queue.chunks.size();
+                for (auto &audio_chunk : audio) {
+                    synth->synthesized_queue.push(std::move(audio_chunk));
+                }
+
+                return PIPER_OK;
+            }
+
+            synth->capture.audio_key = std::move(audio_key);
+        }
+
+        if (cache.find(phoneme_key, false, synth->phoneme_id_queue, nullptr)) {
+            return PIPER_OK;
+        }
+
+        synth->capture.phoneme_key = std::move(phoneme_key);
+    }
+
+    if (options->phonemize_lookahead > 0) {
+        // Phonemize on a background thread
+        synth->pipeline = std::make_unique<PhonemizePipeline>();
+        synth->pipeline->phonemizer = std::move(phonemizer);
+        synth->pipeline->phonemizer.text_ptr =
+            synth->pipeline->phonemizer.text.c_str();
+        synth->pipeline->capacity = options->phonemize_lookahead;
+        synth->pipeline->thread =
+            std::thread(run_pipeline, synth->voice, synth->pipeline.get());
+
+        return PIPER_OK;
+    }
+
+    // Phonemize everything up front
+    phonemizer.text_ptr = phonemizer.text.c_str();
+    while (true) {
+        int result = next_phoneme_id_chunk(synth->voice, phonemizer,
+                                           synth->phoneme_id_queue);
+        if (result == PIPER_DONE) {
+            break;
+        }
+        if (result != PIPER_OK) {
+            return result;
+        }
+    }
+
+    if (!synth->capture.phoneme_key.empty()) {
+        // Cache the phoneme ids now in case synthesis isn't finished
+        SynthesisCacheEntry entry;
+        entry.key = std::move(synth->capture.phoneme_key);
+        entry.phoneme_ids = synth->phoneme_id_queue;
+        cache.insert(std::move(entry));
+        synth->capture.phoneme_key.clear();
+    }
+
+    return PIPER_OK;
+}
+
+int piper_synthesize_phonemes(piper_synthesizer *synth,
+                              const char32_t *phonemes, size_t num_phonemes,
+                              const piper_synthesize_options *options) {
+    if (!synth || (!phonemes && (num_phonemes > 0))) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    piper_synthesize_options default_options;
+    if (!options) {
+        default_options = piper_default_synthesize_options(synth);
+        options = &default_options;
+    }
+
+    int result = start_request(synth, *options);
+    if (result != PIPER_OK) {
+        return result;
+    }
+
+    StageTimer timer(&synth->stats, &piper_stage_stats::phoneme_ids_seconds);
+    PhonemeIdArena &arena = synth->phoneme_id_queue;
+
+    // One chunk per non-empty line
+    std::size_t line_start = 0;
+    while (line_start < num_phonemes) {
+        std::size_t line_end = line_start;
+        while ((line_end < num_phonemes) && (phonemes[line_end] != U'\n')) {
+            line_end++;
+        }
+
+        if (line_end > line_start) {
+            PhonemeIdChunkSpan span = begin_phoneme_id_chunk(arena, 0);
+            for (std::size_t i = line_start; i < line_end; i++) {
+                append_phoneme(synth->voice, phonemes[i], arena);
+            }
+            end_phoneme_id_chunk(arena, span);
+        }
+
+        line_start = line_end + 1;
+    }
+
+    return PIPER_OK;
+}
+
+int piper_synthesize_phonemes_utf8(piper_synthesizer *synth,
+                                   const char *phonemes,
+                                   const piper_synthesize_options *options) {
+    std::u32string codepoints;
+    if (phonemes) {
+        std::string phonemes_str(phonemes);
+        for (char32_t codepoint : una::views::utf8(phonemes_str)) {
+            codepoints.push_back(codepoint);
+        }
+    }
+
+    return piper_synthesize_phonemes(synth, codepoints.data(),
+                                     codepoints.size(), options);
+}
+
+int piper_synthesize_ids(piper_synthesizer *synth, const int64_t *ids,
+                         size_t num_ids,
+                         const piper_synthesize_options *options) {
+    if (!synth || (!ids && (num_ids > 0))) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    for (std::size_t i = 0; i < num_ids; i++) {
+        if (ids[i] < 0) {
+            return PIPER_ERR_GENERIC;
+        }
+    }
+
+    piper_synthesize_options default_options;
+    if (!options) {
+        default_options = piper_default_synthesize_options(synth);
+        options = &default_options;
+    }
+
+    int result = start_request(synth, *options);
+    if (result != PIPER_OK) {
+        return result;
+    }
+
+    // A chunk ends after each EOS (or at the end of the ids)
+    PhonemeIdArena &arena = synth->phoneme_id_queue;
+    std::size_t chunk_start = 0;
+    for (std::size_t i = 0; i < num_ids; i++) {
+        if ((ids[i] != ID_EOS) && (i + 1 < num_ids)) {
+            continue;
+        }
+
+        PhonemeIdChunkSpan span;
+        span.phonemes_offset = arena.phonemes.size();
+        span.ids_offset = arena.ids.size();
+        arena.ids.insert(arena.ids.end(), ids + chunk_start, ids + i + 1);
+        span.num_ids = (i + 1) - chunk_start;
+        arena.chunks.push_back(span);
+
+        chunk_start = i + 1;
+    }
+
+    return PIPER_OK;
+}
+
+piper_document_options piper_default_document_options(void) {
+    piper_document_options options;
+    options.read_text = nullptr;
+    options.write_audio = nullptr;
+    options.on_progress = nullptr;
+    options.user_data = nullptr;
+    options.lookahead_chunks = DEFAULT_DOCUMENT_LOOKAHEAD_CHUNKS;
+
+    return options;
+}
+
+int piper_synthesize_document(piper_synthesizer *synth,
+                              const piper_document_options *document,
+                              const piper_synthesize_options *options) {
+    if (!synth || !document || !document->read_text ||
+        !document->write_audio) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    piper_synthesize_options default_options;
+    if (!options) {
+        default_options = piper_default_synthesize_options(synth);
+        options = &default_options;
+    }
+
+    int result = start_request(synth, *options);
+    if (result != PIPER_OK) {
+        return result;
+    }
+
+    // Text is read by the pipeline as it phonemizes, which bounds how much
+    // of the document is in memory
+    synth->pipeline = std::make_unique<PhonemizePipeline>();
+    TextPhonemizer &phonemizer = synth->pipeline->phonemizer;
+    init_phonemizer(synth, *options, phonemizer);
+    phonemizer.read_text = document->read_text;
+    phonemizer.read_text_user_data = document->user_data;
+    synth->pipeline->capacity = static_cast<std::size_t>(std::max(
+        {1, document->lookahead_chunks, synth->max_batch_sentences}));
+    synth->pipeline->thread =
+        std::thread(run_pipeline, synth->voice, synth->pipeline.get());
+
+    auto start_time = std::chrono::steady_clock::now();
+    piper_document_progress progress;
+    std::memset(&progress, 0, sizeof(progress));
+
+    piper_audio_chunk chunk;
+    while (true) {
+        result = piper_synthesize_next(synth, &chunk);
+        if (result != PIPER_OK) {
+            break;
+        }
+
+        if (document->write_audio(document->user_data, &chunk) != 0) {
+            result = PIPER_ERR_CANCELLED;
+            break;
+        }
+
+        progress.text_bytes_done = synth->chunk_text_end;
+        if (chunk.is_last && synth->pipeline) {
+            // The whole document has been read by now
+            std::lock_guard<std::mutex> lock(synth->pipeline->mutex);
+            progress.text_bytes_done =
+                text_position(synth->pipeline->phonemizer);
+        }
+        progress.num_chunks++;
+        if (chunk.sample_rate > 0) {
+            progress.audio_seconds +=
+                static_cast<double>(chunk.num_samples) / chunk.sample_rate;
+        }
+        progress.elapsed_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          start_time)
+                .count();
+        progress.real_time_factor =
+            (progress.audio_seconds > 0)
+                ? (progress.elapsed_seconds / progress.audio_seconds)
+                : 0.0;
+        if (document->on_progress) {
+            document->on_progress(document->user_data, &progress);
+        }
+    }
+
+    // read_text must not be called once we return
+    drop_queued(synth);
+
+    return result;
+}
+
+// Write the request inputs into their cached tensors.
+// row_params holds the params of each row. Rows share the scales of the
+// first one and must have the same embedding size.
+// Tensors are only recreated when their shape changes.
+static void set_request_inputs(piper_synthesizer *synth,
+                               const RequestParams *const *row_params,
+                               std::size_t batch_size) {
+    InferenceWorkspace &ws = synth->workspace;
+    const piper_voice *voice = synth->voice;
+    const RequestParams &params = *row_params[0];
+
+    ws.scales = {params.noise_scale, params.length_scale, params.noise_w_scale};
+
+    bool resized = (batch_size != ws.request_inputs_batch_size);
+    std::size_t input_index = INPUT_NAMES.size();
+
+    if (voice->has_sid_input) {
+        ws.speaker_ids.resize(batch_size);
+        for (std::size_t i = 0; i < batch_size; i++) {
+            ws.speaker_ids[i] = (int64_t)row_params[i]->speaker_id;
+        }
+        if (resized) {
+            ws.speaker_ids_shape[0] = (int64_t)batch_size;
+            ws.input_tensors[input_index] = Ort::Value::CreateTensor<int64_t>(
+                ws.memory_info, ws.speaker_ids.data(), ws.speaker_ids.size(),
+                ws.speaker_ids_shape.data(), ws.speaker_ids_shape.size());
+        }
+        input_index++;
+    }
+
+    if (voice->has_speaker_embedding_input) {
+        // Zeros if no embedding was given (warmup)
+        std::size_t embedding_size =
+            params.speaker_embedding.empty()
+                ? std::max<std::size_t>(1, voice->speaker_embedding_size)
+                : params.speaker_embedding.size();
+
+        ws.speaker_embeddings.resize(batch_size * embedding_size);
+        for (std::size_t i = 0; i < batch_size; i++) {
+            const std::vector<float> &embedding = row_params[i]->speaker_embedding;
+            float *row = ws.speaker_embeddings.data() + (i * embedding_size);
+            if (embedding.empty()) {
+                std::fill(row, row + embedding_size, 0.0f);
+            } else {
+                std::copy(embedding.begin(), embedding.end(), row);
+            }
+        }
+
+        if (resized ||
+            (ws.speaker_embeddings_shape[1] != (int64_t)embedding_size)) {
+            ws.speaker_embeddings_shape = {(int64_t)batch_size,
+                                           (int64_t)embedding_size};
+            ws.input_tensors[input_index] = Ort::Value::CreateTensor<float>(
+                ws.memory_info, ws.speaker_embeddings.data(),
+                ws.speaker_embeddings.size(),
+                ws.speaker_embeddings_shape.data(),
+                ws.speaker_embeddings_shape.size());
+        }
+    }
+
+    ws.request_inputs_batch_size = batch_size;
+}
+
+// Smallest bucket length that fits length ids, or length itself
+static std::size_t bucket_length(const piper_voice *voice, std::size_t length) {
+    auto bucket = std::lower_bound(voice->length_buckets.begin(),
+                                   voice->length_buckets.end(), length);
+
+    return (bucket != voice->length_buckets.end()) ? *bucket : length;
+}
+
+// Audio samples of a one-sentence run without the audio of any bucket
+// padding, which is cut using the alignments
+static std::size_t trimmed_audio_samples(const InferenceWorkspace &ws,
+                                         std::size_t num_audio_samples,
+                                         const std::vector<int> &alignments) {
+    if (!ws.bucket_padded || alignments.empty()) {
+        return num_audio_samples;
+    }
+
+    std::size_t num_aligned_samples = 0;
+    for (int num_id_samples : alignments) {
+        num_aligned_samples += (std::size_t)std::max(0, num_id_samples);
+    }
+
+    return std::min(num_audio_samples, num_aligned_samples);
+}
+
+// Read the outputs of a one-sentence run left in the workspace: the
+// alignments of its num_ids ids (if the voice has them) and the number of
+// audio samples without bucket padding.
+// Returns PIPER_OK or PIPER_ERR_GENERIC if there is no audio output.
+static int read_run_outputs(piper_synthesizer *synth, std::size_t num_ids,
+                            std::vector<int> &alignments,
+                            std::size_t &num_audio_samples) {
+    InferenceWorkspace &ws = synth->workspace;
+    const auto &output_tensors = ws.output_tensors;
+    if ((output_tensors.size() < 1) || (!output_tensors.front().IsTensor())) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    alignments.clear();
+    if (output_tensors.size() > 1) {
+        // Without bucket padding
+        std::size_t num_alignments = std::min<std::size_t>(
+            last_dimension(output_tensors[1], ws.output_shape), num_ids);
+        const float *alignments_tensor_data =
+            output_tensors[1].GetTensorData<float>();
+
+        alignments.resize(num_alignments);
+        for (std::size_t i = 0; i < num_alignments; i++) {
+            alignments[i] =
+                (int)(alignments_tensor_data[i] * synth->voice->hop_length);
+        }
+    }
+
+    num_audio_samples = trimmed_audio_samples(
+        ws, last_dimension(output_tensors.front(), ws.output_shape),
+        alignments);
+
+    return PIPER_OK;
+}
+
+// Run the model on a [batch_size, max_length] block of phoneme ids.
+// lengths and row_params hold the real length and params of each row.
+// Outputs are left in the workspace until the next call.
+// Returns PIPER_OK or PIPER_ERR_CANCELLED if the run was terminated.
+static int run_session(piper_synthesizer *synth,
+                       const RequestParams *const *row_params,
+                       const int64_t *phoneme_ids, const int64_t *lengths,
+                       std::size_t batch_size, std::size_t max_length) {
+    InferenceWorkspace &ws = synth->workspace;
+
+    // Pad up to a bucket length so the model sees fewer distinct shapes.
+    // Padding is masked out by the real lengths.
+    std::size_t padded_length = bucket_length(synth->voice, max_length);
+    ws.bucket_padded = (padded_length > max_length);
+    if (ws.bucket_padded) {
+        ws.bucket_phoneme_ids.assign(batch_size * padded_length, ID_PAD);
+        for (std::size_t i = 0; i < batch_size; i++) {
+            const int64_t *row = phoneme_ids + (i * max_length);
+            std::copy(row, row + max_length,
+                      ws.bucket_phoneme_ids.begin() + (i * padded_length));
+        }
+        phoneme_ids = ws.bucket_phoneme_ids.data();
+        max_length = padded_length;
+    }
+
+    // Fill preallocated inputs
+    ws.phoneme_ids_shape = {(int64_t)batch_size, (int64_t)max_length};
+    ws.phoneme_id_lengths.assign(lengths, lengths + batch_size);
+    ws.phoneme_id_lengths_shape[0] = (int64_t)batch_size;
+
+    // Inputs are only read, so ids can come straight from an arena
+    ws.input_tensors[0] = Ort::Value::CreateTensor<int64_t>(
+        ws.memory_info, const_cast<int64_t *>(phoneme_ids),
+        batch_size * max_length,
+        ws.phoneme_ids_shape.data(), ws.phoneme_ids_shape.size());
+
+    ws.input_tensors[1] = Ort::Value::CreateTensor<int64_t>(
+        ws.memory_info, ws.phoneme_id_lengths.data(),
+        ws.phoneme_id_lengths.size(), ws.phoneme_id_lengths_shape.data(),
+        ws.phoneme_id_lengths_shape.size());
+
+    set_request_inputs(synth, row_params, batch_size);
+
+    // Release outputs from the previous call so onnxruntime allocates new ones
+    for (auto &output_tensor : ws.output_tensors) {
+        output_tensor = Ort::Value{nullptr};
+    }
+
+    // Infer
+    try {
+        synth->voice->session->Run(synth->run_options, ws.input_names.data(),
+                                   ws.input_tensors.data(),
+                                   ws.input_tensors.size(),
+                                   ws.output_names.data(),
+                                   ws.output_tensors.data(),
+                                   ws.output_tensors.size());
+    } catch (const Ort::Exception &) {
+        ws.input_tensors[0] = Ort::Value{nullptr};
+        if (synth->cancelled.load(std::memory_order_acquire)) {
+            // Terminated by piper_synthesize_cancel
+            return PIPER_ERR_CANCELLED;
+        }
+
+        throw;
+    }
+
+    // Ids point into caller memory
+    ws.input_tensors[0] = Ort::Value{nullptr};
+
+    return PIPER_OK;
+}
+
+// Split the outputs of a batch into one chunk per row using the
+// alignments. The source of each chunk must already be set.
+static int split_batch_outputs(piper_synthesizer *synth,
+                               std::vector<SynthesizedChunk> &batch) {
+    InferenceWorkspace &ws = synth->workspace;
+    auto &output_tensors = ws.output_tensors;
+    if ((output_tensors.size() < 2) || (!output_tensors[0].IsTensor()) ||
+        (!output_tensors[1].IsTensor())) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    // audio is [batch, 1, time], alignments are [batch, 1, max_length]
+    std::size_t audio_stride = last_dimension(output_tensors[0], ws.output_shape);
+    std::size_t alignments_stride =
+        last_dimension(output_tensors[1], ws.output_shape);
+    const float *audio_data = output_tensors[0].GetTensorData<float>();
+    const float *alignments_data = output_tensors[1].GetTensorData<float>();
+
+    for (std::size_t i = 0; i < batch.size(); i++) {
+        SynthesizedChunk &synthesized = batch[i];
+        const PhonemeIdChunkSpan &source = synthesized.source;
+
+        const float *item_alignments = alignments_data + (i * alignments_stride);
+        std::size_t num_item_samples = 0;
+        synthesized.alignments.clear();
+        for (std::size_t j = 0; j < source.num_ids; j++) {
+            int num_id_samples = (int)(item_alignments[j] * synth->voice->hop_length);
+            synthesized.alignments.push_back(num_id_samples);
+            num_item_samples += num_id_samples;
+        }
+        num_item_samples = std::min(num_item_samples, audio_stride);
+
+        const float *item_audio = audio_data + (i * audio_stride);
+        synthesized.samples.assign(num_item_samples + source.silence_samples,
+                                   0.0f);
+        std::copy(item_audio, item_audio + num_item_samples,
+                  synthesized.samples.begin());
+    }
+
+    return PIPER_OK;
+}
+
+// Synthesize several queued chunks in one inference call and move them into
+// synthesized_queue. Consecutive chunks are grouped (to keep their order)
+// while padding stays reasonable.
+static int synthesize_batch(piper_synthesizer *synth) {
+    InferenceWorkspace &ws = synth->workspace;
+
+    // Choose batch
+    std::size_t batch_size = 0;
+    std::size_t max_length = 0;
+    std::size_t total_length = 0;
+    std::size_t max_batch_size = std::min(
+        (std::size_t)synth->max_batch_sentences, synth->phoneme_id_queue.size());
+    PhonemeIdArena &queue = synth->phoneme_id_queue;
+    std::vector<SynthesizedChunk> batch;
+    while ((batch_size < max_batch_size) && !queue.empty()) {
+        std::size_t next_length = queue.front().num_ids;
+        std::size_t new_max_length = std::max(max_length, next_length);
+        std::size_t new_total_length = total_length + next_length;
+        if ((batch_size > 0) &&
+            ((float)(new_max_length * (batch_size + 1)) >
+             (MAX_BATCH_PADDING_RATIO * new_total_length))) {
+            // Too much padding
+            break;
+        }
+
+        batch.emplace_back();
+        batch.back().source = queue.front();
+        queue.pop();
+
+        batch_size++;
+        max_length = new_max_length;
+        total_length = new_total_length;
+    }
+
+    // Pad ids into a [batch_size, max_length] block
+    ws.batch_phoneme_ids.assign(batch_size * max_length, ID_PAD);
+    std::vector<int64_t> lengths(batch_size);
+    for (std::size_t i = 0; i < batch_size; i++) {
+        const PhonemeIdChunkSpan &source = batch[i].source;
+        const PhonemeId *item_ids = queue.chunk_ids(source);
+        std::copy(item_ids, item_ids + source.num_ids,
+                  ws.batch_phoneme_ids.begin() + (i * max_length));
+        lengths[i] = (int64_t)source.num_ids;
+    }
+
+    // All rows belong to this request
+    std::vector<const RequestParams *> row_params(batch_size, &synth->params);
+
+    int result;
+    {
+        StageTimer timer(&synth->stats, &piper_stage_stats::inference_seconds);
+        result = run_session(synth, row_params.data(),
+                             ws.batch_phoneme_ids.data(), lengths.data(),
+                             batch_size, max_length);
+    }
+    if (result != PIPER_OK) {
+        return result;
+    }
+
+    StageTimer timer(&synth->stats, &piper_stage_stats::output_seconds);
+    result = split_batch_outputs(synth, batch);
+    if (result != PIPER_OK) {
+        return result;
+    }
+
+    for (SynthesizedChunk &synthesized : batch) {
+        synth->synthesized_queue.emplace(std::move(synthesized));
+    }
+
+    return PIPER_OK;
+}
+
+// Fill phoneme and id fields of an audio chunk.
+// Phonemes point into the arena, which must not change until the next call.
+static void set_chunk_phonemes(std::vector<int> &chunk_phoneme_ids,
+                               piper_audio_chunk *chunk,
+                               const PhonemeIdArena &arena,
+                               const PhonemeIdChunkSpan &source) {
+    chunk->phonemes = arena.chunk_phonemes(source);
+    chunk->num_phonemes = source.num_phonemes;
+
+    // Copy phoneme ids
+    const PhonemeId *source_ids = arena.chunk_ids(source);
+    for (std::size_t i = 0; i < source.num_ids; i++) {
+        PhonemeId phoneme_id = source_ids[i];
         if (phoneme_id < std::numeric_limits<int>::min() ||
             phoneme_id > std::numeric_limits<int>::max()) {
             continue;
         }
-        synth->chunk_phoneme_ids.push_back(static_cast<int>(phoneme_id));
+        chunk_phoneme_ids.push_back(static_cast<int>(phoneme_id));
+    }
+
+    chunk->phoneme_ids = chunk_phoneme_ids.data();
+    chunk->num_phoneme_ids = chunk_phoneme_ids.size();
+}
+
+// Reset all fields of an audio chunk
+static void clear_chunk(piper_audio_chunk *chunk, int sample_rate) {
+    chunk->sample_rate = sample_rate;
+    chunk->samples = nullptr;
+    chunk->num_samples = 0;
+    chunk->is_last = false;
+    chunk->phonemes = nullptr;
+    chunk->num_phonemes = 0;
+    chunk->phoneme_ids = nullptr;
+    chunk->num_phoneme_ids = 0;
+    chunk->alignments = nullptr;
+    chunk->num_alignments = 0;
+    chunk->pcm_data = nullptr;
+    chunk->pcm_size = 0;
+    chunk->sample_format = PIPER_SAMPLE_FORMAT_FLOAT32;
+}
+
+// Resample an audio chunk to the output sample rate.
+// Filter state carries over between chunks of the same synthesis and the
+// tail is flushed with the last chunk.
+// Returns true if the samples were replaced by chunk_samples.
+static bool resample_chunk(Resampler &resampler,
+                           std::vector<float> &chunk_samples,
+                           std::vector<float> &resampled_samples,
+                           std::vector<int> &chunk_alignments,
+                           piper_audio_chunk *chunk, int output_sample_rate) {
+    if (!resampler.active()) {
+        return false;
+    }
+
+    // Samples may point into chunk_samples, so resample into a second buffer
+    resampler.process(chunk->samples, chunk->num_samples, chunk->is_last,
+                      resampled_samples);
+    chunk_samples.swap(resampled_samples);
+    chunk->samples = chunk_samples.data();
+    chunk->num_samples = chunk_samples.size();
+    chunk->sample_rate = output_sample_rate;
+
+    // Scale cumulative counts so the alignments still add up
+    int64_t input_position = 0;
+    int64_t output_position = 0;
+    for (auto &alignment : chunk_alignments) {
+        input_position += alignment;
+        int64_t next_output_position = resampler.scale(input_position);
+        alignment = (int)(next_output_position - output_position);
+        output_position = next_output_position;
+    }
+
+    return true;
+}
+
+// Fill pcm fields of an audio chunk from its samples
+static void set_chunk_pcm(std::vector<uint8_t> &chunk_pcm,
+                          piper_audio_chunk *chunk,
+                          piper_sample_format sample_format) {
+    switch (sample_format) {
+    case PIPER_SAMPLE_FORMAT_INT16:
+        chunk_pcm.resize(chunk->num_samples * sizeof(int16_t));
+        float_to_int16(chunk->samples, chunk->num_samples,
+                       reinterpret_cast<int16_t *>(chunk_pcm.data()));
+        break;
+
+    case PIPER_SAMPLE_FORMAT_MULAW:
+        chunk_pcm.resize(chunk->num_samples);
+        float_to_g711<int16_to_ulaw>(chunk->samples, chunk->num_samples,
+                                     chunk_pcm.data());
+        break;
+
+    case PIPER_SAMPLE_FORMAT_ALAW:
+        chunk_pcm.resize(chunk->num_samples);
+        float_to_g711<int16_to_alaw>(chunk->samples, chunk->num_samples,
+                                     chunk_pcm.data());
+        break;
+
+    default:
+        chunk->pcm_data = chunk->samples;
+        chunk->pcm_size = chunk->num_samples * sizeof(float);
+        chunk->sample_format = PIPER_SAMPLE_FORMAT_FLOAT32;
+        return;
+    }
+
+    chunk->pcm_data = chunk_pcm.data();
+    chunk->pcm_size = chunk_pcm.size();
+    chunk->sample_format = sample_format;
+}
+
+// Count a returned chunk (at the voice's sample rate) in the stats
+static void record_chunk(piper_synthesizer *synth,
+                         const piper_audio_chunk *chunk) {
+    synth->stats.add_chunk(chunk->num_samples, synth->voice->sample_rate,
+                           synth->phoneme_id_queue.size() +
+                               synth->synthesized_queue.size());
+}
+
+// Drop the rest of the current synthesis
+static void drop_queued(piper_synthesizer *synth) {
+    stop_pipeline(synth);
+    synth->phoneme_id_queue.clear();
+    while (!synth->synthesized_queue.empty()) {
+        synth->synthesized_queue.pop();
+    }
+    synth->capture.clear();
+    synth->last_chunk_pending = false;
+}
+
+// Returns PIPER_ERR_CANCELLED or PIPER_ERR_TIMEOUT if synthesis must stop,
+// otherwise PIPER_OK
+static int check_interrupted(piper_synthesizer *synth) {
+    if (synth->cancelled.load(std::memory_order_acquire)) {
+        return PIPER_ERR_CANCELLED;
+    }
+
+    if (synth->has_deadline &&
+        (std::chrono::steady_clock::now() >= synth->deadline)) {
+        return PIPER_ERR_TIMEOUT;
+    }
+
+    return PIPER_OK;
+}
+
+void piper_synthesize_cancel(piper_synthesizer *synth) {
+    if (!synth) {
+        return;
+    }
+
+    synth->cancelled.store(true, std::memory_order_release);
+    synth->run_options.SetTerminate();
+
+    if (synth->batcher) {
+        // Wake up piper_synthesize_next if it waits on the batcher
+        std::lock_guard<std::mutex> lock(synth->batcher->mutex);
+        synth->batcher->done_cond.notify_all();
+    }
+}
+
+// Queue the next chunk on the batcher and wait for its audio, which is
+// moved into synthesized_queue.
+// A chunk whose batch is already running is waited for even if synthesis
+// is interrupted.
+static int synthesize_with_batcher(piper_synthesizer *synth) {
+    piper_batcher *batcher = synth->batcher;
+
+    BatcherItem item;
+    item.params = &synth->params;
+    item.phoneme_ids = &synth->phoneme_id_queue;
+    item.synthesized.source = synth->phoneme_id_queue.front();
+    synth->phoneme_id_queue.pop();
+
+    std::unique_lock<std::mutex> lock(batcher->mutex);
+    item.queued_at = std::chrono::steady_clock::now();
+    batcher->queue.push_back(&item);
+    batcher->cond.notify_one();
+
+    auto finished = [synth, &item] {
+        return item.done ||
+               (!item.running && (check_interrupted(synth) != PIPER_OK));
+    };
+    if (synth->has_deadline) {
+        batcher->done_cond.wait_until(lock, synth->deadline, finished);
+    } else {
+        batcher->done_cond.wait(lock, finished);
+    }
+
+    if (!item.done) {
+        if (!item.running) {
+            // Withdraw from the queue
+            batcher->queue.erase(
+                std::find(batcher->queue.begin(), batcher->queue.end(), &item));
+            int interrupted = check_interrupted(synth);
+            return (interrupted != PIPER_OK) ? interrupted : PIPER_ERR_TIMEOUT;
+        }
+
+        batcher->done_cond.wait(lock, [&item] { return item.done; });
+    }
+    lock.unlock();
+
+    synth->stats.add_time(&piper_stage_stats::inference_seconds,
+                          item.inference_seconds);
+    if (item.result != PIPER_OK) {
+        return item.result;
+    }
+
+    synth->synthesized_queue.emplace(std::move(item.synthesized));
+
+    return PIPER_OK;
+}
+
+int piper_synthesize_next(struct piper_synthesizer *synth,
+                          struct piper_audio_chunk *chunk) {
+    if (!synth) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    if (!chunk) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    // Clear data from previous call
+    synth->chunk_samples.clear();
+    synth->chunk_samples_in_tensor = false;
+    synth->chunk_phoneme_ids.clear();
+    synth->chunk_alignments.clear();
+
+    clear_chunk(chunk, synth->output_sample_rate);
+
+    InferenceWorkspace &ws = synth->workspace;
+
+    // Release outputs from the previous call
+    for (auto &output_tensor : ws.output_tensors) {
+        output_tensor = Ort::Value{nullptr};
+    }
+
+    int interrupted = check_interrupted(synth);
+    if (interrupted != PIPER_OK) {
+        drop_queued(synth);
+        return interrupted;
+    }
+
+    if (synth->synthesized_queue.empty()) {
+        int result = pull_from_pipeline(synth);
+        if (result != PIPER_OK) {
+            return result;
+        }
+    }
+
+    if (synth->phoneme_id_queue.empty() && synth->synthesized_queue.empty()) {
+        chunk->is_last = true;
+        if (!synth->last_chunk_pending) {
+            // Empty final chunk
+            return PIPER_DONE;
+        }
+
+        // The previous chunk was returned before phonemization finished, so
+        // end with an empty chunk that carries is_last (and resampler tail)
+        synth->last_chunk_pending = false;
+        if (synth->capture.active()) {
+            finish_capture(synth);
+        }
+        resample_chunk(synth->resampler, synth->chunk_samples,
+                       synth->resampled_samples, synth->chunk_alignments,
+                       chunk, synth->output_sample_rate);
+        set_chunk_pcm(synth->chunk_pcm, chunk, synth->sample_format);
+
+        return PIPER_OK;
+    }
+
+    if (synth->batcher && synth->synthesized_queue.empty()) {
+        int result = synthesize_with_batcher(synth);
+        if (result != PIPER_OK) {
+            drop_queued(synth);
+            return result;
+        }
+    }
+
+    // Batching needs alignments to split the output
+    bool can_batch = !synth->batcher && (synth->max_batch_sentences > 1) &&
+                     (ws.output_tensors.size() > 1) &&
+                     (synth->phoneme_id_queue.size() > 1);
+    if (synth->synthesized_queue.empty() && can_batch) {
+        int result = synthesize_batch(synth);
+        if (result != PIPER_OK) {
+            drop_queued(synth);
+            return result;
+        }
+    }
+
+    if (!synth->synthesized_queue.empty()) {
+        // Audio from a batch
+        StageTimer timer(&synth->stats, &piper_stage_stats::output_seconds);
+        auto next_synthesized = std::move(synth->synthesized_queue.front());
+        synth->synthesized_queue.pop();
+
+        synth->chunk_samples = std::move(next_synthesized.samples);
+        chunk->samples = synth->chunk_samples.data();
+        chunk->num_samples = synth->chunk_samples.size();
+
+        synth->chunk_alignments = std::move(next_synthesized.alignments);
+        if (!synth->skip_metadata) {
+            chunk->alignments = synth->chunk_alignments.data();
+            chunk->num_alignments = synth->chunk_alignments.size();
+
+            set_chunk_phonemes(synth->chunk_phoneme_ids, chunk,
+                               synth->phoneme_id_queue, next_synthesized.source);
+        }
+
+        chunk->is_last = synth->phoneme_id_queue.empty() &&
+                         synth->synthesized_queue.empty() &&
+                         !pipeline_has_more(synth);
+        synth->last_chunk_pending = !chunk->is_last;
+
+        synth->chunk_text_end = next_synthesized.source.text_end;
+        capture_chunk(synth, next_synthesized.source, chunk);
+        record_chunk(synth, chunk);
+        resample_chunk(synth->resampler, synth->chunk_samples,
+                       synth->resampled_samples, synth->chunk_alignments,
+                       chunk, synth->output_sample_rate);
+        set_chunk_pcm(synth->chunk_pcm, chunk, synth->sample_format);
+
+        return PIPER_OK;
+    }
+
+    // Process next list of phoneme ids
+    PhonemeIdChunkSpan next_chunk = synth->phoneme_id_queue.front();
+    synth->phoneme_id_queue.pop();
+
+    int64_t next_length = (int64_t)next_chunk.num_ids;
+    const RequestParams *params = &synth->params;
+    int result;
+    {
+        StageTimer timer(&synth->stats, &piper_stage_stats::inference_seconds);
+        result = run_session(synth, &params,
+                             synth->phoneme_id_queue.chunk_ids(next_chunk),
+                             &next_length, 1, next_chunk.num_ids);
+    }
+    if (result != PIPER_OK) {
+        drop_queued(synth);
+        return result;
+    }
+
+    StageTimer timer(&synth->stats, &piper_stage_stats::output_seconds);
+    std::size_t num_audio_samples = 0;
+    result = read_run_outputs(synth, next_chunk.num_ids,
+                              synth->chunk_alignments, num_audio_samples);
+    if (result != PIPER_OK) {
+        return result;
+    }
+
+    if (!synth->skip_metadata && !synth->chunk_alignments.empty()) {
+        chunk->alignments = synth->chunk_alignments.data();
+        chunk->num_alignments = synth->chunk_alignments.size();
+    }
+
+    chunk->num_samples = num_audio_samples + next_chunk.silence_samples;
+
+    const float *audio_tensor_data =
+        ws.output_tensors.front().GetTensorData<float>();
+
+    if (next_chunk.silence_samples > 0) {
+        // Silence stays zero-filled after the audio
+        synth->chunk_samples.resize(chunk->num_samples, 0.0f);
+        std::copy(audio_tensor_data, audio_tensor_data + num_audio_samples,
+                  synth->chunk_samples.begin());
+        chunk->samples = synth->chunk_samples.data();
+    } else {
+        // Hand out the output tensor directly
+        chunk->samples = audio_tensor_data;
+        synth->chunk_samples_in_tensor = true;
+        synth->chunk_tensor_samples = num_audio_samples;
+    }
+
+    chunk->is_last =
+        synth->phoneme_id_queue.empty() && !pipeline_has_more(synth);
+    synth->last_chunk_pending = !chunk->is_last;
+
+    if (!synth->skip_metadata) {
+        set_chunk_phonemes(synth->chunk_phoneme_ids, chunk,
+                           synth->phoneme_id_queue, next_chunk);
+    }
+
+    synth->chunk_text_end = next_chunk.text_end;
+    capture_chunk(synth, next_chunk, chunk);
+    record_chunk(synth, chunk);
+    if (resample_chunk(synth->resampler, synth->chunk_samples,
+                       synth->resampled_samples, synth->chunk_alignments,
+                       chunk, synth->output_sample_rate)) {
+        synth->chunk_samples_in_tensor = false;
+    }
+    set_chunk_pcm(synth->chunk_pcm, chunk, synth->sample_format);
+
+    return PIPER_OK;
+}
+
+int piper_get_stats(piper_synthesizer *synth, piper_stats *stats) {
+    if (!synth || !stats) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    *stats = synth->stats.get();
+
+    return PIPER_OK;
+}
+
+void piper_reset_stats(piper_synthesizer *synth) {
+    if (!synth) {
+        return;
+    }
+
+    synth->stats.reset();
+}
+
+int piper_warmup(piper_synthesizer *synth) {
+    if (!synth) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    // Same ids as an empty sentence
+    std::array<int64_t, 3> phoneme_ids = {ID_BOS, ID_PAD, ID_EOS};
+    int64_t length = (int64_t)phoneme_ids.size();
+
+    synth->chunk_samples_in_tensor = false;
+    const RequestParams *params = &synth->params;
+    int result = run_session(synth, &params, phoneme_ids.data(), &length, 1,
+                             phoneme_ids.size());
+
+    for (auto &output_tensor : synth->workspace.output_tensors) {
+        output_tensor = Ort::Value{nullptr};
+    }
+
+    return result;
+}
+
+// Run the model once for every bucket length of a voice
+static int warmup_length_buckets(piper_voice *voice) {
+    std::unique_ptr<piper_synthesizer, decltype(&piper_free)> synth(
+        piper_context_create(voice), &piper_free);
+    if (!synth) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    // Shortest input, padded up to each bucket
+    std::array<int64_t, 3> phoneme_ids = {ID_BOS, ID_PAD, ID_EOS};
+    const RequestParams *params = &synth->params;
+    for (std::size_t length : voice->length_buckets) {
+        std::vector<int64_t> bucket_ids(std::max(length, phoneme_ids.size()), ID_PAD);
+        std::copy(phoneme_ids.begin(), phoneme_ids.end(), bucket_ids.begin());
+        int64_t real_length = (int64_t)phoneme_ids.size();
+
+        int result = run_session(synth.get(), &params, bucket_ids.data(),
+                                 &real_length, 1, bucket_ids.size());
+        if (result != PIPER_OK) {
+            return result;
+        }
+    }
+
+    return PIPER_OK;
+}
+
+// Move samples into a buffer owned by the caller
+static piper_sample_buffer *detach_samples(std::vector<float> &chunk_samples,
+                                           const float **samples,
+                                           size_t *num_samples) {
+    if (chunk_samples.empty()) {
+        return nullptr;
+    }
+
+    // Moving keeps the data at the same address
+    auto buffer = std::make_unique<piper_sample_buffer>();
+    buffer->samples = std::move(chunk_samples);
+    buffer->data = buffer->samples.data();
+    buffer->size = buffer->samples.size();
+
+    chunk_samples.clear();
+
+    if (samples) {
+        *samples = buffer->data;
+    }
+    if (num_samples) {
+        *num_samples = buffer->size;
+    }
+
+    return buffer.release();
+}
+
+piper_sample_buffer *piper_take_samples(piper_synthesizer *synth,
+                                        const float **samples,
+                                        size_t *num_samples) {
+    if (samples) {
+        *samples = nullptr;
+    }
+    if (num_samples) {
+        *num_samples = 0;
+    }
+
+    if (!synth) {
+        return nullptr;
+    }
+
+    if (!synth->chunk_samples_in_tensor) {
+        return detach_samples(synth->chunk_samples, samples, num_samples);
+    }
+
+    auto &audio_tensor = synth->workspace.output_tensors.front();
+    if (!audio_tensor) {
+        return nullptr;
+    }
+
+    auto buffer = std::make_unique<piper_sample_buffer>();
+    buffer->size = synth->chunk_tensor_samples;
+    buffer->data = audio_tensor.GetTensorData<float>();
+    buffer->tensor = std::move(audio_tensor);
+    buffer->session = synth->voice->session;
+
+    audio_tensor = Ort::Value{nullptr};
+    synth->chunk_samples_in_tensor = false;
+
+    if (samples) {
+        *samples = buffer->data;
+    }
+    if (num_samples) {
+        *num_samples = buffer->size;
+    }
+
+    return buffer.release();
+}
+
+void piper_float_to_int16(const float *samples, size_t num_samples,
+                          int16_t *pcm) {
+    if (!samples || !pcm) {
+        return;
+    }
+
+    float_to_int16(samples, num_samples, pcm);
+}
+
+static void write_le16(uint8_t *data, uint16_t value) {
+    data[0] = (uint8_t)(value & 0xFF);
+    data[1] = (uint8_t)((value >> 8) & 0xFF);
+}
+
+static void write_le32(uint8_t *data, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        data[i] = (uint8_t)((value >> (8 * i)) & 0xFF);
+    }
+}
+
+static bool is_little_endian() {
+    const uint16_t value = 1;
+    return *reinterpret_cast<const uint8_t *>(&value) == 1;
+}
+
+void piper_wav_header(int sample_rate, size_t num_samples, uint8_t *header) {
+    if (!header) {
+        return;
+    }
+
+    const uint16_t num_channels = 1;
+    const uint16_t bits_per_sample = 16;
+    const uint16_t block_align = num_channels * (bits_per_sample / 8);
+
+    // Sizes that don't fit are treated like an unknown length
+    uint32_t data_size = 0xFFFFFFFF;
+    uint32_t riff_size = 0xFFFFFFFF;
+    if ((num_samples != PIPER_WAV_UNKNOWN_LENGTH) &&
+        ((uint64_t)num_samples * block_align <=
+         0xFFFFFFFFULL - (PIPER_WAV_HEADER_SIZE - 8))) {
+        data_size = (uint32_t)(num_samples * block_align);
+        riff_size = data_size + (PIPER_WAV_HEADER_SIZE - 8);
+    }
+
+    std::memcpy(header, "RIFF", 4);
+    write_le32(header + 4, riff_size);
+    std::memcpy(header + 8, "WAVE", 4);
+    std::memcpy(header + 12, "fmt ", 4);
+    write_le32(header + 16, 16); // fmt chunk size
+    write_le16(header + 20, 1);  // PCM format
+    write_le16(header + 22, num_channels);
+    write_le32(header + 24, (uint32_t)sample_rate);
+    write_le32(header + 28, (uint32_t)sample_rate * block_align);
+    write_le16(header + 32, block_align);
+    write_le16(header + 34, bits_per_sample);
+    std::memcpy(header + 36, "data", 4);
+    write_le32(header + 40, data_size);
+}
+
+piper_wav_writer *piper_wav_writer_open(const char *path, int sample_rate) {
+    if (!path) {
+        return nullptr;
+    }
+
+    auto writer = std::make_unique<piper_wav_writer>();
+    writer->file = std::fopen(path, "wb");
+    if (!writer->file) {
+        return nullptr;
+    }
+
+    writer->sample_rate = sample_rate;
+
+    uint8_t header[PIPER_WAV_HEADER_SIZE];
+    piper_wav_header(sample_rate, PIPER_WAV_UNKNOWN_LENGTH, header);
+    if (std::fwrite(header, 1, sizeof(header), writer->file) !=
+        sizeof(header)) {
+        std::fclose(writer->file);
+        return nullptr;
+    }
+
+    return writer.release();
+}
+
+int piper_wav_writer_write(piper_wav_writer *writer, const float *samples,
+                           size_t num_samples) {
+    if (!writer || (!samples && (num_samples > 0))) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    if (writer->failed) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    bool swap_bytes = !is_little_endian();
+    writer->pcm.resize(std::min(num_samples, WAV_WRITE_BLOCK_SAMPLES));
+
+    for (std::size_t offset = 0; offset < num_samples;
+         offset += WAV_WRITE_BLOCK_SAMPLES) {
+        std::size_t num_block_samples =
+            std::min(num_samples - offset, WAV_WRITE_BLOCK_SAMPLES);
+        float_to_int16(samples + offset, num_block_samples,
+                       writer->pcm.data());
+
+        if (swap_bytes) {
+            // WAV data is little-endian
+            for (std::size_t i = 0; i < num_block_samples; i++) {
+                uint16_t value = (uint16_t)writer->pcm[i];
+                writer->pcm[i] = (int16_t)((value >> 8) | (value << 8));
+            }
+        }
+
+        if (std::fwrite(writer->pcm.data(), sizeof(int16_t),
+                        num_block_samples,
+                        writer->file) != num_block_samples) {
+            writer->failed = true;
+            return PIPER_ERR_GENERIC;
+        }
+
+        writer->num_samples += num_block_samples;
+    }
+
+    return PIPER_OK;
+}
+
+int piper_wav_writer_close(piper_wav_writer *writer) {
+    if (!writer) {
+        return PIPER_OK;
+    }
+
+    std::unique_ptr<piper_wav_writer> owned(writer);
+    bool ok = !writer->failed;
+
+    // Patch sizes into the header (pipes keep the unknown length)
+    if (ok && (std::fseek(writer->file, 0, SEEK_SET) == 0)) {
+        uint8_t header[PIPER_WAV_HEADER_SIZE];
+        piper_wav_header(writer->sample_rate, (size_t)writer->num_samples,
+                         header);
+        ok = (std::fwrite(header, 1, sizeof(header), writer->file) ==
+              sizeof(header));
+    }
+
+    if (std::fclose(writer->file) != 0) {
+        ok = false;
+    }
+
+    return ok ? PIPER_OK : PIPER_ERR_GENERIC;
+}
+
+void piper_sample_buffer_free(piper_sample_buffer *buffer) {
+    if (!buffer) {
+        return;
+    }
+
+    // Tensor is released before the session
+    buffer->tensor = Ort::Value{nullptr};
+    delete buffer;
+}
+
+// Synthesize one chunk into memory owned by the caller
+static int synthesize_chunk(piper_synthesizer *synth,
+                            const RequestParams &params,
+                            const PhonemeIdArena &arena,
+                            SynthesizedChunk &synthesized) {
+    InferenceWorkspace &ws = synth->workspace;
+    const PhonemeIdChunkSpan &source = synthesized.source;
+
+    int64_t length = (int64_t)source.num_ids;
+    const RequestParams *row_params = &params;
+    int result = run_session(synth, &row_params, arena.chunk_ids(source),
+                             &length, 1, source.num_ids);
+    if (result != PIPER_OK) {
+        return result;
+    }
+
+    std::size_t num_audio_samples = 0;
+    result = read_run_outputs(synth, source.num_ids, synthesized.alignments,
+                              num_audio_samples);
+    if (result != PIPER_OK) {
+        return result;
+    }
+
+    const float *audio_tensor_data =
+        ws.output_tensors.front().GetTensorData<float>();
+
+    // Silence stays zero-filled after the audio
+    synthesized.samples.assign(num_audio_samples + source.silence_samples,
+                               0.0f);
+    std::copy(audio_tensor_data, audio_tensor_data + num_audio_samples,
+              synthesized.samples.begin());
+
+    for (auto &output_tensor : ws.output_tensors) {
+        output_tensor = Ort::Value{nullptr};
+    }
+
+    return PIPER_OK;
+}
+
+// Take a task from the worker's own deque or steal one from another worker
+static bool pool_take_task(piper_pool *pool, std::size_t worker_index,
+                           PoolTask &task) {
+    std::size_t num_workers = pool->workers.size();
+    for (std::size_t i = 0; i < num_workers; i++) {
+        PoolWorker &worker = *pool->workers[(worker_index + i) % num_workers];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            continue;
+        }
+
+        if (i == 0) {
+            // Own tasks are taken in order
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+        } else {
+            // Steal the task its owner would get to last
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+
+        return true;
     }
 
-    chunk->phoneme_ids = synth->chunk_phoneme_ids.data();
-    chunk->num_phoneme_ids = synth->chunk_phoneme_ids.size();
+    return false;
+}
 
-    // Check for alignments
-    if (output_tensors.size() > 1) {
-        auto alignments_shape =
-            output_tensors[1].GetTensorTypeAndShapeInfo().GetShape();
+static void run_pool_task(piper_synthesizer *context, PoolTask &task) {
+    PoolRequestState &request = *task.request;
+    PoolChunk &slot = request.chunks[task.index];
 
-        chunk->num_alignments = alignments_shape[alignments_shape.size() - 1];
-        const float *alignments_tensor_data =
-            output_tensors[1].GetTensorData<float>();
+    bool skip = false;
+    {
+        std::lock_guard<std::mutex> lock(request.mutex);
+        skip = request.cancelled || request.failed ||
+               (request.has_deadline &&
+                (std::chrono::steady_clock::now() >= request.deadline));
+    }
 
-        synth->chunk_alignments.resize(chunk->num_alignments);
-        for (std::size_t i = 0; i < chunk->num_alignments; i++) {
-            synth->chunk_alignments[i] =
-                (int)(alignments_tensor_data[i] * synth->hop_length);
+    int result = PIPER_OK;
+    if (!skip) {
+        try {
+            result = synthesize_chunk(context, request.params,
+                                      request.phoneme_ids, slot.synthesized);
+        } catch (...) {
+            result = PIPER_ERR_GENERIC;
         }
+    }
 
-        chunk->alignments = synth->chunk_alignments.data();
+    std::lock_guard<std::mutex> lock(request.mutex);
+    if (result != PIPER_OK) {
+        request.failed = true;
+    }
+    slot.ready = true;
+    request.cond.notify_all();
+}
+
+static void run_pool_worker(piper_pool *pool, std::size_t worker_index) {
+    piper_synthesizer *context = pool->workers[worker_index]->context;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->cond.wait(lock, [pool] {
+                return pool->stop || (pool->num_queued > 0);
+            });
+
+            if (pool->stop) {
+                return;
+            }
+
+            // Claim a task while holding the lock so other workers go back
+            // to waiting instead of racing for it
+            pool->num_queued--;
+        }
+
+        // Tasks are queued before they are counted, so a claimed one is in
+        // some deque. A scan can still miss it when a later request's task
+        // is taken behind it.
+        PoolTask task;
+        while (!pool_take_task(pool, worker_index, task)) {
+            std::this_thread::yield();
+        }
+
+        run_pool_task(context, task);
+    }
+}
+
+piper_pool *piper_pool_create(piper_synthesizer *synth, int num_workers) {
+    if (!synth) {
+        return nullptr;
+    }
+
+    if (num_workers <= 0) {
+        num_workers = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    auto pool = std::make_unique<piper_pool>();
+    pool->voice = synth->voice;
+    piper_voice_retain(pool->voice);
+
+    for (int i = 0; i < num_workers; i++) {
+        auto worker = std::make_unique<PoolWorker>();
+        worker->context = piper_context_create(pool->voice);
+        if (!worker->context) {
+            piper_pool_free(pool.release());
+            return nullptr;
+        }
+
+        pool->workers.push_back(std::move(worker));
+    }
+
+    // Start threads once the worker list is complete (for stealing)
+    for (std::size_t i = 0; i < pool->workers.size(); i++) {
+        pool->workers[i]->thread = std::thread(run_pool_worker, pool.get(), i);
+    }
+
+    return pool.release();
+}
+
+void piper_pool_free(piper_pool *pool) {
+    if (!pool) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->stop = true;
+    }
+    pool->cond.notify_all();
+
+    for (auto &worker : pool->workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+
+    // Fail requests that are still waiting for queued tasks
+    for (auto &worker : pool->workers) {
+        for (auto &task : worker->tasks) {
+            std::lock_guard<std::mutex> lock(task.request->mutex);
+            task.request->failed = true;
+            task.request->cond.notify_all();
+        }
+        worker->tasks.clear();
+
+        piper_free(worker->context);
+    }
+
+    piper_voice_release(pool->voice);
+    delete pool;
+}
+
+int piper_pool_num_workers(piper_pool *pool) {
+    if (!pool) {
+        return 0;
+    }
+
+    return (int)pool->workers.size();
+}
+
+piper_voice *piper_pool_get_voice(piper_pool *pool) {
+    if (!pool) {
+        return nullptr;
+    }
+
+    return pool->voice;
+}
+
+piper_synthesize_options piper_pool_default_synthesize_options(piper_pool *pool) {
+    piper_synthesize_options options = piper_default_synthesize_options(nullptr);
+    if (pool) {
+        options.length_scale = pool->voice->synth_length_scale;
+        options.noise_scale = pool->voice->synth_noise_scale;
+        options.noise_w_scale = pool->voice->synth_noise_w_scale;
+    }
+
+    return options;
+}
+
+piper_pool_request *piper_pool_submit(piper_pool *pool, const char *text,
+                                      const piper_synthesize_options *options) {
+    if (!pool) {
+        return nullptr;
+    }
+
+    piper_synthesize_options default_options;
+    if (!options) {
+        default_options = piper_pool_default_synthesize_options(pool);
+        options = &default_options;
+    }
+
+    auto state = std::make_shared<PoolRequestState>();
+    if (set_request_params(pool->voice, *options, state->params) != PIPER_OK) {
+        return nullptr;
+    }
+    state->has_deadline = (options->timeout_ms > 0);
+    if (state->has_deadline) {
+        state->deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(options->timeout_ms);
+    }
+
+    // Phonemize on the caller's thread (the voice is immutable)
+    TextPhonemizer phonemizer;
+    phonemizer.text = text ? text : "";
+    phonemizer.text_ptr = phonemizer.text.c_str();
+    phonemizer.espeak_voice = pool->voice->espeak_voice;
+    phonemizer.max_chunk_phonemes = options->max_chunk_phonemes;
+    if (options->clause_silence_seconds > 0) {
+        phonemizer.clause_silence_samples = static_cast<std::size_t>(
+            options->clause_silence_seconds * pool->voice->sample_rate);
+    }
+
+    // Audio isn't cached for pools, only phoneme ids
+    SynthesisCache &cache = pool->voice->cache;
+    std::string cache_key;
+    bool cached = false;
+    if (cache.enabled()) {
+        phonemizer.text = normalize_cache_text(phonemizer.text);
+        phonemizer.text_ptr = phonemizer.text.c_str();
+        cache_key = phoneme_cache_key(phonemizer);
+        cached = cache.find(cache_key, false, state->phoneme_ids, nullptr);
+    }
+
+    while (!cached) {
+        int result = next_phoneme_id_chunk(pool->voice, phonemizer,
+                                           state->phoneme_ids);
+        if (result == PIPER_DONE) {
+            break;
+        }
+        if (result != PIPER_OK) {
+            return nullptr;
+        }
+    }
+
+    if (!cached && !cache_key.empty()) {
+        SynthesisCacheEntry entry;
+        entry.key = std::move(cache_key);
+        entry.phoneme_ids = state->phoneme_ids;
+        cache.insert(std::move(entry));
+    }
+
+    state->chunks.resize(state->phoneme_ids.size());
+    for (std::size_t i = 0; i < state->chunks.size(); i++) {
+        state->chunks[i].synthesized.source = state->phoneme_ids.chunks[i];
+    }
+
+    auto request = std::make_unique<piper_pool_request>();
+    request->state = state;
+    request->sample_rate = (options->output_sample_rate > 0)
+                               ? options->output_sample_rate
+                               : pool->voice->sample_rate;
+    request->sample_format = options->sample_format;
+    request->skip_metadata = options->skip_metadata;
+    request->resampler.configure(pool->voice->sample_rate,
+                                 request->sample_rate);
+
+    if (state->chunks.empty()) {
+        return request.release();
+    }
+
+    // Spread chunks across workers, starting after the last request
+    std::size_t num_workers = pool->workers.size();
+    std::size_t first_worker;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        first_worker = pool->next_worker;
+        pool->next_worker = (first_worker + state->chunks.size()) % num_workers;
+    }
+
+    for (std::size_t i = 0; i < state->chunks.size(); i++) {
+        PoolWorker &worker = *pool->workers[(first_worker + i) % num_workers];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(PoolTask{state, i});
     }
 
-    // Clean up
-    for (std::size_t i = 0; i < output_tensors.size(); i++) {
-        Ort::detail::OrtRelease(output_tensors[i].release());
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->num_queued += state->chunks.size();
     }
+    pool->cond.notify_all();
 
-    for (std::size_t i = 0; i < input_tensors.size(); i++) {
-        Ort::detail::OrtRelease(input_tensors[i].release());
+    return request.release();
+}
+
+int piper_pool_next(piper_pool_request *request, piper_audio_chunk *chunk) {
+    if (!request) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    if (!chunk) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    // Clear data from previous call
+    request->chunk_samples.clear();
+    request->chunk_phoneme_ids.clear();
+    request->chunk_alignments.clear();
+
+    clear_chunk(chunk, request->sample_rate);
+
+    PoolRequestState &state = *request->state;
+    if (request->next_index >= state.chunks.size()) {
+        // Empty final chunk
+        chunk->is_last = true;
+        return PIPER_DONE;
+    }
+
+    PoolChunk &slot = state.chunks[request->next_index];
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        auto is_ready = [&state, &slot] {
+            return slot.ready || state.failed || state.cancelled;
+        };
+        if (state.has_deadline) {
+            state.cond.wait_until(lock, state.deadline, is_ready);
+        } else {
+            state.cond.wait(lock, is_ready);
+        }
+
+        if (state.cancelled) {
+            return PIPER_ERR_CANCELLED;
+        }
+        if (state.failed) {
+            return PIPER_ERR_GENERIC;
+        }
+        if (state.has_deadline &&
+            (std::chrono::steady_clock::now() >= state.deadline)) {
+            // Workers skip the remaining tasks as well
+            return PIPER_ERR_TIMEOUT;
+        }
+    }
+
+    SynthesizedChunk &synthesized = slot.synthesized;
+
+    request->chunk_samples = std::move(synthesized.samples);
+    chunk->samples = request->chunk_samples.data();
+    chunk->num_samples = request->chunk_samples.size();
+
+    request->chunk_alignments = std::move(synthesized.alignments);
+    if (!request->skip_metadata) {
+        if (!request->chunk_alignments.empty()) {
+            chunk->alignments = request->chunk_alignments.data();
+            chunk->num_alignments = request->chunk_alignments.size();
+        }
+
+        set_chunk_phonemes(request->chunk_phoneme_ids, chunk, state.phoneme_ids,
+                           synthesized.source);
+    }
+
+    request->next_index++;
+    chunk->is_last = (request->next_index >= state.chunks.size());
+
+    resample_chunk(request->resampler, request->chunk_samples,
+                   request->resampled_samples, request->chunk_alignments, chunk,
+                   request->sample_rate);
+    set_chunk_pcm(request->chunk_pcm, chunk, request->sample_format);
+
+    return PIPER_OK;
+}
+
+piper_sample_buffer *piper_pool_take_samples(piper_pool_request *request,
+                                             const float **samples,
+                                             size_t *num_samples) {
+    if (samples) {
+        *samples = nullptr;
+    }
+    if (num_samples) {
+        *num_samples = 0;
+    }
+
+    if (!request) {
+        return nullptr;
+    }
+
+    return detach_samples(request->chunk_samples, samples, num_samples);
+}
+
+void piper_pool_request_cancel(piper_pool_request *request) {
+    if (!request) {
+        return;
+    }
+
+    // Workers skip the remaining tasks
+    std::lock_guard<std::mutex> lock(request->state->mutex);
+    request->state->cancelled = true;
+    request->state->cond.notify_all();
+}
+
+void piper_pool_request_free(piper_pool_request *request) {
+    if (!request) {
+        return;
+    }
+
+    {
+        // Workers skip the remaining tasks
+        std::lock_guard<std::mutex> lock(request->state->mutex);
+        request->state->cancelled = true;
+    }
+
+    delete request;
+}
+
+// Rows of one batch share the scales and the embedding size
+static bool can_share_batch(const RequestParams &a, const RequestParams &b) {
+    return (a.length_scale == b.length_scale) &&
+           (a.noise_scale == b.noise_scale) &&
+           (a.noise_w_scale == b.noise_w_scale) &&
+           (a.speaker_embedding.size() == b.speaker_embedding.size());
+}
+
+// Take the next batch off the queue (with the batcher locked): the oldest
+// chunk and, in order, the chunks that can share its batch while padding
+// stays reasonable. Chunks that don't fit wait for a later batch.
+static void take_batch(piper_batcher *batcher,
+                       std::vector<BatcherItem *> &batch) {
+    std::deque<BatcherItem *> &queue = batcher->queue;
+    const RequestParams &first_params = *queue.front()->params;
+
+    std::size_t max_length = 0;
+    std::size_t total_length = 0;
+    auto it = queue.begin();
+    while ((it != queue.end()) && (batch.size() < batcher->max_batch_size)) {
+        BatcherItem *item = *it;
+        std::size_t next_length = item->synthesized.source.num_ids;
+        std::size_t new_max_length = std::max(max_length, next_length);
+        std::size_t new_total_length = total_length + next_length;
+        if (!batch.empty() &&
+            (!can_share_batch(first_params, *item->params) ||
+             ((float)(new_max_length * (batch.size() + 1)) >
+              (MAX_BATCH_PADDING_RATIO * new_total_length)))) {
+            ++it;
+            continue;
+        }
+
+        item->running = true;
+        batch.push_back(item);
+        it = queue.erase(it);
+
+        max_length = new_max_length;
+        total_length = new_total_length;
+    }
+}
+
+// Synthesize the chunks of a batch into outputs, in the same order
+static int run_batch(piper_synthesizer *context,
+                     const std::vector<BatcherItem *> &batch,
+                     std::vector<SynthesizedChunk> &outputs) {
+    InferenceWorkspace &ws = context->workspace;
+    std::size_t batch_size = batch.size();
+
+    outputs.resize(batch_size);
+    for (std::size_t i = 0; i < batch_size; i++) {
+        outputs[i] = SynthesizedChunk();
+        outputs[i].source = batch[i]->synthesized.source;
     }
 
+    if (batch_size == 1) {
+        // Works without alignments
+        return synthesize_chunk(context, *batch[0]->params,
+                                *batch[0]->phoneme_ids, outputs[0]);
+    }
+
+    std::size_t max_length = 0;
+    for (const BatcherItem *item : batch) {
+        max_length = std::max(max_length, item->synthesized.source.num_ids);
+    }
+
+    // Pad ids of every request into a [batch_size, max_length] block
+    ws.batch_phoneme_ids.assign(batch_size * max_length, ID_PAD);
+    std::vector<int64_t> lengths(batch_size);
+    std::vector<const RequestParams *> row_params(batch_size);
+    for (std::size_t i = 0; i < batch_size; i++) {
+        const PhonemeIdChunkSpan &source = batch[i]->synthesized.source;
+        const PhonemeId *item_ids = batch[i]->phoneme_ids->chunk_ids(source);
+        std::copy(item_ids, item_ids + source.num_ids,
+                  ws.batch_phoneme_ids.begin() + (i * max_length));
+        lengths[i] = (int64_t)source.num_ids;
+        row_params[i] = batch[i]->params;
+    }
+
+    int result = run_session(context, row_params.data(),
+                             ws.batch_phoneme_ids.data(), lengths.data(),
+                             batch_size, max_length);
+    if (result != PIPER_OK) {
+        return result;
+    }
+
+    return split_batch_outputs(context, outputs);
+}
+
+// Scheduler thread: waits until a batch is full or its oldest chunk has
+// waited max_wait, then runs it and hands the audio back to each request.
+static void run_batcher(piper_batcher *batcher) {
+    std::vector<BatcherItem *> batch;
+    std::vector<SynthesizedChunk> outputs;
+
+    while (true) {
+        batch.clear();
+        std::chrono::steady_clock::time_point batch_start;
+        {
+            std::unique_lock<std::mutex> lock(batcher->mutex);
+            batcher->cond.wait(lock, [batcher] {
+                return batcher->stop || !batcher->queue.empty();
+            });
+            if (batcher->stop) {
+                return;
+            }
+
+            // Give other requests a chance to fill the batch
+            auto fill_deadline =
+                batcher->queue.front()->queued_at + batcher->max_wait;
+            batcher->cond.wait_until(lock, fill_deadline, [batcher] {
+                return batcher->stop ||
+                       (batcher->queue.size() >= batcher->max_batch_size);
+            });
+            if (batcher->stop) {
+                return;
+            }
+            if (batcher->queue.empty()) {
+                // Every request withdrew while waiting
+                continue;
+            }
+
+            take_batch(batcher, batch);
+
+            batch_start = std::chrono::steady_clock::now();
+            for (const BatcherItem *item : batch) {
+                std::chrono::duration<double> waited =
+                    batch_start - item->queued_at;
+                batcher->stats.queue_seconds += waited.count();
+            }
+        }
+
+        int result;
+        try {
+            result = run_batch(batcher->context, batch, outputs);
+        } catch (...) {
+            result = PIPER_ERR_GENERIC;
+        }
+
+        std::chrono::duration<double> inference_seconds =
+            std::chrono::steady_clock::now() - batch_start;
+
+        std::lock_guard<std::mutex> lock(batcher->mutex);
+        for (std::size_t i = 0; i < batch.size(); i++) {
+            BatcherItem &item = *batch[i];
+            item.result = result;
+            if (result == PIPER_OK) {
+                item.synthesized = std::move(outputs[i]);
+            }
+            item.inference_seconds = inference_seconds.count();
+            item.done = true;
+        }
+        batcher->stats.num_batches++;
+        batcher->stats.num_chunks += batch.size();
+        batcher->stats.inference_seconds += inference_seconds.count();
+        batcher->done_cond.notify_all();
+    }
+}
+
+piper_batcher_options piper_batcher_default_options(void) {
+    piper_batcher_options options;
+    options.max_batch_size = DEFAULT_BATCHER_MAX_BATCH_SIZE;
+    options.max_wait_ms = DEFAULT_BATCHER_MAX_WAIT_MS;
+
+    return options;
+}
+
+piper_batcher *piper_batcher_create(piper_voice *voice,
+                                    const piper_batcher_options *options) {
+    if (!voice) {
+        return nullptr;
+    }
+
+    piper_batcher_options default_options = piper_batcher_default_options();
+    if (!options) {
+        options = &default_options;
+    }
+
+    auto batcher = std::make_unique<piper_batcher>();
+    batcher->context = piper_context_create(voice);
+    if (!batcher->context) {
+        return nullptr;
+    }
+    batcher->voice = voice;
+    piper_voice_retain(voice);
+
+    // Splitting a batch needs alignments
+    bool has_alignments = (batcher->context->workspace.output_tensors.size() > 1);
+    batcher->max_batch_size =
+        has_alignments ? (std::size_t)std::max(1, options->max_batch_size) : 1;
+    batcher->max_wait = std::chrono::milliseconds(std::max(0, options->max_wait_ms));
+
+    batcher->thread = std::thread(run_batcher, batcher.get());
+
+    return batcher.release();
+}
+
+// Drop one reference and free the batcher with the last one.
+// No chunks are queued by then, since waiting contexts hold a reference.
+static void release_batcher(piper_batcher *batcher) {
+    if (!batcher ||
+        (batcher->ref_count.fetch_sub(1, std::memory_order_acq_rel) != 1)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(batcher->mutex);
+        batcher->stop = true;
+    }
+    batcher->cond.notify_all();
+
+    if (batcher->thread.joinable()) {
+        batcher->thread.join();
+    }
+
+    piper_free(batcher->context);
+    piper_voice_release(batcher->voice);
+    delete batcher;
+}
+
+void piper_batcher_free(piper_batcher *batcher) { release_batcher(batcher); }
+
+int piper_batcher_get_stats(piper_batcher *batcher,
+                            piper_batcher_stats *stats) {
+    if (!batcher || !stats) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    std::lock_guard<std::mutex> lock(batcher->mutex);
+    *stats = batcher->stats;
+
     return PIPER_OK;
 }
+
+void piper_batcher_reset_stats(piper_batcher *batcher) {
+    if (!batcher) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(batcher->mutex);
+    batcher->stats = {};
+}
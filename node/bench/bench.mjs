@@ -0,0 +1,245 @@
+// Benchmarks for the Node addon.
+//
+// Usage: node bench/bench.mjs MODEL [ITERATIONS]
+//
+// Runs on a fixed text corpus and measures:
+//
+// - cold start: creating a synthesizer and the first inference
+// - time to first chunk and real-time factor across text lengths and
+//   intra-op thread counts, with the stage timings from getStats
+// - throughput of concurrent synthesizers sharing one voice
+// - peak resident memory
+//
+// Results are written to stdout as JSON.
+//
+// Concurrent synthesizeAsync calls run on the libuv thread pool, so set
+// UV_THREADPOOL_SIZE to at least the largest instance count.
+
+import os from 'node:os';
+import { performance } from 'node:perf_hooks';
+
+import { PiperVoice, PiperSynthesizer } from '../lib/index.js';
+
+// Keep in sync with libpiper/bench/piper_bench.cpp
+const CORPUS = [
+    { name: 'short', text: 'Hello, how can I help you today?' },
+    {
+        name: 'medium',
+        text:
+            'The quick brown fox jumps over the lazy dog. ' +
+            'A journey of a thousand miles begins with a single step. ' +
+            'She sells sea shells by the sea shore. ' +
+            'How much wood would a woodchuck chuck if a woodchuck could chuck wood?',
+    },
+    {
+        name: 'long',
+        text:
+            'It was the best of times, it was the worst of times, it was the age of ' +
+            'wisdom, it was the age of foolishness, it was the epoch of belief, it ' +
+            'was the epoch of incredulity, it was the season of Light, it was the ' +
+            'season of Darkness, it was the spring of hope, it was the winter of ' +
+            'despair. We had everything before us, we had nothing before us. There ' +
+            'were a king with a large jaw and a queen with a plain face, on the ' +
+            'throne of England. There were a king with a large jaw and a queen with ' +
+            'a fair face, on the throne of France. In both countries it was clearer ' +
+            'than crystal to the lords of the State preserves of loaves and fishes, ' +
+            'that things in general were settled for ever.',
+    },
+];
+
+// Text used for concurrency runs
+const BENCH_TEXT = CORPUS[1].text;
+
+function percentile(values, p) {
+    if (values.length === 0) {
+        return 0;
+    }
+
+    const sorted = [...values].sort((a, b) => a - b);
+    const idx = Math.round(p * (sorted.length - 1));
+    return sorted[Math.min(idx, sorted.length - 1)];
+}
+
+function round(value, digits = 3) {
+    return Number(value.toFixed(digits));
+}
+
+// Thread counts to compare, up to the number of cores
+function threadCounts() {
+    const numCores = Math.max(1, os.availableParallelism?.() ?? os.cpus().length);
+    const counts = [];
+    for (let count = 1; count <= numCores; count *= 2) {
+        counts.push(count);
+        if (count >= 8) {
+            break;
+        }
+    }
+
+    return counts;
+}
+
+// Synthesize a text to the end, timing the first chunk
+async function synthesizeText(synth, text) {
+    const start = performance.now();
+    let firstChunkMs = 0;
+    let audioSeconds = 0;
+
+    for await (const chunk of synth.synthesizeStream(text)) {
+        if (firstChunkMs === 0) {
+            firstChunkMs = performance.now() - start;
+        }
+        audioSeconds += chunk.samples.length / chunk.sampleRate;
+    }
+
+    return { firstChunkMs, audioSeconds, wallMs: performance.now() - start };
+}
+
+function coldStart(modelPath) {
+    let start = performance.now();
+    let synth = new PiperSynthesizer(modelPath);
+    const createMs = performance.now() - start;
+
+    start = performance.now();
+    synth.warmup();
+    const firstInferenceMs = performance.now() - start;
+    const peakRssKb = process.resourceUsage().maxRSS;
+    synth.dispose();
+
+    start = performance.now();
+    synth = new PiperSynthesizer(modelPath);
+    const reloadMs = performance.now() - start;
+    synth.dispose();
+
+    return {
+        createMs: round(createMs),
+        reloadMs: round(reloadMs),
+        firstInferenceMs: round(firstInferenceMs),
+        peakRssKb,
+    };
+}
+
+async function throughput(modelPath, corpusText, numThreads, iterations) {
+    const synth = new PiperSynthesizer(modelPath, { intraOpNumThreads: numThreads });
+    try {
+        // Warm up outside of the measurement
+        await synthesizeText(synth, corpusText.text);
+        synth.resetStats();
+
+        const firstChunkMs = [];
+        let wallMs = 0;
+        let audioSeconds = 0;
+        for (let i = 0; i < iterations; i++) {
+            const result = await synthesizeText(synth, corpusText.text);
+            firstChunkMs.push(result.firstChunkMs);
+            wallMs += result.wallMs;
+            audioSeconds += result.audioSeconds;
+        }
+
+        const { total } = synth.getStats();
+        const stageMs = (seconds) => round((seconds * 1000) / iterations);
+
+        return {
+            text: corpusText.name,
+            threads: numThreads,
+            audioSeconds: round(audioSeconds / iterations),
+            realTimeFactor: round(wallMs / 1000 / audioSeconds, 4),
+            firstChunkMs: {
+                p50: round(percentile(firstChunkMs, 0.5)),
+                p99: round(percentile(firstChunkMs, 0.99)),
+            },
+            stageMs: {
+                phonemize: stageMs(total.phonemizeSeconds),
+                phonemeIds: stageMs(total.phonemeIdsSeconds),
+                inference: stageMs(total.inferenceSeconds),
+                output: stageMs(total.outputSeconds),
+            },
+        };
+    } finally {
+        synth.dispose();
+    }
+}
+
+// Each instance is a synthesizer of one shared voice with a single
+// intra-op thread
+async function concurrency(voice, numInstances, iterations) {
+    const synths = [];
+    for (let i = 0; i < numInstances; i++) {
+        const synth = new PiperSynthesizer(voice);
+        synth.warmup();
+        synths.push(synth);
+    }
+
+    try {
+        const start = performance.now();
+        const audioSeconds = await Promise.all(
+            synths.map(async (synth) => {
+                let seconds = 0;
+                for (let i = 0; i < iterations; i++) {
+                    const chunks = await synth.synthesizeAsync(BENCH_TEXT);
+                    for (const chunk of chunks) {
+                        seconds += chunk.samples.length / chunk.sampleRate;
+                    }
+                }
+                return seconds;
+            })
+        );
+        const wallSeconds = (performance.now() - start) / 1000;
+
+        const totalSeconds = audioSeconds.reduce((sum, seconds) => sum + seconds, 0);
+        return { instances: numInstances, audioPerSecond: totalSeconds / wallSeconds };
+    } finally {
+        for (const synth of synths) {
+            synth.dispose();
+        }
+    }
+}
+
+async function main() {
+    const [modelPath, iterationsArg] = process.argv.slice(2);
+    if (!modelPath) {
+        console.error('Usage: node bench/bench.mjs MODEL [ITERATIONS]');
+        process.exit(1);
+    }
+
+    const iterations = Math.max(1, Number.parseInt(iterationsArg ?? '20', 10) || 20);
+
+    // Must run first to include process-wide setup
+    const coldStartResult = coldStart(modelPath);
+
+    const counts = threadCounts();
+
+    const throughputResults = [];
+    for (const corpusText of CORPUS) {
+        for (const numThreads of counts) {
+            throughputResults.push(await throughput(modelPath, corpusText, numThreads, iterations));
+        }
+    }
+
+    const concurrencyResults = [];
+    const voice = new PiperVoice(modelPath, { intraOpNumThreads: 1, interOpNumThreads: 1 });
+    try {
+        for (const numInstances of counts) {
+            concurrencyResults.push(await concurrency(voice, numInstances, iterations));
+        }
+    } finally {
+        voice.dispose();
+    }
+
+    const baseThroughput = concurrencyResults[0]?.audioPerSecond ?? 0;
+
+    const results = {
+        iterations,
+        coldStart: coldStartResult,
+        throughput: throughputResults,
+        concurrency: concurrencyResults.map((result) => ({
+            instances: result.instances,
+            audioPerSecond: round(result.audioPerSecond),
+            scaling: round(baseThroughput > 0 ? result.audioPerSecond / baseThroughput : 0),
+        })),
+        peakRssKb: process.resourceUsage().maxRSS,
+    };
+
+    console.log(JSON.stringify(results, null, 2));
+}
+
+await main();
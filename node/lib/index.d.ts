@@ -1,3 +1,5 @@
+import { Readable, Transform, Writable } from 'node:stream';
+
 /**
  * Options for creating a Piper synthesizer.
  */
@@ -8,11 +10,220 @@ export interface PiperSynthesizerOptions {
      */
     configPath?: string;
 
+    /**
+     * Voice config (bytes, JSON text or parsed) when the model is passed
+     * in memory.
+     */
+    config?: Uint8Array | string | object;
+
     /**
      * Path to the espeak-ng data directory.
      * Defaults to the bundled data.
      */
     espeakDataPath?: string;
+
+    /**
+     * Threads used within an operator (default: 0, onnxruntime default).
+     * Set this when running many synthesizers to avoid oversubscribing the CPU.
+     */
+    intraOpNumThreads?: number;
+
+    /**
+     * Threads used across operators (default: 0, onnxruntime default).
+     * Values above 1 enable parallel execution.
+     */
+    interOpNumThreads?: number;
+
+    /** Let idle threads spin instead of sleeping (default: true). */
+    allowSpinning?: boolean;
+
+    /** Graph optimization level (default: 'all'). */
+    graphOptimizationLevel?: 'disable' | 'basic' | 'extended' | 'all';
+
+    /**
+     * Hardware used for inference (default: 'cpu').
+     * Providers other than CPU require a matching onnxruntime build.
+     */
+    executionProvider?: 'cpu' | 'cuda' | 'coreml' | 'directml';
+
+    /** Device id for GPU execution providers (default: 0). */
+    deviceId?: number;
+
+    /**
+     * Run on the process-wide thread pool shared by all synthesizers that set
+     * this option (default: false). Thread count and spinning options are
+     * ignored when set. Throws if a synthesizer was already created without
+     * it, since the pool can only be added to a fresh process.
+     */
+    useGlobalThreadPool?: boolean;
+
+    /**
+     * Reuse tensor memory between chunks with onnxruntime's CPU arena
+     * (default: false). Fewer allocations, higher resident memory.
+     */
+    enableCpuMemArena?: boolean;
+
+    /** Plan memory from previous runs with the same shapes (default: false). */
+    enableMemPattern?: boolean;
+
+    /**
+     * Existing directory where the optimized graph is cached, keyed on the
+     * model hash and onnxruntime version. Later loads skip optimization.
+     */
+    optimizedModelCacheDir?: string;
+
+    /**
+     * Memory budget in bytes of the voice's LRU cache of phoneme ids for
+     * repeated text (default: 0 = disabled). With cacheAudio, audio is
+     * cached as well.
+     */
+    synthesisCacheBytes?: number;
+
+    /**
+     * Record an onnxruntime profile of every model run to
+     * <prefix>_<timestamp>.json (see endProfiling). Slows down inference.
+     */
+    profileFilePrefix?: string;
+
+    /**
+     * Lengths that phoneme ids are padded up to, so accelerator execution
+     * providers see a few fixed input shapes instead of one per sentence.
+     * The padding is trimmed from the audio using the alignments (requires a
+     * voice with alignments).
+     */
+    lengthBuckets?: number[];
+
+    /** Run the model once per bucket length while loading (default: false). */
+    warmupLengthBuckets?: boolean;
+}
+
+/**
+ * Counters of a voice's synthesis cache.
+ */
+export interface CacheStats {
+    /** Texts whose phoneme ids were found in the cache. */
+    hits: number;
+
+    /** Texts that had to be phonemized. */
+    misses: number;
+
+    /** Requests with cacheAudio whose audio was found in the cache. */
+    audioHits: number;
+
+    /** Requests with cacheAudio that had to be synthesized. */
+    audioMisses: number;
+
+    /** Entries dropped to stay within the memory budget. */
+    evictions: number;
+
+    /** Number of cached entries. */
+    numEntries: number;
+
+    /** Approximate memory used by cached entries in bytes. */
+    sizeBytes: number;
+
+    /** Memory budget in bytes. */
+    capacityBytes: number;
+}
+
+/**
+ * Time spent in each stage of synthesis and the audio produced.
+ */
+export interface StageStats {
+    /** Seconds spent phonemizing text with espeak-ng. */
+    phonemizeSeconds: number;
+
+    /** Seconds spent normalizing phonemes and mapping them to ids. */
+    phonemeIdsSeconds: number;
+
+    /** Seconds spent running the voice model. */
+    inferenceSeconds: number;
+
+    /** Seconds spent copying, resampling and converting audio. */
+    outputSeconds: number;
+
+    /** Audio chunks produced. */
+    numChunks: number;
+
+    /** Samples produced, at the voice's sample rate. */
+    numSamples: number;
+
+    /** Seconds of audio produced. */
+    audioSeconds: number;
+
+    /** Time of all stages divided by audioSeconds (below 1 is faster than real time). */
+    realTimeFactor: number;
+}
+
+/**
+ * Stage timings of a synthesizer.
+ */
+export interface SynthesisStats {
+    /** Number of synthesis requests. */
+    numRequests: number;
+
+    /** Totals since the synthesizer was created or resetStats was called. */
+    total: StageStats;
+
+    /** Totals of the current or most recent request. */
+    lastRequest: StageStats;
+
+    /** Chunks queued ahead of the last chunk produced. */
+    queueDepth: number;
+}
+
+/**
+ * Options for creating a synthesizer pool.
+ */
+export interface PiperPoolOptions extends PiperSynthesizerOptions {
+    /** Number of worker threads (default: one per CPU core). */
+    workers?: number;
+}
+
+/**
+ * Options for creating a batcher.
+ */
+export interface PiperBatcherOptions extends PiperSynthesizerOptions {
+    /**
+     * Most sentences per inference call (default: 8). The batcher runs this
+     * many requests at once on its own threads, and later ones wait their
+     * turn. Voices without alignments always run batches of 1.
+     */
+    maxBatchSize?: number;
+
+    /** Longest a sentence waits for its batch to fill, in milliseconds (default: 5). */
+    maxWaitMs?: number;
+}
+
+/**
+ * Counters of a batcher.
+ */
+export interface BatcherStats {
+    /** Inference calls made. */
+    numBatches: number;
+
+    /** Sentences synthesized (numChunks / numBatches is the average batch size). */
+    numChunks: number;
+
+    /** Total seconds sentences waited before their batch started. */
+    queueSeconds: number;
+
+    /** Total seconds spent running the voice model. */
+    inferenceSeconds: number;
+}
+
+/**
+ * Options for the process-wide thread pool.
+ */
+export interface GlobalThreadPoolOptions {
+    /** Threads used within an operator (default: 0, onnxruntime default). */
+    intraOpNumThreads?: number;
+
+    /** Threads used across operators (default: 0, onnxruntime default). */
+    interOpNumThreads?: number;
+
+    /** Let idle threads spin instead of sleeping (default: true). */
+    allowSpinning?: boolean;
 }
 
 /**
@@ -39,6 +250,127 @@ export interface SynthesizeOptions {
      * Default depends on the voice model.
      */
     noiseWScale?: number;
+
+    /**
+     * Maximum number of phonemes per chunk (default: 0, no limit).
+     * Long sentences are split at commas, colons, and semicolons so the first
+     * audio arrives sooner. A single clause is never split.
+     */
+    maxChunkPhonemes?: number;
+
+    /**
+     * Seconds of silence added after a chunk that ends mid-sentence
+     * (default: 0). Only applies when maxChunkPhonemes is set.
+     */
+    clauseSilenceSeconds?: number;
+
+    /**
+     * Maximum sentences per inference call (default: 1).
+     * Batching improves throughput but requires a voice model with
+     * alignments; other voices synthesize one sentence at a time.
+     */
+    maxBatchSentences?: number;
+
+    /**
+     * Chunks to phonemize ahead of synthesis on a background thread
+     * (default: 0 = phonemize all text before the first chunk).
+     * Lowers time to first audio for long text. Chunks are returned without
+     * waiting for the next sentence, so the results may end with an empty
+     * chunk that only marks `isLast`.
+     */
+    phonemizeLookahead?: number;
+
+    /**
+     * Sample rate of the audio in Hertz (default: the voice's rate).
+     * Chunks are resampled without seams between them.
+     */
+    outputSampleRate?: number;
+
+    /**
+     * Format of chunk.pcm (default: 'float32' = no pcm).
+     * 'mulaw' and 'alaw' are 8-bit G.711 for telephony.
+     */
+    sampleFormat?: 'float32' | 'int16' | 'mulaw' | 'alaw';
+
+    /**
+     * Cache the audio of this text (default: false).
+     * Only applies when noiseScale and noiseWScale are 0, so the audio is
+     * deterministic, and requires synthesisCacheBytes.
+     */
+    cacheAudio?: boolean;
+
+    /**
+     * Fail once synthesis takes longer than this many milliseconds
+     * (default: 0 = no limit). A sentence already being synthesized is
+     * finished first.
+     */
+    timeoutMs?: number;
+
+    /**
+     * How chunks carry phonemes, phonemeIds and alignments (default:
+     * 'full'). 'packed' returns them as views of one shared ArrayBuffer per
+     * chunk, and 'none' leaves them out (null), which saves copying them
+     * when only the audio is needed.
+     */
+    metadata?: 'full' | 'packed' | 'none';
+
+    /**
+     * Precomputed speaker embedding for models exported with a
+     * speaker_embedding input instead of speaker ids. Required by those
+     * models and rejected by others.
+     */
+    speakerEmbedding?: Float32Array;
+}
+
+/**
+ * Options for asynchronous synthesis.
+ */
+export interface AsyncSynthesizeOptions extends SynthesizeOptions {
+    /**
+     * Cancels the request. Remaining sentences are dropped and a running
+     * inference call is terminated, so the cores are freed right away.
+     */
+    signal?: AbortSignal;
+}
+
+/**
+ * Progress of a document (see PiperSynthesizer.synthesizeDocument()).
+ */
+export interface DocumentProgress {
+    /** Bytes of text whose audio has been written. */
+    textBytesDone: number;
+
+    /** Audio chunks (sentences) written. */
+    numChunks: number;
+
+    /** Seconds of audio written. */
+    audioSeconds: number;
+
+    /** Seconds since synthesis of the document started. */
+    elapsedSeconds: number;
+
+    /** elapsedSeconds divided by audioSeconds. */
+    realTimeFactor: number;
+}
+
+/**
+ * Options for document synthesis. output or onChunk is required.
+ */
+export interface DocumentOptions extends AsyncSynthesizeOptions {
+    /**
+     * Path or file descriptor the audio is written to, as raw samples in
+     * sampleFormat (float32 by default).
+     */
+    output?: string | number;
+
+    /** Called with each audio chunk. */
+    onChunk?: (chunk: AudioChunk) => void;
+
+    /** Called after each chunk. */
+    onProgress?: (progress: DocumentProgress) => void;
+
+    /** Sentences phonemized ahead of synthesis (default: 8). */
+    lookaheadChunks?: number;
 }
 
 /**
@@ -68,6 +400,65 @@ export interface AudioChunk {
      * Null if the voice model does not support alignments.
      */
     alignments: Int32Array | null;
+
+    /**
+     * Samples converted to options.sampleFormat.
+     * Null for 'float32'.
+     */
+    pcm: Int16Array | Uint8Array | null;
+}
+
+/**
+ * A loaded voice model shared by synthesizers and pools.
+ */
+export class PiperVoice {
+    /**
+     * Load a voice model once for any number of synthesizers.
+     *
+     * @param modelPath - Path to the ONNX voice model file, or the model
+     *   bytes (options.config is then required).
+     * @param options - Synthesizer options.
+     */
+    constructor(modelPath: string | Uint8Array, options?: PiperSynthesizerOptions);
+
+    /** Get the counters of the voice's synthesis cache. */
+    getCacheStats(): CacheStats;
+
+    /** Remove all entries from the voice's synthesis cache. */
+    clearCache(): void;
+
+    /**
+     * Stop onnxruntime profiling and write the profile.
+     *
+     * @returns Path of the profile file, or null if profiling is not enabled.
+     */
+    endProfiling(): string | null;
+
+    /**
+     * Share the voice with worker threads.
+     *
+     * Send the handle to a worker and open it there with
+     * PiperVoice.fromHandle() to use this model instead of loading another
+     * copy. The handle can be opened until this voice is disposed.
+     */
+    share(): PiperVoiceHandle;
+
+    /** Open a voice shared by another thread with share(). */
+    static fromHandle(handle: PiperVoiceHandle): PiperVoice;
+
+    /**
+     * Release this object's reference to the voice.
+     *
+     * Synthesizers and pools created from the voice keep working.
+     */
+    dispose(): void;
+}
+
+/**
+ * Handle of a voice shared across worker threads (see PiperVoice.share()).
+ */
+export interface PiperVoiceHandle {
+    readonly piperVoiceId: number;
 }
 
 /**
@@ -77,26 +468,146 @@ export class PiperSynthesizer {
     /**
      * Create a synthesizer from a voice model.
      *
-     * @param modelPath - Path to the ONNX voice model file.
+     * @param modelPath - Path to the ONNX voice model file, or the model
+     *   bytes (options.config is then required).
      * @param options - Synthesizer options.
      */
-    constructor(modelPath: string, options?: PiperSynthesizerOptions);
+    constructor(modelPath: string | Uint8Array, options?: PiperSynthesizerOptions);
+
+    /**
+     * Create a synthesizer that shares a loaded voice.
+     *
+     * @param voice - Loaded voice.
+     */
+    constructor(voice: PiperVoice);
 
     /**
      * Get the default synthesis options from the voice model config.
      */
-    getDefaultOptions(): Required<SynthesizeOptions>;
+    getDefaultOptions(): Required<Pick<SynthesizeOptions,
+        'speakerId' | 'lengthScale' | 'noiseScale' | 'noiseWScale'>>;
 
     /**
      * Synthesize text into audio chunks.
      *
-     * Returns one audio chunk per sentence.
+     * Returns one audio chunk per sentence. Throws while a stream or
+     * document of this synthesizer is in flight.
      *
      * @param text - Text to synthesize.
      * @param options - Synthesis options.
      */
     synthesize(text: string, options?: SynthesizeOptions): AudioChunk[];
 
+    /**
+     * Synthesize text into audio chunks on a worker thread.
+     *
+     * Calls on the same synthesizer are serialized.
+     *
+     * @param text - Text to synthesize.
+     * @param options - Synthesis options.
+     */
+    synthesizeAsync(text: string, options?: AsyncSynthesizeOptions): Promise<AudioChunk[]>;
+
+    /**
+     * Synthesize phonemes instead of text, skipping espeak-ng.
+     *
+     * Codepoints are looked up in the voice's phoneme map without
+     * normalization. Every line becomes one chunk.
+     *
+     * @param phonemes - Phoneme codepoints, or a string of them.
+     * @param options - Synthesis options.
+     */
+    synthesizePhonemes(phonemes: Uint32Array | string, options?: SynthesizeOptions): AudioChunk[];
+
+    /**
+     * Synthesize phonemes into audio chunks on a worker thread.
+     *
+     * @param phonemes - Phoneme codepoints, or a string of them.
+     * @param options - Synthesis options.
+     */
+    synthesizePhonemesAsync(
+        phonemes: Uint32Array | string,
+        options?: AsyncSynthesizeOptions
+    ): Promise<AudioChunk[]>;
+
+    /**
+     * Synthesize phoneme ids directly, skipping phonemization.
+     *
+     * Ids must include the pad, BOS and EOS ids. A new chunk starts after
+     * every EOS id.
+     *
+     * @param ids - Phoneme ids.
+     * @param options - Synthesis options.
+     */
+    synthesizeIds(ids: BigInt64Array | number[], options?: SynthesizeOptions): AudioChunk[];
+
+    /**
+     * Synthesize phoneme ids into audio chunks on a worker thread.
+     *
+     * @param ids - Phoneme ids.
+     * @param options - Synthesis options.
+     */
+    synthesizeIdsAsync(
+        ids: BigInt64Array | number[],
+        options?: AsyncSynthesizeOptions
+    ): Promise<AudioChunk[]>;
+
+    /**
+     * Synthesize text into an object-mode stream of audio chunks.
+     *
+     * Chunks are emitted as soon as they are produced, and synthesis waits
+     * while the stream's buffer is full. Until the stream ends or is
+     * destroyed it holds the synthesizer (but no libuv thread), so other
+     * requests wait and synthesize() throws. The stream is async iterable.
+     *
+     * @param text - Text to synthesize.
+     * @param options - Synthesis options.
+     */
+    synthesizeStream(text: string, options?: AsyncSynthesizeOptions): Readable & AsyncIterable<AudioChunk>;
+
+    /**
+     * Synthesize a long document with bounded memory.
+     *
+     * Text is read incrementally and only a few sentences are phonemized
+     * ahead of synthesis. Audio goes to options.output and/or
+     * options.onChunk chunk by chunk. While it runs, synthesize() and
+     * warmup() throw.
+     *
+     * @param input - Path or file descriptor of a regular file of UTF-8
+     *   text (not a pipe or socket).
+     * @param options - Output, callbacks and synthesis options.
+     * @returns Progress at the end.
+     */
+    synthesizeDocument(input: string | number, options: DocumentOptions): Promise<DocumentProgress>;
+
+    /**
+     * Run a short dummy inference to initialize onnxruntime before the
+     * first real request.
+     */
+    warmup(): void;
+
+    /**
+     * Get the counters of the voice's synthesis cache
+     * (shared by synthesizers of the same voice).
+     */
+    getCacheStats(): CacheStats;
+
+    /** Remove all entries from the voice's synthesis cache. */
+    clearCache(): void;
+
+    /** Get the time spent in each stage of synthesis. */
+    getStats(): SynthesisStats;
+
+    /** Reset the stage timings to zero. */
+    resetStats(): void;
+
+    /**
+     * Stop onnxruntime profiling of the voice and write the profile.
+     *
+     * @returns Path of the profile file, or null if profiling is not enabled.
+     */
+    endProfiling(): string | null;
+
     /**
      * Free resources held by the synthesizer.
      *
@@ -105,6 +616,171 @@ export class PiperSynthesizer {
     dispose(): void;
 }
 
+/**
+ * Worker threads sharing one voice model between concurrent requests.
+ */
+export class PiperPool {
+    /**
+     * Create a pool from a voice model.
+     *
+     * intraOpNumThreads defaults to 1 since workers already run in parallel.
+     *
+     * @param modelPath - Path to the ONNX voice model file.
+     * @param options - Pool options.
+     */
+    constructor(modelPath: string, options?: PiperPoolOptions);
+
+    /**
+     * Create a pool that shares a loaded voice.
+     *
+     * @param voice - Loaded voice.
+     * @param options - Pool options (only workers applies).
+     */
+    constructor(voice: PiperVoice, options?: Pick<PiperPoolOptions, 'workers'>);
+
+    /** Number of worker threads in the pool. */
+    readonly workers: number;
+
+    /**
+     * Synthesize text into audio chunks using the pool's workers.
+     *
+     * Chunks are returned in order. Calls may overlap freely.
+     *
+     * @param text - Text to synthesize.
+     * @param options - Synthesis options.
+     */
+    synthesizeAsync(text: string, options?: AsyncSynthesizeOptions): Promise<AudioChunk[]>;
+
+    /**
+     * Free resources held by the pool once pending requests finish.
+     */
+    dispose(): void;
+}
+
+/**
+ * Scheduler batching the sentences of concurrent requests into shared
+ * inference calls.
+ */
+export class PiperBatcher {
+    /**
+     * Create a batcher from a voice model.
+     *
+     * @param modelPath - Path to the ONNX voice model file.
+     * @param options - Batcher options.
+     */
+    constructor(modelPath: string, options?: PiperBatcherOptions);
+
+    /**
+     * Create a batcher that shares a loaded voice.
+     *
+     * @param voice - Loaded voice.
+     * @param options - Batcher options (only maxBatchSize and maxWaitMs apply).
+     */
+    constructor(voice: PiperVoice, options?: Pick<PiperBatcherOptions, 'maxBatchSize' | 'maxWaitMs'>);
+
+    /**
+     * Synthesize text into audio chunks, sharing inference calls with other
+     * requests of the batcher.
+     *
+     * Chunks are returned in order. Calls may overlap freely.
+     *
+     * @param text - Text to synthesize.
+     * @param options - Synthesis options (maxBatchSentences is ignored).
+     */
+    synthesizeAsync(text: string, options?: AsyncSynthesizeOptions): Promise<AudioChunk[]>;
+
+    /** Get the batcher's counters. */
+    getStats(): BatcherStats;
+
+    /** Reset the counters returned by getStats(). */
+    resetStats(): void;
+
+    /**
+     * Free resources held by the batcher once pending requests finish.
+     */
+    dispose(): void;
+}
+
+/**
+ * Create the process-wide thread pool shared by synthesizers created with
+ * `useGlobalThreadPool: true`.
+ *
+ * Must be called before any synthesizer is created.
+ *
+ * @param options - Thread pool options.
+ */
+export function initGlobalThreadPool(options?: GlobalThreadPoolOptions): void;
+
+/**
+ * Options for a WAV encoder.
+ */
+export interface WavEncoderOptions {
+    /** Output format (default: 'wav'). 'raw' emits PCM without a header. */
+    format?: 'wav' | 'raw';
+
+    /** Sample rate for the header (default: from the first chunk). */
+    sampleRate?: number;
+}
+
+/**
+ * Transform stream encoding audio chunks into 16-bit PCM as they arrive.
+ *
+ * Write AudioChunk objects (e.g. from synthesizeStream) and read Buffers.
+ * The WAV header is written with unknown sizes (0xFFFFFFFF).
+ */
+export class WavEncoder extends Transform {
+    constructor(options?: WavEncoderOptions);
+
+    /** Sample rate of the audio (0 until the first chunk unless given). */
+    readonly sampleRate: number;
+
+    /** Number of samples encoded so far. */
+    readonly numSamples: number;
+
+    /**
+     * WAV header with the sizes of everything encoded so far, for patching
+     * the start of a seekable file.
+     */
+    header(): Buffer;
+}
+
+/**
+ * Options for a WAV file writer.
+ */
+export interface WavFileWriterOptions {
+    /** Sample rate of the file (default: from the first chunk). */
+    sampleRate?: number;
+}
+
+/**
+ * Writable stream appending audio chunks to a WAV file in constant memory.
+ *
+ * Write AudioChunk objects (e.g. from synthesizeStream). libpiper writes
+ * them on worker threads and patches the sizes into the header when the
+ * stream finishes; pipes keep the unknown sizes (0xFFFFFFFF).
+ */
+export class WavFileWriter extends Writable {
+    constructor(filePath: string, options?: WavFileWriterOptions);
+
+    /** Sample rate of the file (0 until the first chunk unless given). */
+    readonly sampleRate: number;
+
+    /** Number of samples written so far. */
+    readonly numSamples: number;
+}
+
+/**
+ * Write audio chunks to a WAV file as they arrive, in constant memory.
+ *
+ * @param filePath - Path of the WAV file to create.
+ * @param chunks - Audio chunks, e.g. from synthesizeStream().
+ * @returns Number of samples written.
+ */
+export function writeWavFile(
+    filePath: string,
+    chunks: Iterable<AudioChunk> | AsyncIterable<AudioChunk>
+): Promise<number>;
+
 /**
  * Convert an array of audio chunks into a WAV file buffer.
  *
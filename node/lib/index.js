@@ -1,6 +1,10 @@
 'use strict';
 
+const os = require('node:os');
 const path = require('node:path');
+const fs = require('node:fs');
+const { Readable, Transform, Writable } = require('node:stream');
+const { pipeline } = require('node:stream/promises');
 
 let addon;
 try {
@@ -16,24 +20,265 @@ try {
 }
 
 const NativePiperSynthesizer = addon.PiperSynthesizer;
+const NativePiperPool = addon.PiperPool;
+const NativePiperBatcher = addon.PiperBatcher;
+const NativePiperVoice = addon.PiperVoice;
+const NativeCancelToken = addon.CancelToken;
+const NativeStreamFlow = addon.StreamFlow;
 const ESPEAK_DATA_PATH = path.join(__dirname, '..', 'espeak-ng-data');
 
+// Native voice of each PiperVoice
+const nativeVoices = new WeakMap();
+
+// View a Uint8Array model as a Buffer (without copying)
+function toModelBuffer(model) {
+    if (Buffer.isBuffer(model)) {
+        return model;
+    }
+
+    return Buffer.from(model.buffer, model.byteOffset, model.byteLength);
+}
+
+// Voice config as a Buffer or JSON string
+function toConfigJson(config) {
+    if (config instanceof Uint8Array) {
+        return toModelBuffer(config);
+    }
+    if (typeof config === 'string') {
+        return config;
+    }
+    if (config && typeof config === 'object') {
+        return JSON.stringify(config);
+    }
+
+    throw new TypeError('options.config is required when loading a model from memory');
+}
+
+// Phoneme codepoints as a Uint32Array
+function toPhonemeArray(phonemes) {
+    if (phonemes instanceof Uint32Array) {
+        return phonemes;
+    }
+    if (typeof phonemes === 'string') {
+        return Uint32Array.from(phonemes, (phoneme) => phoneme.codePointAt(0));
+    }
+
+    throw new TypeError('phonemes must be a Uint32Array or a string');
+}
+
+// Phoneme ids as a BigInt64Array
+function toIdArray(ids) {
+    if (ids instanceof BigInt64Array) {
+        return ids;
+    }
+    if (Array.isArray(ids) || ArrayBuffer.isView(ids)) {
+        return BigInt64Array.from(ids, (id) => BigInt(id));
+    }
+
+    throw new TypeError('ids must be a BigInt64Array or an array of numbers');
+}
+
+// Run a native async call with a cancel token tied to an AbortSignal.
+// Rejects with the signal's reason once it aborts.
+function runWithSignal(signal, run) {
+    if (!signal) {
+        return run(null);
+    }
+    if (signal.aborted) {
+        return Promise.reject(signal.reason);
+    }
+
+    const token = new NativeCancelToken();
+    const onAbort = () => token.cancel();
+    signal.addEventListener('abort', onAbort, { once: true });
+
+    return run(token).then(
+        (result) => {
+            signal.removeEventListener('abort', onAbort);
+            return result;
+        },
+        (err) => {
+            signal.removeEventListener('abort', onAbort);
+            throw signal.aborted ? signal.reason : err;
+        }
+    );
+}
+
+class PiperVoice {
+    /**
+     * Load a voice model that can be shared by many synthesizers and pools.
+     *
+     * The model weights are loaded once, no matter how many synthesizers are
+     * created from the voice.
+     *
+     * @param {string|Uint8Array} modelPath - Path to the ONNX voice model
+     *   file, or the model itself (e.g. from a cache) with options.config.
+     * @param {object} [options] - Same options as the PiperSynthesizer
+     *   constructor.
+     */
+    constructor(modelPath, options = {}) {
+        const espeakDataPath = options.espeakDataPath ?? ESPEAK_DATA_PATH;
+
+        if (modelPath instanceof Uint8Array) {
+            nativeVoices.set(
+                this,
+                new NativePiperVoice(
+                    toModelBuffer(modelPath),
+                    toConfigJson(options.config),
+                    espeakDataPath,
+                    options
+                )
+            );
+            return;
+        }
+
+        if (typeof modelPath !== 'string') {
+            throw new TypeError('modelPath must be a string or a Uint8Array');
+        }
+
+        const configPath = options.configPath ?? null;
+
+        nativeVoices.set(
+            this,
+            new NativePiperVoice(modelPath, configPath, espeakDataPath, options)
+        );
+    }
+
+    /**
+     * Get the counters of the voice's synthesis cache
+     * (see options.synthesisCacheBytes).
+     *
+     * @returns {object} hits, misses, audioHits, audioMisses, evictions,
+     *   numEntries, sizeBytes and capacityBytes.
+     */
+    getCacheStats() {
+        return nativeVoices.get(this).getCacheStats();
+    }
+
+    /**
+     * Remove all entries from the voice's synthesis cache.
+     */
+    clearCache() {
+        nativeVoices.get(this).clearCache();
+    }
+
+    /**
+     * Stop onnxruntime profiling (see options.profileFilePrefix) and write
+     * the profile.
+     *
+     * @returns {string|null} Path of the profile file, or null if profiling
+     *   is not enabled or has already ended.
+     */
+    endProfiling() {
+        return nativeVoices.get(this).endProfiling();
+    }
+
+    /**
+     * Share the voice with worker threads.
+     *
+     * The returned handle can be sent to a worker (e.g. in workerData or
+     * with postMessage) and opened there with PiperVoice.fromHandle(), so
+     * every thread uses the model loaded here instead of its own copy. The
+     * handle can be opened until this voice is disposed; voices opened from
+     * it hold their own reference.
+     *
+     * @returns {{piperVoiceId: number}}
+     */
+    share() {
+        return { piperVoiceId: nativeVoices.get(this).share() };
+    }
+
+    /**
+     * Open a voice shared by another thread with share().
+     *
+     * @param {{piperVoiceId: number}} handle - Handle returned by share().
+     * @returns {PiperVoice}
+     */
+    static fromHandle(handle) {
+        if (!handle || typeof handle.piperVoiceId !== 'number') {
+            throw new TypeError('handle must be returned by PiperVoice.share()');
+        }
+
+        const voice = Object.create(PiperVoice.prototype);
+        nativeVoices.set(voice, new NativePiperVoice(handle.piperVoiceId));
+        return voice;
+    }
+
+    /**
+     * Release this object's reference to the voice.
+     *
+     * Synthesizers and pools created from the voice keep working; the model
+     * is freed once all of them are disposed too.
+     */
+    dispose() {
+        nativeVoices.get(this).dispose();
+    }
+}
+
 class PiperSynthesizer {
     #native;
 
     /**
      * Create a Piper text-to-speech synthesizer.
      *
-     * @param {string} modelPath - Path to the ONNX voice model file.
+     * @param {string|Uint8Array|PiperVoice} modelPath - Path to the ONNX voice
+     *   model file, the model itself with options.config, or a loaded voice
+     *   to share (other options are then ignored).
      * @param {object} [options]
      * @param {string} [options.configPath] - Path to the JSON voice config file.
      *   Defaults to modelPath + ".json".
+     * @param {Uint8Array|string|object} [options.config] - Voice config (bytes,
+     *   JSON text or parsed) when modelPath is a Uint8Array.
      * @param {string} [options.espeakDataPath] - Path to the espeak-ng data directory.
      *   Defaults to the bundled data.
+     * @param {number} [options.intraOpNumThreads] - Threads used within an operator
+     *   (0 = onnxruntime default).
+     * @param {number} [options.interOpNumThreads] - Threads used across operators
+     *   (0 = onnxruntime default).
+     * @param {boolean} [options.allowSpinning] - Let idle threads spin (default: true).
+     * @param {'disable'|'basic'|'extended'|'all'} [options.graphOptimizationLevel] -
+     *   Graph optimization level (default: 'all').
+     * @param {'cpu'|'cuda'|'coreml'|'directml'} [options.executionProvider] -
+     *   Hardware used for inference (default: 'cpu').
+     * @param {number} [options.deviceId] - Device id for GPU providers (default: 0).
+     * @param {boolean} [options.useGlobalThreadPool] - Share the process-wide
+     *   thread pool (see initGlobalThreadPool) instead of private threads.
+     *   Throws if a synthesizer was already created without it.
+     * @param {boolean} [options.enableCpuMemArena] - Reuse tensor memory between
+     *   chunks via onnxruntime's arena (default: false).
+     * @param {boolean} [options.enableMemPattern] - Plan memory from previous runs
+     *   (default: false).
+     * @param {string} [options.optimizedModelCacheDir] - Existing directory where
+     *   the optimized graph is cached to speed up later loads of the voice.
+     * @param {number} [options.synthesisCacheBytes] - Memory budget of an LRU
+     *   cache of phoneme ids (and audio with cacheAudio) for repeated text
+     *   (default: 0 = disabled).
+     * @param {string} [options.profileFilePrefix] - Record an onnxruntime
+     *   profile to <prefix>_<timestamp>.json (see endProfiling).
+     * @param {number[]} [options.lengthBuckets] - Pad phoneme ids up to these
+     *   lengths so accelerators see fewer input shapes (requires a voice with
+     *   alignments).
+     * @param {boolean} [options.warmupLengthBuckets] - Run the model once per
+     *   bucket length while loading (default: false).
      */
     constructor(modelPath, options = {}) {
+        if (modelPath instanceof PiperVoice) {
+            this.#native = new NativePiperSynthesizer(nativeVoices.get(modelPath));
+            return;
+        }
+
+        if (modelPath instanceof Uint8Array) {
+            this.#native = new NativePiperSynthesizer(
+                toModelBuffer(modelPath),
+                toConfigJson(options.config),
+                options.espeakDataPath ?? ESPEAK_DATA_PATH,
+                options
+            );
+            return;
+        }
+
         if (typeof modelPath !== 'string') {
-            throw new TypeError('modelPath must be a string');
+            throw new TypeError('modelPath must be a string, a Uint8Array or a PiperVoice');
         }
 
         const configPath = options.configPath ?? null;
@@ -42,7 +287,8 @@ class PiperSynthesizer {
         this.#native = new NativePiperSynthesizer(
             modelPath,
             configPath,
-            espeakDataPath
+            espeakDataPath,
+            options
         );
     }
 
@@ -59,7 +305,8 @@ class PiperSynthesizer {
      * Synthesize text into audio chunks.
      *
      * Returns one audio chunk per sentence. Each chunk contains raw float32
-     * audio samples along with phoneme and alignment data.
+     * audio samples along with phoneme and alignment data. Throws while a
+     * stream or document of this synthesizer is in flight.
      *
      * @param {string} text - Text to synthesize.
      * @param {object} [options]
@@ -67,22 +314,701 @@ class PiperSynthesizer {
      * @param {number} [options.lengthScale] - Speech tempo (0.5 = 2x faster, 2.0 = 2x slower).
      * @param {number} [options.noiseScale] - Voice quality noise.
      * @param {number} [options.noiseWScale] - Phoneme width variation noise.
+     * @param {number} [options.maxChunkPhonemes] - Split long sentences at
+     *   clause boundaries so chunks stay under this many phonemes (0 = off).
+     * @param {number} [options.clauseSilenceSeconds] - Silence added after a
+     *   chunk that was split mid-sentence.
+     * @param {number} [options.maxBatchSentences] - Synthesize up to this many
+     *   sentences per inference call (requires a voice with alignments).
+     * @param {number} [options.phonemizeLookahead] - Phonemize up to this many
+     *   chunks ahead of synthesis on a background thread (0 = up front). The
+     *   results may end with an empty chunk that only marks isLast.
+     * @param {number} [options.timeoutMs] - Fail once synthesis takes longer
+     *   than this (0 = no limit).
+     * @param {'full'|'packed'|'none'} [options.metadata] - Return phonemes,
+     *   phonemeIds and alignments as separate arrays ('full'), as views of
+     *   one ArrayBuffer ('packed'), or not at all ('none').
+     * @param {Float32Array} [options.speakerEmbedding] - Precomputed speaker
+     *   embedding, required by models with a speaker_embedding input.
      * @returns {AudioChunk[]}
      */
     synthesize(text, options) {
         return this.#native.synthesize(text, options);
     }
 
+    /**
+     * Synthesize text into audio chunks without blocking the event loop.
+     *
+     * Phonemization and inference run on the synthesizer's own thread
+     * (not libuv's thread pool). Calls on the same synthesizer are queued
+     * and run one at a time; use several synthesizers to run requests in
+     * parallel.
+     *
+     * @param {string} text - Text to synthesize.
+     * @param {object} [options] - Same options as synthesize().
+     * @param {AbortSignal} [options.signal] - Cancels the request, including
+     *   an inference call that is already running.
+     * @returns {Promise<AudioChunk[]>}
+     */
+    synthesizeAsync(text, options) {
+        return runWithSignal(options?.signal, (token) =>
+            this.#native.synthesizeAsync(text, options, token)
+        );
+    }
+
+    /**
+     * Synthesize phonemes instead of text, skipping espeak-ng.
+     *
+     * Each codepoint is looked up in the voice's phoneme map as it is (no
+     * normalization). Every line becomes one chunk, with the pad, BOS and
+     * EOS ids added as for text.
+     *
+     * @param {Uint32Array|string} phonemes - Phoneme codepoints, or a string
+     *   of them.
+     * @param {object} [options] - Same options as synthesize()
+     *   (maxChunkPhonemes, clauseSilenceSeconds and phonemizeLookahead are
+     *   ignored).
+     * @returns {AudioChunk[]}
+     */
+    synthesizePhonemes(phonemes, options) {
+        return this.#native.synthesize(toPhonemeArray(phonemes), options);
+    }
+
+    /**
+     * Synthesize phonemes without blocking the event loop.
+     *
+     * @param {Uint32Array|string} phonemes - Same as synthesizePhonemes().
+     * @param {object} [options] - Same options as synthesizeAsync().
+     * @returns {Promise<AudioChunk[]>}
+     */
+    synthesizePhonemesAsync(phonemes, options) {
+        const input = toPhonemeArray(phonemes);
+        return runWithSignal(options?.signal, (token) =>
+            this.#native.synthesizeAsync(input, options, token)
+        );
+    }
+
+    /**
+     * Synthesize phoneme ids directly, skipping phonemization.
+     *
+     * Ids go to the model as they are, so they must include the pad, BOS
+     * and EOS ids (e.g. the phonemeIds of earlier chunks). A new chunk
+     * starts after every EOS id. Chunks have no phonemes.
+     *
+     * @param {BigInt64Array|number[]} ids - Phoneme ids.
+     * @param {object} [options] - Same options as synthesizePhonemes().
+     * @returns {AudioChunk[]}
+     */
+    synthesizeIds(ids, options) {
+        return this.#native.synthesize(toIdArray(ids), options);
+    }
+
+    /**
+     * Synthesize phoneme ids without blocking the event loop.
+     *
+     * @param {BigInt64Array|number[]} ids - Same as synthesizeIds().
+     * @param {object} [options] - Same options as synthesizeAsync().
+     * @returns {Promise<AudioChunk[]>}
+     */
+    synthesizeIdsAsync(ids, options) {
+        const input = toIdArray(ids);
+        return runWithSignal(options?.signal, (token) =>
+            this.#native.synthesizeAsync(input, options, token)
+        );
+    }
+
+    /**
+     * Synthesize text into a stream of audio chunks.
+     *
+     * Each chunk is pushed as soon as it is produced, so playback of the
+     * first sentence can start while later sentences are still being
+     * synthesized. The returned stream is in object mode and can be consumed
+     * with `for await (const chunk of stream)`.
+     *
+     * Synthesis waits while the stream's buffer is full, so a slow
+     * consumer doesn't make chunks pile up in memory. Until the stream ends
+     * or is destroyed, synthesize() and warmup() throw, and other requests
+     * on this synthesizer wait their turn. Async requests run on the
+     * synthesizer's own thread, not libuv's thread pool, so a stream that is
+     * never read holds only this synthesizer, not a thread that file system,
+     * DNS or crypto work need; destroy streams you abandon.
+     *
+     * Destroying the stream (e.g. breaking out of `for await`) cancels the
+     * rest of the synthesis.
+     *
+     * @param {string} text - Text to synthesize.
+     * @param {object} [options] - Same options as synthesize().
+     * @param {AbortSignal} [options.signal] - Destroys the stream with the
+     *   signal's reason and cancels synthesis.
+     * @returns {Readable} Stream of AudioChunk objects.
+     */
+    synthesizeStream(text, options) {
+        const token = new NativeCancelToken();
+        const flow = new NativeStreamFlow();
+        const stream = new Readable({
+            objectMode: true,
+            read() {
+                flow.resume();
+            },
+            destroy(err, callback) {
+                token.cancel();
+                flow.resume();
+                callback(err);
+            },
+        });
+
+        const signal = options?.signal;
+        if (signal) {
+            if (signal.aborted) {
+                stream.destroy(signal.reason);
+                return stream;
+            }
+
+            const onAbort = () => stream.destroy(signal.reason);
+            signal.addEventListener('abort', onAbort, { once: true });
+            stream.once('close', () => signal.removeEventListener('abort', onAbort));
+        }
+
+        this.#native
+            .synthesizeStream(text, options, (chunk) => {
+                // false pauses synthesis until read() is called
+                return stream.destroyed || stream.push(chunk);
+            }, token, flow)
+            .then(
+                () => stream.push(null),
+                (err) => stream.destroy(err)
+            );
+
+        return stream;
+    }
+
+    /**
+     * Synthesize a long document (e.g. a book) with bounded memory.
+     *
+     * Text is read from the input as it is phonemized, split at sentence
+     * boundaries, and phonemized at most options.lookaheadChunks sentences
+     * ahead of synthesis. Each chunk's audio is written to options.output
+     * (raw samples in options.sampleFormat, float32 by default) and/or
+     * passed to options.onChunk, then dropped, so memory doesn't grow with
+     * the length of the document. While it runs, synthesize() and warmup()
+     * throw instead of blocking the event loop.
+     *
+     * @param {string|number} input - Path or file descriptor of a regular
+     *   file of UTF-8 text. Reads from pipes and sockets can't be
+     *   interrupted, so cancelling would wait for their next data.
+     * @param {object} options - Same options as synthesizeAsync(), plus:
+     * @param {string|number} [options.output] - Path or file descriptor the
+     *   audio is written to.
+     * @param {function(AudioChunk): void} [options.onChunk] - Called with
+     *   each audio chunk. output or onChunk is required.
+     * @param {function(DocumentProgress): void} [options.onProgress] -
+     *   Called after each chunk with the text bytes done, chunks, seconds of
+     *   audio, elapsed seconds and real-time factor.
+     * @param {number} [options.lookaheadChunks] - Sentences phonemized ahead
+     *   of synthesis (default: 8).
+     * @returns {Promise<DocumentProgress>} Progress at the end.
+     */
+    async synthesizeDocument(input, options = {}) {
+        if (typeof input !== 'string' && typeof input !== 'number') {
+            throw new TypeError('input must be a path or a file descriptor');
+        }
+
+        const { output, onChunk, onProgress } = options;
+        const inputFile = typeof input === 'string' ? await fs.promises.open(input, 'r') : null;
+        let outputFile = null;
+        try {
+            if (typeof output === 'string') {
+                outputFile = await fs.promises.open(output, 'w');
+            }
+
+            const inputFd = inputFile ? inputFile.fd : input;
+            const outputFd = outputFile ? outputFile.fd : (output ?? -1);
+            return await runWithSignal(options.signal, (token) =>
+                this.#native.synthesizeDocument(
+                    inputFd, outputFd, options, onChunk, onProgress, token
+                )
+            );
+        } finally {
+            await outputFile?.close();
+            await inputFile?.close();
+        }
+    }
+
+    /**
+     * Run a short dummy inference so the first real request doesn't pay
+     * for onnxruntime's lazy initialization.
+     */
+    warmup() {
+        this.#native.warmup();
+    }
+
+    /**
+     * Get the counters of the voice's synthesis cache
+     * (see options.synthesisCacheBytes).
+     *
+     * Synthesizers sharing a voice share its cache.
+     *
+     * @returns {object} hits, misses, audioHits, audioMisses, evictions,
+     *   numEntries, sizeBytes and capacityBytes.
+     */
+    getCacheStats() {
+        return this.#native.getCacheStats();
+    }
+
+    /**
+     * Remove all entries from the voice's synthesis cache.
+     */
+    clearCache() {
+        this.#native.clearCache();
+    }
+
+    /**
+     * Get the time spent in each stage of synthesis.
+     *
+     * @returns {object} numRequests, queueDepth, and total and lastRequest
+     *   with phonemizeSeconds, phonemeIdsSeconds, inferenceSeconds,
+     *   outputSeconds, numChunks, numSamples, audioSeconds and realTimeFactor.
+     */
+    getStats() {
+        return this.#native.getStats();
+    }
+
+    /**
+     * Reset the stage timings to zero.
+     */
+    resetStats() {
+        this.#native.resetStats();
+    }
+
+    /**
+     * Stop onnxruntime profiling (see options.profileFilePrefix) and write
+     * the profile.
+     *
+     * @returns {string|null} Path of the profile file, or null if profiling
+     *   is not enabled or has already ended.
+     */
+    endProfiling() {
+        return this.#native.endProfiling();
+    }
+
     /**
      * Free resources held by the synthesizer.
      *
      * After calling dispose, the synthesizer can no longer be used.
+     * Native resources are released once any pending async synthesis
+     * finishes.
+     */
+    dispose() {
+        this.#native.dispose();
+    }
+}
+
+class PiperPool {
+    #native;
+
+    /**
+     * Create a pool of worker threads that synthesize concurrent requests
+     * with one shared copy of a voice model.
+     *
+     * Sentences of each request are spread across the workers, so both
+     * single long requests and many parallel requests scale across cores.
+     * Each pending request occupies one libuv thread while it waits, so
+     * raise UV_THREADPOOL_SIZE for many parallel requests.
+     *
+     * @param {string|PiperVoice} modelPath - Path to the ONNX voice model
+     *   file, or a loaded voice to share.
+     * @param {object} [options] - Same options as the PiperSynthesizer
+     *   constructor. intraOpNumThreads defaults to 1 since workers already
+     *   run in parallel (only options.workers applies to a PiperVoice).
+     * @param {number} [options.workers] - Number of worker threads
+     *   (default: one per CPU core).
+     */
+    constructor(modelPath, options = {}) {
+        if (modelPath instanceof PiperVoice) {
+            this.#native = new NativePiperPool(
+                nativeVoices.get(modelPath),
+                options.workers ?? 0
+            );
+            return;
+        }
+
+        if (typeof modelPath !== 'string') {
+            throw new TypeError('modelPath must be a string or a PiperVoice');
+        }
+
+        const configPath = options.configPath ?? null;
+        const espeakDataPath = options.espeakDataPath ?? ESPEAK_DATA_PATH;
+
+        this.#native = new NativePiperPool(
+            modelPath,
+            configPath,
+            espeakDataPath,
+            { intraOpNumThreads: 1, ...options },
+            options.workers ?? 0
+        );
+    }
+
+    /**
+     * Number of worker threads in the pool.
+     *
+     * @type {number}
+     */
+    get workers() {
+        return this.#native.getNumWorkers();
+    }
+
+    /**
+     * Synthesize text into audio chunks using the pool's workers.
+     *
+     * Chunks are returned in order. Calls may overlap freely.
+     *
+     * @param {string} text - Text to synthesize.
+     * @param {object} [options] - Same options as PiperSynthesizer.synthesize().
+     * @param {AbortSignal} [options.signal] - Cancels the request; sentences
+     *   that haven't been synthesized yet are skipped.
+     * @returns {Promise<AudioChunk[]>}
+     */
+    synthesizeAsync(text, options) {
+        return runWithSignal(options?.signal, (token) =>
+            this.#native.synthesizeAsync(text, options, token)
+        );
+    }
+
+    /**
+     * Free resources held by the pool once pending requests finish.
+     */
+    dispose() {
+        this.#native.dispose();
+    }
+}
+
+class PiperBatcher {
+    #native;
+
+    /**
+     * Create a scheduler that batches the sentences of concurrent requests
+     * into shared inference calls.
+     *
+     * Suits many short concurrent requests: each sentence waits up to
+     * maxWaitMs for sentences of other requests, then up to maxBatchSize of
+     * them run in one padded inference call. Raising either trades latency
+     * for throughput under load. Sentences only share a batch if their
+     * lengthScale, noiseScale and noiseWScale match. Requests run on
+     * maxBatchSize threads of the batcher (not libuv's), so up to
+     * maxBatchSize of them synthesize at once and the rest wait their turn.
+     *
+     * @param {string|PiperVoice} modelPath - Path to the ONNX voice model
+     *   file, or a loaded voice to share.
+     * @param {object} [options] - Same options as the PiperSynthesizer
+     *   constructor (ignored for a PiperVoice).
+     * @param {number} [options.maxBatchSize] - Most sentences per inference
+     *   call (default: 8). Voices without alignments always use 1.
+     * @param {number} [options.maxWaitMs] - Longest a sentence waits for its
+     *   batch to fill (default: 5).
+     */
+    constructor(modelPath, options = {}) {
+        const voice = modelPath instanceof PiperVoice ? modelPath : new PiperVoice(modelPath, options);
+
+        try {
+            this.#native = new NativePiperBatcher(
+                nativeVoices.get(voice),
+                options.maxBatchSize ?? 8,
+                options.maxWaitMs ?? 5
+            );
+        } finally {
+            if (voice !== modelPath) {
+                // The batcher holds its own reference
+                voice.dispose();
+            }
+        }
+    }
+
+    /**
+     * Synthesize text into audio chunks, sharing inference calls with other
+     * requests of the batcher.
+     *
+     * Chunks are returned in order. Calls may overlap freely.
+     *
+     * @param {string} text - Text to synthesize.
+     * @param {object} [options] - Same options as PiperSynthesizer.synthesize()
+     *   (maxBatchSentences is ignored).
+     * @param {AbortSignal} [options.signal] - Cancels the request. A sentence
+     *   whose batch is already running is finished first.
+     * @returns {Promise<AudioChunk[]>}
+     */
+    synthesizeAsync(text, options) {
+        return runWithSignal(options?.signal, (token) =>
+            this.#native.synthesizeAsync(text, options, token)
+        );
+    }
+
+    /**
+     * Get the batcher's counters.
+     *
+     * @returns {object} numBatches, numChunks, queueSeconds and
+     *   inferenceSeconds.
+     */
+    getStats() {
+        return this.#native.getStats();
+    }
+
+    /**
+     * Reset the counters returned by getStats().
+     */
+    resetStats() {
+        this.#native.resetStats();
+    }
+
+    /**
+     * Free resources held by the batcher once pending requests finish.
      */
     dispose() {
         this.#native.dispose();
     }
 }
 
+/**
+ * Create the process-wide thread pool shared by synthesizers created with
+ * `useGlobalThreadPool: true`.
+ *
+ * Must be called before any synthesizer is created. If it is never called,
+ * the first such synthesizer creates a pool with default sizes.
+ *
+ * @param {object} [options]
+ * @param {number} [options.intraOpNumThreads] - Threads used within an operator
+ *   (0 = onnxruntime default).
+ * @param {number} [options.interOpNumThreads] - Threads used across operators
+ *   (0 = onnxruntime default).
+ * @param {boolean} [options.allowSpinning] - Let idle threads spin (default: true).
+ */
+function initGlobalThreadPool(options = {}) {
+    addon.initGlobalThreadPool(
+        options.intraOpNumThreads ?? 0,
+        options.interOpNumThreads ?? 0,
+        options.allowSpinning ?? true
+    );
+}
+
+const WAV_HEADER_SIZE = 44;
+
+// Convert float32 samples to little-endian int16 PCM at an even offset
+// of buffer. Returns the number of bytes written.
+function writePcm(samples, buffer, offset) {
+    const pcm = new Int16Array(buffer.buffer, buffer.byteOffset + offset,
+        samples.length);
+    addon.floatToInt16(samples, pcm);
+    if (os.endianness() === 'BE') {
+        buffer.subarray(offset, offset + pcm.byteLength).swap16();
+    }
+
+    return pcm.byteLength;
+}
+
+/**
+ * Transform stream encoding audio chunks as they are synthesized.
+ *
+ * Takes AudioChunk objects (e.g. from synthesizeStream) and emits 16-bit
+ * PCM buffers, preceded by a WAV header unless format is 'raw'. The length
+ * isn't known while streaming, so the header sizes are set to 0xFFFFFFFF;
+ * use header() after the stream ends to patch a seekable file, or write
+ * files with WavFileWriter.
+ */
+class WavEncoder extends Transform {
+    #format;
+    #sampleRate;
+    #numSamples = 0;
+    #started = false;
+
+    /**
+     * @param {object} [options]
+     * @param {'wav'|'raw'} [options.format='wav'] - Output format.
+     * @param {number} [options.sampleRate] - Sample rate for the header
+     *   (default: from the first chunk).
+     */
+    constructor(options = {}) {
+        super({ writableObjectMode: true });
+
+        this.#format = options.format ?? 'wav';
+        if (this.#format !== 'wav' && this.#format !== 'raw') {
+            throw new TypeError(`Unknown format: ${this.#format}`);
+        }
+
+        this.#sampleRate = options.sampleRate ?? 0;
+    }
+
+    /** Sample rate of the audio (0 until the first chunk unless given). */
+    get sampleRate() {
+        return this.#sampleRate;
+    }
+
+    /** Number of samples encoded so far. */
+    get numSamples() {
+        return this.#numSamples;
+    }
+
+    /**
+     * WAV header with the sizes of everything encoded so far.
+     *
+     * @returns {Buffer} Header to write at the start of the file.
+     */
+    header() {
+        return addon.wavHeader(this.#sampleRate, this.#numSamples);
+    }
+
+    #start() {
+        this.#started = true;
+        if (this.#format === 'wav') {
+            this.push(addon.wavHeader(this.#sampleRate, -1));
+        }
+    }
+
+    _transform(chunk, encoding, callback) {
+        try {
+            if (!this.#started) {
+                this.#sampleRate = this.#sampleRate || chunk.sampleRate;
+                this.#start();
+            } else if (chunk.sampleRate !== this.#sampleRate) {
+                throw new Error(
+                    `Sample rate changed from ${this.#sampleRate} to ${chunk.sampleRate}`
+                );
+            }
+
+            if (chunk.samples.length > 0) {
+                // Buffer.alloc doesn't use the shared pool, so data is aligned
+                const pcm = Buffer.alloc(chunk.samples.length * 2);
+                writePcm(chunk.samples, pcm, 0);
+                this.#numSamples += chunk.samples.length;
+                this.push(pcm);
+            }
+        } catch (err) {
+            callback(err);
+            return;
+        }
+
+        callback();
+    }
+
+    _flush(callback) {
+        if (!this.#started && this.#sampleRate > 0) {
+            // Header of an empty file
+            this.#start();
+        }
+
+        callback();
+    }
+}
+
+/**
+ * Writable stream appending audio chunks to a WAV file as they arrive.
+ *
+ * Takes AudioChunk objects (e.g. from synthesizeStream). Samples are
+ * converted and written by libpiper on libuv worker threads, so memory use
+ * does not grow with the length of the audio, and the sizes are patched
+ * into the header when the stream finishes. Pipes keep the unknown sizes
+ * (0xFFFFFFFF).
+ */
+class WavFileWriter extends Writable {
+    #path;
+    #sampleRate;
+    #numSamples = 0;
+    #writer = null;
+
+    /**
+     * @param {string} filePath - Path of the WAV file to create.
+     * @param {object} [options]
+     * @param {number} [options.sampleRate] - Sample rate of the file
+     *   (default: from the first chunk).
+     */
+    constructor(filePath, options = {}) {
+        super({ objectMode: true });
+
+        this.#path = filePath;
+        this.#sampleRate = options.sampleRate ?? 0;
+    }
+
+    /** Sample rate of the file (0 until the first chunk unless given). */
+    get sampleRate() {
+        return this.#sampleRate;
+    }
+
+    /** Number of samples written so far. */
+    get numSamples() {
+        return this.#numSamples;
+    }
+
+    #open() {
+        this.#writer = new addon.WavWriter(this.#path, this.#sampleRate);
+    }
+
+    _write(chunk, encoding, callback) {
+        try {
+            if (!this.#writer) {
+                this.#sampleRate = this.#sampleRate || chunk.sampleRate;
+                this.#open();
+            } else if (chunk.sampleRate !== this.#sampleRate) {
+                throw new Error(
+                    `Sample rate changed from ${this.#sampleRate} to ${chunk.sampleRate}`
+                );
+            }
+        } catch (err) {
+            callback(err);
+            return;
+        }
+
+        this.#writer.write(chunk.samples).then(() => {
+            this.#numSamples += chunk.samples.length;
+            callback();
+        }, callback);
+    }
+
+    _final(callback) {
+        if (!this.#writer) {
+            if (this.#sampleRate === 0) {
+                callback(new Error('No audio chunks provided'));
+                return;
+            }
+
+            // Header of an empty file
+            try {
+                this.#open();
+            } catch (err) {
+                callback(err);
+                return;
+            }
+        }
+
+        this.#writer.close().then(() => callback(), callback);
+    }
+
+    _destroy(err, callback) {
+        // Closing twice is harmless, so this also covers a finished stream
+        if (!this.#writer) {
+            callback(err);
+            return;
+        }
+
+        this.#writer.close().then(() => callback(err), () => callback(err));
+    }
+}
+
+/**
+ * Write audio chunks to a WAV file as they arrive.
+ *
+ * Memory use does not grow with the length of the audio. Sizes are patched
+ * into the header once all chunks are written (see WavFileWriter).
+ *
+ * @param {string} filePath - Path of the WAV file to create.
+ * @param {Iterable<AudioChunk>|AsyncIterable<AudioChunk>} chunks - Audio
+ *   chunks, e.g. from synthesizeStream().
+ * @returns {Promise<number>} Number of samples written.
+ */
+async function writeWavFile(filePath, chunks) {
+    const writer = new WavFileWriter(filePath);
+    await pipeline(Readable.from(chunks), writer);
+
+    return writer.numSamples;
+}
+
 /**
  * Convert an array of audio chunks into a WAV file buffer.
  *
@@ -102,43 +1028,16 @@ function chunksToWavBuffer(chunks) {
         totalSamples += chunk.samples.length;
     }
 
-    // Convert float32 samples to int16 PCM
-    const pcmData = Buffer.alloc(totalSamples * 2);
-    let offset = 0;
+    // Header and data in one buffer (no concat)
+    const wav = Buffer.alloc(WAV_HEADER_SIZE + totalSamples * 2);
+    addon.wavHeader(sampleRate, totalSamples).copy(wav, 0);
+
+    let offset = WAV_HEADER_SIZE;
     for (const chunk of chunks) {
-        const samples = chunk.samples;
-        for (let i = 0; i < samples.length; i++) {
-            const s = Math.max(-1, Math.min(1, samples[i]));
-            const val = s < 0 ? s * 32768 : s * 32767;
-            pcmData.writeInt16LE(Math.round(val), offset);
-            offset += 2;
-        }
-    }
-
-    // Build WAV header
-    const numChannels = 1;
-    const bitsPerSample = 16;
-    const byteRate = sampleRate * numChannels * (bitsPerSample / 8);
-    const blockAlign = numChannels * (bitsPerSample / 8);
-    const dataSize = pcmData.length;
-    const headerSize = 44;
-
-    const header = Buffer.alloc(headerSize);
-    header.write('RIFF', 0);
-    header.writeUInt32LE(dataSize + headerSize - 8, 4);
-    header.write('WAVE', 8);
-    header.write('fmt ', 12);
-    header.writeUInt32LE(16, 16); // fmt chunk size
-    header.writeUInt16LE(1, 20); // PCM format
-    header.writeUInt16LE(numChannels, 22);
-    header.writeUInt32LE(sampleRate, 24);
-    header.writeUInt32LE(byteRate, 28);
-    header.writeUInt16LE(blockAlign, 32);
-    header.writeUInt16LE(bitsPerSample, 34);
-    header.write('data', 36);
-    header.writeUInt32LE(dataSize, 40);
-
-    return Buffer.concat([header, pcmData]);
+        offset += writePcm(chunk.samples, wav, offset);
+    }
+
+    return wav;
 }
 
 /**
@@ -149,11 +1048,19 @@ function chunksToWavBuffer(chunks) {
  */
 function samplesToInt16(samples) {
     const int16 = new Int16Array(samples.length);
-    for (let i = 0; i < samples.length; i++) {
-        const s = Math.max(-1, Math.min(1, samples[i]));
-        int16[i] = Math.round(s < 0 ? s * 32768 : s * 32767);
-    }
+    addon.floatToInt16(samples, int16);
     return int16;
 }
 
-module.exports = { PiperSynthesizer, chunksToWavBuffer, samplesToInt16 };
+module.exports = {
+    PiperVoice,
+    PiperSynthesizer,
+    PiperPool,
+    PiperBatcher,
+    initGlobalThreadPool,
+    WavEncoder,
+    WavFileWriter,
+    chunksToWavBuffer,
+    writeWavFile,
+    samplesToInt16,
+};
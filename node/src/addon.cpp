@@ -1,44 +1,2473 @@
 #include <napi.h>
+#include <uv.h>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "piper.h"
 
+// Async request of a synthesizer. Created on the JS thread, run on the
+// synthesizer's thread, then finished and deleted on the JS thread.
+struct SynthesizerRequest {
+    virtual ~SynthesizerRequest() = default;
+
+    // Synthesize on the synthesizer's thread
+    virtual void Run() = 0;
+
+    // Settle the Promise on the JS thread
+    virtual void Finish(Napi::Env env) = 0;
+};
+
+// Native synthesizer shared between the JS object and in-flight async work.
+// piper_synthesizer holds per-call state, so every synthesis locks the mutex.
+// The synthesizer is freed when the last owner lets go of the handle.
+//
+// A stream waiting for its reader holds the synthesizer until it is read or
+// destroyed, and a document holds it until it is done. Async requests
+// therefore run one at a time on the synthesizer's own thread instead of
+// libuv's, where every one of them (and every request queued behind them on
+// the mutex) would pin a thread that fs, dns and crypto work need. Chunks and
+// results go back to JS through on_event.
+struct SynthesizerHandle {
+    std::mutex mutex;
+    piper_synthesizer *synth = nullptr;
+
+    // Streams and documents in flight, which hold mutex until they finish
+    // (JS thread only)
+    int num_long_requests = 0;
+
+    // Requests waiting for the thread (guarded by request_mutex)
+    std::mutex request_mutex;
+    std::condition_variable request_cond;
+    std::deque<SynthesizerRequest *> requests;
+    std::thread thread;
+    bool stop = false;
+
+    // Calls back into JS. Started with the first request and only referenced
+    // while requests are pending (num_pending is only used on the JS thread),
+    // so an idle synthesizer doesn't keep the process alive.
+    Napi::ThreadSafeFunction on_event;
+    size_t num_pending = 0;
+
+    using Event = std::function<void(Napi::Env)>;
+
+    // Queue a request (JS thread)
+    void Submit(Napi::Env env, SynthesizerRequest *request) {
+        if (!thread.joinable()) {
+            on_event = Napi::ThreadSafeFunction::New(env, Napi::Function(), "PiperSynthesizer",
+                                                     0, 1);
+            on_event.Unref(env);
+            thread = std::thread(&SynthesizerHandle::RunRequests, this);
+        }
+        if (num_pending++ == 0) {
+            on_event.Ref(env);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(request_mutex);
+            requests.push_back(request);
+        }
+        request_cond.notify_one();
+    }
+
+    // Run event on the JS thread, after the events posted before it
+    void Post(Event event) {
+        on_event.BlockingCall(new Event(std::move(event)),
+                              [](Napi::Env env, Napi::Function, Event *posted) {
+                                  (*posted)(env);
+                                  delete posted;
+                              });
+    }
+
+    void RunRequests() {
+        while (true) {
+            SynthesizerRequest *request = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(request_mutex);
+                request_cond.wait(lock, [this] { return stop || !requests.empty(); });
+                if (stop) {
+                    return;
+                }
+                request = requests.front();
+                requests.pop_front();
+            }
+
+            request->Run();
+
+            // May free this handle on the JS thread (after this thread is
+            // done with the request)
+            Post([this, request](Napi::Env env) {
+                request->Finish(env);
+                if (--num_pending == 0) {
+                    on_event.Unref(env);
+                }
+                delete request;
+            });
+        }
+    }
+
+    // Runs on the JS thread once the last request has been finished, so the
+    // thread is idle
+    ~SynthesizerHandle() {
+        {
+            std::lock_guard<std::mutex> lock(request_mutex);
+            stop = true;
+        }
+        request_cond.notify_all();
+        if (thread.joinable()) {
+            thread.join();
+        }
+        if (static_cast<napi_threadsafe_function>(on_event) != nullptr) {
+            on_event.Release();
+        }
+
+        if (synth) {
+            piper_free(synth);
+            synth = nullptr;
+        }
+    }
+};
+
+// Native pool shared between the JS object and in-flight async work.
+// Requests may be submitted concurrently, so no lock is needed.
+struct PoolHandle {
+    piper_pool *pool = nullptr;
+
+    ~PoolHandle() {
+        if (pool) {
+            piper_pool_free(pool);
+            pool = nullptr;
+        }
+    }
+};
+
+struct BatcherRequest;
+
+// Native batcher shared between the JS object and in-flight async work.
+// Every request runs on its own synthesis context, and contexts are kept
+// for later requests once they finish.
+//
+// A request blocks its thread while its sentence waits for a batch, so
+// requests run on the batcher's own threads (one per batch slot) instead
+// of libuv's, where they would starve other async work and could never
+// fill a batch larger than the libuv pool. Results go back to JS through
+// on_done.
+struct BatcherHandle {
+    piper_batcher *batcher = nullptr;
+
+    // One reference held, for creating contexts
+    piper_voice *voice = nullptr;
+    piper_synthesize_options default_options;
+
+    std::mutex mutex;
+    std::vector<piper_synthesizer *> idle_contexts;
+
+    // Requests waiting for a thread (guarded by mutex)
+    std::condition_variable request_cond;
+    std::deque<BatcherRequest *> requests;
+    std::vector<std::thread> threads;
+    bool stop = false;
+
+    // Resolves requests on the JS thread. Only referenced while requests
+    // are pending (num_pending is only used on the JS thread), so an idle
+    // batcher doesn't keep the process alive.
+    Napi::ThreadSafeFunction on_done;
+    size_t num_pending = 0;
+
+    void StartThreads(size_t num_threads) {
+        for (size_t i = 0; i < num_threads; i++) {
+            threads.emplace_back(&BatcherHandle::RunRequests, this);
+        }
+    }
+
+    void Submit(BatcherRequest *request) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back(request);
+        }
+        request_cond.notify_one();
+    }
+
+    void RunRequests();
+
+    // Idle context or a new one (nullptr on error)
+    piper_synthesizer *AcquireContext() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!idle_contexts.empty()) {
+                piper_synthesizer *synth = idle_contexts.back();
+                idle_contexts.pop_back();
+                return synth;
+            }
+        }
+
+        return piper_context_create(voice);
+    }
+
+    void ReleaseContext(piper_synthesizer *synth) {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle_contexts.push_back(synth);
+    }
+
+    // Runs on the JS thread once the last request has been resolved, so
+    // the threads are idle
+    ~BatcherHandle() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        request_cond.notify_all();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        if (static_cast<napi_threadsafe_function>(on_done) != nullptr) {
+            on_done.Release();
+        }
+
+        for (piper_synthesizer *synth : idle_contexts) {
+            piper_free(synth);
+        }
+        piper_batcher_free(batcher);
+        piper_voice_release(voice);
+    }
+};
+
+// Demand of the JS stream a SynthesizeStreamRequest feeds, shared with a
+// JS StreamFlow. The worker sends a chunk only once JS took the previous one
+// and the stream's buffer has room again.
+struct StreamFlowState {
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool delivering = false;
+    bool paused = false;
+
+    // Called on the worker thread before sending a chunk
+    void WaitForDemand() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return !delivering && !paused; });
+        delivering = true;
+    }
+
+    // Called on the JS thread once a chunk was pushed into the stream
+    void Delivered(bool wants_more) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            delivering = false;
+            paused = !wants_more;
+        }
+        cond.notify_one();
+    }
+
+    // Called when the stream is read again or destroyed
+    void Resume() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            paused = false;
+        }
+        cond.notify_one();
+    }
+};
+
+// Native WAV writer shared between the JS object and in-flight writes.
+// Writes and close may run on different libuv threads, so they lock the mutex.
+struct WavWriterHandle {
+    std::mutex mutex;
+    piper_wav_writer *writer = nullptr;
+
+    ~WavWriterHandle() { piper_wav_writer_close(writer); }
+};
+
+// Cancellation of one async request, shared between a JS CancelToken and
+// the worker. The worker attaches its synthesizer or pool request while it
+// runs so cancel() can interrupt it from the JS thread.
+struct CancelState {
+    std::mutex mutex;
+    bool cancelled = false;
+    piper_synthesizer *synth = nullptr;
+    piper_pool_request *request = nullptr;
+
+    void Cancel() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        if (synth) {
+            piper_synthesize_cancel(synth);
+        }
+        if (request) {
+            piper_pool_request_cancel(request);
+        }
+    }
+
+    // Attach after piper_synthesize_start, which clears cancellation
+    void Attach(piper_synthesizer *running_synth) {
+        std::lock_guard<std::mutex> lock(mutex);
+        synth = running_synth;
+        if (cancelled) {
+            piper_synthesize_cancel(synth);
+        }
+    }
+
+    void Attach(piper_pool_request *running_request) {
+        std::lock_guard<std::mutex> lock(mutex);
+        request = running_request;
+        if (cancelled) {
+            piper_pool_request_cancel(request);
+        }
+    }
+
+    void Detach() {
+        std::lock_guard<std::mutex> lock(mutex);
+        synth = nullptr;
+        request = nullptr;
+    }
+
+    bool IsCancelled() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cancelled;
+    }
+};
+
+// Detaches a cancel state when the synthesis using it ends
+struct CancelScope {
+    CancelState *state = nullptr;
+
+    ~CancelScope() {
+        if (state) {
+            state->Detach();
+        }
+    }
+};
+
+// Owns samples detached from a synthesizer with piper_take_samples
+struct SampleBufferDeleter {
+    void operator()(piper_sample_buffer *buffer) const {
+        piper_sample_buffer_free(buffer);
+    }
+};
+using SampleBufferPtr = std::unique_ptr<piper_sample_buffer, SampleBufferDeleter>;
+
+// Detach the samples of the last chunk so they can be handed to JS without
+// copying.
+static SampleBufferPtr TakeSamples(piper_synthesizer *synth) {
+    return SampleBufferPtr(piper_take_samples(synth, nullptr, nullptr));
+}
+
+// Owned copy of a piper_audio_chunk that can outlive the next
+// piper_synthesize_next call (e.g. to cross from a worker thread to JS).
+// Samples are detached rather than copied.
+struct AudioChunkData {
+    SampleBufferPtr sample_buffer;
+    const float *samples = nullptr;
+    size_t num_samples = 0;
+    int sample_rate = 0;
+    bool is_last = false;
+    std::vector<char32_t> phonemes;
+    std::vector<int> phoneme_ids;
+    std::vector<int> alignments;
+    piper_sample_format sample_format = PIPER_SAMPLE_FORMAT_FLOAT32;
+    std::vector<uint8_t> pcm;
+
+    static AudioChunkData Copy(const piper_audio_chunk &chunk);
+    static AudioChunkData Take(piper_synthesizer *synth, const piper_audio_chunk &chunk);
+    static AudioChunkData Take(piper_pool_request *request, const piper_audio_chunk &chunk);
+    piper_audio_chunk View() const;
+};
+
 class PiperSynthesizerWrap : public Napi::ObjectWrap<PiperSynthesizerWrap> {
 public:
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     PiperSynthesizerWrap(const Napi::CallbackInfo &info);
     ~PiperSynthesizerWrap();
 
-private:
-    Napi::Value Synthesize(const Napi::CallbackInfo &info);
-    Napi::Value GetDefaultOptions(const Napi::CallbackInfo &info);
-    void Dispose(const Napi::CallbackInfo &info);
+private:
+    Napi::Value Synthesize(const Napi::CallbackInfo &info);
+    Napi::Value SynthesizeAsync(const Napi::CallbackInfo &info);
+    Napi::Value SynthesizeStream(const Napi::CallbackInfo &info);
+    Napi::Value SynthesizeDocument(const Napi::CallbackInfo &info);
+    Napi::Value GetDefaultOptions(const Napi::CallbackInfo &info);
+    void Warmup(const Napi::CallbackInfo &info);
+    Napi::Value GetCacheStats(const Napi::CallbackInfo &info);
+    void ClearCache(const Napi::CallbackInfo &info);
+    Napi::Value GetStats(const Napi::CallbackInfo &info);
+    void ResetStats(const Napi::CallbackInfo &info);
+    Napi::Value EndProfiling(const Napi::CallbackInfo &info);
+    void Dispose(const Napi::CallbackInfo &info);
+
+    std::shared_ptr<SynthesizerHandle> handle_;
+};
+
+// Shared voice model. Synthesizers and pools created from it hold their own
+// reference, so disposing the voice only drops the JS object's reference.
+class PiperVoiceWrap : public Napi::ObjectWrap<PiperVoiceWrap> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    PiperVoiceWrap(const Napi::CallbackInfo &info);
+    ~PiperVoiceWrap();
+
+    // Native voice or nullptr if disposed
+    piper_voice *Voice() const { return voice_; }
+
+private:
+    Napi::Value GetCacheStats(const Napi::CallbackInfo &info);
+    void ClearCache(const Napi::CallbackInfo &info);
+    Napi::Value EndProfiling(const Napi::CallbackInfo &info);
+    Napi::Value Share(const Napi::CallbackInfo &info);
+    void Dispose(const Napi::CallbackInfo &info);
+    void Release();
+
+    piper_voice *voice_ = nullptr;
+
+    // Id in the shared voice registry or 0 if not shared
+    uint32_t shared_id_ = 0;
+};
+
+// Voices shared with other threads (environments) of the process by id.
+// Each entry holds a reference for the voice that shared it, so any worker
+// thread can open the model without loading its own copy.
+struct SharedVoiceRegistry {
+    std::mutex mutex;
+    std::unordered_map<uint32_t, piper_voice *> voices;
+    uint32_t next_id = 1;
+
+    // Register a voice and return its id
+    uint32_t Add(piper_voice *voice) {
+        std::lock_guard<std::mutex> lock(mutex);
+        piper_voice_retain(voice);
+        uint32_t id = next_id++;
+        voices[id] = voice;
+        return id;
+    }
+
+    // Get a new reference to a shared voice or nullptr if it's gone
+    piper_voice *Retain(uint32_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = voices.find(id);
+        if (it == voices.end()) {
+            return nullptr;
+        }
+
+        piper_voice_retain(it->second);
+        return it->second;
+    }
+
+    // Drop the registry's reference to a shared voice
+    void Remove(uint32_t id) {
+        piper_voice *voice = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = voices.find(id);
+            if (it == voices.end()) {
+                return;
+            }
+            voice = it->second;
+            voices.erase(it);
+        }
+
+        piper_voice_release(voice);
+    }
+};
+
+// Process-wide, unlike AddonData
+static SharedVoiceRegistry &SharedVoices() {
+    static SharedVoiceRegistry registry;
+    return registry;
+}
+
+class PiperPoolWrap : public Napi::ObjectWrap<PiperPoolWrap> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    PiperPoolWrap(const Napi::CallbackInfo &info);
+    ~PiperPoolWrap();
+
+private:
+    Napi::Value SynthesizeAsync(const Napi::CallbackInfo &info);
+    Napi::Value GetNumWorkers(const Napi::CallbackInfo &info);
+    void Dispose(const Napi::CallbackInfo &info);
+
+    std::shared_ptr<PoolHandle> handle_;
+};
+
+class PiperBatcherWrap : public Napi::ObjectWrap<PiperBatcherWrap> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    PiperBatcherWrap(const Napi::CallbackInfo &info);
+    ~PiperBatcherWrap();
+
+private:
+    Napi::Value SynthesizeAsync(const Napi::CallbackInfo &info);
+    Napi::Value GetStats(const Napi::CallbackInfo &info);
+    void ResetStats(const Napi::CallbackInfo &info);
+    void Dispose(const Napi::CallbackInfo &info);
+
+    std::shared_ptr<BatcherHandle> handle_;
+};
+
+// JS handle used to cancel an async request (backs AbortSignal support)
+class CancelTokenWrap : public Napi::ObjectWrap<CancelTokenWrap> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    CancelTokenWrap(const Napi::CallbackInfo &info);
+
+    std::shared_ptr<CancelState> State() const { return state_; }
+
+private:
+    void Cancel(const Napi::CallbackInfo &info);
+
+    std::shared_ptr<CancelState> state_ = std::make_shared<CancelState>();
+};
+
+// JS handle resuming a paused stream (backs synthesizeStream backpressure)
+class StreamFlowWrap : public Napi::ObjectWrap<StreamFlowWrap> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    StreamFlowWrap(const Napi::CallbackInfo &info);
+
+    std::shared_ptr<StreamFlowState> State() const { return state_; }
+
+private:
+    void Resume(const Napi::CallbackInfo &info);
+
+    std::shared_ptr<StreamFlowState> state_ = std::make_shared<StreamFlowState>();
+};
+
+// Appends audio to a WAV file on libuv worker threads (backs WavFileWriter)
+class WavWriterWrap : public Napi::ObjectWrap<WavWriterWrap> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    WavWriterWrap(const Napi::CallbackInfo &info);
+
+private:
+    Napi::Value Write(const Napi::CallbackInfo &info);
+    Napi::Value Close(const Napi::CallbackInfo &info);
+
+    std::shared_ptr<WavWriterHandle> handle_ = std::make_shared<WavWriterHandle>();
+};
+
+// Constructors kept per environment (worker threads have their own)
+struct AddonData {
+    Napi::FunctionReference synthesizer_ctor;
+    Napi::FunctionReference voice_ctor;
+    Napi::FunctionReference cancel_token_ctor;
+    Napi::FunctionReference stream_flow_ctor;
+};
+
+// Get the cancel state of an optional CancelToken argument.
+// Returns nullptr if the value is undefined/null or not a CancelToken.
+static std::shared_ptr<CancelState> UnwrapCancelState(Napi::Env env,
+                                                      const Napi::Value &value) {
+    AddonData *data = env.GetInstanceData<AddonData>();
+    if (!value.IsObject() || !data ||
+        !value.As<Napi::Object>().InstanceOf(data->cancel_token_ctor.Value())) {
+        return nullptr;
+    }
+
+    return CancelTokenWrap::Unwrap(value.As<Napi::Object>())->State();
+}
+
+// Get the state of an optional StreamFlow argument.
+// Returns nullptr if the value is undefined/null or not a StreamFlow.
+static std::shared_ptr<StreamFlowState> UnwrapStreamFlow(Napi::Env env,
+                                                         const Napi::Value &value) {
+    AddonData *data = env.GetInstanceData<AddonData>();
+    if (!value.IsObject() || !data ||
+        !value.As<Napi::Object>().InstanceOf(data->stream_flow_ctor.Value())) {
+        return nullptr;
+    }
+
+    return StreamFlowWrap::Unwrap(value.As<Napi::Object>())->State();
+}
+
+// Get the native voice of a PiperVoice object.
+// Returns nullptr (with a pending JS exception) if the value isn't a
+// PiperVoice or the voice has been disposed.
+static piper_voice *UnwrapVoice(Napi::Env env, const Napi::Value &value) {
+    AddonData *data = env.GetInstanceData<AddonData>();
+    if (!value.IsObject() || !data ||
+        !value.As<Napi::Object>().InstanceOf(data->voice_ctor.Value())) {
+        Napi::TypeError::New(env, "voice must be a PiperVoice")
+            .ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    piper_voice *voice = PiperVoiceWrap::Unwrap(value.As<Napi::Object>())->Voice();
+    if (!voice) {
+        Napi::Error::New(env, "Voice has been disposed").ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    return voice;
+}
+
+// Voice model and config passed from JS in memory
+struct VoiceBytes {
+    const void *model_data = nullptr;
+    size_t model_size = 0;
+    std::string config_json;
+};
+
+// Get model bytes from a Buffer and config JSON from a Buffer or string.
+// Returns false (with a pending JS exception) on invalid values.
+static bool GetVoiceBytes(Napi::Env env, const Napi::Value &model,
+                          const Napi::Value &config, VoiceBytes &bytes) {
+    Napi::Buffer<uint8_t> model_buffer = model.As<Napi::Buffer<uint8_t>>();
+    bytes.model_data = model_buffer.Data();
+    bytes.model_size = model_buffer.Length();
+
+    if (config.IsBuffer()) {
+        Napi::Buffer<char> config_buffer = config.As<Napi::Buffer<char>>();
+        bytes.config_json.assign(config_buffer.Data(), config_buffer.Length());
+    } else if (config.IsString()) {
+        bytes.config_json = config.As<Napi::String>().Utf8Value();
+    } else {
+        Napi::TypeError::New(env, "config (Buffer or string) is required with a model Buffer")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+
+    return true;
+}
+
+// Copy everything but the samples
+AudioChunkData AudioChunkData::Copy(const piper_audio_chunk &chunk) {
+    AudioChunkData data;
+    data.sample_rate = chunk.sample_rate;
+    data.is_last = chunk.is_last;
+
+    if (chunk.phonemes && chunk.num_phonemes > 0) {
+        data.phonemes.assign(chunk.phonemes, chunk.phonemes + chunk.num_phonemes);
+    }
+    if (chunk.phoneme_ids && chunk.num_phoneme_ids > 0) {
+        data.phoneme_ids.assign(chunk.phoneme_ids,
+                                chunk.phoneme_ids + chunk.num_phoneme_ids);
+    }
+    if (chunk.alignments && chunk.num_alignments > 0) {
+        data.alignments.assign(chunk.alignments,
+                               chunk.alignments + chunk.num_alignments);
+    }
+    if (chunk.sample_format != PIPER_SAMPLE_FORMAT_FLOAT32 && chunk.pcm_data) {
+        // Converted samples are small, copy them
+        const uint8_t *pcm_data = static_cast<const uint8_t *>(chunk.pcm_data);
+        data.sample_format = chunk.sample_format;
+        data.pcm.assign(pcm_data, pcm_data + chunk.pcm_size);
+    }
+
+    return data;
+}
+
+AudioChunkData AudioChunkData::Take(piper_synthesizer *synth,
+                                    const piper_audio_chunk &chunk) {
+    AudioChunkData data = Copy(chunk);
+    if (chunk.samples && chunk.num_samples > 0) {
+        data.sample_buffer.reset(
+            piper_take_samples(synth, &data.samples, &data.num_samples));
+    }
+
+    return data;
+}
+
+AudioChunkData AudioChunkData::Take(piper_pool_request *request,
+                                    const piper_audio_chunk &chunk) {
+    AudioChunkData data = Copy(chunk);
+    if (chunk.samples && chunk.num_samples > 0) {
+        data.sample_buffer.reset(
+            piper_pool_take_samples(request, &data.samples, &data.num_samples));
+    }
+
+    return data;
+}
+
+piper_audio_chunk AudioChunkData::View() const {
+    piper_audio_chunk chunk;
+    chunk.samples = samples;
+    chunk.num_samples = num_samples;
+    chunk.sample_rate = sample_rate;
+    chunk.is_last = is_last;
+    chunk.phonemes = phonemes.data();
+    chunk.num_phonemes = phonemes.size();
+    chunk.phoneme_ids = phoneme_ids.data();
+    chunk.num_phoneme_ids = phoneme_ids.size();
+    chunk.alignments = alignments.data();
+    chunk.num_alignments = alignments.size();
+    chunk.sample_format = sample_format;
+    if (sample_format == PIPER_SAMPLE_FORMAT_FLOAT32) {
+        chunk.pcm_data = samples;
+        chunk.pcm_size = num_samples * sizeof(float);
+    } else {
+        chunk.pcm_data = pcm.data();
+        chunk.pcm_size = pcm.size();
+    }
+
+    return chunk;
+}
+
+// Wrap detached samples in a Float32Array without copying.
+// Falls back to a copy when no buffer was detached or when the runtime
+// doesn't allow external buffers (e.g. Electron).
+static Napi::Float32Array SamplesToArray(Napi::Env env, const float *data,
+                                         size_t num_samples,
+                                         SampleBufferPtr sample_buffer) {
+#ifndef NODE_API_NO_EXTERNAL_BUFFERS_ALLOWED
+    if (sample_buffer && data && num_samples > 0) {
+        piper_sample_buffer *buffer = sample_buffer.release();
+        Napi::ArrayBuffer array_buffer = Napi::ArrayBuffer::New(
+            env, const_cast<float *>(data), num_samples * sizeof(float),
+            [](Napi::Env, void *, piper_sample_buffer *hint) {
+                piper_sample_buffer_free(hint);
+            },
+            buffer);
+
+        return Napi::Float32Array::New(env, num_samples, array_buffer, 0);
+    }
+#endif
+
+    Napi::Float32Array samples = Napi::Float32Array::New(env, num_samples);
+    if (num_samples > 0 && data) {
+        std::memcpy(samples.Data(), data, num_samples * sizeof(float));
+    }
+
+    return samples;
+}
+
+static_assert(sizeof(char32_t) == sizeof(uint32_t) && sizeof(int) == sizeof(int32_t),
+              "chunk metadata is copied into 32-bit typed arrays");
+
+// Set phonemes, phonemeIds and alignments as views of one ArrayBuffer, so a
+// chunk allocates a single backing store for its metadata
+static void SetPackedMetadata(Napi::Env env, Napi::Object &chunk_obj,
+                              const piper_audio_chunk &chunk) {
+    size_t num_phonemes = chunk.phonemes ? chunk.num_phonemes : 0;
+    size_t num_phoneme_ids = chunk.phoneme_ids ? chunk.num_phoneme_ids : 0;
+    size_t num_alignments = chunk.alignments ? chunk.num_alignments : 0;
+    size_t num_values = num_phonemes + num_phoneme_ids + num_alignments;
+    if (num_values == 0) {
+        chunk_obj.Set("phonemes", env.Null());
+        chunk_obj.Set("phonemeIds", env.Null());
+        chunk_obj.Set("alignments", env.Null());
+        return;
+    }
+
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, num_values * sizeof(uint32_t));
+    uint8_t *data = static_cast<uint8_t *>(buffer.Data());
+    size_t offset = 0;
+
+    if (num_phonemes > 0) {
+        std::memcpy(data + offset, chunk.phonemes, num_phonemes * sizeof(char32_t));
+        chunk_obj.Set("phonemes", Napi::Uint32Array::New(env, num_phonemes, buffer, offset));
+        offset += num_phonemes * sizeof(char32_t);
+    } else {
+        chunk_obj.Set("phonemes", env.Null());
+    }
+
+    if (num_phoneme_ids > 0) {
+        std::memcpy(data + offset, chunk.phoneme_ids, num_phoneme_ids * sizeof(int));
+        chunk_obj.Set("phonemeIds", Napi::Int32Array::New(env, num_phoneme_ids, buffer, offset));
+        offset += num_phoneme_ids * sizeof(int);
+    } else {
+        chunk_obj.Set("phonemeIds", env.Null());
+    }
+
+    if (num_alignments > 0) {
+        std::memcpy(data + offset, chunk.alignments, num_alignments * sizeof(int));
+        chunk_obj.Set("alignments", Napi::Int32Array::New(env, num_alignments, buffer, offset));
+    } else {
+        chunk_obj.Set("alignments", env.Null());
+    }
+}
+
+// Set phonemes, phonemeIds and alignments as separate typed arrays
+static void SetMetadata(Napi::Env env, Napi::Object &chunk_obj,
+                        const piper_audio_chunk &chunk) {
+    // Phoneme codepoints as Uint32Array
+    if (chunk.phonemes && chunk.num_phonemes > 0) {
+        Napi::Uint32Array phonemes_arr =
+            Napi::Uint32Array::New(env, chunk.num_phonemes);
+        std::memcpy(phonemes_arr.Data(), chunk.phonemes,
+                    chunk.num_phonemes * sizeof(char32_t));
+        chunk_obj.Set("phonemes", phonemes_arr);
+    } else {
+        chunk_obj.Set("phonemes", env.Null());
+    }
+
+    // Phoneme IDs as Int32Array
+    if (chunk.phoneme_ids && chunk.num_phoneme_ids > 0) {
+        Napi::Int32Array phoneme_ids_arr =
+            Napi::Int32Array::New(env, chunk.num_phoneme_ids);
+        std::memcpy(phoneme_ids_arr.Data(), chunk.phoneme_ids,
+                    chunk.num_phoneme_ids * sizeof(int));
+        chunk_obj.Set("phonemeIds", phoneme_ids_arr);
+    } else {
+        chunk_obj.Set("phonemeIds", env.Null());
+    }
+
+    // Alignments as Int32Array
+    if (chunk.alignments && chunk.num_alignments > 0) {
+        Napi::Int32Array alignments_arr =
+            Napi::Int32Array::New(env, chunk.num_alignments);
+        std::memcpy(alignments_arr.Data(), chunk.alignments,
+                    chunk.num_alignments * sizeof(int));
+        chunk_obj.Set("alignments", alignments_arr);
+    } else {
+        chunk_obj.Set("alignments", env.Null());
+    }
+}
+
+// Convert an audio chunk into a JS object.
+// Samples are moved from sample_buffer if given, everything else is copied.
+static Napi::Object ChunkToObject(Napi::Env env, const piper_audio_chunk &chunk,
+                                  SampleBufferPtr sample_buffer = nullptr,
+                                  bool pack_metadata = false) {
+    Napi::Object chunk_obj = Napi::Object::New(env);
+
+    // Audio samples as Float32Array
+    chunk_obj.Set("samples", SamplesToArray(env, chunk.samples, chunk.num_samples,
+                                            std::move(sample_buffer)));
+
+    chunk_obj.Set("sampleRate", Napi::Number::New(env, chunk.sample_rate));
+    chunk_obj.Set("isLast", Napi::Boolean::New(env, chunk.is_last));
+
+    if (pack_metadata) {
+        SetPackedMetadata(env, chunk_obj, chunk);
+    } else {
+        SetMetadata(env, chunk_obj, chunk);
+    }
+
+    // Converted samples as Int16Array or Uint8Array (G.711)
+    if (chunk.sample_format == PIPER_SAMPLE_FORMAT_INT16) {
+        Napi::Int16Array pcm_arr =
+            Napi::Int16Array::New(env, chunk.pcm_size / sizeof(int16_t));
+        if (chunk.pcm_size > 0) {
+            std::memcpy(pcm_arr.Data(), chunk.pcm_data, chunk.pcm_size);
+        }
+        chunk_obj.Set("pcm", pcm_arr);
+    } else if (chunk.sample_format == PIPER_SAMPLE_FORMAT_MULAW ||
+               chunk.sample_format == PIPER_SAMPLE_FORMAT_ALAW) {
+        Napi::Uint8Array pcm_arr = Napi::Uint8Array::New(env, chunk.pcm_size);
+        if (chunk.pcm_size > 0) {
+            std::memcpy(pcm_arr.Data(), chunk.pcm_data, chunk.pcm_size);
+        }
+        chunk_obj.Set("pcm", pcm_arr);
+    } else {
+        chunk_obj.Set("pcm", env.Null());
+    }
+
+    return chunk_obj;
+}
+
+// Storage for the strings and arrays that create options point to
+struct CreateOptionStorage {
+    std::string cache_dir;
+    std::string profile_file_prefix;
+    std::vector<int> length_buckets;
+};
+
+// Parse JS create options on top of the defaults.
+// Returns false (with a pending JS exception) on invalid values.
+static bool ParseCreateOptions(Napi::Env env, const Napi::Value &value,
+                               piper_create_options &options,
+                               CreateOptionStorage &storage) {
+    options = piper_default_create_options();
+    if (!value.IsObject()) {
+        return true;
+    }
+
+    Napi::Object opts = value.As<Napi::Object>();
+
+    if (opts.Has("intraOpNumThreads") && opts.Get("intraOpNumThreads").IsNumber()) {
+        options.intra_op_num_threads =
+            opts.Get("intraOpNumThreads").As<Napi::Number>().Int32Value();
+    }
+    if (opts.Has("interOpNumThreads") && opts.Get("interOpNumThreads").IsNumber()) {
+        options.inter_op_num_threads =
+            opts.Get("interOpNumThreads").As<Napi::Number>().Int32Value();
+    }
+    if (opts.Has("allowSpinning") && opts.Get("allowSpinning").IsBoolean()) {
+        options.allow_spinning = opts.Get("allowSpinning").As<Napi::Boolean>().Value();
+    }
+    if (opts.Has("deviceId") && opts.Get("deviceId").IsNumber()) {
+        options.device_id = opts.Get("deviceId").As<Napi::Number>().Int32Value();
+    }
+    if (opts.Has("useGlobalThreadPool") && opts.Get("useGlobalThreadPool").IsBoolean()) {
+        options.use_global_thread_pool =
+            opts.Get("useGlobalThreadPool").As<Napi::Boolean>().Value();
+    }
+    if (opts.Has("enableCpuMemArena") && opts.Get("enableCpuMemArena").IsBoolean()) {
+        options.enable_cpu_mem_arena =
+            opts.Get("enableCpuMemArena").As<Napi::Boolean>().Value();
+    }
+    if (opts.Has("enableMemPattern") && opts.Get("enableMemPattern").IsBoolean()) {
+        options.enable_mem_pattern =
+            opts.Get("enableMemPattern").As<Napi::Boolean>().Value();
+    }
+    if (opts.Has("optimizedModelCacheDir") && opts.Get("optimizedModelCacheDir").IsString()) {
+        storage.cache_dir = opts.Get("optimizedModelCacheDir").As<Napi::String>().Utf8Value();
+        options.optimized_model_cache_dir = storage.cache_dir.c_str();
+    }
+    if (opts.Has("profileFilePrefix") && opts.Get("profileFilePrefix").IsString()) {
+        storage.profile_file_prefix = opts.Get("profileFilePrefix").As<Napi::String>().Utf8Value();
+        options.profile_file_prefix = storage.profile_file_prefix.c_str();
+    }
+    if (opts.Has("lengthBuckets") && opts.Get("lengthBuckets").IsArray()) {
+        Napi::Array buckets = opts.Get("lengthBuckets").As<Napi::Array>();
+        for (uint32_t i = 0; i < buckets.Length(); i++) {
+            if (buckets.Get(i).IsNumber()) {
+                storage.length_buckets.push_back(buckets.Get(i).As<Napi::Number>().Int32Value());
+            }
+        }
+        options.length_buckets = storage.length_buckets.data();
+        options.num_length_buckets = storage.length_buckets.size();
+    }
+    if (opts.Has("warmupLengthBuckets") && opts.Get("warmupLengthBuckets").IsBoolean()) {
+        options.warmup_length_buckets =
+            opts.Get("warmupLengthBuckets").As<Napi::Boolean>().Value();
+    }
+    if (opts.Has("synthesisCacheBytes") && opts.Get("synthesisCacheBytes").IsNumber()) {
+        int64_t cache_bytes = opts.Get("synthesisCacheBytes").As<Napi::Number>().Int64Value();
+        options.synthesis_cache_bytes = static_cast<size_t>(std::max<int64_t>(0, cache_bytes));
+    }
+
+    if (opts.Has("graphOptimizationLevel") && opts.Get("graphOptimizationLevel").IsString()) {
+        std::string level = opts.Get("graphOptimizationLevel").As<Napi::String>().Utf8Value();
+        if (level == "disable") {
+            options.graph_optimization_level = PIPER_GRAPH_OPTIMIZATION_DISABLE;
+        } else if (level == "basic") {
+            options.graph_optimization_level = PIPER_GRAPH_OPTIMIZATION_BASIC;
+        } else if (level == "extended") {
+            options.graph_optimization_level = PIPER_GRAPH_OPTIMIZATION_EXTENDED;
+        } else if (level == "all") {
+            options.graph_optimization_level = PIPER_GRAPH_OPTIMIZATION_ALL;
+        } else {
+            Napi::TypeError::New(env, "graphOptimizationLevel must be one of: disable, basic, extended, all")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    if (opts.Has("executionProvider") && opts.Get("executionProvider").IsString()) {
+        std::string provider = opts.Get("executionProvider").As<Napi::String>().Utf8Value();
+        if (provider == "cpu") {
+            options.execution_provider = PIPER_PROVIDER_CPU;
+        } else if (provider == "cuda") {
+            options.execution_provider = PIPER_PROVIDER_CUDA;
+        } else if (provider == "coreml") {
+            options.execution_provider = PIPER_PROVIDER_COREML;
+        } else if (provider == "directml") {
+            options.execution_provider = PIPER_PROVIDER_DIRECTML;
+        } else {
+            Napi::TypeError::New(env, "executionProvider must be one of: cpu, cuda, coreml, directml")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Synthesis options with storage for the arrays they point to
+struct SynthesisOptions {
+    piper_synthesize_options options;
+    std::vector<float> speaker_embedding;
+
+    // Chunk metadata as views of one ArrayBuffer (metadata: 'packed')
+    bool pack_metadata = false;
+
+    // Options pointing into this object (which may have been moved)
+    const piper_synthesize_options &Get() {
+        options.speaker_embedding =
+            speaker_embedding.empty() ? nullptr : speaker_embedding.data();
+        options.speaker_embedding_size = speaker_embedding.size();
+        return options;
+    }
+};
+
+// Parse JS synthesis options on top of the voice defaults.
+static SynthesisOptions ParseSynthesizeOptions(piper_synthesize_options defaults,
+                                               const Napi::Value &value) {
+    SynthesisOptions result;
+    result.options = defaults;
+    if (!value.IsObject()) {
+        return result;
+    }
+
+    piper_synthesize_options &options = result.options;
+    Napi::Object opts = value.As<Napi::Object>();
+
+    if (opts.Has("speakerId") && opts.Get("speakerId").IsNumber()) {
+        options.speaker_id = opts.Get("speakerId").As<Napi::Number>().Int32Value();
+    }
+    if (opts.Has("lengthScale") && opts.Get("lengthScale").IsNumber()) {
+        options.length_scale = opts.Get("lengthScale").As<Napi::Number>().FloatValue();
+    }
+    if (opts.Has("noiseScale") && opts.Get("noiseScale").IsNumber()) {
+        options.noise_scale = opts.Get("noiseScale").As<Napi::Number>().FloatValue();
+    }
+    if (opts.Has("noiseWScale") && opts.Get("noiseWScale").IsNumber()) {
+        options.noise_w_scale = opts.Get("noiseWScale").As<Napi::Number>().FloatValue();
+    }
+    if (opts.Has("maxChunkPhonemes") && opts.Get("maxChunkPhonemes").IsNumber()) {
+        options.max_chunk_phonemes = opts.Get("maxChunkPhonemes").As<Napi::Number>().Int32Value();
+    }
+    if (opts.Has("clauseSilenceSeconds") && opts.Get("clauseSilenceSeconds").IsNumber()) {
+        options.clause_silence_seconds =
+            opts.Get("clauseSilenceSeconds").As<Napi::Number>().FloatValue();
+    }
+    if (opts.Has("maxBatchSentences") && opts.Get("maxBatchSentences").IsNumber()) {
+        options.max_batch_sentences =
+            opts.Get("maxBatchSentences").As<Napi::Number>().Int32Value();
+    }
+    if (opts.Has("phonemizeLookahead") && opts.Get("phonemizeLookahead").IsNumber()) {
+        options.phonemize_lookahead =
+            opts.Get("phonemizeLookahead").As<Napi::Number>().Int32Value();
+    }
+    if (opts.Has("outputSampleRate") && opts.Get("outputSampleRate").IsNumber()) {
+        options.output_sample_rate =
+            opts.Get("outputSampleRate").As<Napi::Number>().Int32Value();
+    }
+    if (opts.Has("sampleFormat") && opts.Get("sampleFormat").IsString()) {
+        std::string format = opts.Get("sampleFormat").As<Napi::String>().Utf8Value();
+        if (format == "int16") {
+            options.sample_format = PIPER_SAMPLE_FORMAT_INT16;
+        } else if (format == "mulaw") {
+            options.sample_format = PIPER_SAMPLE_FORMAT_MULAW;
+        } else if (format == "alaw") {
+            options.sample_format = PIPER_SAMPLE_FORMAT_ALAW;
+        } else {
+            options.sample_format = PIPER_SAMPLE_FORMAT_FLOAT32;
+        }
+    }
+    if (opts.Has("cacheAudio") && opts.Get("cacheAudio").IsBoolean()) {
+        options.cache_audio = opts.Get("cacheAudio").As<Napi::Boolean>().Value();
+    }
+    if (opts.Has("timeoutMs") && opts.Get("timeoutMs").IsNumber()) {
+        options.timeout_ms = opts.Get("timeoutMs").As<Napi::Number>().Int32Value();
+    }
+    if (opts.Has("metadata") && opts.Get("metadata").IsString()) {
+        std::string metadata = opts.Get("metadata").As<Napi::String>().Utf8Value();
+        options.skip_metadata = (metadata == "none");
+        result.pack_metadata = (metadata == "packed");
+    }
+    if (opts.Has("speakerEmbedding") && opts.Get("speakerEmbedding").IsTypedArray()) {
+        Napi::TypedArray array = opts.Get("speakerEmbedding").As<Napi::TypedArray>();
+        if (array.TypedArrayType() == napi_float32_array) {
+            Napi::Float32Array embedding = array.As<Napi::Float32Array>();
+            result.speaker_embedding.assign(embedding.Data(),
+                                            embedding.Data() + embedding.ElementLength());
+        }
+    }
+
+    return result;
+}
+
+// Convert the synthesis cache counters of a voice into a JS object
+static Napi::Object CacheStatsToObject(Napi::Env env, piper_voice *voice) {
+    piper_cache_stats stats;
+    std::memset(&stats, 0, sizeof(stats));
+    piper_voice_cache_stats(voice, &stats);
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("hits", Napi::Number::New(env, static_cast<double>(stats.hits)));
+    result.Set("misses", Napi::Number::New(env, static_cast<double>(stats.misses)));
+    result.Set("audioHits", Napi::Number::New(env, static_cast<double>(stats.audio_hits)));
+    result.Set("audioMisses", Napi::Number::New(env, static_cast<double>(stats.audio_misses)));
+    result.Set("evictions", Napi::Number::New(env, static_cast<double>(stats.evictions)));
+    result.Set("numEntries", Napi::Number::New(env, static_cast<double>(stats.num_entries)));
+    result.Set("sizeBytes", Napi::Number::New(env, static_cast<double>(stats.size_bytes)));
+    result.Set("capacityBytes", Napi::Number::New(env, static_cast<double>(stats.capacity_bytes)));
+
+    return result;
+}
+
+static Napi::Object StageStatsToObject(Napi::Env env, const piper_stage_stats &stats) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("phonemizeSeconds", Napi::Number::New(env, stats.phonemize_seconds));
+    result.Set("phonemeIdsSeconds", Napi::Number::New(env, stats.phoneme_ids_seconds));
+    result.Set("inferenceSeconds", Napi::Number::New(env, stats.inference_seconds));
+    result.Set("outputSeconds", Napi::Number::New(env, stats.output_seconds));
+    result.Set("numChunks", Napi::Number::New(env, static_cast<double>(stats.num_chunks)));
+    result.Set("numSamples", Napi::Number::New(env, static_cast<double>(stats.num_samples)));
+    result.Set("audioSeconds", Napi::Number::New(env, stats.audio_seconds));
+    result.Set("realTimeFactor", Napi::Number::New(env, stats.real_time_factor));
+
+    return result;
+}
+
+// Convert the stage timings of a synthesizer into a JS object
+static Napi::Object StatsToObject(Napi::Env env, piper_synthesizer *synth) {
+    piper_stats stats;
+    std::memset(&stats, 0, sizeof(stats));
+    piper_get_stats(synth, &stats);
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("numRequests", Napi::Number::New(env, static_cast<double>(stats.num_requests)));
+    result.Set("total", StageStatsToObject(env, stats.total));
+    result.Set("lastRequest", StageStatsToObject(env, stats.last_request));
+    result.Set("queueDepth", Napi::Number::New(env, static_cast<double>(stats.queue_depth)));
+
+    return result;
+}
+
+// Stop profiling of a voice and return the profile path (or null)
+static Napi::Value EndVoiceProfiling(Napi::Env env, piper_voice *voice) {
+    char path[4096];
+    int result;
+    try {
+        result = piper_voice_end_profiling(voice, path, sizeof(path));
+    } catch (const std::exception &e) {
+        std::string msg = "Failed to end profiling: ";
+        msg += e.what();
+        Napi::Error::New(env, msg).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (result != PIPER_OK) {
+        return env.Null();
+    }
+
+    return Napi::String::New(env, path);
+}
+
+// Error message for a failed piper_synthesize_next/piper_pool_next
+static const char *SynthesisErrorMessage(int result) {
+    switch (result) {
+    case PIPER_ERR_CANCELLED:
+        return "Synthesis was cancelled";
+    case PIPER_ERR_TIMEOUT:
+        return "Synthesis timed out";
+    default:
+        return "Synthesis failed during audio generation";
+    }
+}
+
+// Error message for synthesis that failed to start. Explains why the
+// speaker embedding in the options doesn't fit the voice, if it doesn't.
+static std::string StartErrorMessage(piper_voice *voice,
+                                     const piper_synthesize_options &options) {
+    size_t embedding_size = 0;
+    if (!piper_voice_has_speaker_embedding(voice, &embedding_size)) {
+        if (options.speaker_embedding) {
+            return "Failed to start synthesis: speakerEmbedding is not supported by "
+                   "this voice";
+        }
+    } else if (!options.speaker_embedding || (options.speaker_embedding_size == 0)) {
+        return "Failed to start synthesis: this voice requires a speakerEmbedding";
+    } else if ((embedding_size > 0) && (options.speaker_embedding_size != embedding_size)) {
+        return "Failed to start synthesis: speakerEmbedding must have " +
+               std::to_string(embedding_size) + " floats, got " +
+               std::to_string(options.speaker_embedding_size);
+    }
+
+    return "Failed to start synthesis";
+}
+
+// Text, phonemes or phoneme ids to synthesize
+struct SynthesisInput {
+    enum class Kind { Text, Phonemes, Ids };
+
+    Kind kind = Kind::Text;
+    std::string text;
+    std::u32string phonemes;
+    std::vector<int64_t> ids;
+};
+
+// The sync calls would block the event loop until the stream or document is
+// done, forever if a paused stream is never read again
+static const char *BUSY_MESSAGE = "Synthesizer is busy with a stream or document; use the "
+                                  "async methods or another synthesizer";
+
+static const char *INPUT_REQUIRED_MESSAGE =
+    "text (string), phonemes (Uint32Array) or ids (BigInt64Array) is required";
+
+// Parse the input of a synthesis call: a string of text, a Uint32Array of
+// phoneme codepoints or a BigInt64Array of phoneme ids.
+// Returns false if the value is none of them.
+static bool ParseSynthesisInput(const Napi::Value &value, SynthesisInput &input) {
+    if (value.IsString()) {
+        input.kind = SynthesisInput::Kind::Text;
+        input.text = value.As<Napi::String>().Utf8Value();
+        return true;
+    }
+
+    if (!value.IsTypedArray()) {
+        return false;
+    }
+
+    Napi::TypedArray array = value.As<Napi::TypedArray>();
+    if (array.TypedArrayType() == napi_uint32_array) {
+        Napi::Uint32Array phonemes = array.As<Napi::Uint32Array>();
+        input.kind = SynthesisInput::Kind::Phonemes;
+        input.phonemes.assign(phonemes.Data(), phonemes.Data() + phonemes.ElementLength());
+        return true;
+    }
+
+    if (array.TypedArrayType() == napi_bigint64_array) {
+        Napi::BigInt64Array ids = array.As<Napi::BigInt64Array>();
+        input.kind = SynthesisInput::Kind::Ids;
+        input.ids.assign(ids.Data(), ids.Data() + ids.ElementLength());
+        return true;
+    }
+
+    return false;
+}
+
+// Run synthesis to completion, calling on_chunk for every audio chunk.
+// The caller must hold the handle's mutex. cancel may be nullptr.
+// Returns false and fills error on failure.
+static bool RunSynthesis(piper_synthesizer *synth, const SynthesisInput &input,
+                         const piper_synthesize_options &options,
+                         const std::function<void(const piper_audio_chunk &)> &on_chunk,
+                         CancelState *cancel, std::string &error) {
+    int result;
+    try {
+        switch (input.kind) {
+        case SynthesisInput::Kind::Phonemes:
+            result = piper_synthesize_phonemes(synth, input.phonemes.data(),
+                                               input.phonemes.size(), &options);
+            break;
+        case SynthesisInput::Kind::Ids:
+            result = piper_synthesize_ids(synth, input.ids.data(), input.ids.size(),
+                                          &options);
+            break;
+        default:
+            result = piper_synthesize_start(synth, input.text.c_str(), &options);
+            break;
+        }
+    } catch (const std::exception &e) {
+        error = "Failed to start synthesis: ";
+        error += e.what();
+        return false;
+    }
+    if (result != PIPER_OK) {
+        error = StartErrorMessage(piper_get_voice(synth), options);
+        return false;
+    }
+
+    CancelScope cancel_scope;
+    if (cancel) {
+        cancel->Attach(synth);
+        cancel_scope.state = cancel;
+    }
+
+    piper_audio_chunk chunk;
+    while (true) {
+        try {
+            result = piper_synthesize_next(synth, &chunk);
+        } catch (const std::exception &e) {
+            error = "Synthesis failed: ";
+            error += e.what();
+            return false;
+        }
+
+        if (result == PIPER_DONE) {
+            break;
+        }
+        if (result != PIPER_OK) {
+            error = SynthesisErrorMessage(result);
+            return false;
+        }
+
+        on_chunk(chunk);
+    }
+
+    return true;
+}
+
+// Runs synthesis on the synthesizer's thread and resolves a Promise with the
+// audio chunks.
+class SynthesizeRequest : public SynthesizerRequest {
+public:
+    SynthesizeRequest(Napi::Env env, std::shared_ptr<SynthesizerHandle> handle,
+                      SynthesisInput input, SynthesisOptions options,
+                      std::shared_ptr<CancelState> cancel)
+        : deferred_(env), handle_(std::move(handle)), input_(std::move(input)),
+          options_(std::move(options)), cancel_(std::move(cancel)) {}
+
+    Napi::Promise Promise() const { return deferred_.Promise(); }
+
+    void Run() override {
+        std::lock_guard<std::mutex> lock(handle_->mutex);
+        if (!handle_->synth) {
+            error_ = "Synthesizer has been disposed";
+            return;
+        }
+
+        RunSynthesis(handle_->synth, input_, options_.Get(),
+                     [this](const piper_audio_chunk &chunk) {
+                         chunks_.push_back(AudioChunkData::Take(handle_->synth, chunk));
+                     },
+                     cancel_.get(), error_);
+    }
+
+    void Finish(Napi::Env env) override {
+        Napi::HandleScope scope(env);
+
+        if (!error_.empty()) {
+            deferred_.Reject(Napi::Error::New(env, error_).Value());
+            return;
+        }
+
+        Napi::Array chunks = Napi::Array::New(env, chunks_.size());
+        for (uint32_t i = 0; i < chunks_.size(); i++) {
+            chunks.Set(i, ChunkToObject(env, chunks_[i].View(),
+                                        std::move(chunks_[i].sample_buffer),
+                                        options_.pack_metadata));
+        }
+
+        deferred_.Resolve(chunks);
+    }
+
+private:
+    Napi::Promise::Deferred deferred_;
+    std::shared_ptr<SynthesizerHandle> handle_;
+    SynthesisInput input_;
+    SynthesisOptions options_;
+    std::shared_ptr<CancelState> cancel_;
+    std::vector<AudioChunkData> chunks_;
+    std::string error_;
+};
+
+// Runs synthesis on the synthesizer's thread and hands each chunk to a JS
+// callback as soon as piper_synthesize_next produces it. The Promise resolves
+// after the last chunk has been delivered.
+//
+// With a StreamFlow, the callback returns false when the stream's buffer is
+// full and synthesis waits until StreamFlow.resume() is called.
+class SynthesizeStreamRequest : public SynthesizerRequest {
+public:
+    SynthesizeStreamRequest(Napi::Env env, std::shared_ptr<SynthesizerHandle> handle,
+                            SynthesisInput input, SynthesisOptions options,
+                            Napi::Function on_chunk, std::shared_ptr<CancelState> cancel,
+                            std::shared_ptr<StreamFlowState> flow)
+        : deferred_(env), handle_(std::move(handle)), input_(std::move(input)),
+          options_(std::move(options)), on_chunk_(Napi::Persistent(on_chunk)),
+          cancel_(std::move(cancel)), flow_(std::move(flow)) {
+        handle_->num_long_requests++;
+    }
+
+    ~SynthesizeStreamRequest() { handle_->num_long_requests--; }
+
+    Napi::Promise Promise() const { return deferred_.Promise(); }
+
+    void Run() override {
+        std::lock_guard<std::mutex> lock(handle_->mutex);
+        if (!handle_->synth) {
+            error_ = "Synthesizer has been disposed";
+            return;
+        }
+
+        RunSynthesis(handle_->synth, input_, options_.Get(),
+                     [this](const piper_audio_chunk &chunk) {
+                         auto data = std::make_shared<AudioChunkData>(
+                             AudioChunkData::Take(handle_->synth, chunk));
+                         if (flow_) {
+                             flow_->WaitForDemand();
+                         }
+                         handle_->Post([this, data](Napi::Env env) { Deliver(env, *data); });
+                     },
+                     cancel_.get(), error_);
+    }
+
+    void Finish(Napi::Env env) override {
+        Napi::HandleScope scope(env);
+
+        if (!error_.empty()) {
+            deferred_.Reject(Napi::Error::New(env, error_).Value());
+        } else {
+            deferred_.Resolve(env.Undefined());
+        }
+    }
+
+private:
+    // Called on the JS thread
+    void Deliver(Napi::Env env, AudioChunkData &data) {
+        Napi::HandleScope scope(env);
+
+        Napi::Value wants_more = on_chunk_.Value().Call(
+            {ChunkToObject(env, data.View(), std::move(data.sample_buffer),
+                           options_.pack_metadata)});
+        if (flow_) {
+            flow_->Delivered(!wants_more.IsBoolean() || wants_more.As<Napi::Boolean>().Value());
+        }
+    }
+
+    Napi::Promise::Deferred deferred_;
+    std::shared_ptr<SynthesizerHandle> handle_;
+    SynthesisInput input_;
+    SynthesisOptions options_;
+    Napi::FunctionReference on_chunk_;
+    std::shared_ptr<CancelState> cancel_;
+    std::shared_ptr<StreamFlowState> flow_;
+    std::string error_;
+};
+
+// Audio chunk (if requested) and progress sent after each chunk of a document
+struct DocumentEvent {
+    std::shared_ptr<AudioChunkData> chunk;
+    piper_document_progress progress;
+};
+
+// Convert document progress into a JS object
+static Napi::Object DocumentProgressToObject(Napi::Env env,
+                                             const piper_document_progress &progress) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("textBytesDone",
+               Napi::Number::New(env, static_cast<double>(progress.text_bytes_done)));
+    result.Set("numChunks", Napi::Number::New(env, static_cast<double>(progress.num_chunks)));
+    result.Set("audioSeconds", Napi::Number::New(env, progress.audio_seconds));
+    result.Set("elapsedSeconds", Napi::Number::New(env, progress.elapsed_seconds));
+    result.Set("realTimeFactor", Napi::Number::New(env, progress.real_time_factor));
+
+    return result;
+}
+
+// Chunks and progress sent to JS but not yet handled by a document
+static const size_t MAX_DOCUMENT_EVENTS_IN_FLIGHT = 4;
+
+// Synthesizes a document read from a file descriptor on the synthesizer's
+// thread. Audio is written to an output file descriptor and/or handed to a
+// JS callback chunk by chunk, with progress after each one, so memory
+// doesn't grow with the length of the document. The Promise resolves with
+// the final progress.
+class SynthesizeDocumentRequest : public SynthesizerRequest {
+public:
+    SynthesizeDocumentRequest(Napi::Env env, std::shared_ptr<SynthesizerHandle> handle,
+                              uv_file input_fd, uv_file output_fd, int lookahead_chunks,
+                              SynthesisOptions options, const Napi::Value &on_chunk,
+                              const Napi::Value &on_progress,
+                              std::shared_ptr<CancelState> cancel)
+        : deferred_(env), handle_(std::move(handle)), input_fd_(input_fd),
+          output_fd_(output_fd), lookahead_chunks_(lookahead_chunks),
+          options_(std::move(options)), cancel_(std::move(cancel)) {
+        if (on_chunk.IsFunction()) {
+            on_chunk_ = Napi::Persistent(on_chunk.As<Napi::Function>());
+            send_chunks_ = true;
+        }
+        if (on_progress.IsFunction()) {
+            on_progress_ = Napi::Persistent(on_progress.As<Napi::Function>());
+        }
+
+        // Only passed to synchronous file system calls
+        napi_get_uv_event_loop(env, &loop_);
+        std::memset(&final_progress_, 0, sizeof(final_progress_));
+        handle_->num_long_requests++;
+    }
+
+    ~SynthesizeDocumentRequest() { handle_->num_long_requests--; }
+
+    Napi::Promise Promise() const { return deferred_.Promise(); }
+
+    void Run() override {
+        std::lock_guard<std::mutex> lock(handle_->mutex);
+        if (!handle_->synth) {
+            error_ = "Synthesizer has been disposed";
+            return;
+        }
+
+        piper_document_options document = piper_default_document_options();
+        document.read_text = ReadText;
+        document.write_audio = WriteAudio;
+        document.on_progress = OnDocumentProgress;
+        document.user_data = this;
+        if (lookahead_chunks_ > 0) {
+            document.lookahead_chunks = lookahead_chunks_;
+        }
+
+        CancelScope cancel_scope;
+        if (cancel_) {
+            cancel_->Attach(handle_->synth);
+            cancel_scope.state = cancel_.get();
+        }
+
+        int result;
+        try {
+            result = piper_synthesize_document(handle_->synth, &document, &options_.Get());
+        } catch (const std::exception &e) {
+            error_ = "Synthesis failed: ";
+            error_ += e.what();
+            return;
+        }
+
+        // Reading stopped with the pipeline, so its error is safe to read
+        if (!read_error_.empty()) {
+            error_ = read_error_;
+        } else if (!write_error_.empty()) {
+            error_ = write_error_;
+        } else if (result == PIPER_ERR_SPEAKER_EMBEDDING) {
+            error_ = StartErrorMessage(piper_get_voice(handle_->synth), options_.Get());
+        } else if (result != PIPER_DONE) {
+            error_ = SynthesisErrorMessage(result);
+        }
+    }
+
+    void Finish(Napi::Env env) override {
+        Napi::HandleScope scope(env);
+
+        if (!error_.empty()) {
+            deferred_.Reject(Napi::Error::New(env, error_).Value());
+        } else {
+            deferred_.Resolve(DocumentProgressToObject(env, final_progress_));
+        }
+    }
+
+private:
+    // Called on the JS thread
+    void Deliver(Napi::Env env, const DocumentEvent &event) {
+        Napi::HandleScope scope(env);
+
+        {
+            std::lock_guard<std::mutex> lock(events_mutex_);
+            events_in_flight_--;
+        }
+        events_cond_.notify_one();
+
+        if (event.chunk) {
+            on_chunk_.Value().Call({ChunkToObject(env, event.chunk->View(),
+                                                  std::move(event.chunk->sample_buffer),
+                                                  options_.pack_metadata)});
+        }
+        if (!on_progress_.IsEmpty()) {
+            on_progress_.Value().Call({DocumentProgressToObject(env, event.progress)});
+        }
+    }
+
+    // Called on the phonemization thread
+    static int ReadText(void *user_data, char *buffer, size_t size) {
+        auto *worker = static_cast<SynthesizeDocumentRequest *>(user_data);
+        uv_buf_t buf = uv_buf_init(buffer, static_cast<unsigned int>(size));
+        uv_fs_t req;
+        int result = uv_fs_read(worker->loop_, &req, worker->input_fd_, &buf, 1, -1, nullptr);
+        uv_fs_req_cleanup(&req);
+        if (result < 0) {
+            worker->read_error_ = "Failed to read document: ";
+            worker->read_error_ += uv_strerror(result);
+        }
+
+        return result;
+    }
+
+    static int WriteAudio(void *user_data, const piper_audio_chunk *chunk) {
+        auto *worker = static_cast<SynthesizeDocumentRequest *>(user_data);
+        if (worker->cancel_ && worker->cancel_->IsCancelled()) {
+            return 1;
+        }
+        if ((worker->output_fd_ >= 0) && !worker->WriteOutput(*chunk)) {
+            return 1;
+        }
+
+        // Written before the samples are taken
+        if (worker->send_chunks_) {
+            worker->pending_chunk_ = std::make_shared<AudioChunkData>(
+                AudioChunkData::Take(worker->handle_->synth, *chunk));
+        }
+
+        return 0;
+    }
+
+    static void OnDocumentProgress(void *user_data,
+                                   const piper_document_progress *progress) {
+        auto *worker = static_cast<SynthesizeDocumentRequest *>(user_data);
+        worker->final_progress_ = *progress;
+
+        // Wait for JS to catch up so queued chunks don't grow with the document
+        {
+            std::unique_lock<std::mutex> lock(worker->events_mutex_);
+            worker->events_cond_.wait(lock, [worker] {
+                return worker->events_in_flight_ < MAX_DOCUMENT_EVENTS_IN_FLIGHT;
+            });
+            worker->events_in_flight_++;
+        }
+
+        DocumentEvent event;
+        event.chunk = std::move(worker->pending_chunk_);
+        event.progress = *progress;
+        worker->handle_->Post(
+            [worker, event](Napi::Env env) { worker->Deliver(env, event); });
+    }
+
+    // Write the samples of a chunk in its sample format
+    bool WriteOutput(const piper_audio_chunk &chunk) {
+        char *data = static_cast<char *>(const_cast<void *>(chunk.pcm_data));
+        size_t remaining = chunk.pcm_size;
+        while (remaining > 0) {
+            uv_buf_t buf = uv_buf_init(data, static_cast<unsigned int>(remaining));
+            uv_fs_t req;
+            int result = uv_fs_write(loop_, &req, output_fd_, &buf, 1, -1, nullptr);
+            uv_fs_req_cleanup(&req);
+            if (result < 0) {
+                write_error_ = "Failed to write audio: ";
+                write_error_ += uv_strerror(result);
+                return false;
+            }
+
+            data += result;
+            remaining -= static_cast<size_t>(result);
+        }
+
+        return true;
+    }
+
+    Napi::Promise::Deferred deferred_;
+    std::shared_ptr<SynthesizerHandle> handle_;
+    uv_loop_t *loop_ = nullptr;
+    uv_file input_fd_;
+    uv_file output_fd_;
+    int lookahead_chunks_;
+    SynthesisOptions options_;
+    Napi::FunctionReference on_chunk_;
+    Napi::FunctionReference on_progress_;
+    bool send_chunks_ = false;
+    std::shared_ptr<CancelState> cancel_;
+
+    std::shared_ptr<AudioChunkData> pending_chunk_;
+    std::mutex events_mutex_;
+    std::condition_variable events_cond_;
+    size_t events_in_flight_ = 0;
+    piper_document_progress final_progress_;
+    std::string read_error_;
+    std::string write_error_;
+    std::string error_;
+};
+
+
+// Submits text to a pool and waits on a libuv worker thread for the audio
+// chunks, then resolves a Promise with them.
+class PoolSynthesizeWorker : public Napi::AsyncWorker {
+public:
+    PoolSynthesizeWorker(Napi::Env env, std::shared_ptr<PoolHandle> handle,
+                         std::string text, SynthesisOptions options,
+                         std::shared_ptr<CancelState> cancel)
+        : Napi::AsyncWorker(env, "PiperPoolSynthesize"), deferred_(env),
+          handle_(std::move(handle)), text_(std::move(text)), options_(std::move(options)),
+          cancel_(std::move(cancel)) {}
+
+    Napi::Promise Promise() const { return deferred_.Promise(); }
+
+protected:
+    void Execute() override {
+        piper_pool_request *request = nullptr;
+        try {
+            request = piper_pool_submit(handle_->pool, text_.c_str(), &options_.Get());
+        } catch (const std::exception &e) {
+            std::string msg = "Failed to start synthesis: ";
+            msg += e.what();
+            SetError(msg);
+            return;
+        }
+        if (!request) {
+            SetError(StartErrorMessage(piper_pool_get_voice(handle_->pool), options_.Get()));
+            return;
+        }
+
+        if (cancel_) {
+            cancel_->Attach(request);
+        }
+
+        piper_audio_chunk chunk;
+        while (true) {
+            int result = piper_pool_next(request, &chunk);
+            if (result == PIPER_DONE) {
+                break;
+            }
+            if (result != PIPER_OK) {
+                SetError(SynthesisErrorMessage(result));
+                break;
+            }
+
+            chunks_.push_back(AudioChunkData::Take(request, chunk));
+        }
+
+        if (cancel_) {
+            cancel_->Detach();
+        }
+        piper_pool_request_free(request);
+    }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+        Napi::Array chunks = Napi::Array::New(env, chunks_.size());
+        for (uint32_t i = 0; i < chunks_.size(); i++) {
+            chunks.Set(i, ChunkToObject(env, chunks_[i].View(),
+                                        std::move(chunks_[i].sample_buffer),
+                                        options_.pack_metadata));
+        }
+
+        deferred_.Resolve(chunks);
+    }
+
+    void OnError(const Napi::Error &e) override { deferred_.Reject(e.Value()); }
+
+private:
+    Napi::Promise::Deferred deferred_;
+    std::shared_ptr<PoolHandle> handle_;
+    std::string text_;
+    SynthesisOptions options_;
+    std::shared_ptr<CancelState> cancel_;
+    std::vector<AudioChunkData> chunks_;
+};
+
+// Async request of a batcher. Runs on one of the batcher's threads and is
+// resolved (and deleted) on the JS thread.
+struct BatcherRequest {
+    Napi::Promise::Deferred deferred;
+    std::shared_ptr<BatcherHandle> handle;
+    SynthesisInput input;
+    SynthesisOptions options;
+    std::shared_ptr<CancelState> cancel;
+    std::vector<AudioChunkData> chunks;
+    std::string error;
+
+    BatcherRequest(Napi::Env env, std::shared_ptr<BatcherHandle> handle, SynthesisInput input,
+                   SynthesisOptions options, std::shared_ptr<CancelState> cancel)
+        : deferred(env), handle(std::move(handle)), input(std::move(input)),
+          options(std::move(options)), cancel(std::move(cancel)) {}
+
+    // Synthesize on a batcher thread
+    void Run() {
+        piper_synthesizer *synth = nullptr;
+        try {
+            synth = handle->AcquireContext();
+        } catch (const std::exception &e) {
+            error = "Failed to start synthesis: ";
+            error += e.what();
+            return;
+        }
+        if (!synth) {
+            error = "Failed to start synthesis";
+            return;
+        }
+
+        piper_synthesize_options synth_options = options.Get();
+        synth_options.batcher = handle->batcher;
+
+        RunSynthesis(synth, input, synth_options,
+                     [this, synth](const piper_audio_chunk &chunk) {
+                         chunks.push_back(AudioChunkData::Take(synth, chunk));
+                     },
+                     cancel.get(), error);
+        handle->ReleaseContext(synth);
+    }
+
+    // Settle the Promise on the JS thread
+    void Finish(Napi::Env env) {
+        Napi::HandleScope scope(env);
+
+        if (!error.empty()) {
+            deferred.Reject(Napi::Error::New(env, error).Value());
+        } else {
+            Napi::Array result = Napi::Array::New(env, chunks.size());
+            for (uint32_t i = 0; i < chunks.size(); i++) {
+                result.Set(i, ChunkToObject(env, chunks[i].View(),
+                                            std::move(chunks[i].sample_buffer),
+                                            options.pack_metadata));
+            }
+            deferred.Resolve(result);
+        }
+
+        if (--handle->num_pending == 0) {
+            handle->on_done.Unref(env);
+        }
+    }
+};
+
+void BatcherHandle::RunRequests() {
+    while (true) {
+        BatcherRequest *request = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            request_cond.wait(lock, [this] { return stop || !requests.empty(); });
+            if (stop) {
+                return;
+            }
+            request = requests.front();
+            requests.pop_front();
+        }
+
+        request->Run();
+
+        // May free this handle on the JS thread (after this thread is done
+        // with the request)
+        on_done.BlockingCall(request, [](Napi::Env env, Napi::Function, BatcherRequest *done) {
+            done->Finish(env);
+            delete done;
+        });
+    }
+}
+
+Napi::Object PiperSynthesizerWrap::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "PiperSynthesizer",
+                                      {
+                                          InstanceMethod<&PiperSynthesizerWrap::Synthesize>("synthesize"),
+                                          InstanceMethod<&PiperSynthesizerWrap::SynthesizeAsync>("synthesizeAsync"),
+                                          InstanceMethod<&PiperSynthesizerWrap::SynthesizeStream>("synthesizeStream"),
+                                          InstanceMethod<&PiperSynthesizerWrap::SynthesizeDocument>("synthesizeDocument"),
+                                          InstanceMethod<&PiperSynthesizerWrap::GetDefaultOptions>("getDefaultOptions"),
+                                          InstanceMethod<&PiperSynthesizerWrap::Warmup>("warmup"),
+                                          InstanceMethod<&PiperSynthesizerWrap::GetCacheStats>("getCacheStats"),
+                                          InstanceMethod<&PiperSynthesizerWrap::ClearCache>("clearCache"),
+                                          InstanceMethod<&PiperSynthesizerWrap::GetStats>("getStats"),
+                                          InstanceMethod<&PiperSynthesizerWrap::ResetStats>("resetStats"),
+                                          InstanceMethod<&PiperSynthesizerWrap::EndProfiling>("endProfiling"),
+                                          InstanceMethod<&PiperSynthesizerWrap::Dispose>("dispose"),
+                                      });
+
+    env.GetInstanceData<AddonData>()->synthesizer_ctor = Napi::Persistent(func);
+    exports.Set("PiperSynthesizer", func);
+
+    return exports;
+}
+
+PiperSynthesizerWrap::PiperSynthesizerWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<PiperSynthesizerWrap>(info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() > 0 && info[0].IsObject()) {
+        // PiperSynthesizer(voice)
+        piper_voice *voice = UnwrapVoice(env, info[0]);
+        if (!voice) {
+            return;
+        }
+
+        piper_synthesizer *synth = nullptr;
+        try {
+            synth = piper_context_create(voice);
+        } catch (const std::exception &e) {
+            std::string msg = "Failed to create Piper synthesizer: ";
+            msg += e.what();
+            Napi::Error::New(env, msg).ThrowAsJavaScriptException();
+            return;
+        }
+        if (!synth) {
+            Napi::Error::New(env, "Failed to create Piper synthesizer")
+                .ThrowAsJavaScriptException();
+            return;
+        }
+
+        handle_ = std::make_shared<SynthesizerHandle>();
+        handle_->synth = synth;
+        return;
+    }
+
+    if (info.Length() > 0 && info[0].IsBuffer()) {
+        // PiperSynthesizer(modelBuffer, config, espeakDataPath, createOptions)
+        VoiceBytes bytes;
+        if (!GetVoiceBytes(env, info[0], info.Length() > 1 ? info[1] : env.Undefined(),
+                           bytes)) {
+            return;
+        }
+
+        std::string espeak_data_path_str;
+        if (info.Length() > 2 && info[2].IsString()) {
+            espeak_data_path_str = info[2].As<Napi::String>().Utf8Value();
+        }
+
+        piper_create_options create_options;
+        CreateOptionStorage option_storage;
+        if (!ParseCreateOptions(env, info.Length() > 3 ? info[3] : env.Undefined(),
+                                create_options, option_storage)) {
+            return;
+        }
+
+        piper_synthesizer *synth = nullptr;
+        try {
+            synth = piper_create_from_memory(
+                bytes.model_data, bytes.model_size, bytes.config_json.data(),
+                bytes.config_json.size(),
+                espeak_data_path_str.empty() ? nullptr : espeak_data_path_str.c_str(),
+                &create_options);
+        } catch (const std::exception &e) {
+            std::string msg = "Failed to create Piper synthesizer: ";
+            msg += e.what();
+            Napi::Error::New(env, msg).ThrowAsJavaScriptException();
+            return;
+        }
+        if (!synth) {
+            Napi::Error::New(env, "Failed to create Piper synthesizer from memory")
+                .ThrowAsJavaScriptException();
+            return;
+        }
+
+        handle_ = std::make_shared<SynthesizerHandle>();
+        handle_->synth = synth;
+        return;
+    }
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "modelPath (string) is required as the first argument")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    std::string model_path = info[0].As<Napi::String>().Utf8Value();
+
+    const char *config_path = nullptr;
+    std::string config_path_str;
+    if (info.Length() > 1 && !info[1].IsNull() && !info[1].IsUndefined()) {
+        if (!info[1].IsString()) {
+            Napi::TypeError::New(env, "configPath must be a string or null")
+                .ThrowAsJavaScriptException();
+            return;
+        }
+        config_path_str = info[1].As<Napi::String>().Utf8Value();
+        config_path = config_path_str.c_str();
+    }
+
+    const char *espeak_data_path = nullptr;
+    std::string espeak_data_path_str;
+    if (info.Length() > 2 && !info[2].IsNull() && !info[2].IsUndefined()) {
+        if (!info[2].IsString()) {
+            Napi::TypeError::New(env, "espeakDataPath must be a string or null")
+                .ThrowAsJavaScriptException();
+            return;
+        }
+        espeak_data_path_str = info[2].As<Napi::String>().Utf8Value();
+        espeak_data_path = espeak_data_path_str.c_str();
+    }
+
+    piper_create_options create_options;
+    CreateOptionStorage option_storage;
+    if (!ParseCreateOptions(env, info.Length() > 3 ? info[3] : env.Undefined(),
+                            create_options, option_storage)) {
+        return;
+    }
+
+    piper_synthesizer *synth = nullptr;
+    try {
+        synth = piper_create_ex(model_path.c_str(), config_path, espeak_data_path,
+                                &create_options);
+    } catch (const std::exception &e) {
+        std::string msg = "Failed to create Piper synthesizer: ";
+        msg += e.what();
+        Napi::Error::New(env, msg).ThrowAsJavaScriptException();
+        return;
+    }
+    if (!synth) {
+        Napi::Error::New(env, "Failed to create Piper synthesizer. Check model and config paths.")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    handle_ = std::make_shared<SynthesizerHandle>();
+    handle_->synth = synth;
+}
+
+PiperSynthesizerWrap::~PiperSynthesizerWrap() {
+    // In-flight workers keep their own reference to the handle
+    handle_.reset();
+}
+
+Napi::Value PiperSynthesizerWrap::Synthesize(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!handle_) {
+        Napi::Error::New(env, "Synthesizer has been disposed")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    SynthesisInput input;
+    if (info.Length() < 1 || !ParseSynthesisInput(info[0], input)) {
+        Napi::TypeError::New(env, INPUT_REQUIRED_MESSAGE).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (handle_->num_long_requests > 0) {
+        Napi::Error::New(env, BUSY_MESSAGE).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // Waits for any in-flight async synthesis on this instance
+    std::lock_guard<std::mutex> lock(handle_->mutex);
+
+    SynthesisOptions options = ParseSynthesizeOptions(
+        piper_default_synthesize_options(handle_->synth),
+        info.Length() > 1 ? info[1] : env.Undefined());
+
+    // Collect all audio chunks
+    Napi::Array chunks = Napi::Array::New(env);
+    uint32_t chunk_idx = 0;
+
+    std::string error;
+    bool ok = RunSynthesis(handle_->synth, input, options.Get(),
+                           [&](const piper_audio_chunk &chunk) {
+                               chunks.Set(chunk_idx++,
+                                          ChunkToObject(env, chunk,
+                                                        TakeSamples(handle_->synth),
+                                                        options.pack_metadata));
+                           },
+                           nullptr, error);
+    if (!ok) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return chunks;
+}
+
+Napi::Value PiperSynthesizerWrap::SynthesizeAsync(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+    if (!handle_) {
+        deferred.Reject(Napi::Error::New(env, "Synthesizer has been disposed").Value());
+        return deferred.Promise();
+    }
+
+    SynthesisInput input;
+    if (info.Length() < 1 || !ParseSynthesisInput(info[0], input)) {
+        deferred.Reject(Napi::TypeError::New(env, INPUT_REQUIRED_MESSAGE).Value());
+        return deferred.Promise();
+    }
+
+    // Defaults only read the immutable voice config, so no lock is needed
+    SynthesisOptions options = ParseSynthesizeOptions(
+        piper_default_synthesize_options(handle_->synth),
+        info.Length() > 1 ? info[1] : env.Undefined());
+
+    SynthesizeRequest *request = new SynthesizeRequest(
+        env, handle_, std::move(input), std::move(options),
+        UnwrapCancelState(env, info.Length() > 2 ? info[2] : env.Undefined()));
+    Napi::Promise promise = request->Promise();
+    handle_->Submit(env, request);
+
+    return promise;
+}
+
+// synthesizeStream(input, options, onChunk, cancelToken, streamFlow)
+Napi::Value PiperSynthesizerWrap::SynthesizeStream(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+    if (!handle_) {
+        deferred.Reject(Napi::Error::New(env, "Synthesizer has been disposed").Value());
+        return deferred.Promise();
+    }
+
+    SynthesisInput input;
+    if (info.Length() < 1 || !ParseSynthesisInput(info[0], input)) {
+        deferred.Reject(Napi::TypeError::New(env, INPUT_REQUIRED_MESSAGE).Value());
+        return deferred.Promise();
+    }
+
+    if (info.Length() < 3 || !info[2].IsFunction()) {
+        deferred.Reject(Napi::TypeError::New(env, "onChunk (function) is required").Value());
+        return deferred.Promise();
+    }
+
+    SynthesisOptions options = ParseSynthesizeOptions(
+        piper_default_synthesize_options(handle_->synth), info[1]);
+
+    SynthesizeStreamRequest *request = new SynthesizeStreamRequest(
+        env, handle_, std::move(input), std::move(options), info[2].As<Napi::Function>(),
+        UnwrapCancelState(env, info.Length() > 3 ? info[3] : env.Undefined()),
+        UnwrapStreamFlow(env, info.Length() > 4 ? info[4] : env.Undefined()));
+    Napi::Promise promise = request->Promise();
+    handle_->Submit(env, request);
+
+    return promise;
+}
+
+// synthesizeDocument(inputFd, outputFd, options, onChunk, onProgress, cancelToken)
+Napi::Value PiperSynthesizerWrap::SynthesizeDocument(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+    if (!handle_) {
+        deferred.Reject(Napi::Error::New(env, "Synthesizer has been disposed").Value());
+        return deferred.Promise();
+    }
+
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+        deferred.Reject(
+            Napi::TypeError::New(env, "inputFd and outputFd (numbers) are required").Value());
+        return deferred.Promise();
+    }
+
+    uv_file input_fd = info[0].As<Napi::Number>().Int32Value();
+    uv_file output_fd = info[1].As<Napi::Number>().Int32Value();
+    Napi::Value on_chunk = info.Length() > 3 ? info[3] : env.Undefined();
+    if ((output_fd < 0) && !on_chunk.IsFunction()) {
+        deferred.Reject(
+            Napi::TypeError::New(env, "output or onChunk is required for a document").Value());
+        return deferred.Promise();
+    }
+
+    Napi::Value opts = info.Length() > 2 ? info[2] : env.Undefined();
+    int lookahead_chunks = 0;
+    if (opts.IsObject() && opts.As<Napi::Object>().Get("lookaheadChunks").IsNumber()) {
+        lookahead_chunks =
+            opts.As<Napi::Object>().Get("lookaheadChunks").As<Napi::Number>().Int32Value();
+    }
+
+    SynthesisOptions options =
+        ParseSynthesizeOptions(piper_default_synthesize_options(handle_->synth), opts);
+
+    SynthesizeDocumentRequest *request = new SynthesizeDocumentRequest(
+        env, handle_, input_fd, output_fd, lookahead_chunks, std::move(options), on_chunk,
+        info.Length() > 4 ? info[4] : env.Undefined(),
+        UnwrapCancelState(env, info.Length() > 5 ? info[5] : env.Undefined()));
+    Napi::Promise promise = request->Promise();
+    handle_->Submit(env, request);
+
+    return promise;
+}
+
+Napi::Value PiperSynthesizerWrap::GetDefaultOptions(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!handle_) {
+        Napi::Error::New(env, "Synthesizer has been disposed")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    piper_synthesize_options options = piper_default_synthesize_options(handle_->synth);
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("speakerId", Napi::Number::New(env, options.speaker_id));
+    result.Set("lengthScale", Napi::Number::New(env, options.length_scale));
+    result.Set("noiseScale", Napi::Number::New(env, options.noise_scale));
+    result.Set("noiseWScale", Napi::Number::New(env, options.noise_w_scale));
+
+    return result;
+}
+
+void PiperSynthesizerWrap::Warmup(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!handle_) {
+        Napi::Error::New(env, "Synthesizer has been disposed")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    if (handle_->num_long_requests > 0) {
+        Napi::Error::New(env, BUSY_MESSAGE).ThrowAsJavaScriptException();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(handle_->mutex);
+
+    int result;
+    try {
+        result = piper_warmup(handle_->synth);
+    } catch (const std::exception &e) {
+        std::string msg = "Warmup failed: ";
+        msg += e.what();
+        Napi::Error::New(env, msg).ThrowAsJavaScriptException();
+        return;
+    }
+    if (result != PIPER_OK) {
+        Napi::Error::New(env, "Warmup failed").ThrowAsJavaScriptException();
+    }
+}
+
+// The cache has its own lock, so these don't wait for running synthesis
+Napi::Value PiperSynthesizerWrap::GetCacheStats(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!handle_) {
+        Napi::Error::New(env, "Synthesizer has been disposed")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return CacheStatsToObject(env, piper_get_voice(handle_->synth));
+}
+
+void PiperSynthesizerWrap::ClearCache(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!handle_) {
+        Napi::Error::New(env, "Synthesizer has been disposed")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    piper_voice_cache_clear(piper_get_voice(handle_->synth));
+}
+
+// Stats have their own lock as well
+Napi::Value PiperSynthesizerWrap::GetStats(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!handle_) {
+        Napi::Error::New(env, "Synthesizer has been disposed")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return StatsToObject(env, handle_->synth);
+}
+
+void PiperSynthesizerWrap::ResetStats(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!handle_) {
+        Napi::Error::New(env, "Synthesizer has been disposed")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    piper_reset_stats(handle_->synth);
+}
+
+Napi::Value PiperSynthesizerWrap::EndProfiling(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!handle_) {
+        Napi::Error::New(env, "Synthesizer has been disposed")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return EndVoiceProfiling(env, piper_get_voice(handle_->synth));
+}
+
+void PiperSynthesizerWrap::Dispose(const Napi::CallbackInfo &info) {
+    // The native synthesizer is freed once in-flight async work completes
+    handle_.reset();
+}
+
+Napi::Object PiperVoiceWrap::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "PiperVoice",
+                                      {
+                                          InstanceMethod<&PiperVoiceWrap::GetCacheStats>("getCacheStats"),
+                                          InstanceMethod<&PiperVoiceWrap::ClearCache>("clearCache"),
+                                          InstanceMethod<&PiperVoiceWrap::EndProfiling>("endProfiling"),
+                                          InstanceMethod<&PiperVoiceWrap::Share>("share"),
+                                          InstanceMethod<&PiperVoiceWrap::Dispose>("dispose"),
+                                      });
+
+    env.GetInstanceData<AddonData>()->voice_ctor = Napi::Persistent(func);
+    exports.Set("PiperVoice", func);
+
+    return exports;
+}
+
+// PiperVoice(modelPath, configPath, espeakDataPath, createOptions)
+// PiperVoice(modelBuffer, config, espeakDataPath, createOptions)
+// PiperVoice(sharedId)
+PiperVoiceWrap::PiperVoiceWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<PiperVoiceWrap>(info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() > 0 && info[0].IsNumber()) {
+        uint32_t shared_id = info[0].As<Napi::Number>().Uint32Value();
+        voice_ = SharedVoices().Retain(shared_id);
+        if (!voice_) {
+            Napi::Error::New(env, "Shared voice not found. The voice that shared it has been disposed.")
+                .ThrowAsJavaScriptException();
+        }
+        return;
+    }
+
+    if (info.Length() > 0 && info[0].IsBuffer()) {
+        VoiceBytes bytes;
+        if (!GetVoiceBytes(env, info[0], info.Length() > 1 ? info[1] : env.Undefined(),
+                           bytes)) {
+            return;
+        }
+
+        std::string espeak_data_path_str;
+        if (info.Length() > 2 && info[2].IsString()) {
+            espeak_data_path_str = info[2].As<Napi::String>().Utf8Value();
+        }
+
+        piper_create_options create_options;
+        CreateOptionStorage option_storage;
+        if (!ParseCreateOptions(env, info.Length() > 3 ? info[3] : env.Undefined(),
+                                create_options, option_storage)) {
+            return;
+        }
+
+        try {
+            voice_ = piper_voice_load_from_memory(
+                bytes.model_data, bytes.model_size, bytes.config_json.data(),
+                bytes.config_json.size(),
+                espeak_data_path_str.empty() ? nullptr : espeak_data_path_str.c_str(),
+                &create_options);
+        } catch (const std::exception &e) {
+            std::string msg = "Failed to load Piper voice: ";
+            msg += e.what();
+            Napi::Error::New(env, msg).ThrowAsJavaScriptException();
+            return;
+        }
+        if (!voice_) {
+            Napi::Error::New(env, "Failed to load Piper voice from memory")
+                .ThrowAsJavaScriptException();
+        }
+        return;
+    }
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "modelPath (string) is required as the first argument")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    std::string model_path = info[0].As<Napi::String>().Utf8Value();
+
+    const char *config_path = nullptr;
+    std::string config_path_str;
+    if (info.Length() > 1 && info[1].IsString()) {
+        config_path_str = info[1].As<Napi::String>().Utf8Value();
+        config_path = config_path_str.c_str();
+    }
+
+    const char *espeak_data_path = nullptr;
+    std::string espeak_data_path_str;
+    if (info.Length() > 2 && info[2].IsString()) {
+        espeak_data_path_str = info[2].As<Napi::String>().Utf8Value();
+        espeak_data_path = espeak_data_path_str.c_str();
+    }
+
+    piper_create_options create_options;
+    CreateOptionStorage option_storage;
+    if (!ParseCreateOptions(env, info.Length() > 3 ? info[3] : env.Undefined(),
+                            create_options, option_storage)) {
+        return;
+    }
+
+    try {
+        voice_ = piper_voice_load(model_path.c_str(), config_path, espeak_data_path,
+                                  &create_options);
+    } catch (const std::exception &e) {
+        std::string msg = "Failed to load Piper voice: ";
+        msg += e.what();
+        Napi::Error::New(env, msg).ThrowAsJavaScriptException();
+        return;
+    }
+    if (!voice_) {
+        Napi::Error::New(env, "Failed to load Piper voice. Check model and config paths.")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+}
+
+PiperVoiceWrap::~PiperVoiceWrap() { Release(); }
+
+// Drop this object's references (its own and the registry's)
+void PiperVoiceWrap::Release() {
+    if (shared_id_ != 0) {
+        SharedVoices().Remove(shared_id_);
+        shared_id_ = 0;
+    }
+
+    piper_voice_release(voice_);
+    voice_ = nullptr;
+}
+
+Napi::Value PiperVoiceWrap::GetCacheStats(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!voice_) {
+        Napi::Error::New(env, "Voice has been disposed").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return CacheStatsToObject(env, voice_);
+}
+
+void PiperVoiceWrap::ClearCache(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!voice_) {
+        Napi::Error::New(env, "Voice has been disposed").ThrowAsJavaScriptException();
+        return;
+    }
+
+    piper_voice_cache_clear(voice_);
+}
 
-    piper_synthesizer *synth_ = nullptr;
-};
+Napi::Value PiperVoiceWrap::EndProfiling(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
 
-Napi::Object PiperSynthesizerWrap::Init(Napi::Env env, Napi::Object exports) {
-    Napi::Function func = DefineClass(env, "PiperSynthesizer",
+    if (!voice_) {
+        Napi::Error::New(env, "Voice has been disposed").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return EndVoiceProfiling(env, voice_);
+}
+
+Napi::Value PiperVoiceWrap::Share(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!voice_) {
+        Napi::Error::New(env, "Voice has been disposed").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // One registry entry per voice object, however often it's shared
+    if (shared_id_ == 0) {
+        shared_id_ = SharedVoices().Add(voice_);
+    }
+
+    return Napi::Number::New(env, shared_id_);
+}
+
+void PiperVoiceWrap::Dispose(const Napi::CallbackInfo &info) { Release(); }
+
+Napi::Object PiperPoolWrap::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "PiperPool",
                                       {
-                                          InstanceMethod<&PiperSynthesizerWrap::Synthesize>("synthesize"),
-                                          InstanceMethod<&PiperSynthesizerWrap::GetDefaultOptions>("getDefaultOptions"),
-                                          InstanceMethod<&PiperSynthesizerWrap::Dispose>("dispose"),
+                                          InstanceMethod<&PiperPoolWrap::SynthesizeAsync>("synthesizeAsync"),
+                                          InstanceMethod<&PiperPoolWrap::GetNumWorkers>("getNumWorkers"),
+                                          InstanceMethod<&PiperPoolWrap::Dispose>("dispose"),
                                       });
 
-    Napi::FunctionReference *ctor = new Napi::FunctionReference();
-    *ctor = Napi::Persistent(func);
-    exports.Set("PiperSynthesizer", func);
-    env.SetInstanceData<Napi::FunctionReference>(ctor);
+    exports.Set("PiperPool", func);
 
     return exports;
 }
 
-PiperSynthesizerWrap::PiperSynthesizerWrap(const Napi::CallbackInfo &info)
-    : Napi::ObjectWrap<PiperSynthesizerWrap>(info) {
+// PiperPool(modelPath, configPath, espeakDataPath, createOptions, numWorkers)
+// PiperPool(voice, numWorkers)
+PiperPoolWrap::PiperPoolWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<PiperPoolWrap>(info) {
     Napi::Env env = info.Env();
 
+    if (info.Length() > 0 && info[0].IsObject()) {
+        piper_voice *voice = UnwrapVoice(env, info[0]);
+        if (!voice) {
+            return;
+        }
+
+        int num_workers = 0;
+        if (info.Length() > 1 && info[1].IsNumber()) {
+            num_workers = info[1].As<Napi::Number>().Int32Value();
+        }
+
+        piper_synthesizer *synth = nullptr;
+        piper_pool *pool = nullptr;
+        try {
+            synth = piper_context_create(voice);
+            pool = piper_pool_create(synth, num_workers);
+        } catch (const std::exception &e) {
+            piper_free(synth);
+            std::string msg = "Failed to create Piper pool: ";
+            msg += e.what();
+            Napi::Error::New(env, msg).ThrowAsJavaScriptException();
+            return;
+        }
+        piper_free(synth);
+
+        if (!pool) {
+            Napi::Error::New(env, "Failed to create Piper pool")
+                .ThrowAsJavaScriptException();
+            return;
+        }
+
+        handle_ = std::make_shared<PoolHandle>();
+        handle_->pool = pool;
+        return;
+    }
+
     if (info.Length() < 1 || !info[0].IsString()) {
         Napi::TypeError::New(env, "modelPath (string) is required as the first argument")
             .ThrowAsJavaScriptException();
@@ -49,207 +2478,487 @@ PiperSynthesizerWrap::PiperSynthesizerWrap(const Napi::CallbackInfo &info)
 
     const char *config_path = nullptr;
     std::string config_path_str;
-    if (info.Length() > 1 && !info[1].IsNull() && !info[1].IsUndefined()) {
-        if (!info[1].IsString()) {
-            Napi::TypeError::New(env, "configPath must be a string or null")
-                .ThrowAsJavaScriptException();
-            return;
-        }
+    if (info.Length() > 1 && info[1].IsString()) {
         config_path_str = info[1].As<Napi::String>().Utf8Value();
         config_path = config_path_str.c_str();
     }
 
     const char *espeak_data_path = nullptr;
     std::string espeak_data_path_str;
-    if (info.Length() > 2 && !info[2].IsNull() && !info[2].IsUndefined()) {
-        if (!info[2].IsString()) {
-            Napi::TypeError::New(env, "espeakDataPath must be a string or null")
-                .ThrowAsJavaScriptException();
-            return;
-        }
+    if (info.Length() > 2 && info[2].IsString()) {
         espeak_data_path_str = info[2].As<Napi::String>().Utf8Value();
         espeak_data_path = espeak_data_path_str.c_str();
     }
 
+    piper_create_options create_options;
+    CreateOptionStorage option_storage;
+    if (!ParseCreateOptions(env, info.Length() > 3 ? info[3] : env.Undefined(),
+                            create_options, option_storage)) {
+        return;
+    }
+
+    int num_workers = 0;
+    if (info.Length() > 4 && info[4].IsNumber()) {
+        num_workers = info[4].As<Napi::Number>().Int32Value();
+    }
+
+    // The pool shares the model, the synthesizer itself isn't needed after
+    piper_synthesizer *synth = nullptr;
+    piper_pool *pool = nullptr;
     try {
-        synth_ = piper_create(model_path.c_str(), config_path, espeak_data_path);
+        synth = piper_create_ex(model_path.c_str(), config_path, espeak_data_path,
+                                &create_options);
+        if (synth) {
+            pool = piper_pool_create(synth, num_workers);
+        }
     } catch (const std::exception &e) {
-        std::string msg = "Failed to create Piper synthesizer: ";
+        piper_free(synth);
+        std::string msg = "Failed to create Piper pool: ";
         msg += e.what();
         Napi::Error::New(env, msg).ThrowAsJavaScriptException();
         return;
     }
-    if (!synth_) {
-        Napi::Error::New(env, "Failed to create Piper synthesizer. Check model and config paths.")
+    piper_free(synth);
+
+    if (!pool) {
+        Napi::Error::New(env, "Failed to create Piper pool. Check model and config paths.")
             .ThrowAsJavaScriptException();
         return;
     }
+
+    handle_ = std::make_shared<PoolHandle>();
+    handle_->pool = pool;
 }
 
-PiperSynthesizerWrap::~PiperSynthesizerWrap() {
-    if (synth_) {
-        piper_free(synth_);
-        synth_ = nullptr;
-    }
+PiperPoolWrap::~PiperPoolWrap() {
+    // In-flight workers keep their own reference to the handle
+    handle_.reset();
 }
 
-Napi::Value PiperSynthesizerWrap::Synthesize(const Napi::CallbackInfo &info) {
+Napi::Value PiperPoolWrap::SynthesizeAsync(const Napi::CallbackInfo &info) {
     Napi::Env env = info.Env();
+    Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
 
-    if (!synth_) {
-        Napi::Error::New(env, "Synthesizer has been disposed")
-            .ThrowAsJavaScriptException();
-        return env.Undefined();
+    if (!handle_) {
+        deferred.Reject(Napi::Error::New(env, "Pool has been disposed").Value());
+        return deferred.Promise();
     }
 
     if (info.Length() < 1 || !info[0].IsString()) {
-        Napi::TypeError::New(env, "text (string) is required")
-            .ThrowAsJavaScriptException();
-        return env.Undefined();
+        deferred.Reject(Napi::TypeError::New(env, "text (string) is required").Value());
+        return deferred.Promise();
     }
 
     std::string text = info[0].As<Napi::String>().Utf8Value();
+    SynthesisOptions options = ParseSynthesizeOptions(
+        piper_pool_default_synthesize_options(handle_->pool),
+        info.Length() > 1 ? info[1] : env.Undefined());
 
-    // Parse synthesis options
-    piper_synthesize_options options = piper_default_synthesize_options(synth_);
-    if (info.Length() > 1 && info[1].IsObject()) {
-        Napi::Object opts = info[1].As<Napi::Object>();
+    PoolSynthesizeWorker *worker = new PoolSynthesizeWorker(
+        env, handle_, std::move(text), std::move(options),
+        UnwrapCancelState(env, info.Length() > 2 ? info[2] : env.Undefined()));
+    worker->Queue();
 
-        if (opts.Has("speakerId") && opts.Get("speakerId").IsNumber()) {
-            options.speaker_id = opts.Get("speakerId").As<Napi::Number>().Int32Value();
-        }
-        if (opts.Has("lengthScale") && opts.Get("lengthScale").IsNumber()) {
-            options.length_scale = opts.Get("lengthScale").As<Napi::Number>().FloatValue();
-        }
-        if (opts.Has("noiseScale") && opts.Get("noiseScale").IsNumber()) {
-            options.noise_scale = opts.Get("noiseScale").As<Napi::Number>().FloatValue();
-        }
-        if (opts.Has("noiseWScale") && opts.Get("noiseWScale").IsNumber()) {
-            options.noise_w_scale = opts.Get("noiseWScale").As<Napi::Number>().FloatValue();
-        }
+    return worker->Promise();
+}
+
+Napi::Value PiperPoolWrap::GetNumWorkers(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!handle_) {
+        Napi::Error::New(env, "Pool has been disposed").ThrowAsJavaScriptException();
+        return env.Undefined();
     }
 
-    // Start synthesis
-    int result;
+    return Napi::Number::New(env, piper_pool_num_workers(handle_->pool));
+}
+
+void PiperPoolWrap::Dispose(const Napi::CallbackInfo &info) {
+    // The native pool is freed once in-flight async work completes
+    handle_.reset();
+}
+
+Napi::Object PiperBatcherWrap::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "PiperBatcher",
+                                      {
+                                          InstanceMethod<&PiperBatcherWrap::SynthesizeAsync>("synthesizeAsync"),
+                                          InstanceMethod<&PiperBatcherWrap::GetStats>("getStats"),
+                                          InstanceMethod<&PiperBatcherWrap::ResetStats>("resetStats"),
+                                          InstanceMethod<&PiperBatcherWrap::Dispose>("dispose"),
+                                      });
+
+    exports.Set("PiperBatcher", func);
+
+    return exports;
+}
+
+// PiperBatcher(voice, maxBatchSize, maxWaitMs)
+PiperBatcherWrap::PiperBatcherWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<PiperBatcherWrap>(info) {
+    Napi::Env env = info.Env();
+
+    piper_voice *voice = UnwrapVoice(env, info.Length() > 0 ? info[0] : env.Undefined());
+    if (!voice) {
+        return;
+    }
+
+    piper_batcher_options options = piper_batcher_default_options();
+    if (info.Length() > 1 && info[1].IsNumber()) {
+        options.max_batch_size = info[1].As<Napi::Number>().Int32Value();
+    }
+    if (info.Length() > 2 && info[2].IsNumber()) {
+        options.max_wait_ms = info[2].As<Napi::Number>().Int32Value();
+    }
+
+    // The first context also gives the voice's default options
+    auto handle = std::make_shared<BatcherHandle>();
+    handle->voice = voice;
+    piper_voice_retain(voice);
+
+    piper_synthesizer *synth = nullptr;
     try {
-        result = piper_synthesize_start(synth_, text.c_str(), &options);
+        handle->batcher = piper_batcher_create(voice, &options);
+        synth = piper_context_create(voice);
     } catch (const std::exception &e) {
-        std::string msg = "Failed to start synthesis: ";
+        piper_free(synth);
+        std::string msg = "Failed to create Piper batcher: ";
         msg += e.what();
         Napi::Error::New(env, msg).ThrowAsJavaScriptException();
-        return env.Undefined();
+        return;
     }
-    if (result != PIPER_OK) {
-        Napi::Error::New(env, "Failed to start synthesis")
+
+    if (!handle->batcher || !synth) {
+        piper_free(synth);
+        Napi::Error::New(env, "Failed to create Piper batcher")
             .ThrowAsJavaScriptException();
+        return;
+    }
+
+    handle->default_options = piper_default_synthesize_options(synth);
+    handle->ReleaseContext(synth);
+
+    handle->on_done = Napi::ThreadSafeFunction::New(env, Napi::Function(), "PiperBatcher", 0, 1);
+    handle->on_done.Unref(env);
+
+    // Enough requests in flight to fill a batch
+    handle->StartThreads(static_cast<size_t>(std::max(1, options.max_batch_size)));
+    handle_ = std::move(handle);
+}
+
+PiperBatcherWrap::~PiperBatcherWrap() {
+    // Pending requests keep their own reference to the handle
+    handle_.reset();
+}
+
+Napi::Value PiperBatcherWrap::SynthesizeAsync(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+    if (!handle_) {
+        deferred.Reject(Napi::Error::New(env, "Batcher has been disposed").Value());
+        return deferred.Promise();
+    }
+
+    SynthesisInput input;
+    if (info.Length() < 1 || !ParseSynthesisInput(info[0], input)) {
+        deferred.Reject(Napi::TypeError::New(env, INPUT_REQUIRED_MESSAGE).Value());
+        return deferred.Promise();
+    }
+
+    SynthesisOptions options = ParseSynthesizeOptions(
+        handle_->default_options, info.Length() > 1 ? info[1] : env.Undefined());
+
+    auto *request = new BatcherRequest(
+        env, handle_, std::move(input), std::move(options),
+        UnwrapCancelState(env, info.Length() > 2 ? info[2] : env.Undefined()));
+    Napi::Promise promise = request->deferred.Promise();
+
+    if (handle_->num_pending++ == 0) {
+        handle_->on_done.Ref(env);
+    }
+    handle_->Submit(request);
+
+    return promise;
+}
+
+Napi::Value PiperBatcherWrap::GetStats(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (!handle_) {
+        Napi::Error::New(env, "Batcher has been disposed").ThrowAsJavaScriptException();
         return env.Undefined();
     }
 
-    // Collect all audio chunks
-    Napi::Array chunks = Napi::Array::New(env);
-    uint32_t chunk_idx = 0;
+    piper_batcher_stats stats;
+    std::memset(&stats, 0, sizeof(stats));
+    piper_batcher_get_stats(handle_->batcher, &stats);
 
-    piper_audio_chunk chunk;
-    while (true) {
-        try {
-            result = piper_synthesize_next(synth_, &chunk);
-        } catch (const std::exception &e) {
-            std::string msg = "Synthesis failed: ";
-            msg += e.what();
-            Napi::Error::New(env, msg).ThrowAsJavaScriptException();
-            return env.Undefined();
-        }
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("numBatches", Napi::Number::New(env, static_cast<double>(stats.num_batches)));
+    result.Set("numChunks", Napi::Number::New(env, static_cast<double>(stats.num_chunks)));
+    result.Set("queueSeconds", Napi::Number::New(env, stats.queue_seconds));
+    result.Set("inferenceSeconds", Napi::Number::New(env, stats.inference_seconds));
 
-        if (result == PIPER_DONE) {
-            break;
-        }
-        if (result != PIPER_OK) {
-            Napi::Error::New(env, "Synthesis failed during audio generation")
-                .ThrowAsJavaScriptException();
-            return env.Undefined();
-        }
+    return result;
+}
+
+void PiperBatcherWrap::ResetStats(const Napi::CallbackInfo &info) {
+    if (handle_) {
+        piper_batcher_reset_stats(handle_->batcher);
+    }
+}
+
+void PiperBatcherWrap::Dispose(const Napi::CallbackInfo &info) {
+    // The native batcher is freed once pending requests are resolved
+    handle_.reset();
+}
 
-        Napi::Object chunk_obj = Napi::Object::New(env);
+Napi::Object CancelTokenWrap::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "CancelToken",
+                                      {
+                                          InstanceMethod<&CancelTokenWrap::Cancel>("cancel"),
+                                      });
+
+    env.GetInstanceData<AddonData>()->cancel_token_ctor = Napi::Persistent(func);
+    exports.Set("CancelToken", func);
+
+    return exports;
+}
+
+CancelTokenWrap::CancelTokenWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<CancelTokenWrap>(info) {}
+
+// Doesn't take the synthesizer's mutex, which the running request holds
+void CancelTokenWrap::Cancel(const Napi::CallbackInfo &info) { state_->Cancel(); }
+
+Napi::Object StreamFlowWrap::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "StreamFlow",
+                                      {
+                                          InstanceMethod<&StreamFlowWrap::Resume>("resume"),
+                                      });
+
+    env.GetInstanceData<AddonData>()->stream_flow_ctor = Napi::Persistent(func);
+    exports.Set("StreamFlow", func);
+
+    return exports;
+}
+
+StreamFlowWrap::StreamFlowWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<StreamFlowWrap>(info) {}
 
-        // Audio samples as Float32Array
-        Napi::Float32Array samples = Napi::Float32Array::New(env, chunk.num_samples);
-        if (chunk.num_samples > 0 && chunk.samples) {
-            std::memcpy(samples.Data(), chunk.samples,
-                        chunk.num_samples * sizeof(float));
+void StreamFlowWrap::Resume(const Napi::CallbackInfo &info) { state_->Resume(); }
+
+// Writes samples to a WAV file, or closes it when there are none, on a
+// libuv worker thread and resolves a Promise when done.
+class WavWriteWorker : public Napi::AsyncWorker {
+public:
+    WavWriteWorker(Napi::Env env, std::shared_ptr<WavWriterHandle> handle,
+                   const Napi::Float32Array *samples)
+        : Napi::AsyncWorker(env, "PiperWavWrite"), deferred_(env), handle_(std::move(handle)) {
+        if (samples) {
+            // Kept alive until the write is done instead of copied
+            samples_ref_ = Napi::Persistent(*samples);
+            samples_ = samples->Data();
+            num_samples_ = samples->ElementLength();
+            close_ = false;
         }
-        chunk_obj.Set("samples", samples);
+    }
 
-        chunk_obj.Set("sampleRate", Napi::Number::New(env, chunk.sample_rate));
-        chunk_obj.Set("isLast", Napi::Boolean::New(env, chunk.is_last));
+    Napi::Promise Promise() const { return deferred_.Promise(); }
 
-        // Phoneme codepoints as Uint32Array
-        if (chunk.phonemes && chunk.num_phonemes > 0) {
-            Napi::Uint32Array phonemes_arr =
-                Napi::Uint32Array::New(env, chunk.num_phonemes);
-            for (size_t i = 0; i < chunk.num_phonemes; i++) {
-                phonemes_arr[i] = static_cast<uint32_t>(chunk.phonemes[i]);
+protected:
+    void Execute() override {
+        std::lock_guard<std::mutex> lock(handle_->mutex);
+        if (close_) {
+            int result = piper_wav_writer_close(handle_->writer);
+            handle_->writer = nullptr;
+            if (result != PIPER_OK) {
+                SetError("Failed to finish WAV file");
             }
-            chunk_obj.Set("phonemes", phonemes_arr);
-        } else {
-            chunk_obj.Set("phonemes", env.Null());
+            return;
         }
 
-        // Phoneme IDs as Int32Array
-        if (chunk.phoneme_ids && chunk.num_phoneme_ids > 0) {
-            Napi::Int32Array phoneme_ids_arr =
-                Napi::Int32Array::New(env, chunk.num_phoneme_ids);
-            std::memcpy(phoneme_ids_arr.Data(), chunk.phoneme_ids,
-                        chunk.num_phoneme_ids * sizeof(int));
-            chunk_obj.Set("phonemeIds", phoneme_ids_arr);
-        } else {
-            chunk_obj.Set("phonemeIds", env.Null());
+        if (!handle_->writer) {
+            SetError("WAV file has been closed");
+            return;
         }
-
-        // Alignments as Int32Array
-        if (chunk.alignments && chunk.num_alignments > 0) {
-            Napi::Int32Array alignments_arr =
-                Napi::Int32Array::New(env, chunk.num_alignments);
-            std::memcpy(alignments_arr.Data(), chunk.alignments,
-                        chunk.num_alignments * sizeof(int));
-            chunk_obj.Set("alignments", alignments_arr);
-        } else {
-            chunk_obj.Set("alignments", env.Null());
+        if (piper_wav_writer_write(handle_->writer, samples_, num_samples_) != PIPER_OK) {
+            SetError("Failed to write WAV file");
         }
+    }
+
+    void OnOK() override { deferred_.Resolve(Env().Undefined()); }
+
+    void OnError(const Napi::Error &e) override { deferred_.Reject(e.Value()); }
+
+private:
+    Napi::Promise::Deferred deferred_;
+    std::shared_ptr<WavWriterHandle> handle_;
+    Napi::Reference<Napi::Float32Array> samples_ref_;
+    const float *samples_ = nullptr;
+    size_t num_samples_ = 0;
+    bool close_ = true;
+};
+
+Napi::Object WavWriterWrap::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "WavWriter",
+                                      {
+                                          InstanceMethod<&WavWriterWrap::Write>("write"),
+                                          InstanceMethod<&WavWriterWrap::Close>("close"),
+                                      });
+
+    exports.Set("WavWriter", func);
+
+    return exports;
+}
+
+// WavWriter(path, sampleRate)
+WavWriterWrap::WavWriterWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<WavWriterWrap>(info) {
+    Napi::Env env = info.Env();
 
-        chunks.Set(chunk_idx++, chunk_obj);
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsNumber()) {
+        Napi::TypeError::New(env, "path (string) and sampleRate (number) are required")
+            .ThrowAsJavaScriptException();
+        return;
     }
 
-    return chunks;
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    handle_->writer =
+        piper_wav_writer_open(path.c_str(), info[1].As<Napi::Number>().Int32Value());
+    if (!handle_->writer) {
+        std::string msg = "Failed to create WAV file: ";
+        msg += path;
+        Napi::Error::New(env, msg).ThrowAsJavaScriptException();
+    }
 }
 
-Napi::Value PiperSynthesizerWrap::GetDefaultOptions(const Napi::CallbackInfo &info) {
+// write(samples): Promise resolved once samples (a Float32Array) are in the file
+Napi::Value WavWriterWrap::Write(const Napi::CallbackInfo &info) {
     Napi::Env env = info.Env();
 
-    if (!synth_) {
-        Napi::Error::New(env, "Synthesizer has been disposed")
+    if (info.Length() < 1 || !info[0].IsTypedArray() ||
+        info[0].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array) {
+        Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+        deferred.Reject(Napi::TypeError::New(env, "Expected a Float32Array").Value());
+        return deferred.Promise();
+    }
+
+    Napi::Float32Array samples = info[0].As<Napi::Float32Array>();
+    WavWriteWorker *worker = new WavWriteWorker(env, handle_, &samples);
+    worker->Queue();
+
+    return worker->Promise();
+}
+
+// close(): Promise resolved once the sizes are patched in and the file is closed
+Napi::Value WavWriterWrap::Close(const Napi::CallbackInfo &info) {
+    WavWriteWorker *worker = new WavWriteWorker(info.Env(), handle_, nullptr);
+    worker->Queue();
+
+    return worker->Promise();
+}
+
+// initGlobalThreadPool(intraOpNumThreads, interOpNumThreads, allowSpinning)
+static Napi::Value InitGlobalThreadPool(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    int intra_op_num_threads = 0;
+    int inter_op_num_threads = 0;
+    bool allow_spinning = true;
+
+    if (info.Length() > 0 && info[0].IsNumber()) {
+        intra_op_num_threads = info[0].As<Napi::Number>().Int32Value();
+    }
+    if (info.Length() > 1 && info[1].IsNumber()) {
+        inter_op_num_threads = info[1].As<Napi::Number>().Int32Value();
+    }
+    if (info.Length() > 2 && info[2].IsBoolean()) {
+        allow_spinning = info[2].As<Napi::Boolean>().Value();
+    }
+
+    int result;
+    try {
+        result = piper_init_global_thread_pool(intra_op_num_threads,
+                                               inter_op_num_threads, allow_spinning);
+    } catch (const std::exception &e) {
+        std::string msg = "Failed to create global thread pool: ";
+        msg += e.what();
+        Napi::Error::New(env, msg).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (result != PIPER_OK) {
+        Napi::Error::New(env, "Global thread pool must be created before any synthesizer")
             .ThrowAsJavaScriptException();
         return env.Undefined();
     }
 
-    piper_synthesize_options options = piper_default_synthesize_options(synth_);
+    return env.Undefined();
+}
 
-    Napi::Object result = Napi::Object::New(env);
-    result.Set("speakerId", Napi::Number::New(env, options.speaker_id));
-    result.Set("lengthScale", Napi::Number::New(env, options.length_scale));
-    result.Set("noiseScale", Napi::Number::New(env, options.noise_scale));
-    result.Set("noiseWScale", Napi::Number::New(env, options.noise_w_scale));
+// floatToInt16(samples, pcm): convert a Float32Array into an Int16Array
+// with room for every sample
+static Napi::Value FloatToInt16(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
 
-    return result;
+    if (info.Length() < 2 || !info[0].IsTypedArray() ||
+        info[0].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array ||
+        !info[1].IsTypedArray() ||
+        info[1].As<Napi::TypedArray>().TypedArrayType() != napi_int16_array) {
+        Napi::TypeError::New(env, "Expected a Float32Array and an Int16Array")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::Float32Array samples = info[0].As<Napi::Float32Array>();
+    Napi::Int16Array pcm = info[1].As<Napi::Int16Array>();
+    if (pcm.ElementLength() < samples.ElementLength()) {
+        Napi::RangeError::New(env, "Int16Array is shorter than the samples")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    piper_float_to_int16(samples.Data(), samples.ElementLength(), pcm.Data());
+
+    return env.Undefined();
 }
 
-void PiperSynthesizerWrap::Dispose(const Napi::CallbackInfo &info) {
-    if (synth_) {
-        piper_free(synth_);
-        synth_ = nullptr;
+// wavHeader(sampleRate, numSamples): WAV header as a Buffer.
+// A negative numSamples writes the unknown length used for streams.
+static Napi::Value WavHeader(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+        Napi::TypeError::New(env, "Expected sample rate and sample count")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
     }
+
+    int sample_rate = info[0].As<Napi::Number>().Int32Value();
+    double num_samples = info[1].As<Napi::Number>().DoubleValue();
+
+    Napi::Buffer<uint8_t> header =
+        Napi::Buffer<uint8_t>::New(env, PIPER_WAV_HEADER_SIZE);
+    piper_wav_header(sample_rate,
+                     (num_samples < 0) ? PIPER_WAV_UNKNOWN_LENGTH
+                                       : static_cast<size_t>(num_samples),
+                     header.Data());
+
+    return header;
 }
 
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
+    env.SetInstanceData<AddonData>(new AddonData());
+
+    exports.Set("initGlobalThreadPool", Napi::Function::New(env, InitGlobalThreadPool));
+    exports.Set("floatToInt16", Napi::Function::New(env, FloatToInt16));
+    exports.Set("wavHeader", Napi::Function::New(env, WavHeader));
+    PiperVoiceWrap::Init(env, exports);
+    PiperPoolWrap::Init(env, exports);
+    PiperBatcherWrap::Init(env, exports);
+    CancelTokenWrap::Init(env, exports);
+    StreamFlowWrap::Init(env, exports);
+    WavWriterWrap::Init(env, exports);
     return PiperSynthesizerWrap::Init(env, exports);
 }
 
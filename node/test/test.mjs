@@ -1,12 +1,23 @@
 import { describe, it, afterEach } from 'node:test';
 import assert from 'node:assert/strict';
+import { execFileSync } from 'node:child_process';
+import fs from 'node:fs';
+import os from 'node:os';
 import path from 'node:path';
-import { fileURLToPath } from 'node:url';
+import { Readable } from 'node:stream';
+import { pipeline } from 'node:stream/promises';
+import { fileURLToPath, pathToFileURL } from 'node:url';
+import { Worker } from 'node:worker_threads';
 
-import { PiperSynthesizer, chunksToWavBuffer, samplesToInt16 } from '../lib/index.js';
+import {
+    PiperVoice, PiperSynthesizer, PiperPool, PiperBatcher, WavEncoder, WavFileWriter, chunksToWavBuffer,
+    writeWavFile, samplesToInt16,
+} from '../lib/index.js';
 
 const __dirname = path.dirname(fileURLToPath(import.meta.url));
 const TEST_VOICE = path.join(__dirname, '..', '..', 'tests', 'test_voice.onnx');
+const TEST_ALIGNMENTS_VOICE = path.join(__dirname, '..', '..', 'tests', 'test_voice_alignments.onnx');
+const TEST_EMBEDDING_VOICE = path.join(__dirname, '..', '..', 'tests', 'test_voice_embedding.onnx');
 
 describe('PiperSynthesizer', () => {
     let synth;
@@ -54,6 +65,19 @@ describe('PiperSynthesizer', () => {
         assert.equal(chunks[1].isLast, true);
     });
 
+    it('should keep samples valid after dispose', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const chunks = synth.synthesize('This is a test.');
+        const asyncChunks = await synth.synthesizeAsync('This is a test.');
+        synth.dispose();
+        synth = null;
+
+        for (const chunk of [...chunks, ...asyncChunks]) {
+            assert.equal(chunk.samples.length, 22050);
+            assert.equal(chunk.samples[chunk.samples.length - 1], 0);
+        }
+    });
+
     it('should include phoneme IDs in chunks', () => {
         synth = new PiperSynthesizer(TEST_VOICE);
         const chunks = synth.synthesize('Test.');
@@ -89,6 +113,400 @@ describe('PiperSynthesizer', () => {
         assert.ok(chunks[0].samples instanceof Float32Array);
     });
 
+    it('should reject a speaker embedding for voices without one', () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        assert.throws(
+            () => synth.synthesize('Test.', { speakerEmbedding: new Float32Array(4) }),
+            /speakerEmbedding is not supported by this voice/
+        );
+
+        // Options don't carry over to the next request
+        assert.equal(synth.synthesize('Test.').length, 1);
+    });
+
+    it('should pass a speaker embedding to voices that take one', () => {
+        // Every sample is the mean of the embedding
+        synth = new PiperSynthesizer(TEST_EMBEDDING_VOICE);
+        const [chunk] = synth.synthesize('Test.', {
+            speakerEmbedding: new Float32Array([0.1, 0.2, 0.3, 0.4]),
+        });
+        assert.ok(Math.abs(chunk.samples[0] - 0.25) < 1e-6);
+
+        assert.throws(() => synth.synthesize('Test.'), /this voice requires a speakerEmbedding/);
+        assert.throws(
+            () => synth.synthesize('Test.', { speakerEmbedding: new Float32Array(3) }),
+            /speakerEmbedding must have 4 floats, got 3/
+        );
+    });
+
+    it('should synthesize phonemes and ids without text', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const [textChunk] = synth.synthesize('This is a test.');
+
+        // Chunk phonemes are BOS, BOS, separator, then each phoneme twice
+        // (id and pad) and a separator, then EOS and a separator
+        const numPhonemes = (textChunk.phonemes.length - 5) / 3;
+        const phonemes = String.fromCodePoint(
+            ...Array.from({ length: numPhonemes }, (_, i) => textChunk.phonemes[3 + 3 * i])
+        );
+
+        const phonemeChunks = synth.synthesizePhonemes(`${phonemes}\n${phonemes}`);
+        assert.equal(phonemeChunks.length, 2);
+        assert.deepEqual(Array.from(phonemeChunks[0].phonemeIds), Array.from(textChunk.phonemeIds));
+
+        const ids = BigInt64Array.from(textChunk.phonemeIds, (id) => BigInt(id));
+        const idChunks = await synth.synthesizeIdsAsync(ids);
+        assert.equal(idChunks.length, 1);
+        assert.equal(idChunks[0].samples.length, textChunk.samples.length);
+    });
+
+    it('should split long sentences at clause boundaries', () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const text = 'This is a test, this is another test.';
+
+        assert.equal(synth.synthesize(text).length, 1);
+
+        const chunks = synth.synthesize(text, {
+            maxChunkPhonemes: 5,
+            clauseSilenceSeconds: 0.5,
+        });
+        assert.equal(chunks.length, 2);
+
+        // Silence is only added after the mid-sentence split
+        assert.equal(chunks[0].samples.length, 22050 + 11025);
+        assert.equal(chunks[1].samples.length, 22050);
+        assert.equal(chunks[1].isLast, true);
+    });
+
+    it('should return one chunk per sentence when batching', () => {
+        synth = new PiperSynthesizer(TEST_ALIGNMENTS_VOICE);
+        const text = 'This is a test. This is another test. And a third.';
+        const unbatched = synth.synthesize(text);
+        const chunks = synth.synthesize(text, { maxBatchSentences: 4 });
+
+        assert.equal(chunks.length, 3);
+        assert.equal(chunks[2].isLast, true);
+        assert.equal(chunks[0].phonemeIds[0], 1); // BOS
+        chunks.forEach((chunk, i) => {
+            assert.equal(chunk.samples.length, unbatched[i].samples.length);
+            assert.deepEqual(Array.from(chunk.alignments), Array.from(unbatched[i].alignments));
+            assert.deepEqual(Array.from(chunk.samples), Array.from(unbatched[i].samples));
+        });
+    });
+
+    it('should trim padding of length buckets', async () => {
+        const text = 'This is a test. This is another test.';
+        synth = new PiperSynthesizer(TEST_ALIGNMENTS_VOICE);
+        const unpadded = synth.synthesize(text);
+        synth.dispose();
+
+        // Padding ids have durations too, so untrimmed audio would be longer
+        synth = new PiperSynthesizer(TEST_ALIGNMENTS_VOICE, {
+            lengthBuckets: [64, 128],
+            warmupLengthBuckets: true,
+        });
+
+        // Async results take the output tensor instead of copying it
+        const results = [
+            synth.synthesize(text),
+            await synth.synthesizeAsync(text),
+            await synth.synthesizeStream(text).toArray(),
+        ];
+        for (const padded of results) {
+            assert.equal(padded.length, 2);
+            padded.forEach((chunk, i) => {
+                assert.ok(chunk.phonemeIds.length < 64);
+                assert.equal(chunk.alignments.length, chunk.phonemeIds.length);
+                assert.deepEqual(Array.from(chunk.alignments),
+                                 Array.from(unpadded[i].alignments));
+                assert.equal(chunk.samples.length, unpadded[i].samples.length);
+                assert.equal(chunk.samples.length,
+                             chunk.alignments.reduce((sum, count) => sum + count, 0));
+            });
+        }
+    });
+
+    it('should pack or skip chunk metadata', () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const text = 'This is a test.';
+        const [full] = synth.synthesize(text);
+        const [packed] = synth.synthesize(text, { metadata: 'packed' });
+        const [none] = synth.synthesize(text, { metadata: 'none' });
+
+        assert.deepEqual(Array.from(packed.phonemes), Array.from(full.phonemes));
+        assert.deepEqual(Array.from(packed.phonemeIds), Array.from(full.phonemeIds));
+        assert.equal(packed.phonemeIds.buffer, packed.phonemes.buffer);
+
+        assert.equal(none.phonemes, null);
+        assert.equal(none.phonemeIds, null);
+        assert.equal(none.alignments, null);
+        assert.equal(none.samples.length, full.samples.length);
+    });
+
+    it('should return the same chunks when phonemizing ahead', () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const text = 'This is a test. This is another test. And a third.';
+        const eager = synth.synthesize(text);
+        const pipelined = synth.synthesize(text, { phonemizeLookahead: 1 });
+
+        // The end may only be known after the last sentence, which adds an
+        // empty chunk
+        const spoken = pipelined.filter((chunk) => chunk.phonemeIds.length > 0);
+        assert.ok(pipelined.length - spoken.length <= 1);
+        assert.deepEqual(
+            spoken.map((chunk) => Array.from(chunk.phonemeIds)),
+            eager.map((chunk) => Array.from(chunk.phonemeIds)),
+        );
+        assert.deepEqual(
+            pipelined.map((chunk) => chunk.isLast),
+            pipelined.map((_, i) => i === pipelined.length - 1),
+        );
+    });
+
+    it('should synthesize a document to a file', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const text = 'This is a test. This is another test.\nAnd a third.\n';
+        const expected = synth.synthesize(text);
+
+        const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'piper-document-'));
+        try {
+            const input = path.join(dir, 'book.txt');
+            const output = path.join(dir, 'book.raw');
+            fs.writeFileSync(input, text);
+
+            const chunks = [];
+            const updates = [];
+            const progress = await synth.synthesizeDocument(input, {
+                output,
+                lookaheadChunks: 1,
+                onChunk: (chunk) => chunks.push(chunk),
+                onProgress: (update) => updates.push(update),
+            });
+
+            // May end with an empty chunk (see phonemizing ahead)
+            const spoken = chunks.filter((chunk) => chunk.phonemeIds.length > 0);
+            assert.deepEqual(
+                spoken.map((chunk) => Array.from(chunk.phonemeIds)),
+                expected.map((chunk) => Array.from(chunk.phonemeIds)),
+            );
+            assert.equal(updates.length, chunks.length);
+            assert.equal(progress.numChunks, chunks.length);
+            assert.equal(chunks[chunks.length - 1].isLast, true);
+            assert.equal(progress.textBytesDone, Buffer.byteLength(text));
+            assert.ok(progress.realTimeFactor > 0);
+
+            const numSamples = chunks.reduce((sum, chunk) => sum + chunk.samples.length, 0);
+            assert.equal(fs.statSync(output).size, numSamples * Float32Array.BYTES_PER_ELEMENT);
+        } finally {
+            fs.rmSync(dir, { recursive: true, force: true });
+        }
+    });
+
+    it('should throw for synchronous calls while a document is in flight', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'piper-document-'));
+        try {
+            const input = path.join(dir, 'book.txt');
+            fs.writeFileSync(input, 'This is a test. This is another test.\n');
+
+            const done = synth.synthesizeDocument(input, { onChunk: () => {} });
+            assert.throws(() => synth.synthesize('Hello.'), /busy/);
+            assert.throws(() => synth.warmup(), /busy/);
+            await done;
+        } finally {
+            fs.rmSync(dir, { recursive: true, force: true });
+        }
+
+        assert.ok(synth.synthesize('Hello.').length > 0);
+    });
+
+    it('should wait for slow document callbacks', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'piper-document-'));
+        try {
+            const input = path.join(dir, 'book.txt');
+            fs.writeFileSync(input, 'This is a test. '.repeat(40));
+
+            synth.resetStats();
+            const sleeper = new Int32Array(new SharedArrayBuffer(4));
+            let received = 0;
+            let maxAhead = 0;
+            await synth.synthesizeDocument(input, {
+                lookaheadChunks: 1,
+                onChunk: () => {
+                    received++;
+                    Atomics.wait(sleeper, 0, 0, 10);
+                    maxAhead = Math.max(maxAhead, synth.getStats().total.numChunks - received);
+                },
+            });
+
+            // A few events in flight, plus the chunk waiting to be sent
+            assert.equal(received, synth.getStats().total.numChunks);
+            assert.ok(maxAhead <= 6, `synthesis ran ${maxAhead} chunks ahead`);
+        } finally {
+            fs.rmSync(dir, { recursive: true, force: true });
+        }
+    });
+
+    it('should resample to the output sample rate', () => {
+        synth = new PiperSynthesizer(TEST_ALIGNMENTS_VOICE);
+        const text = 'This is a test. This is another test. And a third.';
+        const original = synth.synthesize(text);
+        const resampled = synth.synthesize(text, { outputSampleRate: 48000 });
+
+        assert.equal(resampled.length, original.length);
+        const originalSamples = original.reduce((sum, chunk) => sum + chunk.samples.length, 0);
+        const resampledSamples = resampled.reduce((sum, chunk) => sum + chunk.samples.length, 0);
+        // 22050 -> 48000 is 320/147, the filter tail is flushed with the last chunk
+        assert.equal(resampledSamples, Math.floor((originalSamples * 320 + 146) / 147));
+        resampled.forEach((chunk, i) => {
+            assert.equal(chunk.sampleRate, 48000);
+            assert.equal(chunk.pcm, null);
+            const sum = (alignments) => alignments.reduce((total, count) => total + count, 0);
+            assert.equal(sum(chunk.alignments),
+                         Math.floor((sum(original[i].alignments) * 320 + 73) / 147));
+        });
+
+        // Each chunk is whole cycles of a sine, so together they are one
+        // sine, which must stay continuous across the chunk boundaries
+        const samples = resampled.flatMap((chunk) => Array.from(chunk.samples));
+        const step = ((2 * Math.PI) / 64) * (22050 / 48000);
+        let maxError = 0;
+        for (let n = 64; n < samples.length - 64; n++) {
+            maxError = Math.max(maxError, Math.abs(samples[n] - 0.5 * Math.sin(n * step)));
+        }
+        assert.ok(maxError < 1e-3, `max error ${maxError}`);
+    });
+
+    it('should convert chunks to G.711', () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const [chunk] = synth.synthesize('This is a test.', {
+            outputSampleRate: 8000,
+            sampleFormat: 'mulaw',
+        });
+
+        assert.equal(chunk.sampleRate, 8000);
+        assert.ok(chunk.pcm instanceof Uint8Array);
+        assert.equal(chunk.pcm.length, chunk.samples.length);
+
+        const [int16Chunk] = synth.synthesize('This is a test.', { sampleFormat: 'int16' });
+        assert.deepEqual(int16Chunk.pcm, samplesToInt16(int16Chunk.samples));
+    });
+
+    it('should cache the optimized model', () => {
+        const cacheDir = fs.mkdtempSync(path.join(os.tmpdir(), 'piper-cache-'));
+        try {
+            synth = new PiperSynthesizer(TEST_VOICE, { optimizedModelCacheDir: cacheDir });
+            synth.dispose();
+
+            const cached = fs.readdirSync(cacheDir).filter((name) => name.endsWith('.onnx'));
+            assert.equal(cached.length, 1);
+
+            // Loads from the cache
+            synth = new PiperSynthesizer(TEST_VOICE, { optimizedModelCacheDir: cacheDir });
+            synth.warmup();
+            assert.equal(synth.synthesize('This is a test.').length, 1);
+        } finally {
+            synth.dispose();
+            synth = null;
+            fs.rmSync(cacheDir, { recursive: true, force: true });
+        }
+    });
+
+    it('should cache phoneme ids of repeated text', () => {
+        synth = new PiperSynthesizer(TEST_VOICE, { synthesisCacheBytes: 1 << 20 });
+        const first = synth.synthesize('Please hold.');
+        const second = synth.synthesize('  Please   hold. ');
+
+        assert.deepEqual(Array.from(second[0].phonemeIds), Array.from(first[0].phonemeIds));
+        const stats = synth.getCacheStats();
+        assert.equal(stats.misses, 1);
+        assert.equal(stats.hits, 1);
+        assert.equal(stats.numEntries, 1);
+        assert.ok(stats.sizeBytes > 0 && stats.sizeBytes <= stats.capacityBytes);
+
+        synth.clearCache();
+        assert.equal(synth.getCacheStats().numEntries, 0);
+    });
+
+    it('should return the same chunks for a cache hit as for a miss', () => {
+        const ids = (chunks) => chunks.map((chunk) => Array.from(chunk.phonemeIds));
+        const paragraphs = 'This is a test\n\nAnd another';
+        const joined = 'This is a test And another';
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const uncached = [paragraphs, joined].map((text) => ids(synth.synthesize(text)));
+        synth.dispose();
+
+        synth = new PiperSynthesizer(TEST_VOICE, { synthesisCacheBytes: 1 << 20 });
+        const miss = ids(synth.synthesize('Caf\u0065\u0301 time.'));
+        const hit = ids(synth.synthesize('Caf\u00e9 time.'));
+        assert.deepEqual(hit, miss);
+
+        // Line breaks are kept in the key, as espeak-ng may split at them
+        assert.deepEqual(ids(synth.synthesize(paragraphs)), uncached[0]);
+        assert.deepEqual(ids(synth.synthesize(joined)), uncached[1]);
+        assert.deepEqual(ids(synth.synthesize(paragraphs)), uncached[0]);
+
+        const stats = synth.getCacheStats();
+        assert.equal(stats.misses, 3);
+        assert.equal(stats.hits, 2);
+    });
+
+    it('should cache deterministic audio', () => {
+        synth = new PiperSynthesizer(TEST_VOICE, { synthesisCacheBytes: 1 << 24 });
+        const options = { noiseScale: 0, noiseWScale: 0, cacheAudio: true };
+        const first = synth.synthesize('This is a test. This is another test.', options);
+        const second = synth.synthesize('This is a test. This is another test.', options);
+
+        assert.equal(second.length, first.length);
+        assert.deepEqual(second[1].samples, first[1].samples);
+        assert.equal(second[1].isLast, true);
+        const stats = synth.getCacheStats();
+        assert.equal(stats.audioMisses, 1);
+        assert.equal(stats.audioHits, 1);
+    });
+
+    it('should report stage timings', () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        synth.synthesize('This is a test. This is another test.');
+
+        const stats = synth.getStats();
+        assert.equal(stats.numRequests, 1);
+        assert.equal(stats.total.numChunks, 2);
+        assert.equal(stats.total.numSamples, 44100);
+        assert.ok(stats.total.inferenceSeconds > 0);
+        assert.ok(stats.total.phonemizeSeconds > 0);
+        assert.ok(stats.total.realTimeFactor > 0);
+        assert.equal(stats.queueDepth, 0);
+
+        synth.synthesize('This is a test.');
+        const next = synth.getStats();
+        assert.equal(next.numRequests, 2);
+        assert.equal(next.lastRequest.numChunks, 1);
+        assert.equal(next.total.numChunks, 3);
+
+        synth.resetStats();
+        assert.equal(synth.getStats().total.numChunks, 0);
+    });
+
+    it('should write an onnxruntime profile', () => {
+        const profileDir = fs.mkdtempSync(path.join(os.tmpdir(), 'piper-profile-'));
+        try {
+            synth = new PiperSynthesizer(TEST_VOICE, {
+                profileFilePrefix: path.join(profileDir, 'piper'),
+            });
+            synth.synthesize('This is a test.');
+
+            const profilePath = synth.endProfiling();
+            assert.ok(fs.existsSync(profilePath));
+            assert.equal(synth.endProfiling(), null);
+        } finally {
+            synth.dispose();
+            synth = null;
+            fs.rmSync(profileDir, { recursive: true, force: true });
+        }
+    });
+
     it('should return empty array for empty text', () => {
         synth = new PiperSynthesizer(TEST_VOICE);
         const chunks = synth.synthesize('');
@@ -96,6 +514,146 @@ describe('PiperSynthesizer', () => {
         assert.equal(chunks.length, 0);
     });
 
+    it('should synthesize asynchronously', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const chunks = await synth.synthesizeAsync('This is a test. This is another test.');
+
+        assert.equal(chunks.length, 2);
+        assert.equal(chunks[0].samples.length, 22050);
+        assert.equal(chunks[0].isLast, false);
+        assert.equal(chunks[1].isLast, true);
+    });
+
+    it('should serialize concurrent async calls', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const [first, second] = await Promise.all([
+            synth.synthesizeAsync('This is a test.'),
+            synth.synthesizeAsync('This is a test. This is another test.'),
+        ]);
+
+        assert.equal(first.length, 1);
+        assert.equal(second.length, 2);
+    });
+
+    it('should stream chunks as they are synthesized', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const chunks = [];
+        for await (const chunk of synth.synthesizeStream('This is a test. This is another test.')) {
+            chunks.push(chunk);
+        }
+
+        assert.equal(chunks.length, 2);
+        assert.equal(chunks[0].samples.length, 22050);
+        assert.equal(chunks[0].isLast, false);
+        assert.equal(chunks[1].isLast, true);
+    });
+
+    it('should reject with the abort reason when cancelled', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const controller = new AbortController();
+        const text = Array(50).fill('This is a test.').join(' ');
+        const promise = synth.synthesizeAsync(text, { signal: controller.signal });
+        controller.abort();
+
+        await assert.rejects(promise, { name: 'AbortError' });
+        await assert.rejects(synth.synthesizeAsync('Test.', { signal: AbortSignal.abort() }),
+                             { name: 'AbortError' });
+
+        // The synthesizer is usable again
+        const chunks = await synth.synthesizeAsync('This is a test.');
+        assert.equal(chunks.length, 1);
+    });
+
+    it('should cancel a stream when it is destroyed', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const stream = synth.synthesizeStream(Array(50).fill('This is a test.').join(' '));
+        let count = 0;
+        for await (const chunk of stream) {
+            assert.ok(chunk.samples.length > 0);
+            if (++count === 2) {
+                break;
+            }
+        }
+
+        assert.equal(count, 2);
+        const chunks = await synth.synthesizeAsync('This is a test.');
+        assert.equal(chunks.length, 1);
+    });
+
+    it('should pause synthesis while the stream is not read', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        synth.resetStats();
+        const stream = synth.synthesizeStream(Array(50).fill('This is a test.').join(' '));
+        await new Promise((resolve) => setTimeout(resolve, 200));
+
+        // The stream's buffer, plus the chunk waiting to be pushed
+        const ahead = synth.getStats().total.numChunks;
+        assert.ok(ahead <= stream.readableHighWaterMark + 1, `synthesized ${ahead} chunks`);
+        assert.throws(() => synth.synthesize('Hello.'), /busy/);
+
+        const chunks = await stream.toArray();
+        assert.equal(chunks.length, 50);
+        assert.equal(synth.synthesize('Hello.').length, 1);
+    });
+
+    it('should keep unread streams off the libuv thread pool', async () => {
+        const text = Array(50).fill('This is a test.').join(' ');
+        const synths = Array.from({ length: 5 }, () => new PiperSynthesizer(TEST_VOICE));
+        try {
+            // More paused streams and queued requests than libuv has threads
+            const streams = synths.map((other) => other.synthesizeStream(text));
+            const queued = [1, 2, 3, 4].map(() => synths[0].synthesizeAsync('This is a test.'));
+            await new Promise((resolve) => setTimeout(resolve, 100));
+
+            const read = fs.promises.readFile(TEST_VOICE);
+            const timeout = new Promise((_, reject) => {
+                setTimeout(() => reject(new Error('libuv thread pool is blocked')), 5000).unref();
+            });
+            assert.ok((await Promise.race([read, timeout])).length > 0);
+
+            streams.forEach((stream) => stream.destroy());
+            for (const chunks of await Promise.all(queued)) {
+                assert.equal(chunks.length, 1);
+            }
+        } finally {
+            synths.forEach((other) => other.dispose());
+        }
+    });
+
+    it('should fail after the timeout', () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const text = Array(50).fill('This is a test.').join(' ');
+
+        assert.throws(() => synth.synthesize(text, { timeoutMs: 1 }), /timed out/);
+    });
+
+    it('should end an empty stream for empty text', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const chunks = await synth.synthesizeStream('').toArray();
+
+        assert.equal(chunks.length, 0);
+    });
+
+    it('should error the stream after dispose', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        synth.dispose();
+
+        await assert.rejects(synth.synthesizeStream('Test.').toArray(), {
+            message: /disposed/,
+        });
+        synth = null;
+    });
+
+    it('should reject async calls after dispose', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        synth.dispose();
+
+        await assert.rejects(synth.synthesizeAsync('Test.'), {
+            message: /disposed/,
+        });
+        synth = null;
+    });
+
     it('should throw after dispose', () => {
         synth = new PiperSynthesizer(TEST_VOICE);
         synth.dispose();
@@ -109,6 +667,63 @@ describe('PiperSynthesizer', () => {
         synth = null;
     });
 
+    it('should accept create options', () => {
+        synth = new PiperSynthesizer(TEST_VOICE, {
+            intraOpNumThreads: 1,
+            interOpNumThreads: 1,
+            allowSpinning: false,
+            graphOptimizationLevel: 'basic',
+            executionProvider: 'cpu',
+        });
+        const chunks = synth.synthesize('Test.');
+
+        assert.equal(chunks.length, 1);
+    });
+
+    it('should run synthesizers on the global thread pool', () => {
+        // The pool must exist before the first synthesizer, so use a fresh process
+        const lib = pathToFileURL(path.join(__dirname, '..', 'lib', 'index.js')).href;
+        const script = `
+            import { PiperSynthesizer, initGlobalThreadPool } from ${JSON.stringify(lib)};
+            initGlobalThreadPool({ intraOpNumThreads: 1, interOpNumThreads: 1 });
+            const voice = ${JSON.stringify(TEST_VOICE)};
+            const a = new PiperSynthesizer(voice, { useGlobalThreadPool: true });
+            const b = new PiperSynthesizer(voice, { useGlobalThreadPool: true });
+            let lateInit = 'ok';
+            try { initGlobalThreadPool(); } catch (e) { lateInit = e.message; }
+            console.log(JSON.stringify({
+                a: a.synthesize('Test.').length,
+                b: b.synthesize('Test. Test.').length,
+                lateInit,
+            }));
+        `;
+        const output = execFileSync(process.execPath, ['--input-type=module', '-e', script], {
+            encoding: 'utf8',
+        });
+        const result = JSON.parse(output);
+
+        assert.equal(result.a, 1);
+        assert.equal(result.b, 2);
+        assert.match(result.lateInit, /before any synthesizer/);
+    });
+
+    it('should throw for the global thread pool after private threads', () => {
+        // Creates the process environment without a global pool
+        synth = new PiperSynthesizer(TEST_VOICE);
+
+        assert.throws(
+            () => new PiperSynthesizer(TEST_VOICE, { useGlobalThreadPool: true }),
+            /global thread pool/
+        );
+    });
+
+    it('should throw for unknown execution provider', () => {
+        assert.throws(
+            () => new PiperSynthesizer(TEST_VOICE, { executionProvider: 'tpu' }),
+            { name: 'TypeError' }
+        );
+    });
+
     it('should throw for invalid model path', () => {
         assert.throws(
             () => new PiperSynthesizer('/nonexistent/model.onnx'),
@@ -123,6 +738,194 @@ describe('PiperSynthesizer', () => {
     });
 });
 
+describe('PiperVoice', () => {
+    it('should share one voice between synthesizers', () => {
+        const voice = new PiperVoice(TEST_VOICE);
+        const first = new PiperSynthesizer(voice);
+        const second = new PiperSynthesizer(voice);
+
+        // Synthesizers keep the voice alive
+        voice.dispose();
+
+        const text = 'This is a test. This is another test.';
+        assert.deepEqual(
+            first.synthesize(text).map((chunk) => Array.from(chunk.phonemeIds)),
+            second.synthesize(text).map((chunk) => Array.from(chunk.phonemeIds))
+        );
+
+        first.dispose();
+        second.dispose();
+    });
+
+    it('should create a pool from a voice', async () => {
+        const voice = new PiperVoice(TEST_VOICE);
+        const pool = new PiperPool(voice, { workers: 2 });
+        voice.dispose();
+
+        const chunks = await pool.synthesizeAsync('This is a test.');
+        assert.equal(chunks.length, 1);
+
+        pool.dispose();
+    });
+
+    it('should load a voice from memory', () => {
+        const model = fs.readFileSync(TEST_VOICE);
+        const config = JSON.parse(fs.readFileSync(`${TEST_VOICE}.json`, 'utf8'));
+        const voice = new PiperVoice(model, { config });
+        const synth = new PiperSynthesizer(voice);
+        voice.dispose();
+
+        const chunks = synth.synthesize('This is a test.');
+        assert.equal(chunks.length, 1);
+        assert.equal(chunks[0].samples.length, 22050);
+
+        synth.dispose();
+    });
+
+    it('should require a config with a model buffer', () => {
+        const model = fs.readFileSync(TEST_VOICE);
+        assert.throws(() => new PiperSynthesizer(model), TypeError);
+    });
+
+    it('should throw for a disposed voice', () => {
+        const voice = new PiperVoice(TEST_VOICE);
+        voice.dispose();
+
+        assert.throws(() => new PiperSynthesizer(voice), /disposed/);
+    });
+
+    it('should share a voice with worker threads', async () => {
+        const voice = new PiperVoice(TEST_VOICE);
+        const handle = voice.share();
+
+        const worker = new Worker(
+            `
+            const { parentPort, workerData } = require('node:worker_threads');
+            const { PiperVoice, PiperSynthesizer } = require(workerData.libPath);
+            const voice = PiperVoice.fromHandle(workerData.handle);
+            const synth = new PiperSynthesizer(voice);
+            voice.dispose();
+            const chunks = synth.synthesize('This is a test.');
+            parentPort.postMessage(chunks[0].samples.length);
+            synth.dispose();
+            `,
+            {
+                eval: true,
+                workerData: { handle, libPath: path.join(__dirname, '..', 'lib', 'index.js') },
+            }
+        );
+        const numSamples = await new Promise((resolve, reject) => {
+            worker.once('message', resolve);
+            worker.once('error', reject);
+        });
+        await worker.terminate();
+        assert.equal(numSamples, 22050);
+
+        // Handles can't be opened once the sharing voice is disposed
+        voice.dispose();
+        assert.throws(() => PiperVoice.fromHandle(handle), /disposed/);
+    });
+});
+
+describe('PiperPool', () => {
+    let pool;
+
+    afterEach(() => {
+        if (pool) {
+            pool.dispose();
+            pool = null;
+        }
+    });
+
+    it('should return chunks in order', async () => {
+        pool = new PiperPool(TEST_VOICE, { workers: 2 });
+        assert.equal(pool.workers, 2);
+
+        const chunks = await pool.synthesizeAsync(
+            'This is a test. This is another test. And a third.'
+        );
+
+        assert.equal(chunks.length, 3);
+        assert.equal(chunks[0].samples.length, 22050);
+        assert.equal(chunks[0].isLast, false);
+        assert.equal(chunks[2].isLast, true);
+    });
+
+    it('should serve concurrent requests', async () => {
+        pool = new PiperPool(TEST_VOICE, { workers: 2 });
+        const results = await Promise.all([
+            pool.synthesizeAsync('This is a test.'),
+            pool.synthesizeAsync('This is a test. This is another test.'),
+            pool.synthesizeAsync(''),
+        ]);
+
+        assert.deepEqual(results.map((chunks) => chunks.length), [1, 2, 0]);
+    });
+
+    it('should cancel a request', async () => {
+        pool = new PiperPool(TEST_VOICE, { workers: 2 });
+        const controller = new AbortController();
+        const promise = pool.synthesizeAsync(Array(50).fill('This is a test.').join(' '), {
+            signal: controller.signal,
+        });
+        controller.abort();
+
+        await assert.rejects(promise, { name: 'AbortError' });
+    });
+
+    it('should reject after dispose', async () => {
+        pool = new PiperPool(TEST_VOICE, { workers: 1 });
+        pool.dispose();
+
+        await assert.rejects(() => pool.synthesizeAsync('This is a test.'), /disposed/);
+        pool = null;
+    });
+});
+
+describe('PiperBatcher', () => {
+    let batcher;
+
+    afterEach(() => {
+        if (batcher) {
+            batcher.dispose();
+            batcher = null;
+        }
+    });
+
+    it('should batch concurrent requests', async () => {
+        const texts = ['This is a test.', 'This is another test. And a third.', 'Test.', ''];
+        const synth = new PiperSynthesizer(TEST_ALIGNMENTS_VOICE);
+        const expected = texts.map((text) => synth.synthesize(text));
+        synth.dispose();
+
+        batcher = new PiperBatcher(TEST_ALIGNMENTS_VOICE, { maxBatchSize: 4, maxWaitMs: 50 });
+        const results = await Promise.all(texts.map((text) => batcher.synthesizeAsync(text)));
+
+        // Each request gets its own audio back out of the batch
+        assert.deepEqual(results.map((chunks) => chunks.length), [1, 2, 1, 0]);
+        results.forEach((chunks, i) => {
+            chunks.forEach((chunk, j) => {
+                assert.deepEqual(Array.from(chunk.alignments), Array.from(expected[i][j].alignments));
+                assert.deepEqual(Array.from(chunk.samples), Array.from(expected[i][j].samples));
+            });
+        });
+
+        const stats = batcher.getStats();
+        assert.equal(stats.numChunks, 4);
+        assert.ok(stats.numBatches < stats.numChunks);
+    });
+
+    it('should fill batches larger than the libuv thread pool', async () => {
+        // The libuv pool has 4 threads by default
+        batcher = new PiperBatcher(TEST_ALIGNMENTS_VOICE, { maxBatchSize: 6, maxWaitMs: 1000 });
+        await Promise.all(Array.from({ length: 6 }, () => batcher.synthesizeAsync('This is a test.')));
+
+        const stats = batcher.getStats();
+        assert.equal(stats.numChunks, 6);
+        assert.equal(stats.numBatches, 1);
+    });
+});
+
 describe('chunksToWavBuffer', () => {
     let synth;
 
@@ -164,6 +967,92 @@ describe('chunksToWavBuffer', () => {
     });
 });
 
+describe('WavEncoder', () => {
+    let synth;
+
+    afterEach(() => {
+        if (synth) {
+            synth.dispose();
+            synth = null;
+        }
+    });
+
+    it('should stream the same PCM as chunksToWavBuffer', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const text = 'This is a test. This is another test.';
+        const expected = chunksToWavBuffer(synth.synthesize(text));
+
+        const parts = [];
+        const encoder = new WavEncoder();
+        encoder.on('data', (part) => parts.push(part));
+        const ended = new Promise((resolve) => encoder.on('end', resolve));
+        synth.synthesizeStream(text).pipe(encoder);
+        await ended;
+
+        const wav = Buffer.concat(parts);
+        assert.equal(wav.length, expected.length);
+        assert.equal(wav.readUInt32LE(40), 0xFFFFFFFF);
+        assert.ok(wav.subarray(44).equals(expected.subarray(44)));
+        assert.ok(encoder.header().equals(expected.subarray(0, 44)));
+    });
+
+    it('should write a WAV file with patched sizes', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const text = 'This is a test. This is another test.';
+        const expected = chunksToWavBuffer(synth.synthesize(text));
+
+        const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'piper-wav-'));
+        try {
+            const filePath = path.join(dir, 'test.wav');
+            const numSamples = await writeWavFile(filePath, synth.synthesizeStream(text));
+
+            assert.equal(numSamples, 22050 * 2);
+            assert.ok(fs.readFileSync(filePath).equals(expected));
+        } finally {
+            fs.rmSync(dir, { recursive: true, force: true });
+        }
+    });
+
+    it('should patch the sizes of a piped WAV file', async () => {
+        synth = new PiperSynthesizer(TEST_VOICE);
+        const text = 'This is a test. This is another test.';
+        const expected = chunksToWavBuffer(synth.synthesize(text));
+
+        const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'piper-wav-'));
+        try {
+            const filePath = path.join(dir, 'test.wav');
+            const writer = new WavFileWriter(filePath);
+            await pipeline(synth.synthesizeStream(text), writer);
+
+            const wav = fs.readFileSync(filePath);
+            assert.equal(writer.sampleRate, 22050);
+            assert.equal(wav.readUInt32LE(4), 36 + writer.numSamples * 2);
+            assert.equal(wav.readUInt32LE(40), writer.numSamples * 2);
+            assert.ok(wav.equals(expected));
+        } finally {
+            fs.rmSync(dir, { recursive: true, force: true });
+        }
+    });
+
+    it('should write the header of an empty WAV file', async () => {
+        const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'piper-wav-'));
+        try {
+            const filePath = path.join(dir, 'empty.wav');
+            await pipeline(Readable.from([]), new WavFileWriter(filePath, { sampleRate: 16000 }));
+
+            const wav = fs.readFileSync(filePath);
+            assert.equal(wav.length, 44);
+            assert.equal(wav.readUInt32LE(4), 36);
+            assert.equal(wav.readUInt32LE(24), 16000);
+            assert.equal(wav.readUInt32LE(40), 0);
+
+            await assert.rejects(writeWavFile(path.join(dir, 'none.wav'), []), /No audio chunks/);
+        } finally {
+            fs.rmSync(dir, { recursive: true, force: true });
+        }
+    });
+});
+
 describe('samplesToInt16', () => {
     it('should convert float samples to int16', () => {
         const float32 = new Float32Array([0, 1, -1, 0.5, -0.5]);
@@ -183,4 +1072,21 @@ describe('samplesToInt16', () => {
         assert.equal(int16[0], 32767);
         assert.equal(int16[1], -32768);
     });
+
+    it('should match Math.round conversion exactly', () => {
+        const edges = [NaN, Infinity, -Infinity, -0, 0.5 / 32767, -0.5 / 32768,
+            1.5 / 32767, -1.5 / 32768, 1e-30, -1e-30];
+        const float32 = new Float32Array(1003);
+        float32.set(edges);
+        for (let i = edges.length; i < float32.length; i++) {
+            float32[i] = Math.random() * 2.4 - 1.2;
+        }
+
+        const int16 = samplesToInt16(float32);
+        for (let i = 0; i < float32.length; i++) {
+            const s = Math.max(-1, Math.min(1, float32[i]));
+            const expected = Math.round(s < 0 ? s * 32768 : s * 32767) || 0;
+            assert.equal(int16[i], expected, `sample ${float32[i]}`);
+        }
+    });
 });
@@ -1,13 +1,20 @@
-"""Generate a test onnx voice model that generates silence.
+"""Generate test onnx voice models.
+
+* test_voice.onnx generates silence
+* test_voice_alignments.onnx also outputs phoneme durations (alignments)
+* test_voice_embedding.onnx takes a speaker embedding
 
 Requires torch and onnx.
 """
 
 import json
+import math
 from pathlib import Path
-from typing import Optional
+from typing import Any, Dict, List, Optional, Union
 
+import onnx
 import torch
+from onnx import TensorProto, helper
 from torch import nn
 
 from piper import PiperConfig
@@ -16,8 +23,20 @@ _DIR = Path(__file__).parent
 _TESTS_DIR = _DIR
 _TEST_VOICE = _TESTS_DIR / "test_voice.onnx"
 _TEST_CONFIG = f"{_TEST_VOICE}.json"
+_ALIGNMENTS_VOICE = _TESTS_DIR / "test_voice_alignments.onnx"
+_EMBEDDING_VOICE = _TESTS_DIR / "test_voice_embedding.onnx"
 
 OPSET_VERSION = 15
+IR_VERSION = 8
+
+# Samples per alignment frame (DEFAULT_HOP_LENGTH in libpiper)
+HOP_LENGTH = 256
+
+# Divides HOP_LENGTH, so the audio of every phoneme is whole sine cycles
+SINE_PERIOD = 64
+SINE_AMPLITUDE = 0.5
+
+SPEAKER_EMBEDDING_SIZE = 4
 
 
 class TestGenerator(nn.Module):
@@ -46,8 +65,184 @@ class TestGenerator(nn.Module):
         return audio.unsqueeze(1)
 
 
+def _constant(
+    name: str,
+    value: Union[int, float, List[int]],
+    data_type: int = TensorProto.INT64,
+) -> onnx.NodeProto:
+    """Constant node with a scalar or 1-D value."""
+    values = value if isinstance(value, list) else [value]
+    dims = [len(values)] if isinstance(value, list) else []
+
+    return helper.make_node(
+        "Constant",
+        [],
+        [name],
+        value=helper.make_tensor(name, data_type, dims, values),
+    )
+
+
+def _voice_inputs() -> List[onnx.ValueInfoProto]:
+    """Inputs of every Piper voice (without speaker selection)."""
+    return [
+        helper.make_tensor_value_info(
+            "input", TensorProto.INT64, ["batch_size", "phonemes"]
+        ),
+        helper.make_tensor_value_info(
+            "input_lengths", TensorProto.INT64, ["batch_size"]
+        ),
+        helper.make_tensor_value_info("scales", TensorProto.FLOAT, [3]),
+    ]
+
+
+def _save_voice(
+    path: Path,
+    graph: onnx.GraphProto,
+    config_dict: Dict[str, Any],
+) -> None:
+    """Check and save a voice model with a copy of the test config."""
+    model = helper.make_model(
+        graph,
+        producer_name="piper",
+        opset_imports=[helper.make_opsetid("", OPSET_VERSION)],
+        ir_version=IR_VERSION,
+    )
+    onnx.checker.check_model(model)
+    onnx.save(model, str(path))
+
+    with open(f"{path}.json", "w", encoding="utf-8") as config_file:
+        json.dump(config_dict, config_file, indent=2, ensure_ascii=False)
+        config_file.write("\n")
+
+    print(path)
+
+
+def export_alignments_voice(config_dict: Dict[str, Any]) -> None:
+    """Export a test voice with alignments.
+
+    A phoneme with id i lasts 1 + (i % 3) frames of HOP_LENGTH samples, padding
+    included, so batched and bucket-padded output must be split or trimmed
+    with the durations to match a single sentence. The audio is a sine that
+    runs for every frame of the longest row, starting over in each chunk.
+    """
+    float_type = TensorProto.FLOAT
+    nodes = [
+        _constant("three", 3),
+        _constant("one", 1),
+        _constant("zero", 0),
+        _constant("phoneme_axis", [1]),
+        _constant("batch_dim", [0]),
+        _constant("channel_dims", [1]),
+        _constant("hop_length", float(HOP_LENGTH), float_type),
+        _constant("sine_step", 2.0 * math.pi / SINE_PERIOD, float_type),
+        _constant("amplitude", SINE_AMPLITUDE, float_type),
+        # Durations in frames [batch_size, 1, phonemes]
+        helper.make_node("Mod", ["input", "three"], ["id_mod"]),
+        helper.make_node("Add", ["id_mod", "one"], ["frames"]),
+        helper.make_node("Cast", ["frames"], ["frames_float"], to=float_type),
+        helper.make_node(
+            "Unsqueeze", ["frames_float", "phoneme_axis"], ["durations"]
+        ),
+        # Samples of the longest row
+        helper.make_node(
+            "ReduceSum",
+            ["frames_float", "phoneme_axis"],
+            ["row_frames"],
+            keepdims=0,
+        ),
+        helper.make_node("ReduceMax", ["row_frames"], ["max_frames"], keepdims=0),
+        helper.make_node(
+            "Mul", ["max_frames", "hop_length"], ["num_samples_float"]
+        ),
+        helper.make_node(
+            "Cast", ["num_samples_float"], ["num_samples"], to=TensorProto.INT64
+        ),
+        # Sine [batch_size, 1, time]
+        helper.make_node(
+            "Range", ["zero", "num_samples", "one"], ["sample_index"]
+        ),
+        helper.make_node(
+            "Cast", ["sample_index"], ["sample_index_float"], to=float_type
+        ),
+        helper.make_node("Mul", ["sample_index_float", "sine_step"], ["phase"]),
+        helper.make_node("Sin", ["phase"], ["sine"]),
+        helper.make_node("Mul", ["sine", "amplitude"], ["wave"]),
+        helper.make_node("Shape", ["input"], ["input_shape"]),
+        helper.make_node(
+            "Gather", ["input_shape", "batch_dim"], ["batch_size"], axis=0
+        ),
+        helper.make_node("Shape", ["wave"], ["wave_shape"]),
+        helper.make_node(
+            "Concat",
+            ["batch_size", "channel_dims", "wave_shape"],
+            ["output_shape"],
+            axis=0,
+        ),
+        helper.make_node("Expand", ["wave", "output_shape"], ["output"]),
+    ]
+
+    graph = helper.make_graph(
+        nodes,
+        "main_graph",
+        _voice_inputs(),
+        [
+            helper.make_tensor_value_info(
+                "output", float_type, ["batch_size", 1, "time"]
+            ),
+            helper.make_tensor_value_info(
+                "durations", float_type, ["batch_size", 1, "phonemes"]
+            ),
+        ],
+    )
+    _save_voice(_ALIGNMENTS_VOICE, graph, config_dict)
+
+
+def export_embedding_voice(config_dict: Dict[str, Any]) -> None:
+    """Export a test voice that takes a speaker embedding.
+
+    Every sample of a row is the mean of its speaker embedding (1 sec).
+    """
+    float_type = TensorProto.FLOAT
+    nodes = [
+        _constant("batch_dim", [0]),
+        _constant("channel_dims", [1]),
+        _constant("time_dims", [22050]),
+        _constant("time_axis", [2]),
+        helper.make_node(
+            "ReduceMean", ["speaker_embedding"], ["mean"], axes=[1], keepdims=1
+        ),
+        helper.make_node("Unsqueeze", ["mean", "time_axis"], ["mean_3d"]),
+        helper.make_node("Shape", ["input"], ["input_shape"]),
+        helper.make_node(
+            "Gather", ["input_shape", "batch_dim"], ["batch_size"], axis=0
+        ),
+        helper.make_node(
+            "Concat",
+            ["batch_size", "channel_dims", "time_dims"],
+            ["output_shape"],
+            axis=0,
+        ),
+        helper.make_node("Expand", ["mean_3d", "output_shape"], ["output"]),
+    ]
+
+    graph = helper.make_graph(
+        nodes,
+        "main_graph",
+        _voice_inputs()
+        + [
+            helper.make_tensor_value_info(
+                "speaker_embedding",
+                float_type,
+                ["batch_size", SPEAKER_EMBEDDING_SIZE],
+            )
+        ],
+        [helper.make_tensor_value_info("output", float_type, ["batch_size", 1, 22050])],
+    )
+    _save_voice(_EMBEDDING_VOICE, graph, config_dict)
+
+
 def main() -> None:
-    """Export test voice."""
+    """Export test voices."""
     with open(_TEST_CONFIG, "r", encoding="utf-8") as config_file:
         config_dict = json.load(config_file)
         config = PiperConfig.from_dict(config_dict)
@@ -83,6 +278,9 @@ def main() -> None:
 
     print(_TEST_VOICE)
 
+    export_alignments_voice(config_dict)
+    export_embedding_voice(config_dict)
+
 
 # -----------------------------------------------------------------------------
 